@@ -2,7 +2,14 @@
 If( Test-Path "..\shaderc\glslc\Debug\glslc.exe"){
   Write-Host "Found glslc."
   ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=vertex ./test.vs -o ./test_vs.spv
+  ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=vertex ./test_ssbo.vs -o ./test_ssbo_vs.spv
+  ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=vertex ./test_inst.vs -o ./test_inst_vs.spv
   ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=fragment ./test.fs -o ./test_fs.spv
+  ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=fragment ./test_bindless.fs -o ./test_bindless_fs.spv
+  ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=compute ./instance_update.cs -o ./instance_update_cs.spv
+  ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=vertex ./test_cull.vs -o ./test_cull_vs.spv
+  ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=compute ./instance_cull.cs -o ./instance_cull_cs.spv
+  ..\shaderc\glslc\Debug\glslc.exe -fshader-stage=compute ./hiz_reduce.cs -o ./hiz_reduce_cs.spv
 }
 Else{
   Write-Host "shaderc not found - Download/Build shaderc and place in ..\shaderc\glslc\Debug\"
@@ -48,6 +48,8 @@ if [[ -f $glslc_bin ]]; then
       type="fragment"
     elif [[ "${ext,,}" = "gs" ]]; then
       type="geometry"
+    elif [[ "${ext,,}" = "cs" ]]; then
+      type="compute"
     fi
     if (( $debug )); then
       echo type=${type}
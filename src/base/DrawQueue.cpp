@@ -0,0 +1,246 @@
+#include "./DrawQueue.h"
+#include "./VulkanClasses.h"
+#include "./GWorld.h"
+
+namespace VG {
+
+#pragma region DrawBindings
+
+DrawBindings& DrawBindings::ubo(const string_t& name, std::shared_ptr<VulkanBuffer> buf, VkDeviceSize offset, VkDeviceSize range) {
+  Entry e;
+  e._kind = Kind::UBO;
+  e._name = name;
+  e._buffer = buf;
+  e._offset = offset;
+  e._range = range;
+  _entries.push_back(e);
+  return *this;
+}
+DrawBindings& DrawBindings::storageBuffer(const string_t& name, std::shared_ptr<VulkanBuffer> buf, VkDeviceSize offset, VkDeviceSize range) {
+  Entry e;
+  e._kind = Kind::StorageBuffer;
+  e._name = name;
+  e._buffer = buf;
+  e._offset = offset;
+  e._range = range;
+  _entries.push_back(e);
+  return *this;
+}
+DrawBindings& DrawBindings::sampler(const string_t& name, std::shared_ptr<TextureImage> texture) {
+  Entry e;
+  e._kind = Kind::Sampler;
+  e._name = name;
+  e._texture = texture;
+  _entries.push_back(e);
+  return *this;
+}
+DrawBindings& DrawBindings::bindlessTexture(std::shared_ptr<TextureImage> texture) {
+  Entry e;
+  e._kind = Kind::BindlessTexture;
+  e._texture = texture;
+  _entries.push_back(e);
+  return *this;
+}
+bool DrawBindings::bind(CommandBuffer* cmd, PipelineShader* shader) const {
+  bool ret = true;
+  for (auto& e : _entries) {
+    if (e._kind == Kind::UBO) {
+      ret = shader->bindUBO(e._name, e._buffer, e._offset, e._range) && ret;
+    }
+    else if (e._kind == Kind::StorageBuffer) {
+      ret = shader->bindStorageBuffer(e._name, e._buffer, e._offset, e._range) && ret;
+    }
+    else if (e._kind == Kind::Sampler) {
+      ret = shader->bindSampler(e._name, e._texture) && ret;
+    }
+    else {
+      //Needs the pipeline for its layout, so only materials (bound after the pipeline) can use it.
+      uint32_t index = e._texture->bindlessIndex();
+      if (index == BindlessTextureTable::c_invalidIndex || shader->boundPipeline() == nullptr) {
+        BRLogErrorCycle("Texture '" + e._texture->name() + "' has no bindless index or no pipeline was bound.");
+        ret = false;
+      }
+      else {
+        cmd->pushConstants(shader->boundPipeline(), index);
+      }
+    }
+  }
+  return ret;
+}
+
+#pragma endregion
+
+#pragma region DrawQueue
+
+void DrawQueueStats::add(const DrawQueueStats& rhs) {
+  _draws += rhs._draws;
+  _drawCalls += rhs._drawCalls;
+  _pipelineBinds += rhs._pipelineBinds;
+  _descriptorBinds += rhs._descriptorBinds;
+  _meshBinds += rhs._meshBinds;
+  _unsortedPipelineBinds += rhs._unsortedPipelineBinds;
+  _unsortedDescriptorBinds += rhs._unsortedDescriptorBinds;
+  _unsortedMeshBinds += rhs._unsortedMeshBinds;
+  _sortMs += rhs._sortMs;
+  _recordMs += rhs._recordMs;
+}
+void DrawQueue::clear() {
+  _packets.clear();
+  _items.clear();
+  _pipelineIds.clear();
+  _materialIds.clear();
+  _meshIds.clear();
+}
+void DrawQueue::submit(DrawPacket&& packet, uint8_t layer) {
+  AssertOrThrow2(packet._mesh != nullptr);
+  size_t pipelineId = std::find(_pipelineIds.begin(), _pipelineIds.end(), packet._pipeline) - _pipelineIds.begin();
+  if (pipelineId == _pipelineIds.size()) {
+    _pipelineIds.push_back(packet._pipeline);
+  }
+  auto mat = _materialIds.insert(std::make_pair(packet._material.get(), (uint16_t)saturate(_materialIds.size())));
+  MeshBinding mb;
+  mb._mesh = packet._mesh.get();
+  mb._streams = packet._instanceStreams;
+  auto mesh = _meshIds.insert(std::make_pair(std::move(mb), (uint16_t)saturate(_meshIds.size())));
+
+  packet._key = ((uint64_t)layer << c_layerShift) |
+                (saturate(pipelineId) << c_pipelineShift) |
+                ((uint64_t)mat.first->second << c_materialShift) |
+                ((uint64_t)mesh.first->second << c_meshShift);
+  _items.push_back({ packet._key, static_cast<uint32_t>(_packets.size()) });
+  _packets.push_back(std::move(packet));
+}
+bool DrawQueue::record(CommandBuffer* cmd, PipelineShader* shader, const DrawBindings& passBindings, const BR2::urect2& viewport) {
+  _stats.reset();
+  _stats._draws = _packets.size();
+  if (_packets.size() == 0) {
+    return true;
+  }
+  countBinds(_items, _stats._unsortedPipelineBinds, _stats._unsortedDescriptorBinds, _stats._unsortedMeshBinds);
+  auto t0 = std::chrono::high_resolution_clock::now();
+  radixSort(_items, _scratch);
+  _stats._sortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+  bool ret = recordSorted(cmd, shader, passBindings, viewport);
+  _stats._recordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+  return ret;
+}
+bool DrawQueue::recordSorted(CommandBuffer* cmd, PipelineShader* shader, const DrawBindings& passBindings, const BR2::urect2& viewport) {
+  //Pass data stays in the shader's slots, materials only overwrite their own names.
+  if (!passBindings.bind(cmd, shader)) {
+    return false;
+  }
+  const DrawPacket* last = nullptr;
+  for (auto& item : _items) {
+    const DrawPacket& p = _packets[item._index];
+    if (last == nullptr || p._pipeline != last->_pipeline) {
+      //Same shader, so the bound descriptor sets stay compatible.
+      if (!shader->bindPipeline(cmd, p._pipeline._vertexFormat, p._pipeline._polygonMode, p._pipeline._topology, p._pipeline._cullMode)) {
+        return false;
+      }
+      if (last == nullptr) {
+        shader->bindViewport(cmd, viewport);
+      }
+      _stats._pipelineBinds++;
+    }
+    if (last == nullptr || p._material != last->_material) {
+      if (p._material != nullptr && !p._material->bind(cmd, shader)) {
+        return false;
+      }
+      if (!shader->bindDescriptors(cmd)) {
+        return false;
+      }
+      _stats._descriptorBinds++;
+    }
+    if (last == nullptr || p._mesh != last->_mesh || p._instanceStreams != last->_instanceStreams) {
+      cmd->bindMesh(p._mesh, p._instanceStreams);
+      _stats._meshBinds++;
+    }
+    if (!drawPacket(cmd, shader, p)) {
+      return false;
+    }
+    last = &p;
+  }
+  return true;
+}
+bool DrawQueue::drawPacket(CommandBuffer* cmd, PipelineShader* shader, const DrawPacket& p) {
+  if (p._batchDraws != nullptr) {
+    //Instance streams are fine, each range's firstInstance offsets them.
+    _stats._drawCalls += cmd->drawIndexedBatch(p._indirect, *p._batchDraws);
+    return true;
+  }
+  if (p._indirect != nullptr) {
+    if (shader->hasInstanceStream()) {
+      BRLogErrorCycle("Shader '" + shader->name() + "' reads per instance attributes, indirect draws fetch instance data from storage buffers.");
+      return false;
+    }
+    if (p._indirectCount != nullptr && shader->vulkan()->drawIndirectCountSupported()) {
+      cmd->drawIndexedIndirectCount(p._indirect, p._indirectOffset, p._indirectCount, p._indirectCountOffset, p._maxDrawCount);
+    }
+    else {
+      //Unwritten draws are left with zero instances.
+      cmd->drawIndexedIndirect(p._indirect, p._indirectOffset, p._maxDrawCount);
+    }
+    _stats._drawCalls++;
+    return true;
+  }
+  if (!shader->validateInstanceStreams(p._instanceStreams, p._firstInstance + p._instanceCount)) {
+    return false;
+  }
+  cmd->drawIndexed(p._instanceCount, p._firstInstance);
+  _stats._drawCalls++;
+  return true;
+}
+void DrawQueue::radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch) {
+  size_t n = items.size();
+  if (n < 2) {
+    return;
+  }
+  scratch.resize(n);
+  //All 8 histograms in one read.
+  std::vector<std::array<size_t, 256>> counts(8);
+  for (auto& c : counts) {
+    c.fill(0);
+  }
+  for (auto& item : items) {
+    for (int ib = 0; ib < 8; ++ib) {
+      counts[ib][(item._key >> (ib * 8)) & 0xFF]++;
+    }
+  }
+  SortItem* src = items.data();
+  SortItem* dst = scratch.data();
+  for (int ib = 0; ib < 8; ++ib) {
+    auto& c = counts[ib];
+    if (c[(src[0]._key >> (ib * 8)) & 0xFF] == n) {
+      continue;
+    }
+    size_t sum = 0;
+    for (auto& count : c) {
+      size_t tmp = count;
+      count = sum;
+      sum += tmp;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      dst[c[(src[i]._key >> (ib * 8)) & 0xFF]++] = src[i];
+    }
+    std::swap(src, dst);
+  }
+  if (src != items.data()) {
+    std::copy(src, src + n, items.data());
+  }
+}
+void DrawQueue::countBinds(const std::vector<SortItem>& items, uint64_t& pipelineBinds, uint64_t& descriptorBinds, uint64_t& meshBinds) {
+  pipelineBinds = descriptorBinds = meshBinds = 0;
+  auto field = [](uint64_t key, uint32_t shift) { return (key >> shift) & c_idMask; };
+  for (size_t i = 0; i < items.size(); ++i) {
+    uint64_t key = items[i]._key;
+    bool first = (i == 0);
+    uint64_t prev = first ? 0 : items[i - 1]._key;
+    pipelineBinds += (first || field(key, c_pipelineShift) != field(prev, c_pipelineShift)) ? 1 : 0;
+    descriptorBinds += (first || field(key, c_materialShift) != field(prev, c_materialShift)) ? 1 : 0;
+    meshBinds += (first || field(key, c_meshShift) != field(prev, c_meshShift)) ? 1 : 0;
+  }
+}
+
+#pragma endregion
+
+}  // namespace VG
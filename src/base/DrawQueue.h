@@ -0,0 +1,160 @@
+/**
+*  @file DrawQueue.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Sorted draw submission with redundant bind removal.
+*/
+#pragma once
+#ifndef __DRAWQUEUE_17923419027718230194526_H__
+#define __DRAWQUEUE_17923419027718230194526_H__
+
+#include "./VulkanHeader.h"
+#include <map>
+
+namespace VG {
+
+class TextureImage;
+/**
+ * @class DrawBindings
+ * @brief Named shader resources bound together, e.g. a material or the per pass UBOs.
+ * */
+class DrawBindings {
+public:
+  DrawBindings& ubo(const string_t& name, std::shared_ptr<VulkanBuffer> buf, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+  DrawBindings& storageBuffer(const string_t& name, std::shared_ptr<VulkanBuffer> buf, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+  DrawBindings& sampler(const string_t& name, std::shared_ptr<TextureImage> texture);
+  //Pushes texture->bindlessIndex() at push constant offset 0, for shaders reading the BindlessTextureTable.
+  DrawBindings& bindlessTexture(std::shared_ptr<TextureImage> texture);
+  bool bind(CommandBuffer* cmd, PipelineShader* shader) const;
+  void clear() { _entries.clear(); }
+
+private:
+  enum class Kind {
+    UBO,
+    StorageBuffer,
+    Sampler,
+    BindlessTexture
+  };
+  class Entry {
+  public:
+    Kind _kind = Kind::UBO;
+    string_t _name;
+    std::shared_ptr<VulkanBuffer> _buffer = nullptr;
+    std::shared_ptr<TextureImage> _texture = nullptr;
+    VkDeviceSize _offset = 0;
+    VkDeviceSize _range = VK_WHOLE_SIZE;
+  };
+  std::vector<Entry> _entries;
+};
+/**
+ * @class DrawPipelineState
+ * @brief Arguments of PipelineShader::bindPipeline.
+ * */
+class DrawPipelineState {
+public:
+  std::shared_ptr<BR2::VertexFormat> _vertexFormat = nullptr;
+  VkPolygonMode _polygonMode = VK_POLYGON_MODE_FILL;
+  VkPrimitiveTopology _topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkCullModeFlags _cullMode = VK_CULL_MODE_BACK_BIT;
+  bool operator==(const DrawPipelineState& rhs) const {
+    return _vertexFormat == rhs._vertexFormat && _polygonMode == rhs._polygonMode && _topology == rhs._topology && _cullMode == rhs._cullMode;
+  }
+  bool operator!=(const DrawPipelineState& rhs) const { return !(*this == rhs); }
+};
+/**
+ * @class DrawPacket
+ * @brief One indexed draw. Direct draws use the instance range, indirect draws (_indirect != nullptr) read it from the GPU.
+ *        Batches (_batchDraws != nullptr) draw several ranges of a MeshBatch mesh.
+ * */
+class DrawPacket {
+public:
+  DrawPipelineState _pipeline;
+  std::shared_ptr<DrawBindings> _material = nullptr;  //Compared by pointer, share one per material.
+  std::shared_ptr<Mesh> _mesh = nullptr;
+  std::vector<VulkanBuffer*> _instanceStreams;
+  uint32_t _instanceCount = 1;
+  uint32_t _firstInstance = 0;
+  VulkanBuffer* _indirect = nullptr;       //VkDrawIndexedIndirectCommands.
+  VkDeviceSize _indirectOffset = 0;
+  VulkanBuffer* _indirectCount = nullptr;  //Optional draw count, used with VK_KHR_draw_indirect_count.
+  VkDeviceSize _indirectCountOffset = 0;
+  uint32_t _maxDrawCount = 1;
+  const std::vector<VkDrawIndexedIndirectCommand>* _batchDraws = nullptr;  //MeshBatch draws uploaded to _indirect, see CommandBuffer::drawIndexedBatch.
+  uint64_t _key = 0;  //Set by DrawQueue::submit.
+};
+/**
+ * @class DrawQueueStats
+ * @brief Binds recorded by DrawQueue, and the binds the same packets need in submission order.
+ * */
+class DrawQueueStats {
+public:
+  uint64_t _draws = 0;
+  uint64_t _drawCalls = 0;  //vkCmdDraw* recorded, a batch is one unless it falls back.
+  uint64_t _pipelineBinds = 0;
+  uint64_t _descriptorBinds = 0;
+  uint64_t _meshBinds = 0;
+  uint64_t _unsortedPipelineBinds = 0;
+  uint64_t _unsortedDescriptorBinds = 0;
+  uint64_t _unsortedMeshBinds = 0;
+  double _sortMs = 0;
+  double _recordMs = 0;  //Including the sort.
+  void add(const DrawQueueStats& rhs);
+  void reset() { *this = DrawQueueStats(); }
+};
+/**
+ * @class DrawQueue
+ * @brief Collects the draws of one render pass, sorts them by a 64 bit key and records them with redundant binds removed.
+ * @details Key, high to low bits: layer(8) pipeline state(16) material(16) mesh and instance streams(16) unused(8).
+ *          State ids are numbered in submission order, per queue. Past 0xFFFF states the ids saturate, which only
+ *          makes the sort group less, since recording compares the actual state.
+ *          The pass shader owns the render pass, so every packet is drawn with it:
+ *            shader->beginRenderPass -> clear -> submit .. -> record -> shader->endRenderPass
+ * */
+class DrawQueue {
+public:
+  static constexpr uint32_t c_layerShift = 56;
+  static constexpr uint32_t c_pipelineShift = 40;
+  static constexpr uint32_t c_materialShift = 24;
+  static constexpr uint32_t c_meshShift = 8;
+  static constexpr uint64_t c_idMask = 0xFFFF;
+
+  void clear();
+  void submit(DrawPacket&& packet, uint8_t layer = 0);
+  size_t size() { return _packets.size(); }
+  //Binds passBindings once, then draws the sorted packets. Returns false if a bind failed.
+  bool record(CommandBuffer* cmd, PipelineShader* shader, const DrawBindings& passBindings, const BR2::urect2& viewport);
+  const DrawQueueStats& stats() { return _stats; }  //Of the last record().
+
+  class SortItem {
+  public:
+    uint64_t _key = 0;
+    uint32_t _index = 0;
+  };
+  //LSD radix sort on _key, 8 bits per pass. Stable, passes where every key has the same byte are skipped.
+  static void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+  //Pipeline, descriptor and mesh binds needed to draw items in order, from the key fields.
+  static void countBinds(const std::vector<SortItem>& items, uint64_t& pipelineBinds, uint64_t& descriptorBinds, uint64_t& meshBinds);
+
+private:
+  class MeshBinding {
+  public:
+    Mesh* _mesh = nullptr;
+    std::vector<VulkanBuffer*> _streams;
+    bool operator<(const MeshBinding& rhs) const { return _mesh != rhs._mesh ? _mesh < rhs._mesh : _streams < rhs._streams; }
+  };
+  static uint64_t saturate(size_t id) { return std::min((uint64_t)id, c_idMask); }
+  bool recordSorted(CommandBuffer* cmd, PipelineShader* shader, const DrawBindings& passBindings, const BR2::urect2& viewport);
+  bool drawPacket(CommandBuffer* cmd, PipelineShader* shader, const DrawPacket& p);
+
+  std::vector<DrawPacket> _packets;
+  std::vector<SortItem> _items;
+  std::vector<SortItem> _scratch;
+  std::vector<DrawPipelineState> _pipelineIds;
+  std::unordered_map<DrawBindings*, uint16_t> _materialIds;
+  std::map<MeshBinding, uint16_t> _meshIds;
+  DrawQueueStats _stats;
+};
+
+}  // namespace VG
+
+#endif
@@ -0,0 +1,275 @@
+#include "./EntityStore.h"
+#include <cstring>
+#include <mutex>
+
+namespace VG {
+
+#pragma region ComponentRegistry
+
+static std::mutex& registryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+static std::vector<ComponentInfo>& registryTypes() {
+  static std::vector<ComponentInfo> types;
+  return types;
+}
+uint32_t ComponentRegistry::registerType(size_t size, size_t align, const char* name) {
+  std::lock_guard<std::mutex> lock(registryMutex());
+  auto& types = registryTypes();
+  AssertOrThrow2(types.size() < c_maxComponents);
+  ComponentInfo info;
+  info._size = size;
+  info._align = align;
+  info._name = name;
+  types.push_back(info);
+  return static_cast<uint32_t>(types.size() - 1);
+}
+ComponentInfo ComponentRegistry::info(uint32_t id) {
+  std::lock_guard<std::mutex> lock(registryMutex());
+  AssertOrThrow2(id < registryTypes().size());
+  return registryTypes()[id];
+}
+
+#pragma endregion
+
+#pragma region EntityChunk
+
+EntityChunk::EntityChunk(size_t bytes) {
+  _data = static_cast<uint8_t*>(::operator new(bytes, std::align_val_t(EntityStore::c_alignment)));
+}
+EntityChunk::~EntityChunk() {
+  if (_data) {
+    ::operator delete(_data, std::align_val_t(EntityStore::c_alignment));
+    _data = nullptr;
+  }
+}
+
+#pragma endregion
+
+#pragma region EntityStore
+
+EntityStore::EntityStore() {
+}
+EntityStore::~EntityStore() {
+  _archetypes.clear();
+}
+size_t EntityStore::chunkCount() const {
+  size_t n = 0;
+  for (auto& arch : _archetypes) {
+    n += arch->_chunks.size();
+  }
+  return n;
+}
+Archetype* EntityStore::archetypeFor(ComponentMask mask) {
+  auto it = _archetypeIndex.find(mask);
+  if (it != _archetypeIndex.end()) {
+    return _archetypes[it->second].get();
+  }
+  auto arch = std::make_unique<Archetype>();
+  arch->_mask = mask;
+  std::fill(std::begin(arch->_columnOf), std::end(arch->_columnOf), (int16_t)-1);
+  size_t entityBytes = sizeof(Entity);
+  std::vector<size_t> aligns;
+  for (uint32_t id = 0; id < ComponentRegistry::c_maxComponents; ++id) {
+    if (mask & ((ComponentMask)1 << id)) {
+      ComponentInfo info = ComponentRegistry::info(id);
+      arch->_columnOf[id] = static_cast<int16_t>(arch->_components.size());
+      arch->_components.push_back(id);
+      arch->_sizes.push_back(info._size);
+      aligns.push_back(std::max(info._align, c_alignment));
+      entityBytes += info._size;
+    }
+  }
+  arch->_offsets.resize(arch->_components.size());
+
+  //Arrays start on cache lines, so the padding can push the last one out. Shrink until it fits.
+  auto layout = [&](uint32_t capacity) {
+    size_t end = (size_t)capacity * sizeof(Entity);
+    for (size_t ic = 0; ic < arch->_components.size(); ++ic) {
+      size_t offset = (end + aligns[ic] - 1) / aligns[ic] * aligns[ic];
+      arch->_offsets[ic] = offset;
+      end = offset + (size_t)capacity * arch->_sizes[ic];
+    }
+    return end;
+  };
+  uint32_t capacity = static_cast<uint32_t>(std::max(c_chunkBytes / entityBytes, (size_t)1));
+  size_t bytes = layout(capacity);
+  while (capacity > 1 && bytes > c_chunkBytes) {
+    bytes = layout(--capacity);
+  }
+  arch->_chunkCapacity = capacity;
+  arch->_chunkBytes = std::max(bytes, c_chunkBytes);
+
+  uint32_t index = static_cast<uint32_t>(_archetypes.size());
+  _archetypes.push_back(std::move(arch));
+  _archetypeIndex[mask] = index;
+  return _archetypes[index].get();
+}
+Entity EntityStore::allocEntity() {
+  uint32_t slot = 0;
+  if (_freeSlots.size() > 0) {
+    slot = _freeSlots.back();
+    _freeSlots.pop_back();
+  }
+  else {
+    slot = static_cast<uint32_t>(_slots.size());
+    _slots.push_back(Slot());
+  }
+  Entity e;
+  e._slot = slot;
+  e._generation = _slots[slot]._generation;
+  _count++;
+  return e;
+}
+void EntityStore::pushRow(Archetype* arch, Entity e, uint32_t& out_chunk, uint32_t& out_row) {
+  if (arch->_chunks.size() == 0 || arch->_chunks.back()->_count == arch->_chunkCapacity) {
+    arch->_chunks.push_back(std::make_unique<EntityChunk>(arch->_chunkBytes));
+  }
+  EntityChunk& chunk = *arch->_chunks.back();
+  out_chunk = static_cast<uint32_t>(arch->_chunks.size() - 1);
+  out_row = chunk._count++;
+  arch->entities(chunk)[out_row] = e;
+  arch->_count++;
+
+  Slot& slot = _slots[e._slot];
+  slot._archetype = _archetypeIndex[arch->_mask];
+  slot._chunk = out_chunk;
+  slot._row = out_row;
+}
+void EntityStore::removeRow(Archetype* arch, uint32_t chunk, uint32_t row) {
+  //The archetype's last entity fills the hole.
+  EntityChunk& last = *arch->_chunks.back();
+  uint32_t lastChunk = static_cast<uint32_t>(arch->_chunks.size() - 1);
+  uint32_t lastRow = last._count - 1;
+  if (chunk != lastChunk || row != lastRow) {
+    EntityChunk& dst = *arch->_chunks[chunk];
+    for (size_t ic = 0; ic < arch->_components.size(); ++ic) {
+      size_t size = arch->_sizes[ic];
+      memcpy(dst._data + arch->_offsets[ic] + row * size, last._data + arch->_offsets[ic] + lastRow * size, size);
+    }
+    Entity moved = arch->entities(last)[lastRow];
+    arch->entities(dst)[row] = moved;
+    _slots[moved._slot]._chunk = chunk;
+    _slots[moved._slot]._row = row;
+  }
+  last._count--;
+  arch->_count--;
+  if (last._count == 0) {
+    arch->_chunks.pop_back();
+  }
+}
+bool EntityStore::destroy(Entity e) {
+  if (!valid(e)) {
+    return false;
+  }
+  Slot& slot = _slots[e._slot];
+  removeRow(_archetypes[slot._archetype].get(), slot._chunk, slot._row);
+  slot._archetype = c_none;
+  slot._generation++;
+  _freeSlots.push_back(e._slot);
+  _count--;
+  return true;
+}
+void EntityStore::clear() {
+  for (auto& arch : _archetypes) {
+    arch->_chunks.clear();
+    arch->_count = 0;
+  }
+  for (uint32_t is = 0; is < _slots.size(); ++is) {
+    if (_slots[is]._archetype != c_none) {
+      _slots[is]._archetype = c_none;
+      _slots[is]._generation++;
+      _freeSlots.push_back(is);
+    }
+  }
+  _count = 0;
+}
+bool EntityStore::move(Entity e, ComponentMask mask) {
+  Slot from = _slots[e._slot];
+  Archetype* src = _archetypes[from._archetype].get();
+  Archetype* dst = archetypeFor(mask);
+  if (dst == src) {
+    return true;
+  }
+  uint32_t chunk = 0, row = 0;
+  pushRow(dst, e, chunk, row);
+  EntityChunk& dstChunk = *dst->_chunks[chunk];
+  EntityChunk& srcChunk = *src->_chunks[from._chunk];
+  for (size_t ic = 0; ic < dst->_components.size(); ++ic) {
+    size_t size = dst->_sizes[ic];
+    uint8_t* to = dstChunk._data + dst->_offsets[ic] + row * size;
+    int16_t srcColumn = src->_columnOf[dst->_components[ic]];
+    if (srcColumn >= 0) {
+      memcpy(to, srcChunk._data + src->_offsets[srcColumn] + from._row * size, size);
+    }
+    else {
+      memset(to, 0, size);
+    }
+  }
+  removeRow(src, from._chunk, from._row);
+  return true;
+}
+void* EntityStore::component(Entity e, uint32_t componentId) {
+  if (!valid(e)) {
+    return nullptr;
+  }
+  Slot& slot = _slots[e._slot];
+  Archetype* arch = _archetypes[slot._archetype].get();
+  int16_t column = arch->_columnOf[componentId];
+  if (column < 0) {
+    return nullptr;
+  }
+  return arch->_chunks[slot._chunk]->_data + arch->_offsets[column] + slot._row * arch->_sizes[column];
+}
+
+#pragma endregion
+
+#pragma region SystemSchedule
+
+void SystemSchedule::add(const EntitySystem& system) {
+  _systems.push_back(system);
+  _bWavesDirty = true;
+}
+size_t SystemSchedule::waveCount() {
+  buildWaves();
+  return _waves.size();
+}
+void SystemSchedule::buildWaves() {
+  if (!_bWavesDirty) {
+    return;
+  }
+  _waves.clear();
+  ComponentMask reads = 0, writes = 0;
+  for (size_t is = 0; is < _systems.size(); ++is) {
+    const EntitySystem& s = _systems[is];
+    bool conflict = (s._writes & (reads | writes)) || (s._reads & writes);
+    if (_waves.size() == 0 || conflict) {
+      _waves.push_back(std::vector<size_t>());
+      reads = writes = 0;
+    }
+    _waves.back().push_back(is);
+    reads |= s._reads;
+    writes |= s._writes;
+  }
+  _bWavesDirty = false;
+}
+void SystemSchedule::run(EntityStore& store, JobSystem& jobs, float dt) {
+  buildWaves();
+  for (auto& wave : _waves) {
+    if (wave.size() == 1) {
+      _systems[wave[0]]._update(store, jobs, dt);
+      continue;
+    }
+    JobCounter counter;
+    for (size_t is : wave) {
+      EntitySystem* system = &_systems[is];
+      jobs.run([system, &store, &jobs, dt]() { system->_update(store, jobs, dt); }, &counter);
+    }
+    jobs.wait(&counter);
+  }
+}
+
+#pragma endregion
+
+}  // namespace VG
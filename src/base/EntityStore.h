@@ -0,0 +1,292 @@
+/**
+*  @file EntityStore.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Archetype entity/component store with chunked structure-of-arrays storage.
+*/
+#pragma once
+#ifndef __ENTITYSTORE_17923481250736491028375_H__
+#define __ENTITYSTORE_17923481250736491028375_H__
+
+#include "./SandboxHeader.h"
+#include "./JobSystem.h"
+#include <typeinfo>
+
+namespace VG {
+
+typedef uint64_t ComponentMask;  //Bit ComponentRegistry::id<T>() per component.
+
+/**
+ * @class ComponentInfo
+ * */
+class ComponentInfo {
+public:
+  size_t _size = 0;
+  size_t _align = 0;
+  string_t _name;
+};
+/**
+ * @class ComponentRegistry
+ * @brief Assigns component types ids on first use. Components are plain data, they are moved with memcpy.
+ *        cv qualifiers are ignored, so forEach<const T> is a read only query of T.
+ * */
+class ComponentRegistry {
+public:
+  static constexpr uint32_t c_maxComponents = 64;  //Bits of ComponentMask.
+
+  template <typename T>
+  static uint32_t id() { return typeId<std::remove_cv_t<T>>(); }
+  static ComponentInfo info(uint32_t id);
+
+private:
+  template <typename T>
+  static uint32_t typeId() {
+    static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value, "Components are moved with memcpy.");
+    static const uint32_t s_id = registerType(sizeof(T), alignof(T), typeid(T).name());
+    return s_id;
+  }
+  static uint32_t registerType(size_t size, size_t align, const char* name);
+};
+template <typename T>
+ComponentMask componentBit() {
+  return (ComponentMask)1 << ComponentRegistry::id<T>();
+}
+template <typename... Ts>
+ComponentMask componentMask() {
+  return (componentBit<Ts>() | ... | (ComponentMask)0);
+}
+/**
+ * @class Entity
+ * @brief Stable reference to an EntityStore entity. Stale handles (destroyed entities) fail validation.
+ * */
+class Entity {
+public:
+  static constexpr uint32_t c_invalid = 0xFFFFFFFF;
+  uint32_t _slot = c_invalid;
+  uint32_t _generation = 0;
+  bool operator==(const Entity& rhs) const { return _slot == rhs._slot && _generation == rhs._generation; }
+  bool operator!=(const Entity& rhs) const { return !(*this == rhs); }
+};
+/**
+ * @class EntityChunk
+ * @brief c_chunkBytes of one archetype's entities, one cache line aligned array per component.
+ * */
+class EntityChunk {
+public:
+  EntityChunk(size_t bytes);
+  ~EntityChunk();
+  EntityChunk(const EntityChunk&) = delete;
+  EntityChunk& operator=(const EntityChunk&) = delete;
+
+  uint8_t* _data = nullptr;
+  uint32_t _count = 0;
+};
+/**
+ * @class Archetype
+ * @brief Every entity with exactly one set of components. All chunks are full but the last, none are empty.
+ * */
+class Archetype {
+public:
+  ComponentMask _mask = 0;
+  std::vector<uint32_t> _components;  //Ids, ascending.
+  std::vector<size_t> _offsets;       //Array offset in a chunk, per _components entry. The Entity array is at 0.
+  std::vector<size_t> _sizes;         //Per _components entry.
+  int16_t _columnOf[ComponentRegistry::c_maxComponents];  //_components index per id, -1 if absent.
+  uint32_t _chunkCapacity = 0;
+  size_t _chunkBytes = 0;  //EntityStore::c_chunkBytes unless one entity is bigger.
+  std::vector<std::unique_ptr<EntityChunk>> _chunks;
+  size_t _count = 0;
+
+  Entity* entities(EntityChunk& chunk) { return reinterpret_cast<Entity*>(chunk._data); }
+  void* column(EntityChunk& chunk, uint32_t componentId) { return chunk._data + _offsets[_columnOf[componentId]]; }
+  template <typename T>
+  T* array(EntityChunk& chunk) { return static_cast<T*>(column(chunk, ComponentRegistry::id<T>())); }  //const T for a read only array.
+};
+/**
+ * @class EntityStore
+ * @brief Entities grouped by archetype (their set of components) into fixed size chunks, structure-of-arrays
+ *        within a chunk, so a query streams the arrays it asks for and skips everything else.
+ * @details Archetypes are dense: destroy() and component changes move the archetype's last entity into the hole.
+ *          Adding or removing a component moves the entity to another archetype, which copies its components,
+ *          so component pointers are only valid until the next structural change. Queries must not make
+ *          structural changes. Handles stay valid across moves.
+ *          Chunks are the unit of parallel work: parallelForEachChunk runs one job per chunk.
+ * */
+class EntityStore {
+public:
+  static constexpr size_t c_chunkBytes = 16384;
+  static constexpr size_t c_alignment = 64;
+
+  EntityStore();
+  virtual ~EntityStore();
+  EntityStore(const EntityStore&) = delete;
+  EntityStore& operator=(const EntityStore&) = delete;
+
+  template <typename... Ts>
+  Entity create(const Ts&... components);
+  bool destroy(Entity e);
+  void clear();
+
+  bool valid(Entity e) const { return e._slot < _slots.size() && _slots[e._slot]._generation == e._generation && _slots[e._slot]._archetype != c_none; }
+  size_t count() const { return _count; }
+  size_t archetypeCount() const { return _archetypes.size(); }
+  size_t chunkCount() const;
+
+  template <typename T>
+  T* get(Entity e);  //Null if e doesn't have T.
+  template <typename T>
+  bool has(Entity e) const { return valid(e) && (_archetypes[_slots[e._slot]._archetype]->_mask & componentBit<T>()) != 0; }
+  template <typename T>
+  bool add(Entity e, const T& value);  //Sets the value if e already has T.
+  template <typename T>
+  bool remove(Entity e);
+
+  //func(size_t count, const Entity* entities, Ts*... arrays) per chunk of every archetype with all of Ts.
+  template <typename... Ts, typename F>
+  void forEachChunk(F&& func);
+  //func(Entity e, Ts&... components) per entity with all of Ts.
+  template <typename... Ts, typename F>
+  void forEach(F&& func);
+  //forEachChunk with a job per chunk. func must only touch its own chunk's entities.
+  template <typename... Ts, typename F>
+  void parallelForEachChunk(JobSystem& jobs, F&& func);
+
+private:
+  static constexpr uint32_t c_none = 0xFFFFFFFF;
+  class Slot {
+  public:
+    uint32_t _archetype = c_none;  //c_none if free.
+    uint32_t _chunk = 0;
+    uint32_t _row = 0;
+    uint32_t _generation = 0;
+  };
+
+  Archetype* archetypeFor(ComponentMask mask);
+  Entity allocEntity();
+  void pushRow(Archetype* arch, Entity e, uint32_t& out_chunk, uint32_t& out_row);
+  void removeRow(Archetype* arch, uint32_t chunk, uint32_t row);
+  bool move(Entity e, ComponentMask mask);  //To the archetype of mask, copying the components both have.
+  void* component(Entity e, uint32_t componentId);
+  template <typename... Ts>
+  void matchingChunks(std::vector<std::pair<Archetype*, EntityChunk*>>& out);
+
+  std::vector<std::unique_ptr<Archetype>> _archetypes;
+  std::unordered_map<ComponentMask, uint32_t> _archetypeIndex;
+  std::vector<Slot> _slots;
+  std::vector<uint32_t> _freeSlots;
+  size_t _count = 0;
+};
+/**
+ * @class EntitySystem
+ * @brief An update over an EntityStore that declares the components it reads and writes.
+ * */
+class EntitySystem {
+public:
+  string_t _name;
+  ComponentMask _reads = 0;
+  ComponentMask _writes = 0;
+  std::function<void(EntityStore& store, JobSystem& jobs, float dt)> _update;
+};
+/**
+ * @class SystemSchedule
+ * @brief Runs systems in the order they were added, grouped into waves of systems that can run at once.
+ * @details A system starts a new wave if it writes a component the wave reads or writes, or reads one the wave
+ *          writes. The systems of a wave run as jobs; they can split their own work with parallelForEachChunk.
+ * */
+class SystemSchedule {
+public:
+  void add(const EntitySystem& system);
+  void run(EntityStore& store, JobSystem& jobs, float dt);
+  size_t systemCount() const { return _systems.size(); }
+  size_t waveCount();
+
+private:
+  void buildWaves();
+
+  std::vector<EntitySystem> _systems;
+  std::vector<std::vector<size_t>> _waves;
+  bool _bWavesDirty = true;
+};
+
+#pragma region EntityStore templates
+
+template <typename... Ts>
+Entity EntityStore::create(const Ts&... components) {
+  Archetype* arch = archetypeFor(componentMask<Ts...>());
+  Entity e = allocEntity();
+  uint32_t chunk = 0, row = 0;
+  pushRow(arch, e, chunk, row);
+  EntityChunk& c = *arch->_chunks[chunk];
+  ((arch->array<Ts>(c)[row] = components), ...);
+  return e;
+}
+template <typename T>
+T* EntityStore::get(Entity e) {
+  return static_cast<T*>(component(e, ComponentRegistry::id<T>()));
+}
+template <typename T>
+bool EntityStore::add(Entity e, const T& value) {
+  if (!valid(e)) {
+    return false;
+  }
+  if (!has<T>(e) && !move(e, _archetypes[_slots[e._slot]._archetype]->_mask | componentBit<T>())) {
+    return false;
+  }
+  *get<T>(e) = value;
+  return true;
+}
+template <typename T>
+bool EntityStore::remove(Entity e) {
+  if (!has<T>(e)) {
+    return false;
+  }
+  return move(e, _archetypes[_slots[e._slot]._archetype]->_mask & ~componentBit<T>());
+}
+template <typename... Ts>
+void EntityStore::matchingChunks(std::vector<std::pair<Archetype*, EntityChunk*>>& out) {
+  ComponentMask required = componentMask<Ts...>();
+  for (auto& arch : _archetypes) {
+    if ((arch->_mask & required) == required) {
+      for (auto& chunk : arch->_chunks) {
+        out.push_back(std::make_pair(arch.get(), chunk.get()));
+      }
+    }
+  }
+}
+template <typename... Ts, typename F>
+void EntityStore::forEachChunk(F&& func) {
+  ComponentMask required = componentMask<Ts...>();
+  for (auto& arch : _archetypes) {
+    if ((arch->_mask & required) == required) {
+      for (auto& chunk : arch->_chunks) {
+        func((size_t)chunk->_count, const_cast<const Entity*>(arch->entities(*chunk)), arch->template array<Ts>(*chunk)...);
+      }
+    }
+  }
+}
+template <typename... Ts, typename F>
+void EntityStore::forEach(F&& func) {
+  forEachChunk<Ts...>([&func](size_t count, const Entity* entities, Ts*... arrays) {
+    for (size_t i = 0; i < count; ++i) {
+      func(entities[i], arrays[i]...);
+    }
+  });
+}
+template <typename... Ts, typename F>
+void EntityStore::parallelForEachChunk(JobSystem& jobs, F&& func) {
+  std::vector<std::pair<Archetype*, EntityChunk*>> chunks;
+  matchingChunks<Ts...>(chunks);
+  jobs.parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t ic = begin; ic < end; ++ic) {
+      Archetype* arch = chunks[ic].first;
+      EntityChunk& chunk = *chunks[ic].second;
+      func((size_t)chunk._count, const_cast<const Entity*>(arch->entities(chunk)), arch->template array<Ts>(chunk)...);
+    }
+  });
+}
+
+#pragma endregion
+
+}  // namespace VG
+
+#endif
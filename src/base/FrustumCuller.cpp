@@ -0,0 +1,207 @@
+#include "./FrustumCuller.h"
+#include "./JobSystem.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VG_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define VG_TARGET_AVX2
+#else
+#define VG_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace VG {
+
+#pragma region Frustum
+
+void Frustum::fromViewProj(const float* view16, const float* proj16) {
+  //clip = proj * view, column major.
+  float clip[16];
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      float s = 0;
+      for (int k = 0; k < 4; ++k) {
+        s += proj16[k * 4 + r] * view16[c * 4 + k];
+      }
+      clip[c * 4 + r] = s;
+    }
+  }
+  auto row = [&clip](int r, int i) { return clip[i * 4 + r]; };
+  //Gribb/Hartmann. Near is -w <= z, which also holds for a [0,1] depth range, so it only culls less.
+  for (int i = 0; i < 4; ++i) {
+    _planes[Left][i] = row(3, i) + row(0, i);
+    _planes[Right][i] = row(3, i) - row(0, i);
+    _planes[Bottom][i] = row(3, i) + row(1, i);
+    _planes[Top][i] = row(3, i) - row(1, i);
+    _planes[Near][i] = row(3, i) + row(2, i);
+    _planes[Far][i] = row(3, i) - row(2, i);
+  }
+  for (auto& p : _planes) {
+    float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    if (len > 0) {
+      for (int i = 0; i < 4; ++i) {
+        p[i] /= len;
+      }
+    }
+  }
+}
+bool Frustum::sphereVisible(float x, float y, float z, float radius) const {
+  for (auto& p : _planes) {
+    if (p[0] * x + p[1] * y + p[2] * z + p[3] < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#pragma endregion
+
+#pragma region Kernels
+
+static size_t cullScalar(const Frustum& f, const CullSpheres& s, size_t begin, size_t end, uint32_t* out) {
+  size_t n = 0;
+  for (size_t i = begin; i < end; ++i) {
+    float r = s._radius ? s._radius[i] : s._uniformRadius;
+    out[n] = static_cast<uint32_t>(i);
+    n += f.sphereVisible(s._x[i], s._y[i], s._z[i], r) ? 1 : 0;
+  }
+  return n;
+}
+
+#ifdef VG_SIMD_X86
+
+//Lane offsets of the set bits of every 8 bit mask, packed to the front. Adding the first index gives the visible indexes.
+struct alignas(32) LeftPackTable {
+  uint32_t _lanes[256][8];
+  uint8_t _count[256];
+  LeftPackTable() {
+    for (uint32_t m = 0; m < 256; ++m) {
+      uint32_t n = 0;
+      for (uint32_t b = 0; b < 8; ++b) {
+        if (m & (1 << b)) {
+          _lanes[m][n++] = b;
+        }
+      }
+      _count[m] = static_cast<uint8_t>(n);
+      while (n < 8) {
+        _lanes[m][n++] = 0;
+      }
+    }
+  }
+};
+static const LeftPackTable& leftPackTable() {
+  static LeftPackTable table;
+  return table;
+}
+
+static size_t cullSSE2(const Frustum& f, const CullSpheres& s, size_t begin, size_t end, uint32_t* out) {
+  const LeftPackTable& lp = leftPackTable();
+  __m128 px[6], py[6], pz[6], pw[6];
+  for (int ip = 0; ip < 6; ++ip) {
+    px[ip] = _mm_set1_ps(f.plane(ip)[0]);
+    py[ip] = _mm_set1_ps(f.plane(ip)[1]);
+    pz[ip] = _mm_set1_ps(f.plane(ip)[2]);
+    pw[ip] = _mm_set1_ps(f.plane(ip)[3]);
+  }
+  __m128 negUniform = _mm_set1_ps(-s._uniformRadius);
+  __m128 signBit = _mm_set1_ps(-0.0f);
+  size_t n = 0;
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 x = _mm_loadu_ps(&s._x[i]), y = _mm_loadu_ps(&s._y[i]), z = _mm_loadu_ps(&s._z[i]);
+    __m128 negR = s._radius ? _mm_xor_ps(_mm_loadu_ps(&s._radius[i]), signBit) : negUniform;
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int ip = 0; ip < 6; ++ip) {
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[ip], x), _mm_mul_ps(py[ip], y)), _mm_add_ps(_mm_mul_ps(pz[ip], z), pw[ip]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+    }
+    int mask = _mm_movemask_ps(inside);
+    //Writes 4 lanes, only the visible ones are kept. n <= i - begin, so this stays within count.
+    __m128i idx = _mm_add_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(lp._lanes[mask])), _mm_set1_epi32(static_cast<int>(i)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n), idx);
+    n += lp._count[mask];
+  }
+  return n + cullScalar(f, s, i, end, out + n);
+}
+VG_TARGET_AVX2 static size_t cullAVX2(const Frustum& f, const CullSpheres& s, size_t begin, size_t end, uint32_t* out) {
+  const LeftPackTable& lp = leftPackTable();
+  __m256 px[6], py[6], pz[6], pw[6];
+  for (int ip = 0; ip < 6; ++ip) {
+    px[ip] = _mm256_set1_ps(f.plane(ip)[0]);
+    py[ip] = _mm256_set1_ps(f.plane(ip)[1]);
+    pz[ip] = _mm256_set1_ps(f.plane(ip)[2]);
+    pw[ip] = _mm256_set1_ps(f.plane(ip)[3]);
+  }
+  __m256 negUniform = _mm256_set1_ps(-s._uniformRadius);
+  __m256 signBit = _mm256_set1_ps(-0.0f);
+  size_t n = 0;
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 x = _mm256_loadu_ps(&s._x[i]), y = _mm256_loadu_ps(&s._y[i]), z = _mm256_loadu_ps(&s._z[i]);
+    __m256 negR = s._radius ? _mm256_xor_ps(_mm256_loadu_ps(&s._radius[i]), signBit) : negUniform;
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int ip = 0; ip < 6; ++ip) {
+      __m256 d = _mm256_fmadd_ps(px[ip], x, _mm256_fmadd_ps(py[ip], y, _mm256_fmadd_ps(pz[ip], z, pw[ip])));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+    }
+    int mask = _mm256_movemask_ps(inside);
+    __m256i idx = _mm256_add_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(lp._lanes[mask])), _mm256_set1_epi32(static_cast<int>(i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n), idx);
+    n += lp._count[mask];
+  }
+  return n + cullSSE2(f, s, i, end, out + n);
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region FrustumCuller
+
+size_t FrustumCuller::cullSpheres(const Frustum& frustum, const CullSpheres& spheres, size_t first, size_t count, uint32_t* out_visible) {
+  return cullSpheres(frustum, spheres, first, count, out_visible, TransformKernels::simdLevel());
+}
+size_t FrustumCuller::cullSpheres(const Frustum& frustum, const CullSpheres& spheres, size_t first, size_t count, uint32_t* out_visible, SimdLevel level) {
+  AssertOrThrow2(spheres._x && spheres._y && spheres._z);
+  if (level > TransformKernels::simdLevel()) {
+    level = TransformKernels::simdLevel();
+  }
+#ifdef VG_SIMD_X86
+  if (level == SimdLevel::AVX2) {
+    return cullAVX2(frustum, spheres, first, first + count, out_visible);
+  }
+  else if (level == SimdLevel::SSE2) {
+    return cullSSE2(frustum, spheres, first, first + count, out_visible);
+  }
+#endif
+  return cullScalar(frustum, spheres, first, first + count, out_visible);
+}
+size_t FrustumCuller::cullSpheresParallel(JobSystem& jobs, size_t grain, const Frustum& frustum, const CullSpheres& spheres, size_t count, uint32_t* out_visible) {
+  grain = std::max(grain, (size_t)64);
+  size_t ranges = (count + grain - 1) / grain;
+  if (ranges <= 1) {
+    return cullSpheres(frustum, spheres, 0, count, out_visible);
+  }
+  //Each range packs into its own part of the output, then the parts are moved together.
+  std::vector<size_t> visible(ranges, 0);
+  jobs.parallelFor(ranges, 1, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      size_t first = r * grain;
+      visible[r] = cullSpheres(frustum, spheres, first, std::min(grain, count - first), out_visible + first);
+    }
+  });
+  size_t n = visible[0];
+  for (size_t r = 1; r < ranges; ++r) {
+    if (visible[r] > 0) {
+      memmove(out_visible + n, out_visible + r * grain, visible[r] * sizeof(uint32_t));
+    }
+    n += visible[r];
+  }
+  return n;
+}
+
+#pragma endregion
+
+}  // namespace VG
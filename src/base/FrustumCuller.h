@@ -0,0 +1,70 @@
+/**
+*  @file FrustumCuller.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Vectorized frustum culling of instance bounding spheres.
+*/
+#pragma once
+#ifndef __FRUSTUMCULLER_17923412846104517327719_H__
+#define __FRUSTUMCULLER_17923412846104517327719_H__
+
+#include "./SandboxHeader.h"
+#include "./TransformKernels.h"
+
+namespace VG {
+
+class JobSystem;
+
+/**
+ * @class Frustum
+ * @brief Six normalized planes with inward normals. A point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all planes.
+ * */
+class Frustum {
+public:
+  enum Plane {
+    Left,
+    Right,
+    Bottom,
+    Top,
+    Near,
+    Far,
+    Plane_Count
+  };
+  //view and proj are column major, as uploaded to ViewProjUBOData (GLSL proj * view * p).
+  void fromViewProj(const float* view16, const float* proj16);
+  bool sphereVisible(float x, float y, float z, float radius) const;
+  const float* plane(int i) const { return _planes[i]; }
+
+private:
+  float _planes[Plane_Count][4] = {};
+};
+/**
+ * @class CullSpheres
+ * @brief Structure-of-arrays bounding spheres, e.g. the TransformStore position columns.
+ * */
+class CullSpheres {
+public:
+  const float* _x = nullptr;
+  const float* _y = nullptr;
+  const float* _z = nullptr;
+  const float* _radius = nullptr;  //Per sphere, or null to use _uniformRadius.
+  float _uniformRadius = 0;
+};
+/**
+ * @class FrustumCuller
+ * @brief Tests bounding spheres against a Frustum, 8 per AVX2 iteration (4 with SSE2), and writes the indexes
+ *        of the visible ones packed in ascending order.
+ * */
+class FrustumCuller {
+public:
+  //Culls spheres [first, first+count). out_visible needs room for count indexes. Returns the number written.
+  static size_t cullSpheres(const Frustum& frustum, const CullSpheres& spheres, size_t first, size_t count, uint32_t* out_visible);
+  static size_t cullSpheres(const Frustum& frustum, const CullSpheres& spheres, size_t first, size_t count, uint32_t* out_visible, SimdLevel level);
+
+  //Culls [0, count) in ranges of grain instances across the job system, then packs the ranges together.
+  static size_t cullSpheresParallel(JobSystem& jobs, size_t grain, const Frustum& frustum, const CullSpheres& spheres, size_t count, uint32_t* out_visible);
+};
+
+}  // namespace VG
+
+#endif
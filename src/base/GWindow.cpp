@@ -21,6 +21,16 @@ float g_spec_hard = 20;      //exponent
 float g_spec_intensity = 1;  //mix value
 bool g_wait_fences = false;
 bool g_vsync_enable = false;
+bool g_gpu_instances = false;
+bool g_cull_instances = false;
+bool g_batch_meshes = false;
+bool g_scene_graph = false;
+bool g_lods = false;
+bool g_lod_simplify = true;
+bool g_occlusion_cull = false;
+bool g_cpu_occlusion = false;
+bool g_bindless_textures = false;
+InstanceFetch g_instance_fetch = InstanceFetch::UBO;
 
 #pragma region GWindow
 
@@ -352,6 +362,7 @@ void GSDL::init() {
       nullptr);
     _pSDLWindow = makeSDLWindow(params, SDL_WINDOW_VULKAN, false);
 
+    _jobs = std::make_unique<JobSystem>();
 
     _vulkan = Vulkan::create(title, _pSDLWindow, g_wait_fences, g_vsync_enable, _settings->_debugEnabled);
 
@@ -369,15 +380,55 @@ void GSDL::init() {
 void GSDL::createGameAndShaderTest() {
   _game = nullptr;
   _pShader = nullptr;
+  _pShaderSSBO = nullptr;
+  _pShaderInstStream = nullptr;
+  _pShaderBindless = nullptr;
+  _instanceStreams1.clear();
+  _instanceStreams2.clear();
+  _pShaderCulled = nullptr;
+  _meshBatch = nullptr;
+  _lodMesh = nullptr;
+  _passIndirect[0].clear();
+  _passIndirect[1].clear();
+  _pInstanceCompute = nullptr;
+  _pInstanceCull = nullptr;
+  _hiZ = nullptr;
+  _hiZDummy = nullptr;
+  _instanceParams1 = nullptr;
+  _instanceParams2 = nullptr;
   _game = std::make_shared<GameDummy>();
-  _game->_mesh1 = std::make_shared<Mesh>(_vulkan.get());
-  _game->_mesh1->makeBox();
-  _game->_mesh2 = std::make_shared<Mesh>(_vulkan.get());
-  _game->_mesh2->makeBox();
+  createScene();
+  createLodMesh();
 
   //Make Shader.
   _pShader = PipelineShader::create(_vulkan.get(), "Vulkan-Tutorial-Test-Shader",
                                     std::vector{ App::dataFile("test.vs.spv"), App::dataFile("test.fs.spv") });
+  //Only the active lights are compiled into the pipeline.
+  _pShader->setSpecConstant("c_numLights", (int32_t)_numLights);
+  _pShaderSSBO = PipelineShader::create(_vulkan.get(), "Instance-SSBO-Test-Shader",
+                                        std::vector{ App::dataFile("test_ssbo.vs.spv"), App::dataFile("test.fs.spv") });
+  _pShaderSSBO->setSpecConstant("c_numLights", (int32_t)_numLights);
+  _pShaderInstStream = PipelineShader::create(_vulkan.get(), "Instance-Stream-Test-Shader",
+                                              std::vector{ App::dataFile("test_inst.vs.spv"), App::dataFile("test.fs.spv") });
+  _pShaderInstStream->setSpecConstant("c_numLights", (int32_t)_numLights);
+  if (_vulkan->bindlessTextures() != nullptr) {
+    _pShaderBindless = PipelineShader::create(_vulkan.get(), "Instance-Stream-Bindless-Test-Shader",
+                                              std::vector{ App::dataFile("test_inst.vs.spv"), App::dataFile("test_bindless.fs.spv") });
+    _pShaderBindless->setSpecConstant("c_numLights", (int32_t)_numLights);
+  }
+  _pShaderCulled = PipelineShader::create(_vulkan.get(), "Instance-Culled-Test-Shader",
+                                         std::vector{ App::dataFile("test_cull.vs.spv"), App::dataFile("test.fs.spv") });
+  _pShaderCulled->setSpecConstant("c_numLights", (int32_t)_numLights);
+  _pInstanceCompute = ComputeShader::create(_vulkan.get(), "Instance-Update-Compute", App::dataFile("instance_update.cs.spv"));
+  _pInstanceCull = ComputeShader::create(_vulkan.get(), "Instance-Cull-Compute", App::dataFile("instance_cull.cs.spv"));
+  _hiZ = std::make_unique<HiZPyramid>(_vulkan.get(), App::dataFile("hiz_reduce.cs.spv"));
+  auto dummy = std::make_shared<Img32>();
+  dummy->_size = { 1, 1 };
+  dummy->_data = new unsigned char[4]{ 255, 255, 255, 255 };
+  dummy->data_len_bytes = 4;
+  dummy->_name = "hiz-dummy";
+  _hiZDummy = std::make_shared<TextureImage>(vulkan(), dummy->_name, TextureType::ColorTexture, MSAA::Disabled, dummy,
+                                             FilterData{ SamplerType::Sampled, MipmapMode::Disabled, 1.0f, TexFilter::Nearest, TexFilter::Nearest, MipLevels::Unset });
   allocateShaderMemory();
 }
 void GSDL::sdl_PrintVideoDiagnostics() {
@@ -431,9 +482,31 @@ BR2::urect2 GSDL::getWindowDims() {
 }
 void GSDL::createUniformBuffers() {
   _pShader->createUBO(c_viewProjUBO, "_uboViewProj", sizeof(ViewProjUBOData), 1);
-  _pShader->createUBO(c_instanceUBO_1, "_uboInstanceData", sizeof(InstanceUBOData), _numInstances);
-  _pShader->createUBO(c_instanceUBO_2, "_uboInstanceData", sizeof(InstanceUBOData), _numInstances);
+  _pShader->createUBO(c_instanceUBO_1, "_uboInstanceData", sizeof(InstanceUBOData), _maxUBOInstances);
+  _pShader->createUBO(c_instanceUBO_2, "_uboInstanceData", sizeof(InstanceUBOData), _maxUBOInstances);
   _pShader->createUBO(c_lightsUBO, "_uboLights", sizeof(GPULight), _maxLights);
+  //The SSBO shader shares the view and light UBOs above. Its instance arrays are runtime sized.
+  _pShaderSSBO->createStorageBuffer(c_instanceSSBO_1, "_drawInstanceData", sizeof(InstanceUBOData), _maxInstances, false);
+  _pShaderSSBO->createStorageBuffer(c_instanceSSBO_2, "_drawInstanceData", sizeof(InstanceUBOData), _maxInstances, false);
+  _pInstanceCompute->createStorageBuffer(c_instanceMatrices_1, "_drawInstanceMatrices", sizeof(InstanceUBOData), _maxInstances);
+  _pInstanceCompute->createStorageBuffer(c_instanceMatrices_2, "_drawInstanceMatrices", sizeof(InstanceUBOData), _maxInstances);
+  //GPU culling output. The CPU resets the indirect draws each frame.
+  _pInstanceCull->createStorageBuffer(c_visibleInstances_1, "_drawVisibleInstances", sizeof(uint32_t), _maxInstances);
+  _pInstanceCull->createStorageBuffer(c_visibleInstances_2, "_drawVisibleInstances", sizeof(uint32_t), _maxInstances);
+  _pInstanceCull->createStorageBuffer(c_indirectDraws_1, "_drawIndirect", sizeof(GPUIndirectDraws), 1, false);
+  _pInstanceCull->createStorageBuffer(c_indirectDraws_2, "_drawIndirect", sizeof(GPUIndirectDraws), 1, false);
+  //Occlusion culling, the late phase's lists are drawn in a second pass.
+  _pInstanceCull->createStorageBuffer(c_visibleInstancesLate_1, "_drawVisibleInstances", sizeof(uint32_t), _maxInstances);
+  _pInstanceCull->createStorageBuffer(c_visibleInstancesLate_2, "_drawVisibleInstances", sizeof(uint32_t), _maxInstances);
+  _pInstanceCull->createStorageBuffer(c_indirectDrawsLate_1, "_drawIndirect", sizeof(GPUIndirectDraws), 1, false);
+  _pInstanceCull->createStorageBuffer(c_indirectDrawsLate_2, "_drawIndirect", sizeof(GPUIndirectDraws), 1, false);
+  _pInstanceCull->createStorageBuffer(c_occlusionState_1, "_drawOcclusionState", sizeof(uint32_t), _maxInstances);
+  _pInstanceCull->createStorageBuffer(c_occlusionState_2, "_drawOcclusionState", sizeof(uint32_t), _maxInstances);
+  _pInstanceCull->createUBO(c_occlusionUBO, "_uboOcclusion", sizeof(GPUOcclusionUBO), 1);
+  //New buffers, upload everything.
+  _instances1.markAllChanged();
+  _instances2.markAllChanged();
+  BRLogInfo("Instance matrices use " + TransformKernels::simdLevelName(TransformKernels::simdLevel()) + " kernels.");
 }
 float GSDL::pingpong_t01(int durationMs) {
   //returns the [0,1] pingpong time.
@@ -452,14 +525,16 @@ float GSDL::pingpong_t01(int durationMs) {
   }
   return t01;
 }
-void GSDL::tryInitializeOffsets(std::vector<BR2::vec3>& offsets, std::vector<float>& rots_delta, std::vector<float>& rots_ini, std::vector<BR2::vec3>& axes_ini) {
-  if (offsets.size() == 0) {
+void GSDL::tryInitializeOffsets(TransformStore& instances) {
+  if (instances.count() == 0) {
+    instances.reserve(_numInstances);
     for (size_t i = 0; i < _numInstances; ++i) {
-      offsets.push_back({ rr, rr, rr });
-      rots_delta.push_back((float)rnd(-M_2PI, M_2PI));                    //rotation delta.
-      rots_ini.push_back((float)rnd(-M_2PI, M_2PI));                      // Initial rotation, and also the value of current rotation.
-      axes_ini.push_back(BR2::vec3(rnd(-1, 1), rnd(-1, 1), rnd(-1, 1)));  // Initial rotation, and also the value of current rotation.
-      axes_ini[axes_ini.size() - 1].normalize();
+      BR2::vec3 axis(rnd(-1, 1), rnd(-1, 1), rnd(-1, 1));
+      axis.normalize();
+      BR2::vec3 pos(rr, rr, rr);
+      float angularVelocity = (float)rnd(-M_2PI, M_2PI);  //rotation delta.
+      float angle = (float)rnd(-M_2PI, M_2PI);            // Initial rotation, and also the value of current rotation.
+      instances.create(pos, axis, angle, angularVelocity);
     }
   }
 }
@@ -476,71 +551,822 @@ void GSDL::updateViewProjUniformBuffer(std::shared_ptr<VulkanBuffer> viewProjBuf
     .camPos = campos
   };
   viewProjBuffer->writeData((void*)&ub, 1);
+  _viewProj = ub;
+  _frustum.fromViewProj(reinterpret_cast<const float*>(&ub.view), reinterpret_cast<const float*>(&ub.proj));
 }
-void GSDL::updateLights(std::shared_ptr<VulkanBuffer> lightsBuffer, float dt) {
-  //Must be lessthan or equal the shader array
-  if (lights.size() == 0) {
-    for (size_t i = 0; i < _numLights; ++i) {
-      lights.push_back(GPULight());
-      lights[lights.size() - 1].pos = BR2::vec3(0, 0, 0);
-      // lights[lights.size() - 1].color = BR2::vec3(std::min(.3 + fr01(), 1.), std::min(.3 + fr01(), 1.), std::min(.3 + fr01(), 1.));
-      if (i == 0) { lights[lights.size() - 1].color.construct(1, 0, 0); }
-      if (i == 1) { lights[lights.size() - 1].color.construct(0, 1, 0); }
-      if (i == 2) { lights[lights.size() - 1].color.construct(0, 0, 1); }
-      //= BR2::vec3(std::min(.3 + fr01(), 1.), std::min(.3 + fr01(), 1.), std::min(.3 + fr01(), 1.));
-      lights[lights.size() - 1].radius = 20 + fr01() * 10;
-      lights[lights.size() - 1].rotation = fr01() * (float)M_2PI;
-      lights[lights.size() - 1].specColor = BR2::vec3(1, 1, 1);
-      lights[lights.size() - 1].specHardness = 1.0f;
-      lights[lights.size() - 1].specIntensity = 1.0f;
-      lights_speed.push_back(2 + fr01() * 8);
-      lights_r.push_back(2 + fr01() * 10);
-    }
-    //Disable the rest
-    for (size_t i = _numLights; i < _maxLights; ++i) {
-      lights.push_back(GPULight());
-      lights[lights.size() - 1].radius = 0;  //disable
-      lights_speed.push_back(1);
-      lights_r.push_back(1);
-    }
+void GSDL::createScene() {
+  //The two instance sets and the lights. The instances themselves stay in _instances1/2, which the upload and culling stream,
+  // so the set entities have no CTransform: their placement is the instance positions, summarized by CBounds.
+  // Both sets are drawn in the scene layer, so a scene pass has several packets sharing the pipeline and the mesh. Set 1 is
+  // also the display layer that shows the render texture.
+  auto box = std::make_shared<Mesh>(_vulkan.get());
+  box->makeBox();
+  uint32_t boxId = _game->addMesh(box);
+  _sceneTexture1 = _game->addTexture(_testTexture1);
+  _sceneTexture2 = _game->addTexture(_testTexture2);
+  const float c_unknown = std::numeric_limits<float>::max();
+  _game->_entities.create(CBounds{ { 0, 0, 0 }, c_unknown, 0, 0 }, CMeshRef{ boxId, _sceneTexture1 },
+                          CInstanceSet{ 0, GameDummy::c_layerScene });
+  _game->_entities.create(CBounds{ { 0, 0, 0 }, c_unknown, 0, 0 }, CMeshRef{ boxId, _sceneTexture2 },
+                          CInstanceSet{ 1, GameDummy::c_layerScene });
+  _game->_entities.create(CBounds{ { 0, 0, 0 }, c_unknown, 0, 0 }, CMeshRef{ boxId, CMeshRef::c_noTexture },
+                          CInstanceSet{ 1, GameDummy::c_layerDisplay });
+  for (uint32_t i = 0; i < _numLights; ++i) {
+    CLight light = {};
+    light._color[i % 3] = 1;
+    light._radius = 20 + (float)fr01() * 10;
+    light._orbitRadius = 2 + (float)fr01() * 10;
+    light._orbitSeconds = 2 + (float)fr01() * 8;
+    light._rotation = (float)fr01() * (float)M_2PI;
+    _game->_entities.create(CTransform{ { 0, 0, 0 } }, light);
   }
 
-  for (size_t ilight = 0; ilight < lights.size(); ++ilight) {
-    auto& light = lights[ilight];
-    if (light.radius > 0) {
-      light.rotation = fmodf(light.rotation + 6.28f * (dt / lights_speed[ilight]), 6.28f);
-      light.pos = BR2::vec3(cosf(light.rotation) * lights_r[ilight], 4, sinf(light.rotation) * lights_r[ilight]);
+  EntitySystem orbit;
+  orbit._name = "LightOrbit";
+  orbit._writes = componentMask<CTransform, CLight>();
+  orbit._update = [](EntityStore& store, JobSystem& jobs, float dt) {
+    store.parallelForEachChunk<CTransform, CLight>(jobs, [dt](size_t count, const Entity*, CTransform* t, CLight* l) {
+      for (size_t i = 0; i < count; ++i) {
+        if (l[i]._radius > 0) {
+          l[i]._rotation = fmodf(l[i]._rotation + 6.28f * (dt / l[i]._orbitSeconds), 6.28f);
+          t[i]._pos[0] = cosf(l[i]._rotation) * l[i]._orbitRadius;
+          t[i]._pos[1] = 4;
+          t[i]._pos[2] = sinf(l[i]._rotation) * l[i]._orbitRadius;
+        }
+      }
+    });
+  };
+  _game->_systems.add(orbit);
+
+  EntitySystem bounds;
+  bounds._name = "InstanceSetBounds";
+  bounds._reads = componentMask<CInstanceSet>();
+  bounds._writes = componentMask<CBounds>();
+  bounds._update = [this](EntityStore& store, JobSystem& jobs, float dt) {
+    //Recomputed when the store's generation changes. The scene graph orbits set 0 around the origin, so it gets an origin centered sphere.
+    // Runs on a worker and reads _instances1/2 and g_scene_graph outside the store. That's safe because updateScene waits for
+    // the systems before the frame touches the instances, and nothing else in the wave reads them.
+    store.forEach<const CInstanceSet, CBounds>([&](Entity e, const CInstanceSet& set, CBounds& b) {
+      TransformStore& instances = set._set == 0 ? _instances1 : _instances2;
+      uint32_t orbit = (set._set == 0 && g_scene_graph) ? 1 : 0;
+      if (b._generation == instances.generation() && b._orbit == orbit) {
+        return;
+      }
+      b._generation = instances.generation();
+      b._orbit = orbit;
+      if (instances.count() == 0) {
+        b._center[0] = b._center[1] = b._center[2] = 0;
+        b._radius = std::numeric_limits<float>::max();
+        return;
+      }
+      const float c_max = std::numeric_limits<float>::max();
+      float bmin[3] = { c_max, c_max, c_max }, bmax[3] = { -c_max, -c_max, -c_max };
+      const float* pos[3] = { instances.posX(), instances.posY(), instances.posZ() };
+      for (size_t i = 0; i < instances.count(); ++i) {
+        for (int k = 0; k < 3; ++k) {
+          bmin[k] = std::min(bmin[k], pos[k][i]);
+          bmax[k] = std::max(bmax[k], pos[k][i]);
+        }
+      }
+      for (int k = 0; k < 3; ++k) {
+        b._center[k] = orbit ? 0 : (bmin[k] + bmax[k]) * 0.5f;
+      }
+      float r2 = 0;
+      for (size_t i = 0; i < instances.count(); ++i) {
+        float dx = pos[0][i] - b._center[0], dy = pos[1][i] - b._center[1], dz = pos[2][i] - b._center[2];
+        r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+      }
+      b._radius = std::sqrt(r2) + _instanceRadius;
+    });
+  };
+  _game->_systems.add(bounds);
+}
+void GSDL::updateScene(float dt) {
+  auto t0 = std::chrono::high_resolution_clock::now();
+  _game->update(*_jobs, dt);
+  _entityMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+}
+void GSDL::updateLights(std::shared_ptr<VulkanBuffer> lightsBuffer, float dt) {
+  //Must be lessthan or equal the shader array. The rest are disabled.
+  std::vector<GPULight> lights;
+  _game->_entities.forEach<CTransform, CLight>([&](Entity e, CTransform& t, CLight& l) {
+    if (lights.size() < _maxLights) {
+      GPULight light = {};
+      light.pos = BR2::vec3(t._pos[0], t._pos[1], t._pos[2]);
+      light.color = BR2::vec3(l._color[0], l._color[1], l._color[2]);
+      light.radius = l._radius;
+      light.rotation = l._rotation;
+      light.specColor = BR2::vec3(1, 1, 1);
       light.specHardness = g_spec_hard;
       light.specIntensity = g_spec_intensity;
+      lights.push_back(light);
     }
+  });
+  while (lights.size() < _maxLights) {
+    lights.push_back(GPULight());
+    lights[lights.size() - 1].radius = 0;  //disable
   }
-  auto s = sizeof(lights[0]);
-  auto sz = sizeof(lights[0]) * lights.size();
   lightsBuffer->writeData(lights.data(), lights.size());
 }
-void GSDL::updateInstanceUniformBuffer(std::shared_ptr<VulkanBuffer> instanceBuffer, std::vector<BR2::vec3>& offsets, std::vector<float>& rots_delta, std::vector<float>& rots_ini, float dt, std::vector<BR2::vec3>& axes) {
-  float t01 = pingpong_t01(10000);
-  float t02 = pingpong_t01(10000);
-  tryInitializeOffsets(offsets, rots_delta, rots_ini, axes);
+uint32_t GSDL::updateInstanceUniformBuffer(std::shared_ptr<VulkanBuffer> instanceBuffer, TransformStore& instances, LodBuckets& lods, RenderFrame* frame, float dt) {
+  tryInitializeOffsets(instances);
+  //One upload channel per swapchain frame, each frame has its own UBO.
+  uint32_t frames = static_cast<uint32_t>(_vulkan->swapchain()->frames().size());
+  if (instances.uploadChannels() != frames) {
+    instances.setUploadChannels(frames);
+  }
 
-  //This slowdown (e.g. 2500fps -> 80fps) is my code mat4 multiplies.
-  // We could dispatch the "instance update" and also any additional physics into a compute shader to get the result more quickily.
-  // Will we really have 1000's of dynamic instances updating per frame? Probably not, but it's fun to think about.
-  BR2::vec3 lookAt = { 0, 0, 0 };
-  BR2::vec3 wwf = (lookAt - campos) * 0.1f;
-  BR2::vec3 trans(0, 0, 0);                 // campos + wwf + (lookAt - campos - wwf) * t01;
+  //This slowdown (e.g. 2500fps -> 80fps) was the mat4 multiplies.
+  // The matrices are now built from the axis-angle in SIMD batches (F5 benchmarks it).
+  // Animated instances are packed at the front of the store, static ones are only rebuilt when they change.
+  BR2::vec3 origin = { -0.5, -0.5, -0.5 };  //cube origin
+  size_t animated = instances.animatedCount();
+  _jobs->parallelFor(animated, _instanceGrain, [&](size_t begin, size_t end) {
+    TransformKernels::buildInstanceMatrices(instances, begin, end - begin, origin, dt, instances.matrices());
+  });
+  instances.matricesRebuilt(0, animated);
+
+  std::vector<std::pair<size_t, size_t>> stale;
+  instances.staleMatrices().forEachRange(animated, instances.count(), [&](size_t begin, size_t end) {
+    stale.push_back(std::make_pair(begin, end));
+  });
+  for (auto& range : stale) {
+    TransformKernels::buildInstanceMatrices(instances, range.first, range.second - range.first, origin, 0, instances.matrices());
+    instances.matricesRebuilt(range.first, range.second);
+  }
+
+  size_t capacity = instanceBuffer->buffer()->itemCount();
+  if (g_cull_instances || g_lods) {
+    //The cube origin centers it on the instance position, so the position columns are the sphere centers.
+    size_t drawn = std::min(instances.count(), capacity);
+    const uint32_t* order = nullptr;
+    if (g_cull_instances) {
+      CullSpheres spheres;
+      spheres._x = instances.posX();
+      spheres._y = instances.posY();
+      spheres._z = instances.posZ();
+      spheres._uniformRadius = _instanceRadius;
+      _visibleInstances.resize(instances.count());
+      auto t0 = std::chrono::high_resolution_clock::now();
+      size_t visible = FrustumCuller::cullSpheresParallel(*_jobs, _cullGrain, _frustum, spheres, instances.count(), _visibleInstances.data());
+      _cullMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+      if (g_cpu_occlusion) {
+        visible = cullOccludedInstances(instances, spheres, visible, capacity);
+      }
+      drawn = std::min(visible, capacity);
+      _instancesVisible += drawn;
+      order = _visibleInstances.data();
+    }
+    if (g_lods) {
+      //Each LOD's instances are drawn from their own range of the buffer, see submitLods.
+      std::vector<float> errors;
+      for (auto& lod : _lodMesh->lods()) {
+        errors.push_back(lod._error);
+      }
+      float scale = LodSelector::projScale((float)_vulkan->swapchain()->windowSize().height, (float)BR2::MathUtils::radians(45.0f));
+      LodSelector::distanceThresholds(errors.data(), (uint32_t)errors.size(), _lodMesh->boundRadius(), scale, _lodPixelError, _lodThresholds);
+      LodSelector::select(_lodThresholds, instances.posX(), instances.posY(), instances.posZ(), order, drawn, campos, lods);
+      order = lods._instances.data();
+    }
+
+    //The drawn set and its order change every frame, so it's packed and written whole. Dirty ranges are left for when both are off.
+    float* mats = static_cast<float*>(instanceBuffer->mapData());
+    if (mats != nullptr) {
+      for (size_t iv = 0; iv < drawn; ++iv) {
+        memcpy(mats + iv * 16, instances.matrices() + (size_t)order[iv] * 16, sizeof(InstanceUBOData));
+      }
+      _instancesUploaded += drawn;
+    }
+    instanceBuffer->unmapData();
+    return static_cast<uint32_t>(drawn);
+  }
+
+  //Copy only the matrices that changed since this frame's UBO was last written.
+  size_t count = std::min(instances.count(), capacity);
+  float* mats = static_cast<float*>(instanceBuffer->mapData());
+  if (mats != nullptr) {
+    instances.uploadDirty(frame->frameIndex()).forEachRange(0, count, [&](size_t begin, size_t end) {
+      memcpy(mats + begin * 16, instances.matrices() + begin * 16, (end - begin) * sizeof(InstanceUBOData));
+      _instancesUploaded += end - begin;
+    });
+    instances.clearUploadDirty(frame->frameIndex());
+  }
+  instanceBuffer->unmapData();
+  return static_cast<uint32_t>(count);
+}
+size_t GSDL::cullOccludedInstances(TransformStore& instances, const CullSpheres& spheres, size_t visible, size_t capacity) {
+  //The nearest of the frustum visible instances are the occluders, added front to back with the mesh they draw.
+  // The rest of _visibleInstances is tested against them and packed in place.
+  // Only the first capacity of the packed list are drawn, so the occluders come from the first capacity of the frustum
+  // list: packing only moves entries down, so each occluder that isn't itself hidden by the others is drawn.
+  auto t0 = std::chrono::high_resolution_clock::now();
+  uint32_t width = 256;
+  uint32_t height = std::max(width * _vulkan->swapchain()->windowSize().height / std::max(_vulkan->swapchain()->windowSize().width, 1u), 1u);
+  if (_cpuOcclusion.width() != width || _cpuOcclusion.height() < height || _cpuOcclusion.height() >= height + MaskedOcclusion::c_tileHeight) {
+    _cpuOcclusion.resize(width, height);
+  }
+  _cpuOcclusion.begin(reinterpret_cast<const float*>(&_viewProj.view), reinterpret_cast<const float*>(&_viewProj.proj));
+
+  size_t candidates = std::min(visible, capacity);
+  std::vector<uint32_t> occluders(_visibleInstances.begin(), _visibleInstances.begin() + candidates);
+  size_t count = std::min((size_t)_occluderCount, candidates);
+  auto dist2 = [&](uint32_t i) {
+    float dx = instances.posX()[i] - campos.x, dy = instances.posY()[i] - campos.y, dz = instances.posZ()[i] - campos.z;
+    return dx * dx + dy * dy + dz * dz;
+  };
+  std::partial_sort(occluders.begin(), occluders.begin() + count, occluders.end(), [&](uint32_t a, uint32_t b) { return dist2(a) < dist2(b); });
+  std::shared_ptr<Mesh> mesh = g_lods ? _lodMesh : _game->instanceSetMesh(0);
+  if (mesh->vertices().size() > 0 && mesh->lods().size() > 0) {
+    for (size_t io = 0; io < count; ++io) {
+      _cpuOcclusion.addOccluder(&mesh->vertices()[0]._pos.x, sizeof(Mesh::VertType), mesh->vertices().size(),
+                                mesh->indices().data() + mesh->lods()[0]._firstIndex, mesh->lods()[0]._indexCount, instances.matrices() + (size_t)occluders[io] * 16);
+    }
+  }
+  _cpuOcclusion.rasterize(_jobs.get());
+
+  size_t kept = _cpuOcclusion.cullSpheresParallel(*_jobs, _cullGrain, spheres, _visibleInstances.data(), visible, _visibleInstances.data());
+  _instancesOccluded += visible - kept;
+  _occlusionMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+  return kept;
+}
+void GSDL::createSceneGraph() {
+  //The flat instances become children of the pivots, their matrices (with the cube origin) are the local transforms.
+  tryInitializeOffsets(_instances1);
   BR2::vec3 origin = { -0.5, -0.5, -0.5 };  //cube origin
-  std::vector<BR2::mat4> mats(_numInstances);
-  for (uint32_t i = 0; i < _numInstances; ++i) {
-    if (i < offsets.size()) {
-      rots_ini[i] += rots_delta[i] * dt;
-      mats[i] = BR2::mat4::translation(origin) *
-                BR2::mat4::rotation(rots_ini[i], axes[i]) *
-                BR2::mat4::translation(trans + offsets[i]);
+  std::vector<float> locals(_instances1.count() * 16);
+  TransformKernels::buildInstanceMatrices(_instances1, 0, _instances1.count(), origin, 0, locals.data());
+
+  _sceneGraph = std::make_unique<SceneGraph>();
+  _scenePivots.clear();
+  for (uint32_t ip = 0; ip < _scenePivotCount; ++ip) {
+    _scenePivots.push_back(_sceneGraph->create(SceneNode(), BR2::vec3(0, 0, 0), BR2::vec3(0, 1, 0), 0));
+  }
+  for (size_t i = 0; i < _instances1.count(); ++i) {
+    _sceneGraph->create(_scenePivots[i % _scenePivots.size()], locals.data() + i * 16);
+  }
+  _sceneTime = 0;
+}
+uint32_t GSDL::updateSceneGraphBuffer(std::shared_ptr<VulkanBuffer> instanceBuffer, RenderFrame* frame, float dt) {
+  //Only the spinning pivots are set, so only their subtrees are rebuilt and uploaded.
+  // Culling reads the flat instance positions and is skipped here.
+  if (_sceneGraph == nullptr) {
+    createSceneGraph();
+  }
+  uint32_t frames = static_cast<uint32_t>(_vulkan->swapchain()->frames().size());
+  if (_sceneGraph->uploadChannels() != frames) {
+    _sceneGraph->setUploadChannels(frames);
+  }
+  _sceneTime += dt;
+  for (size_t ip = 0; ip < _scenePivots.size(); ip += 2) {
+    float angle = (float)(_sceneTime * 0.5 * (double)(ip + 1) / (double)_scenePivots.size());
+    _sceneGraph->setLocal(_scenePivots[ip], BR2::vec3(0, 0, 0), BR2::vec3(0, 1, 0), angle);
+  }
+  auto t0 = std::chrono::high_resolution_clock::now();
+  _sceneGraph->update();
+  _sceneMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+  _sceneChanged = _sceneGraph->changed().size();
+
+  //Breadth first, the pivots are [0, pivots) and the instances follow.
+  size_t first = _scenePivots.size();
+  size_t count = std::min(_sceneGraph->count() - first, (size_t)instanceBuffer->buffer()->itemCount());
+  float* mats = static_cast<float*>(instanceBuffer->mapData());
+  if (mats != nullptr) {
+    _sceneGraph->uploadDirty(frame->frameIndex()).forEachRange(first, first + count, [&](size_t begin, size_t end) {
+      memcpy(mats + (begin - first) * 16, _sceneGraph->worldMatrices() + begin * 16, (end - begin) * sizeof(InstanceUBOData));
+      _instancesUploaded += end - begin;
+    });
+    _sceneGraph->clearUploadDirty(frame->frameIndex());
+  }
+  instanceBuffer->unmapData();
+  return static_cast<uint32_t>(count);
+}
+std::shared_ptr<VulkanBuffer> GSDL::createGPUInstanceParams(TransformStore& instances) {
+  tryInitializeOffsets(instances);
+  std::vector<GPUInstanceParams> params(instances.count());
+  for (size_t i = 0; i < params.size(); ++i) {
+    params[i] = {
+      .offset = BR2::vec3(instances.posX()[i], instances.posY()[i], instances.posZ()[i]),
+      .phase = instances.angle()[i],
+      .axis = BR2::vec3(instances.axisX()[i], instances.axisY()[i], instances.axisZ()[i]),
+      .angularVelocity = instances.angularVelocity()[i],
+    };
+  }
+  return std::make_shared<VulkanBuffer>(vulkan(), VulkanBufferType::StorageBuffer, true, sizeof(GPUInstanceParams), params.size(), params.data(), params.size());
+}
+void GSDL::cmd_updateGPUInstances(CommandBuffer* cmd, RenderFrame* frame, double dt) {
+  //The matrices are built by instance_update.cs. The CPU only pushes the time, whatever the instance count is.
+  _gpuInstanceTime += dt;
+  if (_instanceParams1 == nullptr) {
+    _instanceParams1 = createGPUInstanceParams(_instances1);
+  }
+  if (_instanceParams2 == nullptr) {
+    _instanceParams2 = createGPUInstanceParams(_instances2);
+  }
+  auto mats1 = _pInstanceCompute->getStorageBuffer(c_instanceMatrices_1, frame);
+  auto mats2 = _pInstanceCompute->getStorageBuffer(c_instanceMatrices_2, frame);
+
+  GPUInstanceUpdatePush push = {
+    .origin = BR2::vec3(-0.5f, -0.5f, -0.5f),  //cube origin
+    .time = (float)_gpuInstanceTime,
+    .count = _numInstances,
+  };
+  if (_pInstanceCompute->beginDispatch(cmd, frame)) {
+    _pInstanceCompute->bindStorageBuffer("_drawInstanceParams", _instanceParams1);
+    _pInstanceCompute->bindStorageBuffer("_drawInstanceMatrices", mats1);
+    cmd->pushConstants(_pInstanceCompute->boundPipeline(), push);
+    _pInstanceCompute->dispatchItems(cmd, _numInstances);
+
+    _pInstanceCompute->bindStorageBuffer("_drawInstanceParams", _instanceParams2);
+    _pInstanceCompute->bindStorageBuffer("_drawInstanceMatrices", mats2);
+    _pInstanceCompute->dispatchItems(cmd, _numInstances);
+    _pInstanceCompute->endDispatch();
+  }
+
+  //The vertex shader reads the matrices as _uboInstanceData, _drawInstanceData with the SSBO shader, or as the instance stream.
+  //instance_cull.cs reads them too.
+  for (auto& mats : { mats1, mats2 }) {
+    cmd->bufferBarrier(mats->buffer()->getVkBuffer(),
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                       VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  }
+}
+bool GSDL::occlusionCulling(RenderFrame* frame) {
+  //Two phase Hi-Z culling needs the GPU culled instances, and a depth buffer compute can read (no MSAA).
+  if (!g_occlusion_cull || !g_gpu_instances || !g_cull_instances || _hiZ == nullptr) {
+    return false;
+  }
+  string_t errors;
+  auto depth = frame->getRenderTarget(OutputMRT::RT_DefaultDepth, g_multisample, VK_FORMAT_UNDEFINED, errors, VK_NULL_HANDLE, false);
+  return HiZPyramid::supported(depth.get());
+}
+std::shared_ptr<VulkanBuffer> GSDL::cullOutput(RenderFrame* frame, bool second, bool indirect, bool late) {
+  if (indirect) {
+    return _pInstanceCull->getStorageBuffer(late ? (second ? c_indirectDrawsLate_2 : c_indirectDrawsLate_1) : (second ? c_indirectDraws_2 : c_indirectDraws_1), frame);
+  }
+  return _pInstanceCull->getStorageBuffer(late ? (second ? c_visibleInstancesLate_2 : c_visibleInstancesLate_1) : (second ? c_visibleInstances_2 : c_visibleInstances_1), frame);
+}
+uint32_t GSDL::cmd_cullGPUInstances(CommandBuffer* cmd, RenderFrame* frame, uint32_t phase) {
+  //instance_cull.cs compacts the visible instance IDs and counts them into one indirect draw per mesh.
+  //The CPU records the same commands whatever the instance count or visibility is.
+  //Returns the phase that ran. The early phase falls back to frustum culling if the pyramid can't be created, so everything is still drawn.
+  if (phase == HiZPyramid::c_phaseEarly && !_hiZ->update(cmd, _vulkan->swapchain()->windowSize())) {
+    phase = HiZPyramid::c_phaseFrustum;
+  }
+  bool late = (phase == HiZPyramid::c_phaseLate);
+  GPUInstanceCullPush push = {};
+  for (int ip = 0; ip < Frustum::Plane_Count; ++ip) {
+    memcpy(push.planes[ip], _frustum.plane(ip), sizeof(push.planes[ip]));
+  }
+  push.center = BR2::vec3(0.5f, 0.5f, 0.5f);  //Unit cube, before the origin offset.
+  push.radius = _instanceRadius;
+  push.count = _numInstances;
+  push.phase = phase;
+
+  //The occlusion inputs are bound in every phase, the frustum phase doesn't read them and never touches the pyramid.
+  //The late phase reads the pyramid built this frame.
+  bool occlusionPhase = (phase != HiZPyramid::c_phaseFrustum);
+  auto occlusion = _pInstanceCull->getUBO(c_occlusionUBO, frame);
+  if (phase == HiZPyramid::c_phaseEarly) {
+    GPUOcclusionUBO ub = {};
+    ub.view[0] = _hiZViewProj.view;
+    ub.proj[0] = _hiZViewProj.proj;
+    ub.view[1] = _viewProj.view;
+    ub.proj[1] = _viewProj.proj;
+    ub.depthSize = BR2::vec2((float)_hiZ->depthSize().width, (float)_hiZ->depthSize().height);
+    ub.mipLevels = _hiZ->mipLevels();
+    ub.pyramidValid = _hiZ->valid() ? 1 : 0;
+    occlusion->writeData(&ub, 1);
+  }
+
+  std::shared_ptr<VulkanBuffer> outputs[2][3];
+  if (_pInstanceCull->beginDispatch(cmd, frame)) {
+    for (int iset = 0; iset < 2; ++iset) {
+      bool second = (iset == 1);
+      auto visible = cullOutput(frame, second, false, late);
+      auto indirect = cullOutput(frame, second, true, late);
+      auto state = _pInstanceCull->getStorageBuffer(second ? c_occlusionState_2 : c_occlusionState_1, frame);
+      auto mesh = _game->instanceSetMesh(second ? 1 : 0);
+      outputs[iset][0] = visible;
+      outputs[iset][1] = indirect;
+      outputs[iset][2] = state;
+
+      //The frame's fence has passed, so this is the count of its last submission.
+      GPUIndirectDraws* last = static_cast<GPUIndirectDraws*>(indirect->mapData());
+      if (last != nullptr) {
+        uint32_t count = last->drawCount ? last->draws[0].instanceCount : 0;
+        _instancesVisible += count;
+        _instancesLate += late ? count : 0;
+      }
+      indirect->unmapData();
+
+      GPUIndirectDraws draws = {};
+      draws.draws[0].indexCount = mesh->indexCount();
+      indirect->writeData(&draws, 1);
+
+      _pInstanceCull->bindStorageBuffer("_drawInstanceMatrices", getInstanceBuffer(frame, second));
+      _pInstanceCull->bindStorageBuffer("_drawVisibleInstances", visible);
+      _pInstanceCull->bindStorageBuffer("_drawIndirect", indirect);
+      _pInstanceCull->bindStorageBuffer("_drawOcclusionState", state);
+      _pInstanceCull->bindUBO("_uboOcclusion", occlusion);
+      if (occlusionPhase) {
+        _pInstanceCull->bindImage("_passHiZ", _hiZ->resourceId(), _hiZ->imageView(), VK_IMAGE_LAYOUT_GENERAL, _hiZ->sampler());
+      }
+      else {
+        _pInstanceCull->bindSampler("_passHiZ", _hiZDummy);
+      }
+      cmd->pushConstants(_pInstanceCull->boundPipeline(), push);
+      _pInstanceCull->dispatchItems(cmd, _numInstances);
+    }
+    _pInstanceCull->endDispatch();
+  }
+
+  for (auto& out : outputs) {
+    if (out[0] == nullptr) {
+      continue;
+    }
+    cmd->bufferBarrier(out[0]->buffer()->getVkBuffer(),
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    cmd->bufferBarrier(out[1]->buffer()->getVkBuffer(),
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+    if (phase == HiZPyramid::c_phaseEarly) {
+      //Read by the late phase.
+      cmd->bufferBarrier(out[2]->buffer()->getVkBuffer(),
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+  }
+  return phase;
+}
+void GSDL::setOcclusionCull(bool enable) {
+  if (enable == g_occlusion_cull) {
+    return;
+  }
+  //The pyramid is only built while this is on.
+  if (_hiZ) {
+    _hiZ->invalidate();
+  }
+  g_occlusion_cull = enable;
+}
+void GSDL::setGPUInstances(bool enable) {
+  if (enable == g_gpu_instances) {
+    return;
+  }
+  if (enable) {
+    //Frames in flight may still read the old params.
+    vulkan()->waitIdle();
+    _instanceParams1 = nullptr;
+    _instanceParams2 = nullptr;
+    _gpuInstanceTime = 0;
+  }
+  else {
+    //Continue the CPU animation from where the GPU left it. The UBOs weren't written meanwhile.
+    for (auto instances : { &_instances1, &_instances2 }) {
+      for (size_t i = 0; i < instances->count(); ++i) {
+        instances->angle()[i] += instances->angularVelocity()[i] * (float)_gpuInstanceTime;
+      }
+      instances->markAllChanged();
+    }
+  }
+  g_gpu_instances = enable;
+}
+void GSDL::setCullInstances(bool enable) {
+  if (enable == g_cull_instances) {
+    return;
+  }
+  if (!enable) {
+    //The buffers hold the packed visible instances, not the dense ones.
+    _instances1.markAllChanged();
+    _instances2.markAllChanged();
+  }
+  g_cull_instances = enable;
+}
+void GSDL::setSceneGraph(bool enable) {
+  if (enable == g_scene_graph) {
+    return;
+  }
+  //The buffers hold the other path's matrices. A new graph starts dirty in every frame.
+  _sceneGraph = nullptr;
+  _instances1.markAllChanged();
+  g_scene_graph = enable;
+}
+void GSDL::setLods(bool enable) {
+  if (enable == g_lods) {
+    return;
+  }
+  if (!enable) {
+    //The buffers hold the instances in LOD order.
+    _instances1.markAllChanged();
+    _instances2.markAllChanged();
+  }
+  g_lods = enable;
+}
+void GSDL::setLodSimplify(bool enable) {
+  if (enable == g_lod_simplify) {
+    return;
+  }
+  //Frames in flight may still draw the old mesh.
+  vulkan()->waitIdle();
+  g_lod_simplify = enable;
+  createLodMesh();
+}
+void GSDL::createLodMesh() {
+  _lodMesh = std::make_shared<Mesh>(_vulkan.get());
+  if (g_lod_simplify) {
+    //Simplifications of one dense sphere, indexing its vertices.
+    _lodMesh->makeSphere(128, 64);
+    MeshSimplifier::buildLodChain(*_lodMesh, 3, 0.25f, SimplifyOptions(), _jobs.get());
+    return;
+  }
+  //Coarser tessellations of the same sphere, each with its own vertices.
+  _lodMesh->makeSphere(64, 32);
+  std::vector<MeshLodData> chain;
+  for (uint32_t slices : { 32u, 16u, 8u }) {
+    MeshLodData level;
+    Mesh::makeSphereData(slices, slices / 2, level._verts, level._inds);
+    level._error = Mesh::sphereTessError(slices, slices / 2);
+    chain.push_back(std::move(level));
+  }
+  _lodMesh->setLodChain(std::move(chain));
+}
+void GSDL::setInstanceFetch(InstanceFetch fetch) {
+  if (fetch == g_instance_fetch) {
+    return;
+  }
+  //Different buffers, they have none of the matrices.
+  _instances1.markAllChanged();
+  _instances2.markAllChanged();
+  g_instance_fetch = fetch;
+}
+string_t GSDL::instanceFetchName(InstanceFetch fetch) {
+  if (fetch == InstanceFetch::SSBO) {
+    return "SSBO";
+  }
+  else if (fetch == InstanceFetch::VertexStream) {
+    return "VS";
+  }
+  return "UBO";
+}
+void GSDL::setInstanceCount(uint32_t count) {
+  //Frames in flight may still read the GPU params.
+  vulkan()->waitIdle();
+  _numInstances = std::min(count, _maxInstances);
+  _instances1.clear();
+  _instances2.clear();
+  _instanceParams1 = nullptr;
+  _instanceParams2 = nullptr;
+  _gpuInstanceTime = 0;
+  _sceneGraph = nullptr;
+}
+uint32_t GSDL::drawInstanceCount() {
+  return g_instance_fetch == InstanceFetch::UBO ? std::min(_numInstances, _maxUBOInstances) : _numInstances;
+}
+PipelineShader* GSDL::instanceShader() {
+  if (g_gpu_instances && g_cull_instances) {
+    return _pShaderCulled.get();
+  }
+  if (g_instance_fetch == InstanceFetch::SSBO) {
+    return _pShaderSSBO.get();
+  }
+  else if (g_instance_fetch == InstanceFetch::VertexStream) {
+    return (g_bindless_textures && _pShaderBindless != nullptr) ? _pShaderBindless.get() : _pShaderInstStream.get();
+  }
+  return _pShader.get();
+}
+std::shared_ptr<VulkanBuffer> GSDL::getInstanceBuffer(RenderFrame* frame, bool second) {
+  if (g_gpu_instances) {
+    return _pInstanceCompute->getStorageBuffer(second ? c_instanceMatrices_2 : c_instanceMatrices_1, frame);
+  }
+  if (g_instance_fetch == InstanceFetch::SSBO) {
+    return _pShaderSSBO->getStorageBuffer(second ? c_instanceSSBO_2 : c_instanceSSBO_1, frame);
+  }
+  else if (g_instance_fetch == InstanceFetch::VertexStream) {
+    //Not shader data, the vertex input has no descriptor.
+    auto& streams = second ? _instanceStreams2 : _instanceStreams1;
+    if (streams.size() != _vulkan->swapchain()->frames().size()) {
+      streams.resize(_vulkan->swapchain()->frames().size());
+    }
+    auto& stream = streams[frame->frameIndex()];
+    if (stream == nullptr) {
+      stream = std::make_shared<VulkanBuffer>(vulkan(), VulkanBufferType::VertexBuffer, false, sizeof(InstanceUBOData), _maxInstances, nullptr, 0);
+    }
+    return stream;
+  }
+  return _pShader->getUBO(second ? c_instanceUBO_2 : c_instanceUBO_1, frame);
+}
+void GSDL::addInstanceBindings(PipelineShader* shader, RenderFrame* frame, std::shared_ptr<VulkanBuffer> buffer, bool second, DrawBindings& out) {
+  if (shader == _pShaderCulled.get()) {
+    out.storageBuffer("_drawInstanceData", buffer);
+    out.storageBuffer("_drawVisibleInstances", cullOutput(frame, second, false, _drawLateCull));
+  }
+  else if (shader == _pShaderSSBO.get()) {
+    out.storageBuffer("_drawInstanceData", buffer);
+  }
+  else if (shader == _pShaderInstStream.get() || shader == _pShaderBindless.get()) {
+    //Bound with the mesh, see instanceStreams().
+  }
+  else {
+    //The compute output holds every instance, only the drawn ones fit the uniform block.
+    out.ubo("_uboInstanceData", buffer, 0, drawInstanceCount() * sizeof(InstanceUBOData));
+  }
+}
+void GSDL::submitInstances(PipelineShader* shader, RenderFrame* frame, const DrawPipelineState& state, std::shared_ptr<Mesh> mesh,
+                           std::shared_ptr<TextureImage> texture, std::shared_ptr<VulkanBuffer> buffer, bool second, uint32_t drawCount) {
+  DrawPacket p;
+  p._pipeline = state;
+  p._material = passMaterial(shader, frame, texture, buffer, second);
+  p._mesh = mesh;
+  if (g_batch_meshes && shader != _pShaderCulled.get()) {
+    p._instanceStreams = instanceStreams(buffer);
+    if (!submitBatch(p, frame, second, drawCount)) {
+      return;
     }
   }
-  instanceBuffer->writeData(mats.data(), mats.size());
-  // ub.proj._m22 *= -1;
+  else if (shader == _pShaderCulled.get()) {
+    //The instance count, and whether to draw at all, come from instance_cull.cs.
+    auto indirect = cullOutput(frame, second, true, _drawLateCull);
+    p._indirect = indirect.get();
+    p._indirectOffset = offsetof(GPUIndirectDraws, draws);
+    p._indirectCount = indirect.get();
+    p._indirectCountOffset = offsetof(GPUIndirectDraws, drawCount);
+    p._maxDrawCount = 1;
+  }
+  else {
+    p._instanceStreams = instanceStreams(buffer);
+    p._instanceCount = drawCount;
+    auto& lods = second ? _lodBuckets2 : _lodBuckets1;
+    if (g_lods && !lods.empty() && !submitLods(p, frame, second, lods)) {
+      return;
+    }
+  }
+  _drawQueue.submit(std::move(p));
+}
+std::shared_ptr<DrawBindings> GSDL::passMaterial(PipelineShader* shader, RenderFrame* frame, std::shared_ptr<TextureImage> texture,
+                                                 std::shared_ptr<VulkanBuffer> buffer, bool second) {
+  //DrawQueue compares materials by pointer, so draws with the same texture and instance set share one.
+  auto& material = _passMaterials[std::make_tuple(texture.get(), buffer.get(), second)];
+  if (material == nullptr) {
+    material = std::make_shared<DrawBindings>();
+    if (shader->usesBindlessTextures()) {
+      material->bindlessTexture(texture);
+    }
+    else {
+      material->sampler("_ufTexture0", texture);
+    }
+    addInstanceBindings(shader, frame, buffer, second, *material);
+  }
+  return material;
+}
+void GSDL::submitSceneDraws(PipelineShader* shader, RenderFrame* frame, const DrawPipelineState& state, uint32_t layer, std::shared_ptr<TextureImage> passTexture,
+                            std::shared_ptr<VulkanBuffer> inst1, std::shared_ptr<VulkanBuffer> inst2, uint32_t drawCount1, uint32_t drawCount2) {
+  //The instance sets of the layer the frustum can see, all into the pass's one queue so record() sorts and collapses their binds.
+  // Draws without a texture of their own use the pass's. A set drawn by two passes rebuilds the same _passDraws both times.
+  std::vector<SceneDraw> draws;
+  _game->collectDraws(layer, &_frustum, draws);
+  for (auto& d : draws) {
+    if (d._instanceSet > 1) {
+      BRLogWarnOnce("Instance set " + std::to_string(d._instanceSet) + " has no instance buffer.");
+      continue;
+    }
+    bool second = (d._instanceSet == 1);
+    submitInstances(shader, frame, state, d._mesh, d._texture ? d._texture : passTexture, second ? inst2 : inst1, second, second ? drawCount2 : drawCount1);
+  }
+}
+MeshBatch* GSDL::meshBatch() {
+  if (_meshBatch == nullptr) {
+    _meshBatch = std::make_unique<MeshBatch>();
+    std::mt19937 engine(5678);
+    std::uniform_real_distribution<float> tint(0.4f, 1.0f);
+    for (uint32_t i = 0; i < _batchMeshCount; ++i) {
+      std::vector<Mesh::VertType> verts = _game->instanceSetMesh(0)->vertices();
+      std::vector<uint32_t> inds = _game->instanceSetMesh(0)->indices();
+      BR2::vec4 c = { tint(engine), tint(engine), tint(engine), 1 };
+      for (auto& v : verts) {
+        v._color = { v._color.x * c.x, v._color.y * c.y, v._color.z * c.z, v._color.w };
+      }
+      _meshBatch->add(std::move(verts), std::move(inds));
+    }
+    if (!_meshBatch->build(_vulkan.get())) {
+      _meshBatch = nullptr;
+    }
+  }
+  return _meshBatch.get();
+}
+bool GSDL::submitBatch(DrawPacket& p, RenderFrame* frame, bool second, uint32_t drawCount) {
+  //Mesh k of the batch draws instances [n*k/M, n*(k+1)/M), the whole pass is one multi-draw.
+  MeshBatch* batch = meshBatch();
+  if (batch == nullptr) {
+    return false;
+  }
+  auto& builder = _passDraws[second ? 1 : 0];
+  builder.clear();
+  size_t ranges = batch->rangeCount();
+  for (size_t k = 0; k < ranges; ++k) {
+    uint32_t first = static_cast<uint32_t>((uint64_t)drawCount * k / ranges);
+    uint32_t last = static_cast<uint32_t>((uint64_t)drawCount * (k + 1) / ranges);
+    builder.add(batch->range(k), last - first, first);
+  }
+  p._mesh = batch->mesh();
+  return uploadPassDraws(p, frame, second);
+}
+bool GSDL::submitLods(DrawPacket& p, RenderFrame* frame, bool second, const LodBuckets& lods) {
+  //One instanced draw per LOD, all in one multi-draw. The instances were packed in LOD order by updateInstanceUniformBuffer.
+  auto& builder = _passDraws[second ? 1 : 0];
+  builder.clear();
+  auto& meshLods = _lodMesh->lods();
+  for (size_t l = 0; l < lods._count.size() && l < meshLods.size(); ++l) {
+    builder.add(meshLods[l]._firstIndex, meshLods[l]._indexCount, meshLods[l]._vertexOffset, lods._count[l], lods._first[l]);
+  }
+  p._mesh = _lodMesh;
+  return uploadPassDraws(p, frame, second);
+}
+bool GSDL::uploadPassDraws(DrawPacket& p, RenderFrame* frame, bool second) {
+  auto& builder = _passDraws[second ? 1 : 0];
+  auto& buffers = _passIndirect[second ? 1 : 0];
+  if (buffers.size() != _vulkan->swapchain()->frames().size()) {
+    buffers.resize(_vulkan->swapchain()->frames().size());
+  }
+  //This frame's fence has passed, so a buffer that's too small can be replaced.
+  auto& indirect = buffers[frame->frameIndex()];
+  if (indirect == nullptr || indirect->buffer()->itemCount() < builder.size()) {
+    indirect = std::make_shared<VulkanBuffer>(vulkan(), VulkanBufferType::StorageBuffer, false, sizeof(VkDrawIndexedIndirectCommand),
+                                              std::max(builder.size(), (size_t)1), nullptr, 0);
+  }
+  if (!builder.upload(indirect.get())) {
+    return false;
+  }
+  p._indirect = indirect.get();
+  p._batchDraws = &builder.draws();
+  return true;
+}
+std::vector<VulkanBuffer*> GSDL::instanceStreams(std::shared_ptr<VulkanBuffer> buffer) {
+  if (g_instance_fetch == InstanceFetch::VertexStream) {
+    return { buffer.get() };
+  }
+  return {};
+}
+void GSDL::startFetchBenchmark() {
+  if (_fetchBench.active()) {
+    return;
+  }
+  if (!vulkan()->deviceProperties().limits.timestampComputeAndGraphics) {
+    BRLogWarn("Instance fetch benchmark needs GPU timestamps, which this device doesn't support.");
+    return;
+  }
+  _fetchBench = FetchBenchmark();
+  _fetchBench._savedFetch = g_instance_fetch;
+  _fetchBench._savedInstances = _numInstances;
+  //Equal counts for every path, then the counts the UBO can't draw.
+  for (uint32_t count = 25; count <= _maxInstances; count = (count < _maxUBOInstances) ? _maxUBOInstances : count * 10) {
+    for (int fetch = 0; fetch < (int)InstanceFetch::InstanceFetch_Count; ++fetch) {
+      if ((InstanceFetch)fetch == InstanceFetch::UBO && count > _maxUBOInstances) {
+        continue;
+      }
+      FetchBenchmark::Run run;
+      run._fetch = (InstanceFetch)fetch;
+      run._instances = count;
+      _fetchBench._runs.push_back(run);
+    }
+  }
+  BRLogInfo("Instance fetch benchmark: " + std::to_string(_fetchBench._runs.size()) + " runs of " + std::to_string(_fetchBenchSamples) + " frames.");
+  applyFetchBenchmarkRun();
+}
+void GSDL::applyFetchBenchmarkRun() {
+  auto& run = _fetchBench._runs[_fetchBench._current];
+  setInstanceFetch(run._fetch);
+  if (_numInstances != run._instances) {
+    setInstanceCount(run._instances);
+  }
+}
+void GSDL::stepFetchBenchmark(RenderFrame* frame) {
+  //Frame times are read back when a frame is reused, so the first frames of a run still belong to the last one.
+  if (!_fetchBench.active()) {
+    return;
+  }
+  auto& run = _fetchBench._runs[_fetchBench._current];
+  if (run._frames++ >= _fetchBenchWarmup && frame->gpuTimeMs() >= 0) {
+    run._gpuMs += frame->gpuTimeMs();
+    run._samples++;
+  }
+  if (run._samples < _fetchBenchSamples) {
+    return;
+  }
+  _fetchBench._current++;
+  if (_fetchBench.active()) {
+    applyFetchBenchmarkRun();
+    return;
+  }
+
+  BRLogInfo("Instance fetch benchmark (GPU time per frame, 2 draws):");
+  for (auto& r : _fetchBench._runs) {
+    double ms = r._gpuMs / (double)r._samples;
+    double nsPerInstance = ms * 1000000.0 / (double)(r._instances * 2);
+    BRLogInfo("  " + instanceFetchName(r._fetch) + " " + std::to_string(r._instances) + " instances: " + std::to_string(ms) + "ms, " + std::to_string(nsPerInstance) + "ns/instance");
+  }
+  setInstanceFetch(_fetchBench._savedFetch);
+  setInstanceCount(_fetchBench._savedInstances);
 }
 void GSDL::drawFrame() {
   AssertOrThrow2(_vulkan);
@@ -552,6 +1378,19 @@ void GSDL::drawFrame() {
 
     RenderFrame* frame = _vulkan->swapchain()->currentFrame();
     if (frame != nullptr) {
+      _instancesUploaded = 0;
+      _instancesVisible = 0;
+      _instancesLate = 0;
+      _cullMs = 0;
+      _instancesOccluded = 0;
+      _occlusionMs = 0;
+      _sceneChanged = 0;
+      _sceneMs = 0;
+      _lodBuckets1.clear();
+      _lodBuckets2.clear();
+      _drawStats.reset();
+      stepFetchBenchmark(frame);
+      updateScene((float)t01);
       if (g_pass_test_idx == 0) {
         cmd_simpleCubes(frame, t01);
       }
@@ -568,13 +1407,19 @@ void GSDL::cmd_RenderToTexture(RenderFrame* frame, double dt) {
   //2 Pass Render to texture test
   uint32_t frameIndex = frame->frameIndex();
 
+  PipelineShader* shader = instanceShader();
   auto viewProj = _pShader->getUBO(c_viewProjUBO, frame);
-  auto inst1 = _pShader->getUBO(c_instanceUBO_1, frame);
-  auto inst2 = _pShader->getUBO(c_instanceUBO_2, frame);
+  auto inst1 = getInstanceBuffer(frame, false);
+  auto inst2 = getInstanceBuffer(frame, true);
   auto lightsubo = _pShader->getUBO(c_lightsUBO, frame);
   updateViewProjUniformBuffer(viewProj);
-  updateInstanceUniformBuffer(inst1, offsets1, rots_delta1, rots_ini1, (float)dt, axes1);
-  updateInstanceUniformBuffer(inst2, offsets2, rots_delta2, rots_ini2, (float)dt, axes2);
+  //CPU culling packs the visible instances. GPU culling counts them into the indirect draws.
+  uint32_t drawCount1 = drawInstanceCount();
+  uint32_t drawCount2 = drawInstanceCount();
+  if (!g_gpu_instances) {
+    drawCount1 = g_scene_graph ? updateSceneGraphBuffer(inst1, frame, (float)dt) : updateInstanceUniformBuffer(inst1, _instances1, _lodBuckets1, frame, (float)dt);
+    drawCount2 = updateInstanceUniformBuffer(inst2, _instances2, _lodBuckets2, frame, (float)dt);
+  }
   updateLights(lightsubo, (float)dt);
   auto renderTex = vulkan()->swapchain()->getRenderTexture("Test_RenderTexture", vulkan()->swapchain()->imageFormat(), g_multisample,
                                                            FilterData{ SamplerType::Sampled, MipmapMode::Disabled, vulkan()->maxAF(),
@@ -585,60 +1430,85 @@ void GSDL::cmd_RenderToTexture(RenderFrame* frame, double dt) {
   auto topo = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   auto cmd = frame->commandBuffer();
   cmd->begin();
+  frame->beginGpuTimer();
+  frame->beginPipelineStats();
+  if (g_gpu_instances) {
+    cmd_updateGPUInstances(cmd, frame, dt);
+    if (g_cull_instances) {
+      cmd_cullGPUInstances(cmd, frame, HiZPyramid::c_phaseFrustum);
+    }
+  }
   {
-    auto renderPass1 = _pShader->getPass(frame, g_multisample, BlendFunc::Disabled, FramebufferBlendMode::Independent);
+    DrawPipelineState state;
+    state._polygonMode = mode;
+    state._topology = topo;
+    state._cullMode = g_cullmode;
+    DrawBindings passData;
+    passData.ubo("_uboViewProj", viewProj).ubo("_uboLights", lightsubo);
+
+    auto renderPass1 = shader->getPass(frame, g_multisample, BlendFunc::Disabled, FramebufferBlendMode::Independent);
     renderPass1->setOutput("test_render_texture", OutputMRT::RT_DefaultColor, renderTex, BlendFunc::Disabled, true, cr, cg, cb);
     renderPass1->setOutput(OutputDescription::depthDefault(true));
 
-    if (_pShader->beginRenderPass(cmd, std::move(renderPass1))) {
-      if (_pShader->bindPipeline(cmd, nullptr, mode, topo, g_cullmode)) {
-        //A compatible descriptor set must be bound for all set numbers that any shaders in a pipeline access,
-        // at the time that a drawing or dispatching command is recorded to execute using that pipeline
-        // YUou can't modify descriptors when a command is in the recording state.
-        _pShader->bindViewport(cmd, { { 0, 0 }, _vulkan->swapchain()->windowSize() });
-        _pShader->bindUBO("_uboViewProj", viewProj);
-        _pShader->bindSampler("_ufTexture0", _testTexture1);
-        _pShader->bindUBO("_uboInstanceData", inst1);
-        _pShader->bindUBO("_uboLights", lightsubo);
-        _pShader->bindDescriptors(cmd);
-        _pShader->drawIndexed(cmd, _game->_mesh1, _numInstances);  //Changed from pipe::drawIndexed
-      }
-      _pShader->endRenderPass(cmd);
+    if (shader->beginRenderPass(cmd, std::move(renderPass1))) {
+      //A compatible descriptor set must be bound for all set numbers that any shaders in a pipeline access,
+      // at the time that a drawing or dispatching command is recorded to execute using that pipeline
+      // YUou can't modify descriptors when a command is in the recording state.
+      _drawQueue.clear();
+      _passMaterials.clear();
+      submitSceneDraws(shader, frame, state, GameDummy::c_layerScene, nullptr, inst1, inst2, drawCount1, drawCount2);
+      _drawQueue.record(cmd, shader, passData, { { 0, 0 }, _vulkan->swapchain()->windowSize() });
+      _drawStats.add(_drawQueue.stats());
+      shader->endRenderPass(cmd);
     }
-    auto renderPass2 = _pShader->getPass(frame, g_multisample, BlendFunc::Disabled, FramebufferBlendMode::Independent);
+    auto renderPass2 = shader->getPass(frame, g_multisample, BlendFunc::Disabled, FramebufferBlendMode::Independent);
 
     renderPass2->setOutput(OutputDescription::colorDefault(nullptr, true));
     renderPass2->setOutput(OutputDescription::depthDefault(true));
 
-    if (_pShader->beginRenderPass(cmd, std::move(renderPass2))) {
-      if (_pShader->bindPipeline(cmd, nullptr, mode, topo, g_cullmode)) {
-        _pShader->bindViewport(cmd, { { 0, 0 }, _vulkan->swapchain()->windowSize() });
-        _pShader->bindUBO("_uboViewProj", viewProj);
-        _pShader->bindSampler("_ufTexture0", renderTex->texture(MSAA::Disabled, frame->frameIndex()));
-        _pShader->bindUBO("_uboInstanceData", inst2);
-        _pShader->bindUBO("_uboLights", lightsubo);
-        _pShader->bindDescriptors(cmd);
-        _pShader->drawIndexed(cmd, _game->_mesh2, _numInstances);  //Changed from pipe::drawIndexed
-      }
-      _pShader->endRenderPass(cmd);
+    if (shader->beginRenderPass(cmd, std::move(renderPass2))) {
+      _drawQueue.clear();
+      _passMaterials.clear();
+      submitSceneDraws(shader, frame, state, GameDummy::c_layerDisplay, renderTex->texture(MSAA::Disabled, frame->frameIndex()), inst1, inst2, drawCount1, drawCount2);
+      _drawQueue.record(cmd, shader, passData, { { 0, 0 }, _vulkan->swapchain()->windowSize() });
+      _drawStats.add(_drawQueue.stats());
+      shader->endRenderPass(cmd);
     }
   }
+  frame->endPipelineStats();
+  frame->endGpuTimer();
   cmd->end();
 }
 void GSDL::cmd_simpleCubes(RenderFrame* frame, double dt) {
   uint32_t frameIndex = frame->frameIndex();
 
+  PipelineShader* shader = instanceShader();
   auto viewProj = _pShader->getUBO(c_viewProjUBO, frame);
-  auto inst1 = _pShader->getUBO(c_instanceUBO_1, frame);
-  auto inst2 = _pShader->getUBO(c_instanceUBO_2, frame);
+  auto inst1 = getInstanceBuffer(frame, false);
+  auto inst2 = getInstanceBuffer(frame, true);
   auto lightsubo = _pShader->getUBO(c_lightsUBO, frame);
   updateViewProjUniformBuffer(viewProj);
-  updateInstanceUniformBuffer(inst1, offsets1, rots_delta1, rots_ini1, (float)dt, axes1);
-  updateInstanceUniformBuffer(inst2, offsets2, rots_delta2, rots_ini2, (float)dt, axes2);
+  //CPU culling packs the visible instances. GPU culling counts them into the indirect draws.
+  uint32_t drawCount1 = drawInstanceCount();
+  uint32_t drawCount2 = drawInstanceCount();
+  if (!g_gpu_instances) {
+    drawCount1 = g_scene_graph ? updateSceneGraphBuffer(inst1, frame, (float)dt) : updateInstanceUniformBuffer(inst1, _instances1, _lodBuckets1, frame, (float)dt);
+    drawCount2 = updateInstanceUniformBuffer(inst2, _instances2, _lodBuckets2, frame, (float)dt);
+  }
   updateLights(lightsubo, (float)dt);
 
   auto cmd = frame->commandBuffer();
   cmd->begin();
+  frame->beginGpuTimer();
+  frame->beginPipelineStats();
+  bool occlusion = occlusionCulling(frame);
+  if (g_gpu_instances) {
+    cmd_updateGPUInstances(cmd, frame, dt);
+    if (g_cull_instances) {
+      //Without a pyramid this frame is frustum culled only, and there's no late pass.
+      occlusion = cmd_cullGPUInstances(cmd, frame, occlusion ? HiZPyramid::c_phaseEarly : HiZPyramid::c_phaseFrustum) == HiZPyramid::c_phaseEarly;
+    }
+  }
   {
     //Testing clear color
     float speed = 0.001f;
@@ -680,21 +1550,40 @@ void GSDL::cmd_simpleCubes(RenderFrame* frame, double dt) {
 
     //if x=0 test a simple pass
     //otherwise test the complex pass.
-    auto simple_pass = _pShader->getPass(frame, g_multisample, BlendFunc::Disabled, FramebufferBlendMode::Independent);
-    simple_pass->setOutput(OutputDescription::colorDefault());
-    simple_pass->setOutput(OutputDescription::depthDefault());
-    if (_pShader->beginRenderPass(cmd, std::move(simple_pass))) {
-      if (_pShader->bindPipeline(cmd, nullptr, mode, topo, g_cullmode)) {
-        _pShader->bindViewport(cmd, { { 0, 0 }, _vulkan->swapchain()->windowSize() });
-        _pShader->bindUBO("_uboViewProj", viewProj);
-
-        _pShader->bindSampler("_ufTexture0", _testTexture1);
-        _pShader->bindUBO("_uboInstanceData", inst1);
-        _pShader->bindUBO("_uboLights", lightsubo);
-        _pShader->bindDescriptors(cmd);
-        _pShader->drawIndexed(cmd, _game->_mesh1, _numInstances);  //Changed from pipe::drawIndexed
-      }
-      _pShader->endRenderPass(cmd);
+    //With occlusion culling a second pass loads the first and draws the instances the Hi-Z pyramid of the first shows.
+    bool drawn = false;
+    for (int ipass = 0; ipass < (occlusion ? 2 : 1); ++ipass) {
+      bool latePass = (ipass == 1);
+      if (latePass) {
+        string_t errors;
+        auto depth = frame->getRenderTarget(OutputMRT::RT_DefaultDepth, g_multisample, VK_FORMAT_UNDEFINED, errors, VK_NULL_HANDLE, false);
+        if (!drawn || !_hiZ->build(cmd, frame, depth.get())) {
+          break;
+        }
+        _hiZViewProj = _viewProj;
+        cmd_cullGPUInstances(cmd, frame, HiZPyramid::c_phaseLate);
+      }
+      auto simple_pass = shader->getPass(frame, g_multisample, BlendFunc::Disabled, FramebufferBlendMode::Independent);
+      simple_pass->setOutput(OutputDescription::colorDefault(nullptr, !latePass));
+      simple_pass->setOutput(OutputDescription::depthDefault(!latePass));
+      if (shader->beginRenderPass(cmd, std::move(simple_pass))) {
+        DrawPipelineState state;
+        state._polygonMode = mode;
+        state._topology = topo;
+        state._cullMode = g_cullmode;
+        DrawBindings passData;
+        passData.ubo("_uboViewProj", viewProj).ubo("_uboLights", lightsubo);
+
+        _drawLateCull = latePass;
+        _drawQueue.clear();
+        _passMaterials.clear();
+        submitSceneDraws(shader, frame, state, GameDummy::c_layerScene, nullptr, inst1, inst2, drawCount1, drawCount2);
+        _drawQueue.record(cmd, shader, passData, { { 0, 0 }, _vulkan->swapchain()->windowSize() });
+        _drawStats.add(_drawQueue.stats());
+        _drawLateCull = false;
+        shader->endRenderPass(cmd);
+        drawn = true;
+      }
     }
     //     else {
     //       bool pass1_success = false;
@@ -764,20 +1653,30 @@ void GSDL::cmd_simpleCubes(RenderFrame* frame, double dt) {
     //
     //     }  //if x != 0
   }
+  frame->endPipelineStats();
+  frame->endGpuTimer();
   cmd->end();
 }
-std::shared_ptr<Img32> GSDL::loadImage(const string_t& img) {
+std::shared_ptr<Img32> GSDL::loadImage(const string_t& img, string_t& out_error) {
+  //Runs on job threads, so failures are returned for the caller to report.
   unsigned char* data = nullptr;  //the raw pixels
   unsigned int width, height;
 
-  std::vector<char> image_data = Gu::readFile(img);
+  std::vector<char> image_data;
+  try {
+    image_data = Gu::readFile(img);
+  }
+  catch (const string_t& ex) {
+    out_error = ex;
+    return nullptr;
+  }
 
   int err = lodepng_decode32(&data, &width, &height, (unsigned char*)image_data.data(), image_data.size());
 
   int required_bytes = 4;
 
   if (err != 0) {
-    vulkan()->errorExit("LodePNG could not load image, error: " + err);
+    out_error = "LodePNG could not load image '" + img + "', error: " + std::to_string(err);
     return nullptr;
   }
   std::shared_ptr<Img32> ret = std::make_shared<Img32>();
@@ -789,23 +1688,36 @@ std::shared_ptr<Img32> GSDL::loadImage(const string_t& img) {
 }
 void GSDL::createTextureImages() {
   // auto img = loadImage(App::rootFile("test.png"));
-  auto img = loadImage(App::dataFile(g_test_img1 ? "grass.png" : "TexturesCom_MetalBare0253_2_M.png"));
+  //Decode both images at once, the texture uploads stay on this thread.
+  std::shared_ptr<Img32> img = nullptr;
+  std::shared_ptr<Img32> img2 = nullptr;
+  string_t err, err2;
+  JobCounter decoded;
+  _jobs->run([&]() { img = loadImage(App::dataFile(g_test_img1 ? "grass.png" : "TexturesCom_MetalBare0253_2_M.png"), err); }, &decoded);
+  _jobs->run([&]() { img2 = loadImage(App::dataFile("dirt.png"), err2); }, &decoded);
+  _jobs->wait(&decoded);
+
+  //Frames in flight may still sample the textures being replaced.
+  vulkan()->waitIdle();
   if (img) {
     _testTexture1 = std::make_shared<TextureImage>(vulkan(), img->_name, TextureType::ColorTexture, MSAA::Disabled, img,
                                                    FilterData{ SamplerType::Sampled, g_mipmap_mode, g_anisotropy, g_min_filter,
                                                                g_mag_filter, MipLevels::Unset });
   }
   else {
-    vulkan()->errorExit("Could not load test image 1.");
+    vulkan()->errorExit("Could not load test image 1: " + err);
   }
-  auto img2 = loadImage(App::dataFile("dirt.png"));
   if (img2) {
-    _testTexture2 = std::make_shared<TextureImage>(vulkan(), img->_name, TextureType::ColorTexture, MSAA::Disabled, img2,
+    _testTexture2 = std::make_shared<TextureImage>(vulkan(), img2->_name, TextureType::ColorTexture, MSAA::Disabled, img2,
                                                    FilterData{ SamplerType::Sampled, g_mipmap_mode, g_anisotropy, g_min_filter,
                                                                g_mag_filter, MipLevels::Unset });
   }
   else {
-    vulkan()->errorExit("Could not load test image 2.");
+    vulkan()->errorExit("Could not load test image 2: " + err2);
+  }
+  if (_game) {
+    _game->setTexture(_sceneTexture1, _testTexture1);
+    _game->setTexture(_sceneTexture2, _testTexture2);
   }
 }
 void GSDL::allocateShaderMemory() {
@@ -833,9 +1745,26 @@ void GSDL::cleanup() {
   _testTexture1 = nullptr;
   _testTexture2 = nullptr;
   _pShader = nullptr;
+  _pShaderSSBO = nullptr;
+  _pShaderInstStream = nullptr;
+  _pShaderBindless = nullptr;
+  _instanceStreams1.clear();
+  _instanceStreams2.clear();
+  _pShaderCulled = nullptr;
+  _meshBatch = nullptr;
+  _lodMesh = nullptr;
+  _passIndirect[0].clear();
+  _passIndirect[1].clear();
+  _pInstanceCompute = nullptr;
+  _pInstanceCull = nullptr;
+  _hiZ = nullptr;
+  _hiZDummy = nullptr;
+  _instanceParams1 = nullptr;
+  _instanceParams2 = nullptr;
   _game = nullptr;
 
   _vulkan = nullptr;
+  _jobs = nullptr;
 
   SDL_DestroyWindow(_pSDLWindow);
 }
@@ -1003,8 +1932,9 @@ bool GSDL::doInput() {
         this->_vulkan->set_wait_fences(g_wait_fences);
       }      
       else if (event.key.keysym.scancode == SDL_SCANCODE_8) {
-        _game->_mesh1->recopyData();
-        _game->_mesh2->recopyData();
+        for (uint32_t im = 0; im < _game->meshCount(); ++im) {
+          _game->mesh(im)->recopyData();
+        }
       }
       else if (event.key.keysym.scancode == SDL_SCANCODE_9) {
         if (_pDebugWindow == nullptr) {
@@ -1034,6 +1964,45 @@ bool GSDL::doInput() {
       else if (event.key.keysym.scancode == SDL_SCANCODE_F4) {
         g_use_rtt = !g_use_rtt;
       }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_F5) {
+        TransformKernels::benchmark();
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_F6) {
+        setGPUInstances(!g_gpu_instances);
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_C) {
+        setCullInstances(!g_cull_instances);
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_B) {
+        g_batch_meshes = !g_batch_meshes;
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_H) {
+        setSceneGraph(!g_scene_graph);
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_L) {
+        setLods(!g_lods);
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_K) {
+        setLodSimplify(!g_lod_simplify);
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_O) {
+        setOcclusionCull(!g_occlusion_cull);
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_M) {
+        g_cpu_occlusion = !g_cpu_occlusion;
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_T) {
+        g_bindless_textures = !g_bindless_textures;
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_F7) {
+        setInstanceFetch((InstanceFetch)(((int)g_instance_fetch + 1) % (int)InstanceFetch::InstanceFetch_Count));
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_F12) {
+        setInstanceCount(_numInstances >= _maxInstances ? 25 : (_numInstances < _maxUBOInstances ? _maxUBOInstances : _numInstances * 10));
+      }
+      else if (event.key.keysym.scancode == SDL_SCANCODE_0) {
+        startFetchBenchmark();
+      }
       else if (event.key.keysym.scancode == SDL_SCANCODE_F8) {
         g_pass_test_idx++;
         if (g_pass_test_idx > 4) {
@@ -1070,6 +2039,7 @@ void GSDL::renderLoop() {
   bool exit = false;
   while (!exit) {
     exit = doInput();
+    _jobs->processMainThreadJobs();
 
     try {
       //FPS
@@ -1096,11 +2066,52 @@ void GSDL::renderLoop() {
         string_t line = " F3=Line(" + std::to_string((int)g_poly_line) + ")";
         string_t rtt = " F4=RTT(" + std::to_string((int)g_use_rtt) + ")";
         string_t pass = " F8=pass(" + std::to_string(g_pass_test_idx) + ")";
+        string_t gpuinst = " F6=gpuinst(" + std::to_string((int)g_gpu_instances) + ")";
+        string_t ssbo = " F7=fetch(" + instanceFetchName(g_instance_fetch) + ") F12=n(" + std::to_string(_numInstances) + ",draw=" + std::to_string(drawInstanceCount()) + ")";
+        ssbo += " T=bindless(" + std::to_string((int)g_bindless_textures) + (_pShaderBindless ? "" : ",n/a") + ")";
+        double gpuMs = _vulkan->swapchain()->currentFrame() ? _vulkan->swapchain()->currentFrame()->gpuTimeMs() : -1;
+        string_t gpu = " 0=fetchbench gpu(" + (gpuMs >= 0 ? std::to_string(gpuMs) + "ms" : string_t("n/a")) + ")";
+        string_t cull = " C=cull(" + std::to_string((int)g_cull_instances) + ",vis=" + std::to_string(_instancesVisible) + "," + std::to_string(_cullMs) + "ms)";
+        cull += " O=occl(" + std::to_string((int)g_occlusion_cull) + ",late=" + std::to_string(_instancesLate) + ")";
+        cull += " M=moc(" + std::to_string((int)g_cpu_occlusion) + ",occl=" + std::to_string(_instancesOccluded) + "," + std::to_string(_occlusionMs) + "ms)";
+        const PipelineStats* stats = _vulkan->swapchain()->currentFrame() ? &_vulkan->swapchain()->currentFrame()->pipelineStats() : nullptr;
+        string_t pstats = (stats && stats->_valid) ? " ps(vs=" + std::to_string(stats->_vertexInvocations) + ",prim=" + std::to_string(stats->_clippingPrimitives) +
+                                                         ",frag=" + std::to_string(stats->_fragmentInvocations) + ")"
+                                                   : string_t(" ps(n/a)");
+        string_t queue = " q(draw=" + std::to_string(_drawStats._draws) + ",pipe=" + std::to_string(_drawStats._unsortedPipelineBinds) + ">" + std::to_string(_drawStats._pipelineBinds) +
+                         ",desc=" + std::to_string(_drawStats._unsortedDescriptorBinds) + ">" + std::to_string(_drawStats._descriptorBinds) +
+                         ",mesh=" + std::to_string(_drawStats._unsortedMeshBinds) + ">" + std::to_string(_drawStats._meshBinds) +
+                         ",calls=" + std::to_string(_drawStats._drawCalls) + "," + std::to_string(_drawStats._recordMs) + "ms)";
+        string_t batch = " B=batch(" + std::to_string((int)g_batch_meshes) + "," + std::to_string(_batchMeshCount) + ")";
+        string_t lod = " L=lod(" + std::to_string((int)g_lods);
+        for (auto count : _lodBuckets1._count) {
+          lod += "," + std::to_string(count);
+        }
+        lod += ") K=lodsrc(" + string_t(g_lod_simplify ? "simplify" : "tess") + ")";
+        string_t scene = " H=scene(" + std::to_string((int)g_scene_graph) + ",chg=" + std::to_string(_sceneChanged) + "," + std::to_string(_sceneMs) + "ms)";
+        string_t ecs = " ecs(ent=" + std::to_string(_game->_entities.count()) + ",arch=" + std::to_string(_game->_entities.archetypeCount()) +
+                       ",waves=" + std::to_string(_game->_systems.waveCount()) + "," + std::to_string(_entityMs) + "ms)";
+        string_t inst = " inst(n=" + std::to_string(_instances1.count() + _instances2.count()) + ",anim=" + std::to_string(_instances1.animatedCount() + _instances2.animatedCount()) + ",up=" + std::to_string(_instancesUploaded) + ")";
         string_t aniso = " F9=AF(" + std::to_string(g_anisotropy) + ")";
         string_t msaa = " F10=MSAA(x" + std::to_string((int)TextureImage::msaa_to_int(g_multisample)) + ")";
         string_t img = " F11=chimg";
+        string_t desc = " desc(w=" + std::to_string(_pShader->descriptorWritesFlushed()) + ",skip=" + std::to_string(_pShader->descriptorWritesSkipped()) + ")";
+        uint64_t setBinds = 0, setSkips = 0, poolSets = 0;
+        size_t pools = 0;
+        for (auto& frame : _vulkan->swapchain()->frames()) {
+          setBinds += frame->commandBuffer()->descriptorSetBinds();
+          setSkips += frame->commandBuffer()->descriptorSetBindsSkipped();
+          if (frame->descriptorAllocator()) {
+            pools += frame->descriptorAllocator()->poolCount();
+            poolSets += frame->descriptorAllocator()->allocatedSets();
+          }
+        }
+        string_t sets = " sets(b=" + std::to_string(setBinds) + ",skip=" + std::to_string(setSkips) + ")";
+        string_t dpools = " pools(n=" + std::to_string(pools) + ",sets=" + std::to_string(poolSets) + ")";
+
+        string_t jobs = " jobs(t=" + std::to_string(_jobs->threadCount()) + ",n=" + std::to_string(_jobs->jobsExecuted()) + ",steal=" + std::to_string(_jobs->jobsStolen()) + ")";
 
-        string_t out = fps + mip_f + min_f + mag_f + specg + speci + vsync + savimg + culm + line + rtt + pass + aniso + msaa + img;
+        string_t out = fps + mip_f + min_f + mag_f + specg + speci + vsync + savimg + culm + line + rtt + pass + gpuinst + ssbo + gpu + cull + pstats + queue + batch + scene + ecs + lod + inst + aniso + msaa + img + desc + sets + dpools + jobs;
 
         SDL_SetWindowTitle(_pSDLWindow, out.c_str());
       }
@@ -12,6 +12,16 @@
 #include "./GWindowHeader.h"
 #include "./VulkanHeader.h"
 #include "./GWorld.h"
+#include "./TransformKernels.h"
+#include "./FrustumCuller.h"
+#include "./DrawQueue.h"
+#include "./MeshBatch.h"
+#include "./SceneGraph.h"
+#include "./LodSelector.h"
+#include "./MeshSimplifier.h"
+#include "./HiZPyramid.h"
+#include "./MaskedOcclusion.h"
+#include "./JobSystem.h"
 
 namespace VG {
 
@@ -29,6 +39,37 @@ public:
   void load();
   bool _debugEnabled = false;
 };
+/**
+ *  @enum InstanceFetch
+ *  @brief Where the vertex shader reads the instance matrices from.
+ */
+enum class InstanceFetch {
+  UBO,           //test.vs, indexed uniform block (max 1000).
+  SSBO,          //test_ssbo.vs, indexed storage buffer.
+  VertexStream,  //test_inst.vs, per instance vertex attributes.
+  InstanceFetch_Count
+};
+/**
+ *  @class FetchBenchmark
+ *  @brief GPU frame time with the instance matrices fetched from a UBO, an SSBO, or an instance vertex stream.
+ */
+class FetchBenchmark {
+public:
+  class Run {
+  public:
+    InstanceFetch _fetch = InstanceFetch::UBO;
+    uint32_t _instances = 0;
+    uint32_t _frames = 0;   //Frames rendered, including warm up.
+    uint32_t _samples = 0;  //Timed frames.
+    double _gpuMs = 0;      //Sum over the samples.
+  };
+  bool active() { return _current < _runs.size(); }
+
+  std::vector<Run> _runs;
+  size_t _current = 0;
+  InstanceFetch _savedFetch = InstanceFetch::UBO;  //Restored when done.
+  uint32_t _savedInstances = 0;
+};
 /**
  *  @class GSDL
  *  @brief Vulkan windowing main class
@@ -56,10 +97,48 @@ private:
   void cmd_simpleCubes(RenderFrame* frame, double dt);
   void cmd_RenderToTexture(RenderFrame* frame, double dt);
   void drawFrame();
-  void tryInitializeOffsets(std::vector<BR2::vec3>& offsets, std::vector<float>& rots_delta, std::vector<float>& rots_ini, std::vector<BR2::vec3>& axes_ini);
-  void updateInstanceUniformBuffer(std::shared_ptr<VulkanBuffer> instanceBuffer, std::vector<BR2::vec3>& offsets, std::vector<float>& rots_delta, std::vector<float>& rots_ini, float dt, std::vector<BR2::vec3>& axes);
+  void tryInitializeOffsets(TransformStore& instances);
+  uint32_t updateInstanceUniformBuffer(std::shared_ptr<VulkanBuffer> instanceBuffer, TransformStore& instances, LodBuckets& lods, RenderFrame* frame, float dt);
+  uint32_t updateSceneGraphBuffer(std::shared_ptr<VulkanBuffer> instanceBuffer, RenderFrame* frame, float dt);
+  void createSceneGraph();
+  void createScene();
+  void updateScene(float dt);
   void updateLights(std::shared_ptr<VulkanBuffer> lightsBuffer, float dt);
   void updateViewProjUniformBuffer(std::shared_ptr<VulkanBuffer> viewProjBuffer);
+  std::shared_ptr<VulkanBuffer> createGPUInstanceParams(TransformStore& instances);
+  void cmd_updateGPUInstances(CommandBuffer* cmd, RenderFrame* frame, double dt);
+  uint32_t cmd_cullGPUInstances(CommandBuffer* cmd, RenderFrame* frame, uint32_t phase);
+  bool occlusionCulling(RenderFrame* frame);
+  std::shared_ptr<VulkanBuffer> cullOutput(RenderFrame* frame, bool second, bool indirect, bool late);
+  void setGPUInstances(bool enable);
+  void setCullInstances(bool enable);
+  void setOcclusionCull(bool enable);
+  size_t cullOccludedInstances(TransformStore& instances, const CullSpheres& spheres, size_t visible, size_t capacity);
+  void setSceneGraph(bool enable);
+  void setLods(bool enable);
+  void setLodSimplify(bool enable);
+  void createLodMesh();
+  void setInstanceFetch(InstanceFetch fetch);
+  string_t instanceFetchName(InstanceFetch fetch);
+  void setInstanceCount(uint32_t count);
+  uint32_t drawInstanceCount();
+  PipelineShader* instanceShader();
+  std::shared_ptr<VulkanBuffer> getInstanceBuffer(RenderFrame* frame, bool second);
+  void addInstanceBindings(PipelineShader* shader, RenderFrame* frame, std::shared_ptr<VulkanBuffer> buffer, bool second, DrawBindings& out);
+  void submitInstances(PipelineShader* shader, RenderFrame* frame, const DrawPipelineState& state, std::shared_ptr<Mesh> mesh,
+                       std::shared_ptr<TextureImage> texture, std::shared_ptr<VulkanBuffer> buffer, bool second, uint32_t drawCount);
+  std::shared_ptr<DrawBindings> passMaterial(PipelineShader* shader, RenderFrame* frame, std::shared_ptr<TextureImage> texture,
+                                             std::shared_ptr<VulkanBuffer> buffer, bool second);
+  void submitSceneDraws(PipelineShader* shader, RenderFrame* frame, const DrawPipelineState& state, uint32_t layer, std::shared_ptr<TextureImage> passTexture,
+                        std::shared_ptr<VulkanBuffer> inst1, std::shared_ptr<VulkanBuffer> inst2, uint32_t drawCount1, uint32_t drawCount2);
+  std::vector<VulkanBuffer*> instanceStreams(std::shared_ptr<VulkanBuffer> buffer);
+  MeshBatch* meshBatch();
+  bool submitBatch(DrawPacket& p, RenderFrame* frame, bool second, uint32_t drawCount);
+  bool submitLods(DrawPacket& p, RenderFrame* frame, bool second, const LodBuckets& lods);
+  bool uploadPassDraws(DrawPacket& p, RenderFrame* frame, bool second);
+  void startFetchBenchmark();
+  void applyFetchBenchmarkRun();
+  void stepFetchBenchmark(RenderFrame* frame);
   float pingpong_t01(int durationMs = 5000);
   void createUniformBuffers();
   void sdl_PrintVideoDiagnostics();
@@ -72,25 +151,96 @@ private:
   void test_overlay();
   void createGameAndShaderTest();
   BR2::urect2 getWindowDims();
-  std::shared_ptr<Img32> loadImage(const string_t& img);
+  std::shared_ptr<Img32> loadImage(const string_t& img, string_t& out_error);  //Null and out_error on failure.
   Vulkan* vulkan() { return _vulkan.get(); }
   
   SDL_Window* _pSDLWindow = nullptr;
   std::unique_ptr<SettingsFile> _settings;
 
   std::unique_ptr<Vulkan> _vulkan = nullptr;
+  std::unique_ptr<JobSystem> _jobs = nullptr;
   std::shared_ptr<TextureImage> _testTexture1 = nullptr;
   std::shared_ptr<TextureImage> _testTexture2 = nullptr;
   std::unique_ptr<PipelineShader> _pShader = nullptr;
+  std::unique_ptr<PipelineShader> _pShaderSSBO = nullptr;  //test_ssbo.vs, same pipeline with the instances in a storage buffer.
+  std::unique_ptr<PipelineShader> _pShaderInstStream = nullptr;  //test_inst.vs, the instances are a vertex stream.
+  std::unique_ptr<PipelineShader> _pShaderBindless = nullptr;     //test_inst.vs + test_bindless.fs, null without descriptor indexing.
+  std::vector<std::shared_ptr<VulkanBuffer>> _instanceStreams1;  //Per frame instance vertex buffers, the CPU path writes these.
+  std::vector<std::shared_ptr<VulkanBuffer>> _instanceStreams2;
+  std::unique_ptr<PipelineShader> _pShaderCulled = nullptr;  //test_cull.vs, drawn indirectly from the instance_cull.cs output.
+  std::unique_ptr<ComputeShader> _pInstanceCompute = nullptr;
+  std::unique_ptr<ComputeShader> _pInstanceCull = nullptr;
+  std::unique_ptr<HiZPyramid> _hiZ = nullptr;  //Depth of the last occlusion culled frame.
+  std::shared_ptr<TextureImage> _hiZDummy = nullptr;  //1x1, bound to _passHiZ by the frustum phase which doesn't read it.
+  std::shared_ptr<VulkanBuffer> _instanceParams1 = nullptr;  //Static GPUInstanceParams, uploaded when GPU instances are enabled.
+  std::shared_ptr<VulkanBuffer> _instanceParams2 = nullptr;
+  double _gpuInstanceTime = 0;  //Seconds since the params were uploaded.
   std::shared_ptr<GameDummy> _game = nullptr;
+  uint32_t _sceneTexture1 = 0;  //_game texture ids of _testTexture1 and 2.
+  uint32_t _sceneTexture2 = 0;
+  double _entityMs = 0;        //_game system update time last frame.
+  std::unique_ptr<MeshBatch> _meshBatch = nullptr;  //_batchMeshCount tinted copies of mesh1, built on first use.
+  IndirectDrawBuilder _passDraws[2];                 //Per pass, CPU built draws of the batch or LOD path.
+  std::vector<std::shared_ptr<VulkanBuffer>> _passIndirect[2];  //Per frame, host visible VkDrawIndexedIndirectCommands.
 
   string_t c_viewProjUBO = "c_viewProjUBO";
   string_t c_instanceUBO_1 = "c_instanceUBO_1";
   string_t c_instanceUBO_2 = "c_instanceUBO_2";
+  string_t c_instanceMatrices_1 = "c_instanceMatrices_1";
+  string_t c_instanceMatrices_2 = "c_instanceMatrices_2";
+  string_t c_visibleInstances_1 = "c_visibleInstances_1";
+  string_t c_visibleInstances_2 = "c_visibleInstances_2";
+  string_t c_indirectDraws_1 = "c_indirectDraws_1";
+  string_t c_indirectDraws_2 = "c_indirectDraws_2";
+  string_t c_visibleInstancesLate_1 = "c_visibleInstancesLate_1";
+  string_t c_visibleInstancesLate_2 = "c_visibleInstancesLate_2";
+  string_t c_indirectDrawsLate_1 = "c_indirectDrawsLate_1";
+  string_t c_indirectDrawsLate_2 = "c_indirectDrawsLate_2";
+  string_t c_occlusionState_1 = "c_occlusionState_1";
+  string_t c_occlusionState_2 = "c_occlusionState_2";
+  string_t c_occlusionUBO = "c_occlusionUBO";
+  string_t c_instanceSSBO_1 = "c_instanceSSBO_1";
+  string_t c_instanceSSBO_2 = "c_instanceSSBO_2";
   string_t c_lightsUBO = "c_lightsUBO";
   string_t base_title = "Press F1 to toggle Mipmaps";
 
   uint32_t _numInstances = 25;
+  uint32_t _maxUBOInstances = 1000;   //test.vs instances[1000]. Draws from the UBO are clamped to this.
+  uint32_t _maxInstances = 100000;    //Storage buffer capacity (F12 cycles up to this).
+  uint32_t _fetchBenchWarmup = 8;     //Frames skipped after each FetchBenchmark change, while the old frames are in flight.
+  uint32_t _fetchBenchSamples = 120;  //Timed frames per run.
+  FetchBenchmark _fetchBench;
+  size_t _instanceGrain = 4096;  //Instances per job.
+  size_t _instancesUploaded = 0;  //Instance matrices copied to UBOs last frame.
+  size_t _instancesVisible = 0;   //Instances that passed frustum culling last frame.
+  double _cullMs = 0;             //Frustum culling time last frame.
+  size_t _instancesLate = 0;      //Instances the occlusion early phase hid last frame, retested in the late phase.
+  MaskedOcclusion _cpuOcclusion;  //CPU occlusion culling after the frustum, see cullOccludedInstances.
+  uint32_t _occluderCount = 32;   //Nearest frustum visible instances rasterized as occluders.
+  size_t _instancesOccluded = 0;  //Instances the CPU occlusion culled last frame.
+  double _occlusionMs = 0;        //CPU occlusion raster and test time last frame.
+  ViewProjUBOData _viewProj{};    //From the last updateViewProjUniformBuffer.
+  ViewProjUBOData _hiZViewProj{}; //The view _hiZ was built with.
+  bool _drawLateCull = false;     //submitInstances draws the late phase output.
+  size_t _cullGrain = 16384;      //Spheres per culling job.
+  float _instanceRadius = 0.866f;  //Bounding sphere of the unit cube, centered on the instance position by the cube origin.
+  Frustum _frustum;                //From the last updateViewProjUniformBuffer.
+  std::vector<uint32_t> _visibleInstances;
+  DrawQueue _drawQueue;            //Draws of the pass being recorded.
+  std::map<std::tuple<TextureImage*, VulkanBuffer*, bool>, std::shared_ptr<DrawBindings>> _passMaterials;  //Of _drawQueue, see passMaterial.
+  DrawQueueStats _drawStats;       //Summed over the passes of the last frame.
+  uint32_t _batchMeshCount = 64;   //Meshes in _meshBatch, the instances are split across them.
+  std::unique_ptr<SceneGraph> _sceneGraph = nullptr;  //_instances1 parented to _scenePivots, built on first use.
+  std::vector<SceneNode> _scenePivots;                //Roots. Every other one spins, the rest are static.
+  uint32_t _scenePivotCount = 16;
+  double _sceneTime = 0;
+  size_t _sceneChanged = 0;  //World matrices rebuilt last frame.
+  double _sceneMs = 0;       //SceneGraph::update time last frame.
+  std::shared_ptr<Mesh> _lodMesh = nullptr;  //Sphere with a simplified or tessellated LOD chain, drawn instead of the boxes when LODs are on.
+  LodBuckets _lodBuckets1;                   //Selected this frame, empty when the instances weren't LOD sorted.
+  LodBuckets _lodBuckets2;
+  std::vector<float> _lodThresholds;
+  float _lodPixelError = 1.0f;  //Largest projected error a LOD may have.
   uint32_t _numLights = 3;
   uint32_t _maxLights = 10;  // **TODO: we can automatically set this via the shader's metadata
   FpsMeter _fpsMeter_Render;
@@ -119,19 +269,10 @@ private:
   float min_radius = 2;
 
   //Temps & shader
-  std::vector<GPULight> lights;
-  std::vector<float> lights_speed;
-  std::vector<float> lights_r;
   std::mt19937 _rnd_engine;
   std::uniform_real_distribution<double> _rnd_distribution;  //0,1
-  std::vector<BR2::vec3> offsets1;
-  std::vector<BR2::vec3> offsets2;
-  std::vector<float> rots_delta1;
-  std::vector<float> rots_delta2;
-  std::vector<float> rots_ini1;
-  std::vector<float> rots_ini2;
-  std::vector<BR2::vec3> axes1;
-  std::vector<BR2::vec3> axes2;
+  TransformStore _instances1;
+  TransformStore _instances2;
 };
 
 }  // namespace VG
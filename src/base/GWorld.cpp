@@ -44,6 +44,57 @@ void FpsMeter::update() {
   _iFrame++;
 }
 
+#pragma region GameDummy
+
+uint32_t GameDummy::addMesh(std::shared_ptr<Mesh> mesh) {
+  _meshes.push_back(mesh);
+  return static_cast<uint32_t>(_meshes.size() - 1);
+}
+uint32_t GameDummy::addTexture(std::shared_ptr<TextureImage> texture) {
+  _textures.push_back(texture);
+  return static_cast<uint32_t>(_textures.size() - 1);
+}
+void GameDummy::setTexture(uint32_t id, std::shared_ptr<TextureImage> texture) {
+  AssertOrThrow2(id < _textures.size());
+  _textures[id] = texture;
+}
+std::shared_ptr<Mesh> GameDummy::mesh(uint32_t id) {
+  AssertOrThrow2(id < _meshes.size());
+  return _meshes[id];
+}
+std::shared_ptr<Mesh> GameDummy::instanceSetMesh(uint32_t set) {
+  std::shared_ptr<Mesh> found = nullptr;
+  _entities.forEach<CInstanceSet, CMeshRef>([&](Entity e, CInstanceSet& is, CMeshRef& ref) {
+    if (found == nullptr && is._set == set) {
+      found = mesh(ref._mesh);
+    }
+  });
+  return found;
+}
+void GameDummy::update(JobSystem& jobs, float dt) {
+  _systems.run(_entities, jobs, dt);
+}
+void GameDummy::collectDraws(uint32_t layer, const Frustum* frustum, std::vector<SceneDraw>& out) {
+  _entities.forEachChunk<CInstanceSet, CMeshRef, CBounds>([&](size_t count, const Entity* entities, CInstanceSet* sets, CMeshRef* refs, CBounds* bounds) {
+    for (size_t i = 0; i < count; ++i) {
+      if (sets[i]._layer != layer) {
+        continue;
+      }
+      const CBounds& b = bounds[i];
+      if (frustum != nullptr && b._radius != std::numeric_limits<float>::max() && !frustum->sphereVisible(b._center[0], b._center[1], b._center[2], b._radius)) {
+        continue;
+      }
+      SceneDraw d;
+      d._mesh = mesh(refs[i]._mesh);
+      d._texture = refs[i]._texture == CMeshRef::c_noTexture ? nullptr : _textures[refs[i]._texture];
+      d._instanceSet = sets[i]._set;
+      out.push_back(d);
+    }
+  });
+}
+
+#pragma endregion
+
 #pragma region Mesh
 
 Mesh::Mesh(Vulkan* v) : VulkanObject(v) {
@@ -72,7 +123,7 @@ void Mesh::makeBox() {
     { bv[tl]._pos, bv[tl]._color, { 0, 0 }, nx }, \
     { bv[tr]._pos, bv[tr]._color, { 1, 0 }, nx }
 
-  _boxVerts = {
+  std::vector<VertType> verts = {
     BV_VFACE(0, 1, 2, 3, BR2::vec3(0, 0, -1)),  //F
     BV_VFACE(1, 5, 3, 7, BR2::vec3(1, 0, 0)),   //R
     BV_VFACE(5, 4, 7, 6, BR2::vec3(0, 0, 1)),   //A
@@ -87,7 +138,7 @@ void Mesh::makeBox() {
 //  | /
 //  0------>1
 #define BV_IFACE(idx) ((idx * 4) + 0), ((idx * 4) + 3), ((idx * 4) + 1), ((idx * 4) + 0), ((idx * 4) + 2), ((idx * 4) + 3)
-  _boxInds = {
+  std::vector<uint32_t> inds = {
     BV_IFACE(0),
     BV_IFACE(1),
     BV_IFACE(2),
@@ -95,23 +146,109 @@ void Mesh::makeBox() {
     BV_IFACE(4),
     BV_IFACE(5),
   };
+  setData(std::move(verts), std::move(inds));
+}
+void Mesh::setData(std::vector<VertType>&& verts, std::vector<uint32_t>&& inds) {
+  _boxVerts = std::move(verts);
+  _boxInds = std::move(inds);
+  _indexType = IndexType::IndexTypeUint32;
+  _lods = { MeshLod{ 0, static_cast<uint32_t>(_boxInds.size()), 0, 0 } };
+
+  //Bounding box center, then the farthest vertex.
+  const float c_max = std::numeric_limits<float>::max();
+  BR2::vec3 bmin = { c_max, c_max, c_max }, bmax = { -c_max, -c_max, -c_max };
+  for (auto& v : _boxVerts) {
+    bmin = { std::min(bmin.x, v._pos.x), std::min(bmin.y, v._pos.y), std::min(bmin.z, v._pos.z) };
+    bmax = { std::max(bmax.x, v._pos.x), std::max(bmax.y, v._pos.y), std::max(bmax.z, v._pos.z) };
+  }
+  _boundCenter = _boxVerts.size() ? BR2::vec3((bmin.x + bmax.x) * 0.5f, (bmin.y + bmax.y) * 0.5f, (bmin.z + bmax.z) * 0.5f) : BR2::vec3(0, 0, 0);
+  float r2 = 0;
+  for (auto& v : _boxVerts) {
+    BR2::vec3 d = v._pos - _boundCenter;
+    r2 = std::max(r2, d.x * d.x + d.y * d.y + d.z * d.z);
+  }
+  _boundRadius = std::sqrt(r2);
+
+  createBuffers(_boxVerts, _boxInds);
+}
+bool Mesh::setLodChain(std::vector<MeshLodData>&& levels) {
+  _lods.resize(1);
+  std::vector<VertType> verts = _boxVerts;
+  std::vector<uint32_t> inds = _boxInds;
+  float lastError = 0;
+  for (auto& level : levels) {
+    if (level._error < lastError) {
+      BRLogError("Mesh LOD errors must increase along the chain.");
+      _lods.resize(1);
+      createBuffers(_boxVerts, _boxInds);
+      return false;
+    }
+    lastError = level._error;
+    MeshLod lod;
+    lod._firstIndex = static_cast<uint32_t>(inds.size());
+    lod._indexCount = static_cast<uint32_t>(level._inds.size());
+    lod._vertexOffset = level._verts.size() ? static_cast<int32_t>(verts.size()) : 0;
+    lod._error = level._error;
+    _lods.push_back(lod);
+    verts.insert(verts.end(), level._verts.begin(), level._verts.end());
+    inds.insert(inds.end(), level._inds.begin(), level._inds.end());
+  }
+  createBuffers(verts, inds);
+  return true;
+}
+void Mesh::createBuffers(const std::vector<VertType>& verts, const std::vector<uint32_t>& inds) {
   _vertexBuffer = std::make_unique<VulkanBuffer>(
     vulkan(),
     VulkanBufferType::VertexBuffer,
     true,
     sizeof(VertType),
-    _boxVerts.size(),
-    _boxVerts.data(),
-    _boxVerts.size());
+    verts.size(),
+    (void*)verts.data(),
+    verts.size());
 
   _indexBuffer = std::make_unique<VulkanBuffer>(
     vulkan(),
     VulkanBufferType::IndexBuffer,
     true,
     sizeof(uint32_t),
-    _boxInds.size(),
-    _boxInds.data(),
-    _boxInds.size());
+    inds.size(),
+    (void*)inds.data(),
+    inds.size());
+}
+void Mesh::makeSphere(uint32_t slices, uint32_t stacks) {
+  std::vector<VertType> verts;
+  std::vector<uint32_t> inds;
+  makeSphereData(slices, stacks, verts, inds);
+  setData(std::move(verts), std::move(inds));
+}
+void Mesh::makeSphereData(uint32_t slices, uint32_t stacks, std::vector<VertType>& verts, std::vector<uint32_t>& inds) {
+  //UV sphere, one extra column so the texture seam has its own vertices.
+  slices = std::max(slices, 3u);
+  stacks = std::max(stacks, 2u);
+  verts.clear();
+  inds.clear();
+  for (uint32_t iy = 0; iy <= stacks; ++iy) {
+    float v = (float)iy / (float)stacks;
+    float phi = v * (float)M_PI;
+    for (uint32_t ix = 0; ix <= slices; ++ix) {
+      float u = (float)ix / (float)slices;
+      float theta = u * 2.0f * (float)M_PI;
+      BR2::vec3 n(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+      verts.push_back({ BR2::vec3(0.5f, 0.5f, 0.5f) + n * 0.5f, { 1, 1, 1, 1 }, { u, v }, n });
+    }
+  }
+  for (uint32_t iy = 0; iy < stacks; ++iy) {
+    for (uint32_t ix = 0; ix < slices; ++ix) {
+      uint32_t a = iy * (slices + 1) + ix, b = a + slices + 1;
+      //Same winding as makeBox. The pole rows have one degenerate triangle per quad.
+      inds.insert(inds.end(), { a, a + 1, b, a + 1, b + 1, b });
+    }
+  }
+}
+float Mesh::sphereTessError(uint32_t slices, uint32_t stacks) {
+  //Sagitta of the widest chord, for the unit diameter sphere.
+  float step = std::max((float)M_PI / (float)std::max(stacks, 2u), 2.0f * (float)M_PI / (float)std::max(slices, 3u));
+  return 0.5f * (1.0f - std::cos(step * 0.5f));
 }
 void Mesh::recopyData() {
   //Testing the gpu buffer
@@ -9,6 +9,8 @@
 
 #include "./VulkanHeader.h"
 #include "./VulkanClasses.h"
+#include "./EntityStore.h"
+#include "./FrustumCuller.h"
 
 namespace VG {
 
@@ -39,21 +41,110 @@ private:
   float _avg=0;
 };
 
+#pragma region Scene Components
+
+//EntityStore components of the GameDummy scene. Plain data, meshes and textures are GameDummy registry indexes.
+class CTransform {
+public:
+  float _pos[3];
+};
+class CBounds {
+public:
+  float _center[3];
+  float _radius;           //std::numeric_limits<float>::max() until known, never culled.
+  uint64_t _generation;    //TransformStore::generation() the sphere was computed for.
+  uint32_t _orbit;         //1 if it was computed for the scene graph, which orbits the instances around the origin.
+};
+class CMeshRef {
+public:
+  static constexpr uint32_t c_noTexture = 0xFFFFFFFF;  //The pass supplies it, e.g. a render texture.
+  uint32_t _mesh;
+  uint32_t _texture;
+};
+//Draws a TransformStore of instances, which hold their own transforms. No CTransform.
+class CInstanceSet {
+public:
+  uint32_t _set;    //0 draws _instances1, 1 draws _instances2.
+  uint32_t _layer;  //GameDummy::c_layer*
+};
+class CLight {
+public:
+  float _color[3];
+  float _radius;  //0 disables.
+  float _orbitRadius;
+  float _orbitSeconds;
+  float _rotation;
+};
+
+#pragma endregion
+
 #pragma region GameDummy
 
-//A dummy game with meshes &c to test command getVkBuffer rendering
+/**
+ * @class SceneDraw
+ * @brief One instanced draw of the scene, see GameDummy::collectDraws.
+ * */
+class SceneDraw {
+public:
+  std::shared_ptr<Mesh> _mesh = nullptr;
+  std::shared_ptr<TextureImage> _texture = nullptr;  //Null for CMeshRef::c_noTexture.
+  uint32_t _instanceSet = 0;
+};
+/**
+ * @class GameDummy
+ * @brief A dummy game to test rendering. The scene objects are entities, the renderer pulls its draws from them.
+ * */
 class GameDummy {
 public:
-  std::shared_ptr<Mesh> _mesh1 = nullptr;
-  std::shared_ptr<Mesh> _mesh2 = nullptr;
-  void update(double time) {
-  }
+  static constexpr uint32_t c_layerScene = 0;
+  static constexpr uint32_t c_layerDisplay = 1;  //Drawn with the render texture of the first pass.
+
+  uint32_t addMesh(std::shared_ptr<Mesh> mesh);
+  uint32_t addTexture(std::shared_ptr<TextureImage> texture);
+  void setTexture(uint32_t id, std::shared_ptr<TextureImage> texture);  //Textures are recreated when their filtering changes.
+  std::shared_ptr<Mesh> mesh(uint32_t id);
+  size_t meshCount() const { return _meshes.size(); }
+  std::shared_ptr<Mesh> instanceSetMesh(uint32_t set);  //Null if no entity draws the set.
+
+  void update(JobSystem& jobs, float dt);
+  //Instance sets of layer whose bounds touch frustum (all of them without one), in entity order.
+  void collectDraws(uint32_t layer, const Frustum* frustum, std::vector<SceneDraw>& out);
+
+  EntityStore _entities;
+  SystemSchedule _systems;
+
+private:
+  std::vector<std::shared_ptr<Mesh>> _meshes;
+  std::vector<std::shared_ptr<TextureImage>> _textures;
 };
 
 #pragma endregion
 
+/**
+ * @class MeshLod
+ * @brief One level of a Mesh LOD chain, a range of the mesh's index buffer.
+ * */
+class MeshLod {
+public:
+  uint32_t _firstIndex = 0;
+  uint32_t _indexCount = 0;
+  int32_t _vertexOffset = 0;
+  float _error = 0;  //Object space deviation from LOD 0. Increases along the chain.
+};
+/**
+ * @class MeshLodData
+ * @brief Input to Mesh::setLodChain. Empty _verts reuse the LOD 0 vertices, e.g. a simplified index list.
+ * */
+class MeshLodData {
+public:
+  std::vector<v_v3c4x2n3> _verts;
+  std::vector<uint32_t> _inds;
+  float _error = 0;
+};
 /**
  * @class Mesh
+ * @details LOD 0 is the data given to setData. Coarser levels are appended to the same vertex and index
+ *          buffers by setLodChain, so every level draws with the one bindMesh.
  * */
 class Mesh : public VulkanObject {
 public:
@@ -67,15 +158,31 @@ public:
   VulkanBuffer* vertexBuffer() { return _vertexBuffer.get(); }
   VulkanBuffer* indexBuffer() { return _indexBuffer.get(); }
   IndexType indexType() { return _indexType; }
+  const std::vector<VertType>& vertices() { return _boxVerts; }  //CPU copies of the buffer data.
+  const std::vector<uint32_t>& indices() { return _boxInds; }
+  const std::vector<MeshLod>& lods() { return _lods; }  //[0] is the full mesh.
+  uint32_t indexCount() { return _lods.size() ? _lods[0]._indexCount : 0; }  //Of LOD 0.
+  const BR2::vec3& boundCenter() { return _boundCenter; }  //Bounding sphere of the LOD 0 vertices.
+  float boundRadius() { return _boundRadius; }
 
   uint32_t maxRenderInstances();
   void makeBox();
+  void setData(std::vector<VertType>&& verts, std::vector<uint32_t>&& inds);  //Creates the GPU buffers.
+  bool setLodChain(std::vector<MeshLodData>&& levels);  //LOD 1.., coarsest last. Replaces the previous chain.
+  void makeSphere(uint32_t slices, uint32_t stacks);     //Unit diameter, centered in [0,1]^3 like makeBox.
+  static void makeSphereData(uint32_t slices, uint32_t stacks, std::vector<VertType>& verts, std::vector<uint32_t>& inds);
+  static float sphereTessError(uint32_t slices, uint32_t stacks);  //Deviation of makeSphere from the true sphere.
   void makePlane();
   void recopyData();
 
 private:
+  void createBuffers(const std::vector<VertType>& verts, const std::vector<uint32_t>& inds);
+
   std::vector<v_v3c4x2n3> _boxVerts;
   std::vector<uint32_t> _boxInds;
+  std::vector<MeshLod> _lods;
+  BR2::vec3 _boundCenter = { 0, 0, 0 };
+  float _boundRadius = 0;
   std::unique_ptr<VulkanBuffer> _vertexBuffer = nullptr;
   std::unique_ptr<VulkanBuffer> _indexBuffer = nullptr;
   RenderMode _renderMode = RenderMode::TriangleList;
@@ -0,0 +1,229 @@
+#include "./HiZPyramid.h"
+
+namespace VG {
+
+#pragma region HiZPyramid
+
+static VkImageAspectFlags depthBarrierAspect(VkFormat format) {
+  //Layout transitions of a depth/stencil image cover both aspects.
+  if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT) {
+    return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+  return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+HiZPyramid::HiZPyramid(Vulkan* v, const string_t& reduceShaderFile) : VulkanObject(v) {
+  _pReduce = ComputeShader::create(v, "HiZ-Reduce-Compute", reduceShaderFile);
+}
+HiZPyramid::~HiZPyramid() {
+  cleanup();
+  _pReduce = nullptr;
+}
+void HiZPyramid::cleanup() {
+  if (_image == VK_NULL_HANDLE) {
+    return;
+  }
+  //Frames in flight may still read it.
+  vulkan()->waitIdle();
+  for (auto view : _mipViews) {
+    vkDestroyImageView(vulkan()->device(), view, nullptr);
+  }
+  _mipViews.clear();
+  vkDestroyImageView(vulkan()->device(), _imageView, nullptr);
+  vkDestroySampler(vulkan()->device(), _sampler, nullptr);
+  vkDestroyImage(vulkan()->device(), _image, nullptr);
+  vkFreeMemory(vulkan()->device(), _imageMemory, nullptr);
+  _image = VK_NULL_HANDLE;
+  _imageMemory = VK_NULL_HANDLE;
+  _imageView = VK_NULL_HANDLE;
+  _sampler = VK_NULL_HANDLE;
+  _depthSize = { 0, 0 };
+  _mipLevels = 0;
+  _bLayoutSet = false;
+  _bBuilt = false;
+}
+bool HiZPyramid::supported(TextureImage* depth) {
+  //texelFetch of a sampler2D, multisampled depth would need a sampler2DMS pass. See TextureImage::computeTypeProperties for the usage.
+  VkFormatProperties props;
+  if (depth == nullptr || depth->sampleCount() != MSAA::Disabled) {
+    return false;
+  }
+  vkGetPhysicalDeviceFormatProperties(depth->vulkan()->physicalDevice(), depth->format(), &props);
+  return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+BR2::usize2 HiZPyramid::mipSize(uint32_t level) {
+  uint32_t w = std::max(_depthSize.width / 2, 1u);
+  uint32_t h = std::max(_depthSize.height / 2, 1u);
+  return { std::max(w >> level, 1u), std::max(h >> level, 1u) };
+}
+bool HiZPyramid::create(const BR2::usize2& depthSize) {
+  cleanup();
+  if (_pReduce == nullptr || !_pReduce->valid() || depthSize.width == 0 || depthSize.height == 0) {
+    return false;
+  }
+  _depthSize = depthSize;
+  _resourceId = newResourceId();
+  BR2::usize2 size0 = mipSize(0);
+  _mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(size0.width, size0.height)))) + 1;
+
+  VkImageCreateInfo imageInfo = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .imageType = VK_IMAGE_TYPE_2D,
+    .format = VK_FORMAT_R32_SFLOAT,  //Storage support is required for this format.
+    .extent = {
+      .width = size0.width,
+      .height = size0.height,
+      .depth = 1 },
+    .mipLevels = _mipLevels,
+    .arrayLayers = 1,
+    .samples = VK_SAMPLE_COUNT_1_BIT,
+    .tiling = VK_IMAGE_TILING_OPTIMAL,
+    .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    .queueFamilyIndexCount = 0,
+    .pQueueFamilyIndices = nullptr,
+    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+  CheckVKR(vkCreateImage, vulkan()->device(), &imageInfo, nullptr, &_image);
+
+  VkMemoryRequirements mem_req;
+  vkGetImageMemoryRequirements(vulkan()->device(), _image, &mem_req);
+  VkMemoryAllocateInfo allocInfo = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+    .pNext = nullptr,
+    .allocationSize = mem_req.size,
+    .memoryTypeIndex = VulkanDeviceBuffer::findMemoryType(vulkan()->physicalDevice(), mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+  };
+  CheckVKR(vkAllocateMemory, vulkan()->device(), &allocInfo, nullptr, &_imageMemory);
+  CheckVKR(vkBindImageMemory, vulkan()->device(), _image, _imageMemory, 0);
+
+  //One view per mip, then one of the whole chain.
+  for (uint32_t level = 0; level <= _mipLevels; ++level) {
+    bool all = (level == _mipLevels);
+    VkImageViewCreateInfo viewInfo = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .image = _image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = VK_FORMAT_R32_SFLOAT,
+      .components = {
+        .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+      },
+      .subresourceRange = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = all ? 0 : level,
+        .levelCount = all ? _mipLevels : 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+      },
+    };
+    VkImageView view = VK_NULL_HANDLE;
+    CheckVKR(vkCreateImageView, vulkan()->device(), &viewInfo, nullptr, &view);
+    if (all) {
+      _imageView = view;
+    }
+    else {
+      _mipViews.push_back(view);
+    }
+  }
+
+  //Only texelFetch reads it, the filter doesn't matter but the sampler must cover every mip.
+  VkSamplerCreateInfo samplerInfo = {
+    .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .magFilter = VK_FILTER_NEAREST,
+    .minFilter = VK_FILTER_NEAREST,
+    .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+    .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .mipLodBias = 0,
+    .anisotropyEnable = VK_FALSE,
+    .maxAnisotropy = 1,
+    .compareEnable = VK_FALSE,
+    .compareOp = VK_COMPARE_OP_ALWAYS,
+    .minLod = 0,
+    .maxLod = static_cast<float>(_mipLevels),
+    .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+    .unnormalizedCoordinates = VK_FALSE,
+  };
+  CheckVKR(vkCreateSampler, vulkan()->device(), &samplerInfo, nullptr, &_sampler);
+
+  BRLogInfo("Created Hi-Z pyramid " + std::to_string(size0.width) + "x" + std::to_string(size0.height) + ", " + std::to_string(_mipLevels) + " mips.");
+  return true;
+}
+bool HiZPyramid::update(CommandBuffer* cmd, const BR2::usize2& depthSize) {
+  if (_image == VK_NULL_HANDLE || _depthSize.width != depthSize.width || _depthSize.height != depthSize.height) {
+    if (!create(depthSize)) {
+      BRLogErrorCycle("Failed to create the Hi-Z pyramid.");
+      return false;
+    }
+  }
+  if (!_bLayoutSet) {
+    //Never read before the first build, valid() is false until then. The layout just has to match the descriptors.
+    cmd->imageBarrier(_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    _bLayoutSet = true;
+  }
+  return true;
+}
+bool HiZPyramid::build(CommandBuffer* cmd, RenderFrame* frame, TextureImage* depth) {
+  if (!supported(depth) || !update(cmd, depth->imageSize())) {
+    return false;
+  }
+  VkImageAspectFlags depthAspect = depthBarrierAspect(depth->format());
+  //Depth writes -> sampled.
+  cmd->imageBarrier(depth->image(), depthAspect, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+  //The early phase read the last pyramid.
+  cmd->imageBarrier(_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+  bool success = false;
+  if (_pReduce->beginDispatch(cmd, frame)) {
+    success = true;
+    for (uint32_t level = 0; level < _mipLevels && success; ++level) {
+      BR2::usize2 dst = mipSize(level);
+      BR2::usize2 src = (level == 0) ? _depthSize : mipSize(level - 1);
+      GPUHiZReducePush push = {
+        .srcSize = { (int32_t)src.width, (int32_t)src.height },
+        .dstSize = { (int32_t)dst.width, (int32_t)dst.height },
+        .srcLod = (level == 0) ? 0 : (int32_t)(level - 1),
+      };
+      if (level == 0) {
+        _pReduce->bindImage("_passHiZSource", depth->resourceId(), depth->imageView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, _sampler);
+      }
+      else {
+        _pReduce->bindImage("_passHiZSource", _resourceId, _imageView, VK_IMAGE_LAYOUT_GENERAL, _sampler);
+      }
+      _pReduce->bindImage("_passHiZDest", _resourceId, _mipViews[level], VK_IMAGE_LAYOUT_GENERAL);
+      cmd->pushConstants(_pReduce->boundPipeline(), push);
+      success = _pReduce->dispatch(cmd, (dst.width + _pReduce->localSizeX() - 1) / _pReduce->localSizeX(),
+                                   (dst.height + _pReduce->localSizeY() - 1) / _pReduce->localSizeY());
+      //Read by the next level, the last one by the late phase.
+      cmd->imageBarrier(_image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        level, 1);
+    }
+    _pReduce->endDispatch();
+  }
+
+  //Back to an attachment for the late pass, which loads it.
+  cmd->imageBarrier(depth->image(), depthAspect, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+  _bBuilt = success;
+  return success;
+}
+
+#pragma endregion
+
+}  // namespace VG
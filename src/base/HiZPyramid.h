@@ -0,0 +1,72 @@
+/**
+*  @file HiZPyramid.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Hierarchical depth pyramid for GPU occlusion culling.
+*/
+#pragma once
+#ifndef __HIZPYRAMID_17923461738204915583107_H__
+#define __HIZPYRAMID_17923461738204915583107_H__
+
+#include "./VulkanClasses.h"
+
+namespace VG {
+
+/**
+ * @class HiZPyramid
+ * @brief Mip chain of the depth attachment where each texel is the farthest depth under it, built by hiz_reduce.cs.
+ * @details Depth is cleared to 1 and tested with Less, so an instance whose nearest projected depth is greater than
+ *          the pyramid texels covering its screen rectangle is hidden. Mip 0 is half the depth size, the last mip 1x1.
+ *          Odd sized levels fold their last row and column into the edge texels, so texel x of mip L covers the depth
+ *          pixels [x, x + 1) * 2^(L + 1), the last texel everything past it.
+ *          Two phase culling with instance_cull.cs, one pyramid shared by the frames in flight:
+ *            early: test against the pyramid of the last frame (reprojected with its view) -> draw the visible ones
+ *            build() from this frame's depth
+ *            late:  retest the instances the early phase hid -> draw the ones that are visible after all
+ *          A wrong early result only moves a draw to the late pass, so nothing pops when the camera or the occluders move.
+ *          The image stays in VK_IMAGE_LAYOUT_GENERAL, read through imageView() with sampler() and texelFetch.
+ * */
+class HiZPyramid : public VulkanObject {
+public:
+  static constexpr uint32_t c_phaseFrustum = 0;  //GPUInstanceCullPush::phase
+  static constexpr uint32_t c_phaseEarly = 1;
+  static constexpr uint32_t c_phaseLate = 2;
+
+  HiZPyramid(Vulkan* v, const string_t& reduceShaderFile);
+  virtual ~HiZPyramid() override;
+
+  //(Re)creates the pyramid for a depth size. Call before binding it each frame, outside of render passes.
+  bool update(CommandBuffer* cmd, const BR2::usize2& depthSize);
+  //depth must be single sampled with VK_IMAGE_USAGE_SAMPLED_BIT, in DEPTH_STENCIL_ATTACHMENT_OPTIMAL after its pass. It is left in that layout.
+  bool build(CommandBuffer* cmd, RenderFrame* frame, TextureImage* depth);
+  void invalidate() { _bBuilt = false; }  //The next early phase draws everything it doesn't frustum cull.
+
+  bool valid() { return _bBuilt; }  //Built at the current size.
+  VkImageView imageView() { return _imageView; }
+  VkSampler sampler() { return _sampler; }
+  uint64_t resourceId() { return _resourceId; }  //New each time the image is recreated.
+  uint32_t mipLevels() { return _mipLevels; }
+  const BR2::usize2& depthSize() { return _depthSize; }
+  static bool supported(TextureImage* depth);
+
+private:
+  void cleanup();
+  bool create(const BR2::usize2& depthSize);
+  BR2::usize2 mipSize(uint32_t level);
+
+  std::unique_ptr<ComputeShader> _pReduce = nullptr;
+  VkImage _image = VK_NULL_HANDLE;
+  VkDeviceMemory _imageMemory = VK_NULL_HANDLE;
+  VkImageView _imageView = VK_NULL_HANDLE;  //Every mip.
+  std::vector<VkImageView> _mipViews;      //One mip each, written as storage images.
+  VkSampler _sampler = VK_NULL_HANDLE;
+  BR2::usize2 _depthSize{ 0, 0 };
+  uint32_t _mipLevels = 0;
+  uint64_t _resourceId = 0;
+  bool _bLayoutSet = false;  //Moved to VK_IMAGE_LAYOUT_GENERAL.
+  bool _bBuilt = false;
+};
+
+}  // namespace VG
+
+#endif
@@ -0,0 +1,315 @@
+#include "./JobSystem.h"
+
+namespace VG {
+
+#pragma region Job
+
+class Job {
+public:
+  std::function<void()> _func;
+  JobCounter* _counter = nullptr;
+};
+
+//Worker index of this thread, or -1 for threads that aren't in the system.
+static thread_local JobSystem* t_jobSystem = nullptr;
+static thread_local int32_t t_workerIndex = -1;
+
+#pragma endregion
+
+#pragma region WorkStealingDeque
+
+WorkStealingDeque::WorkStealingDeque(size_t capacity) : _jobs(capacity) {
+  AssertOrThrow2((capacity & (capacity - 1)) == 0);
+  _mask = static_cast<int64_t>(capacity) - 1;
+  for (auto& j : _jobs) {
+    j.store(nullptr, std::memory_order_relaxed);
+  }
+}
+bool WorkStealingDeque::push(Job* job) {
+  int64_t b = _bottom.load(std::memory_order_relaxed);
+  int64_t t = _top.load(std::memory_order_acquire);
+  if (b - t > _mask) {
+    return false;
+  }
+  _jobs[b & _mask].store(job, std::memory_order_relaxed);
+  _bottom.store(b + 1, std::memory_order_release);  //Publishes the job to steal()'s acquire of _bottom.
+  return true;
+}
+Job* WorkStealingDeque::pop() {
+  int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+  _bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = _top.load(std::memory_order_relaxed);
+  Job* ret = nullptr;
+  if (t <= b) {
+    ret = _jobs[b & _mask].load(std::memory_order_relaxed);
+    if (t == b) {
+      //Last job, race the thieves for it.
+      if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        ret = nullptr;
+      }
+      _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+  }
+  else {
+    _bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return ret;
+}
+Job* WorkStealingDeque::steal() {
+  int64_t t = _top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = _bottom.load(std::memory_order_acquire);
+  if (t < b) {
+    Job* ret = _jobs[t & _mask].load(std::memory_order_relaxed);
+    if (_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return ret;
+    }
+  }
+  return nullptr;
+}
+size_t WorkStealingDeque::size() const {
+  int64_t b = _bottom.load(std::memory_order_relaxed);
+  int64_t t = _top.load(std::memory_order_relaxed);
+  return b > t ? static_cast<size_t>(b - t) : 0;
+}
+
+#pragma endregion
+
+#pragma region JobSystem
+
+JobSystem::JobSystem(uint32_t workerThreads) {
+  if (workerThreads == 0) {
+    uint32_t cores = std::thread::hardware_concurrency();
+    workerThreads = cores > 1 ? cores - 1 : 1;
+  }
+  _mainThreadId = std::this_thread::get_id();
+  t_jobSystem = this;
+  t_workerIndex = 0;
+
+  for (uint32_t i = 0; i < workerThreads + 1; ++i) {
+    _workers.push_back(std::make_unique<Worker>());
+  }
+  for (uint32_t i = 1; i < _workers.size(); ++i) {
+    _workers[i]->_thread = std::thread([this, i]() { workerLoop(static_cast<int32_t>(i)); });
+  }
+  BRLogInfo("Job system started with " + std::to_string(workerThreads) + " worker threads.");
+}
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _shutdown = true;
+  }
+  _sleepCondition.notify_all();
+  for (auto& w : _workers) {
+    if (w->_thread.joinable()) {
+      w->_thread.join();
+    }
+  }
+
+  //Anything left never ran.
+  for (auto& w : _workers) {
+    while (Job* job = w->_deque.steal()) {
+      delete job;
+    }
+  }
+  for (auto job : _injected) {
+    delete job;
+  }
+  for (auto job : _mainThreadJobs) {
+    delete job;
+  }
+  if (t_jobSystem == this) {
+    t_jobSystem = nullptr;
+    t_workerIndex = -1;
+  }
+}
+int32_t JobSystem::currentWorker() const {
+  return (t_jobSystem == this) ? t_workerIndex : -1;
+}
+void JobSystem::run(const std::function<void()>& func, JobCounter* counter) {
+  Job* job = new Job();
+  job->_func = func;
+  job->_counter = counter;
+  if (counter) {
+    counter->_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  enqueue(job);
+}
+void JobSystem::runOnMainThread(const std::function<void()>& func, JobCounter* counter) {
+  Job* job = new Job();
+  job->_func = func;
+  job->_counter = counter;
+  if (counter) {
+    counter->_count.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::lock_guard<std::mutex> lock(_mainThreadMutex);
+  _mainThreadJobs.push_back(job);
+}
+void JobSystem::enqueue(Job* job) {
+  int32_t index = currentWorker();
+  _pendingJobs.fetch_add(1, std::memory_order_seq_cst);
+  if (index >= 0) {
+    if (!_workers[index]->_deque.push(job)) {
+      //Deque is full, the queue is deep enough already.
+      _pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+      execute(job);
+      return;
+    }
+  }
+  else {
+    std::lock_guard<std::mutex> lock(_injectMutex);
+    _injected.push_back(job);
+  }
+  wakeWorkers();
+}
+void JobSystem::wakeWorkers() {
+  if (_sleeping.load(std::memory_order_seq_cst) > 0) {
+    //Taking the lock orders this against a worker that checked _pendingJobs but hasn't blocked yet.
+    { std::lock_guard<std::mutex> lock(_sleepMutex); }
+    _sleepCondition.notify_one();
+  }
+}
+Job* JobSystem::findJob(int32_t index) {
+  Job* job = nullptr;
+  if (index >= 0) {
+    job = _workers[index]->_deque.pop();
+  }
+  if (job == nullptr) {
+    std::unique_lock<std::mutex> lock(_injectMutex, std::try_to_lock);
+    if (lock.owns_lock() && _injected.size() > 0) {
+      job = _injected.front();
+      _injected.pop_front();
+    }
+  }
+  if (job == nullptr) {
+    //Start at a different victim per thread so thieves don't all hit the same deque.
+    size_t count = _workers.size();
+    size_t start = static_cast<size_t>(index + 1);
+    for (size_t i = 0; i < count && job == nullptr; ++i) {
+      size_t victim = (start + i) % count;
+      if (static_cast<int32_t>(victim) != index) {
+        job = _workers[victim]->_deque.steal();
+      }
+    }
+    if (job != nullptr) {
+      _jobsStolen.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  if (job != nullptr) {
+    _pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return job;
+}
+void JobSystem::execute(Job* job) {
+  JobCounter* counter = job->_counter;
+  try {
+    job->_func();
+  }
+  catch (...) {
+    if (counter) {
+      std::lock_guard<std::mutex> lock(counter->_exceptionMutex);
+      if (counter->_exception == nullptr) {
+        counter->_exception = std::current_exception();
+      }
+    }
+    else {
+      BRLogError("Unhandled exception in a job with no counter.");
+    }
+  }
+  delete job;
+  _jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+  if (counter) {
+    counter->_count.fetch_sub(1, std::memory_order_release);
+  }
+}
+void JobSystem::workerLoop(int32_t index) {
+  t_jobSystem = this;
+  t_workerIndex = index;
+  const int c_spinCount = 64;
+  int spins = 0;
+  while (!_shutdown.load(std::memory_order_relaxed)) {
+    if (Job* job = findJob(index)) {
+      execute(job);
+      spins = 0;
+    }
+    else if (++spins < c_spinCount) {
+      std::this_thread::yield();
+    }
+    else {
+      std::unique_lock<std::mutex> lock(_sleepMutex);
+      _sleeping.fetch_add(1, std::memory_order_seq_cst);
+      _sleepCondition.wait(lock, [this]() {
+        return _shutdown.load(std::memory_order_relaxed) || _pendingJobs.load(std::memory_order_seq_cst) > 0;
+      });
+      _sleeping.fetch_sub(1, std::memory_order_relaxed);
+      spins = 0;
+    }
+  }
+}
+void JobSystem::wait(JobCounter* counter) {
+  AssertOrThrow2(counter != nullptr);
+  int32_t index = currentWorker();
+  while (!counter->done()) {
+    if (Job* job = findJob(index)) {
+      execute(job);
+    }
+    else if (index == 0) {
+      //A job we wait on may be waiting on the main thread.
+      processMainThreadJobs();
+      std::this_thread::yield();
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+  if (counter->_exception != nullptr) {
+    std::exception_ptr ex = counter->_exception;
+    counter->_exception = nullptr;
+    std::rethrow_exception(ex);
+  }
+}
+void JobSystem::processMainThreadJobs() {
+  AssertOrThrow2(isMainThread());
+  std::deque<Job*> jobs;
+  {
+    std::lock_guard<std::mutex> lock(_mainThreadMutex);
+    jobs.swap(_mainThreadJobs);
+  }
+  for (auto job : jobs) {
+    execute(job);
+  }
+}
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& func) {
+  if (count == 0) {
+    return;
+  }
+  if (grain == 0) {
+    grain = std::max(count / (threadCount() * 4), (size_t)1);
+  }
+  if (count <= grain) {
+    func(0, count);
+    return;
+  }
+  //The caller takes the first range itself.
+  JobCounter counter;
+  for (size_t begin = grain; begin < count; begin += grain) {
+    size_t end = std::min(begin + grain, count);
+    run([&func, begin, end]() { func(begin, end); }, &counter);
+  }
+  std::exception_ptr ex = nullptr;
+  try {
+    func(0, grain);
+  }
+  catch (...) {
+    ex = std::current_exception();
+  }
+  wait(&counter);
+  if (ex != nullptr) {
+    std::rethrow_exception(ex);
+  }
+}
+
+#pragma endregion
+
+}  // namespace VG
@@ -0,0 +1,114 @@
+/**
+*  @file JobSystem.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Work stealing job system for parallel engine loops.
+*/
+#pragma once
+#ifndef __JOBSYSTEM_17923298114201532717290_H__
+#define __JOBSYSTEM_17923298114201532717290_H__
+
+#include "./SandboxHeader.h"
+#include <atomic>
+#include <mutex>
+
+namespace VG {
+
+class Job;
+/**
+ * @class JobCounter
+ * @brief Dependency counter. Jobs started with a counter increment it and decrement it when they finish.
+ *        JobSystem::wait() runs other jobs until the counter reaches zero, then rethrows the first exception a job threw.
+ * */
+class JobCounter {
+public:
+  bool done() const { return _count.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobSystem;
+  std::atomic<int32_t> _count{ 0 };
+  std::mutex _exceptionMutex;
+  std::exception_ptr _exception = nullptr;
+};
+/**
+ * @class WorkStealingDeque
+ * @brief Fixed size Chase-Lev deque (Le et al. 2013 memory orders).
+ *        The owning worker pushes and pops the bottom, other workers steal from the top.
+ * */
+class WorkStealingDeque {
+public:
+  WorkStealingDeque(size_t capacity);
+  bool push(Job* job);  //Owner only. False if full.
+  Job* pop();           //Owner only.
+  Job* steal();         //Any thread.
+  size_t size() const;
+
+private:
+  std::vector<std::atomic<Job*>> _jobs;
+  int64_t _mask = 0;
+  alignas(64) std::atomic<int64_t> _top{ 0 };
+  alignas(64) std::atomic<int64_t> _bottom{ 0 };
+};
+/**
+ * @class JobSystem
+ * @brief Worker threads with one WorkStealingDeque each. The creating thread is the main thread and owns deque 0.
+ *        Jobs started from a worker (or the main thread) go to its own deque, other threads go through a locked queue.
+ *        SDL and other main-thread-only calls go through runOnMainThread(), which the main loop drains.
+ * */
+class JobSystem {
+public:
+  static const size_t c_dequeCapacity = 4096;
+
+  JobSystem(uint32_t workerThreads = 0);  //0 = one per core, less the main thread.
+  virtual ~JobSystem();
+
+  uint32_t threadCount() const { return static_cast<uint32_t>(_workers.size()); }  //Includes the main thread.
+  bool isMainThread() const { return std::this_thread::get_id() == _mainThreadId; }
+  uint64_t jobsExecuted() const { return _jobsExecuted.load(std::memory_order_relaxed); }
+  uint64_t jobsStolen() const { return _jobsStolen.load(std::memory_order_relaxed); }
+
+  void run(const std::function<void()>& func, JobCounter* counter = nullptr);
+  void runOnMainThread(const std::function<void()>& func, JobCounter* counter = nullptr);
+  void wait(JobCounter* counter);  //Runs other jobs while waiting.
+  void processMainThreadJobs();    //Main thread only, once per frame.
+
+  //Splits [0, count) into ranges of at most grain items and blocks until all ran.
+  //grain 0 picks about 4 ranges per thread. Ranges are run inline if count <= grain.
+  void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& func);
+
+private:
+  class Worker {
+  public:
+    Worker() : _deque(c_dequeCapacity) {}
+    WorkStealingDeque _deque;
+    std::thread _thread;
+  };
+
+  void workerLoop(int32_t index);
+  Job* findJob(int32_t index);
+  void execute(Job* job);
+  void enqueue(Job* job);
+  void wakeWorkers();
+  int32_t currentWorker() const;
+
+  std::vector<std::unique_ptr<Worker>> _workers;  //[0] is the main thread, no std::thread.
+  std::thread::id _mainThreadId;
+
+  std::mutex _injectMutex;
+  std::deque<Job*> _injected;  //From threads that aren't ours.
+  std::mutex _mainThreadMutex;
+  std::deque<Job*> _mainThreadJobs;
+
+  std::mutex _sleepMutex;
+  std::condition_variable _sleepCondition;
+  std::atomic<int32_t> _sleeping{ 0 };
+  std::atomic<int64_t> _pendingJobs{ 0 };  //Queued, not yet taken.
+  std::atomic<bool> _shutdown{ false };
+
+  std::atomic<uint64_t> _jobsExecuted{ 0 };
+  std::atomic<uint64_t> _jobsStolen{ 0 };
+};
+
+}  // namespace VG
+
+#endif
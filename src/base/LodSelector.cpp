@@ -0,0 +1,62 @@
+#include "./LodSelector.h"
+
+namespace VG {
+
+#pragma region LodSelector
+
+void LodBuckets::clear() {
+  _instances.clear();
+  _first.clear();
+  _count.clear();
+}
+float LodSelector::projScale(float viewportHeight, float fovy) {
+  return viewportHeight / (2.0f * std::tan(fovy * 0.5f));
+}
+void LodSelector::distanceThresholds(const float* lodErrors, uint32_t lodCount, float radius, float projScale, float pixelError, std::vector<float>& out_minDist2) {
+  AssertOrThrow2(lodCount > 0 && lodCount <= c_maxLods && pixelError > 0);
+  out_minDist2.resize(lodCount);
+  out_minDist2[0] = 0;
+  for (uint32_t l = 1; l < lodCount; ++l) {
+    float d = lodErrors[l] * projScale / pixelError + radius;
+    out_minDist2[l] = std::max(d * d, out_minDist2[l - 1]);
+  }
+}
+void LodSelector::select(const std::vector<float>& minDist2, const float* x, const float* y, const float* z, const uint32_t* ids, size_t count,
+                         const BR2::vec3& eye, LodBuckets& out) {
+  uint32_t lods = static_cast<uint32_t>(minDist2.size());
+  AssertOrThrow2(lods > 0 && lods <= c_maxLods);
+  out._first.assign(lods, 0);
+  out._count.assign(lods, 0);
+  out._lod.resize(count);
+  out._instances.resize(count);
+
+  //LOD = thresholds passed. The table is sorted, so counting them is branch free.
+  const float* thresholds = minDist2.data();
+  uint8_t* lod = out._lod.data();
+  for (size_t i = 0; i < count; ++i) {
+    size_t id = ids ? ids[i] : i;
+    float dx = x[id] - eye.x, dy = y[id] - eye.y, dz = z[id] - eye.z;
+    float d2 = dx * dx + dy * dy + dz * dz;
+    uint32_t l = 0;
+    for (uint32_t il = 1; il < lods; ++il) {
+      l += (d2 >= thresholds[il]) ? 1 : 0;
+    }
+    lod[i] = static_cast<uint8_t>(l);
+  }
+
+  //Counting sort keeps each bucket ascending.
+  for (size_t i = 0; i < count; ++i) {
+    out._count[lod[i]]++;
+  }
+  for (uint32_t l = 1; l < lods; ++l) {
+    out._first[l] = out._first[l - 1] + out._count[l - 1];
+  }
+  std::vector<uint32_t> fill = out._first;
+  for (size_t i = 0; i < count; ++i) {
+    out._instances[fill[lod[i]]++] = ids ? ids[i] : static_cast<uint32_t>(i);
+  }
+}
+
+#pragma endregion
+
+}  // namespace VG
@@ -0,0 +1,51 @@
+/**
+*  @file LodSelector.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Per instance LOD selection from projected error, bucketed into one instanced draw per LOD.
+*/
+#pragma once
+#ifndef __LODSELECTOR_17923452910930756372412_H__
+#define __LODSELECTOR_17923452910930756372412_H__
+
+#include "./SandboxHeader.h"
+
+namespace VG {
+
+/**
+ * @class LodBuckets
+ * @brief Instance ids grouped by LOD. The instances of LOD l are _instances[_first[l], _first[l] + _count[l]),
+ *        ascending, so a LOD's matrices packed in this order are drawn with firstInstance = _first[l].
+ * */
+class LodBuckets {
+public:
+  std::vector<uint32_t> _instances;
+  std::vector<uint32_t> _first;
+  std::vector<uint32_t> _count;
+  std::vector<uint8_t> _lod;  //Per selected instance, scratch for the bucketing.
+  void clear();
+  bool empty() const { return _first.empty(); }
+};
+/**
+ * @class LodSelector
+ * @brief Picks the coarsest LOD whose object space error projects to at most pixelError pixels.
+ * @details The error of LOD l at distance d from the bounding sphere is error_l * projScale / d pixels. With the
+ *          errors increasing along the chain this is a minimum center distance per LOD, so the per instance test is
+ *          one squared distance against a small sorted table, without a sqrt or divide.
+ * */
+class LodSelector {
+public:
+  static constexpr uint32_t c_maxLods = 255;
+
+  //Pixels per object space unit at distance 1, for a vertical field of view in radians.
+  static float projScale(float viewportHeight, float fovy);
+  //Squared center distance from which each LOD is fine. [0] is 0, LOD 0 is always fine.
+  static void distanceThresholds(const float* lodErrors, uint32_t lodCount, float radius, float projScale, float pixelError, std::vector<float>& out_minDist2);
+  //Buckets the instances at positions (x, y, z)[ids[i]], or [0, count) when ids is null.
+  static void select(const std::vector<float>& minDist2, const float* x, const float* y, const float* z, const uint32_t* ids, size_t count,
+                     const BR2::vec3& eye, LodBuckets& out);
+};
+
+}  // namespace VG
+
+#endif
@@ -0,0 +1,466 @@
+#include "./MaskedOcclusion.h"
+#include "./JobSystem.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VG_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define VG_TARGET_AVX2
+#else
+#define VG_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace VG {
+
+#pragma region Kernels
+
+static const float c_minW = 1e-5f;        //Clip w at or below this is at the eye.
+static const float c_guardBand = 256.0f;  //NDC extent of occluder vertices, keeps the edge functions in float range.
+static const float c_edgeClamp = 1e30f;
+
+static void mulMat4(const float* a, const float* b, float* out) {
+  //out = a * b, column major.
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      float s = 0;
+      for (int k = 0; k < 4; ++k) {
+        s += a[k * 4 + r] * b[c * 4 + k];
+      }
+      out[c * 4 + r] = s;
+    }
+  }
+}
+static void transformPoint(const float* m, float x, float y, float z, float* out_clip) {
+  //Same order as the AVX2 box projection, so every level gets the same rectangles.
+  for (int r = 0; r < 4; ++r) {
+    float c = m[12 + r];
+    c = c + m[r] * x;
+    c = c + m[4 + r] * y;
+    c = c + m[8 + r] * z;
+    out_clip[r] = c;
+  }
+}
+//Screen rectangle and nearest depth of clip space points. False if one is before the near plane.
+static bool projectRect(const float (*clip)[4], int count, float width, float height, float* out_rect, float& out_zMin) {
+  out_rect[0] = out_rect[1] = std::numeric_limits<float>::max();
+  out_rect[2] = out_rect[3] = -std::numeric_limits<float>::max();
+  out_zMin = std::numeric_limits<float>::max();
+  for (int i = 0; i < count; ++i) {
+    float w = clip[i][3];
+    if (w <= c_minW || clip[i][2] < -w) {
+      return false;
+    }
+    float px = (clip[i][0] / w * 0.5f + 0.5f) * width;
+    float py = (clip[i][1] / w * 0.5f + 0.5f) * height;
+    out_rect[0] = std::min(out_rect[0], px);
+    out_rect[1] = std::min(out_rect[1], py);
+    out_rect[2] = std::max(out_rect[2], px);
+    out_rect[3] = std::max(out_rect[3], py);
+    out_zMin = std::min(out_zMin, clip[i][2] / w);
+  }
+  return true;
+}
+static uint32_t rowMask(int32_t first, int32_t last) {
+  //Bits [first, last], first in [0, 32], last in [-1, 31].
+  uint32_t lo = first >= 32 ? 0 : (~0u << first);
+  uint32_t hi = last < 0 ? 0 : (~0u >> (31 - last));
+  return lo & hi;
+}
+
+#pragma endregion
+
+#pragma region MaskedOcclusion
+
+MaskedOcclusion::MaskedOcclusion(uint32_t width, uint32_t height) {
+  resize(width, height);
+}
+void MaskedOcclusion::resize(uint32_t width, uint32_t height) {
+  _tilesX = std::max((width + c_tileWidth - 1) / c_tileWidth, 1u);
+  _tilesY = std::max((height + c_tileHeight - 1) / c_tileHeight, 1u);
+  _tiles.resize((size_t)_tilesX * _tilesY);
+  _bins.resize(_tilesY);
+  _tris.clear();
+  for (auto& bin : _bins) {
+    bin.clear();
+  }
+  clear();
+}
+void MaskedOcclusion::clear() {
+  for (auto& tile : _tiles) {
+    memset(tile._mask, 0, sizeof(tile._mask));
+    tile._zFar[0] = std::numeric_limits<float>::max();
+    tile._zFar[1] = -std::numeric_limits<float>::max();
+  }
+}
+void MaskedOcclusion::begin(const float* view16, const float* proj16) {
+  mulMat4(proj16, view16, _viewProj);
+  for (int k = 0; k < 8; ++k) {
+    float sx = (k & 1) ? 1.0f : -1.0f, sy = (k & 2) ? 1.0f : -1.0f, sz = (k & 4) ? 1.0f : -1.0f;
+    for (int r = 0; r < 4; ++r) {
+      _corners[k][r] = sx * _viewProj[r] + sy * _viewProj[4 + r] + sz * _viewProj[8 + r];
+    }
+  }
+  _tris.clear();
+  for (auto& bin : _bins) {
+    bin.clear();
+  }
+  clear();
+}
+void MaskedOcclusion::addOccluder(const float* positions, size_t strideBytes, size_t vertexCount, const uint32_t* indices, size_t indexCount, const float* model16) {
+  AssertOrThrow2(positions && indices);
+  float mvp[16];
+  if (model16) {
+    mulMat4(_viewProj, model16, mvp);
+  }
+  else {
+    memcpy(mvp, _viewProj, sizeof(mvp));
+  }
+  std::vector<float> clip(vertexCount * 4);
+  for (size_t iv = 0; iv < vertexCount; ++iv) {
+    const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + iv * strideBytes);
+    transformPoint(mvp, p[0], p[1], p[2], &clip[iv * 4]);
+  }
+
+  double width = (double)this->width(), height = (double)this->height();
+  for (size_t it = 0; it + 3 <= indexCount; it += 3) {
+    double x[3], y[3], z[3];
+    bool skip = false;
+    for (int iv = 0; iv < 3 && !skip; ++iv) {
+      AssertOrThrow2(indices[it + iv] < vertexCount);
+      const float* c = &clip[(size_t)indices[it + iv] * 4];
+      if (c[3] <= c_minW || c[2] < -c[3] || std::abs(c[0]) > c_guardBand * c[3] || std::abs(c[1]) > c_guardBand * c[3]) {
+        skip = true;  //Clipping would need new vertices, the occluder just loses the triangle.
+        break;
+      }
+      x[iv] = ((double)c[0] / c[3] * 0.5 + 0.5) * width;
+      y[iv] = ((double)c[1] / c[3] * 0.5 + 0.5) * height;
+      z[iv] = (double)c[2] / c[3];
+    }
+    double area2 = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (skip || std::abs(area2) < 1e-8) {
+      continue;
+    }
+    double minX = std::min({ x[0], x[1], x[2] }), maxX = std::max({ x[0], x[1], x[2] });
+    double minY = std::min({ y[0], y[1], y[2] }), maxY = std::max({ y[0], y[1], y[2] });
+    if (maxX < 0 || maxY < 0 || minX > width || minY > height) {
+      continue;
+    }
+
+    //Both windings are drawn, the edges face inward either way.
+    Triangle t;
+    double sign = area2 > 0 ? 1.0 : -1.0;
+    for (int ie = 0; ie < 3; ++ie) {
+      int a = ie, b = (ie + 1) % 3;
+      t._edge[ie][0] = (float)(sign * (y[a] - y[b]));
+      t._edge[ie][1] = (float)(sign * (x[b] - x[a]));
+      t._edge[ie][2] = (float)(sign * (x[a] * y[b] - x[b] * y[a]));
+      t._invA[ie] = t._edge[ie][0] != 0 ? 1.0f / t._edge[ie][0] : 0.0f;
+    }
+    double pa = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area2;
+    double pb = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area2;
+    t._plane[0] = (float)pa;
+    t._plane[1] = (float)pb;
+    t._plane[2] = (float)(z[0] - pa * x[0] - pb * y[0]);
+    t._zMax = (float)std::max({ z[0], z[1], z[2] });
+    t._tx0 = std::max((int32_t)std::floor(minX), 0) / (int32_t)c_tileWidth;
+    t._ty0 = std::max((int32_t)std::floor(minY), 0) / (int32_t)c_tileHeight;
+    t._tx1 = std::min((int32_t)std::floor(maxX) / (int32_t)c_tileWidth, (int32_t)_tilesX - 1);
+    t._ty1 = std::min((int32_t)std::floor(maxY) / (int32_t)c_tileHeight, (int32_t)_tilesY - 1);
+
+    uint32_t index = static_cast<uint32_t>(_tris.size());
+    _tris.push_back(t);
+    for (int32_t ty = t._ty0; ty <= t._ty1; ++ty) {
+      _bins[ty].push_back(index);
+    }
+  }
+}
+static void rowMasksScalar(const float (*edge)[3], const float* invA, float x0, float y0, uint32_t* out) {
+  for (uint32_t r = 0; r < MaskedOcclusion::c_tileHeight; ++r) {
+    //Pixel centers.
+    float y = y0 + ((float)r + 0.5f);
+    float xl = -c_edgeClamp, xr = c_edgeClamp;
+    bool valid = true;
+    for (int ie = 0; ie < 3; ++ie) {
+      float num = edge[ie][1] * y + edge[ie][2];
+      if (edge[ie][0] > 0) {
+        xl = std::max(xl, -num * invA[ie]);
+      }
+      else if (edge[ie][0] < 0) {
+        xr = std::min(xr, -num * invA[ie]);
+      }
+      else {
+        valid = valid && (num >= 0);
+      }
+    }
+    int32_t first = (int32_t)std::ceil(std::min(std::max(xl - x0 - 0.5f, 0.0f), 32.0f));
+    int32_t last = (int32_t)std::floor(std::min(std::max(xr - x0 - 0.5f, -1.0f), 31.0f));
+    out[r] = valid ? rowMask(first, last) : 0;
+  }
+}
+#ifdef VG_SIMD_X86
+VG_TARGET_AVX2 static void rowMasksAVX2(const float (*edge)[3], const float* invA, float x0, float y0, uint32_t* out) {
+  //Lane r is tile row r, same arithmetic as rowMasksScalar.
+  __m256 y = _mm256_add_ps(_mm256_set1_ps(y0), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+  __m256 xl = _mm256_set1_ps(-c_edgeClamp), xr = _mm256_set1_ps(c_edgeClamp);
+  __m256 valid = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  __m256 signBit = _mm256_set1_ps(-0.0f);
+  for (int ie = 0; ie < 3; ++ie) {
+    __m256 num = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edge[ie][1]), y), _mm256_set1_ps(edge[ie][2]));
+    __m256 x = _mm256_mul_ps(_mm256_xor_ps(num, signBit), _mm256_set1_ps(invA[ie]));
+    if (edge[ie][0] > 0) {
+      xl = _mm256_max_ps(xl, x);
+    }
+    else if (edge[ie][0] < 0) {
+      xr = _mm256_min_ps(xr, x);
+    }
+    else {
+      valid = _mm256_and_ps(valid, _mm256_cmp_ps(num, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+  }
+  __m256 half = _mm256_set1_ps(0.5f), tx = _mm256_set1_ps(x0);
+  __m256 first = _mm256_ceil_ps(_mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_sub_ps(xl, tx), half), _mm256_setzero_ps()), _mm256_set1_ps(32.0f)));
+  __m256 last = _mm256_floor_ps(_mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_sub_ps(xr, tx), half), _mm256_set1_ps(-1.0f)), _mm256_set1_ps(31.0f)));
+  //Shifts of 32 or more give 0, which covers the empty rows.
+  __m256i ones = _mm256_set1_epi32(-1);
+  __m256i lo = _mm256_sllv_epi32(ones, _mm256_cvttps_epi32(first));
+  __m256i hi = _mm256_srlv_epi32(ones, _mm256_sub_epi32(_mm256_set1_epi32(31), _mm256_cvttps_epi32(last)));
+  __m256i mask = _mm256_and_si256(_mm256_and_si256(lo, hi), _mm256_castps_si256(valid));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), mask);
+}
+//Rectangles (x0, y0, x1, y1, nearest z) of the boxes around spheres [first, first + 8), as projectRect.
+//Returns a bit per sphere with a corner before the near plane.
+VG_TARGET_AVX2 static int projectSpheresAVX2(const CullSpheres& s, const uint32_t* ids, size_t first, const float* viewProj, const float (*corners)[4],
+                                             float width, float height, float (*out_rects)[8]) {
+  __m256i idx = ids ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + first))
+                    : _mm256_add_epi32(_mm256_set1_epi32((int)first), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  __m256 x = _mm256_i32gather_ps(s._x, idx, 4), y = _mm256_i32gather_ps(s._y, idx, 4), z = _mm256_i32gather_ps(s._z, idx, 4);
+  __m256 r = s._radius ? _mm256_i32gather_ps(s._radius, idx, 4) : _mm256_set1_ps(s._uniformRadius);
+  __m256 center[4];
+  for (int ir = 0; ir < 4; ++ir) {
+    center[ir] = _mm256_set1_ps(viewProj[12 + ir]);
+    center[ir] = _mm256_add_ps(center[ir], _mm256_mul_ps(_mm256_set1_ps(viewProj[ir]), x));
+    center[ir] = _mm256_add_ps(center[ir], _mm256_mul_ps(_mm256_set1_ps(viewProj[4 + ir]), y));
+    center[ir] = _mm256_add_ps(center[ir], _mm256_mul_ps(_mm256_set1_ps(viewProj[8 + ir]), z));
+  }
+  __m256 half = _mm256_set1_ps(0.5f), w = _mm256_set1_ps(width), h = _mm256_set1_ps(height);
+  __m256 signBit = _mm256_set1_ps(-0.0f);
+  __m256 big = _mm256_set1_ps(std::numeric_limits<float>::max());
+  __m256 x0 = big, y0 = big, zMin = big;
+  __m256 x1 = _mm256_xor_ps(big, signBit), y1 = x1;
+  __m256 nearHit = _mm256_setzero_ps();
+  for (int k = 0; k < 8; ++k) {
+    __m256 cx = _mm256_add_ps(center[0], _mm256_mul_ps(r, _mm256_set1_ps(corners[k][0])));
+    __m256 cy = _mm256_add_ps(center[1], _mm256_mul_ps(r, _mm256_set1_ps(corners[k][1])));
+    __m256 cz = _mm256_add_ps(center[2], _mm256_mul_ps(r, _mm256_set1_ps(corners[k][2])));
+    __m256 cw = _mm256_add_ps(center[3], _mm256_mul_ps(r, _mm256_set1_ps(corners[k][3])));
+    nearHit = _mm256_or_ps(nearHit, _mm256_cmp_ps(cw, _mm256_set1_ps(c_minW), _CMP_LE_OQ));
+    nearHit = _mm256_or_ps(nearHit, _mm256_cmp_ps(cz, _mm256_xor_ps(cw, signBit), _CMP_LT_OQ));
+    __m256 px = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(cx, cw), half), half), w);
+    __m256 py = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(cy, cw), half), half), h);
+    x0 = _mm256_min_ps(x0, px);
+    y0 = _mm256_min_ps(y0, py);
+    x1 = _mm256_max_ps(x1, px);
+    y1 = _mm256_max_ps(y1, py);
+    zMin = _mm256_min_ps(zMin, _mm256_div_ps(cz, cw));
+  }
+  _mm256_store_ps(out_rects[0], x0);
+  _mm256_store_ps(out_rects[1], y0);
+  _mm256_store_ps(out_rects[2], x1);
+  _mm256_store_ps(out_rects[3], y1);
+  _mm256_store_ps(out_rects[4], zMin);
+  return _mm256_movemask_ps(nearHit);
+}
+#endif
+void MaskedOcclusion::mergeTile(Tile& tile, const uint32_t* rows, float zTri) {
+  if (zTri >= tile._zFar[0]) {
+    return;  //Behind everything already in the tile.
+  }
+  uint32_t triFull = ~0u, full = ~0u;
+  for (uint32_t r = 0; r < c_tileHeight; ++r) {
+    triFull &= rows[r];
+    full &= (tile._mask[r] | rows[r]);
+  }
+  if (triFull == ~0u) {
+    //Covers the tile alone. The working layer stays if it's nearer.
+    tile._zFar[0] = zTri;
+    if (tile._zFar[1] >= zTri) {
+      memset(tile._mask, 0, sizeof(tile._mask));
+      tile._zFar[1] = -std::numeric_limits<float>::max();
+    }
+    return;
+  }
+  tile._zFar[1] = std::max(tile._zFar[1], zTri);
+  if (full == ~0u) {
+    tile._zFar[0] = tile._zFar[1];
+    memset(tile._mask, 0, sizeof(tile._mask));
+    tile._zFar[1] = -std::numeric_limits<float>::max();
+    return;
+  }
+  for (uint32_t r = 0; r < c_tileHeight; ++r) {
+    tile._mask[r] |= rows[r];
+  }
+}
+void MaskedOcclusion::rasterizeRow(uint32_t ty, SimdLevel level) {
+  float y0 = (float)(ty * c_tileHeight);
+  for (uint32_t index : _bins[ty]) {
+    const Triangle& t = _tris[index];
+    for (int32_t tx = t._tx0; tx <= t._tx1; ++tx) {
+      float x0 = (float)(tx * c_tileWidth);
+      alignas(32) uint32_t rows[c_tileHeight];
+#ifdef VG_SIMD_X86
+      if (level == SimdLevel::AVX2) {
+        rowMasksAVX2(t._edge, t._invA, x0, y0, rows);
+      }
+      else
+#endif
+      {
+        rowMasksScalar(t._edge, t._invA, x0, y0, rows);
+      }
+      uint32_t any = 0;
+      for (uint32_t r = 0; r < c_tileHeight; ++r) {
+        any |= rows[r];
+      }
+      if (any == 0) {
+        continue;
+      }
+      //Farthest point of the plane over the tile's pixel centers, no farther than the farthest vertex.
+      float zTri = t._plane[2] + t._plane[0] * (x0 + (t._plane[0] > 0 ? c_tileWidth - 0.5f : 0.5f)) +
+                   t._plane[1] * (y0 + (t._plane[1] > 0 ? c_tileHeight - 0.5f : 0.5f));
+      mergeTile(_tiles[(size_t)ty * _tilesX + tx], rows, std::min(zTri, t._zMax));
+    }
+  }
+}
+void MaskedOcclusion::rasterize(JobSystem* jobs) {
+  rasterize(jobs, TransformKernels::simdLevel());
+}
+void MaskedOcclusion::rasterize(JobSystem* jobs, SimdLevel level) {
+  if (level > TransformKernels::simdLevel()) {
+    level = TransformKernels::simdLevel();
+  }
+  clear();
+  if (jobs && _tilesY > 1 && _tris.size() > 0) {
+    //Tile rows don't share tiles, so they need no locks.
+    jobs->parallelFor(_tilesY, 1, [&](size_t begin, size_t end) {
+      for (size_t ty = begin; ty < end; ++ty) {
+        rasterizeRow(static_cast<uint32_t>(ty), level);
+      }
+    });
+  }
+  else {
+    for (uint32_t ty = 0; ty < _tilesY; ++ty) {
+      rasterizeRow(ty, level);
+    }
+  }
+}
+bool MaskedOcclusion::rectVisible(float px0, float py0, float px1, float py1, float zMin) const {
+  float w = (float)width(), h = (float)height();
+  if (px1 < 0 || py1 < 0 || px0 > w || py0 > h) {
+    return true;  //Off screen, left to the frustum.
+  }
+  //Every pixel the rectangle touches, not just the centers.
+  int32_t ix0 = (int32_t)std::floor(std::max(px0, 0.0f)), iy0 = (int32_t)std::floor(std::max(py0, 0.0f));
+  int32_t ix1 = std::max((int32_t)std::ceil(std::min(px1, w)) - 1, ix0), iy1 = std::max((int32_t)std::ceil(std::min(py1, h)) - 1, iy0);
+  ix1 = std::min(ix1, (int32_t)width() - 1);
+  iy1 = std::min(iy1, (int32_t)height() - 1);
+  for (int32_t ty = iy0 / (int32_t)c_tileHeight; ty <= iy1 / (int32_t)c_tileHeight; ++ty) {
+    int32_t r0 = std::max(iy0 - ty * (int32_t)c_tileHeight, 0), r1 = std::min(iy1 - ty * (int32_t)c_tileHeight, (int32_t)c_tileHeight - 1);
+    for (int32_t tx = ix0 / (int32_t)c_tileWidth; tx <= ix1 / (int32_t)c_tileWidth; ++tx) {
+      const Tile& tile = _tiles[(size_t)ty * _tilesX + tx];
+      uint32_t cols = rowMask(std::max(ix0 - tx * (int32_t)c_tileWidth, 0), std::min(ix1 - tx * (int32_t)c_tileWidth, (int32_t)c_tileWidth - 1));
+      uint32_t covered = 0, uncovered = 0;
+      for (int32_t r = r0; r <= r1; ++r) {
+        covered |= tile._mask[r] & cols;
+        uncovered |= ~tile._mask[r] & cols;
+      }
+      if ((uncovered && zMin <= tile._zFar[0]) || (covered && zMin <= tile._zFar[1])) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+bool MaskedOcclusion::boxVisible(const float* min3, const float* max3) const {
+  float clip[8][4];
+  for (int k = 0; k < 8; ++k) {
+    transformPoint(_viewProj, (k & 1) ? max3[0] : min3[0], (k & 2) ? max3[1] : min3[1], (k & 4) ? max3[2] : min3[2], clip[k]);
+  }
+  float rect[4], zMin;
+  if (!projectRect(clip, 8, (float)width(), (float)height(), rect, zMin)) {
+    return true;
+  }
+  return rectVisible(rect[0], rect[1], rect[2], rect[3], zMin);
+}
+size_t MaskedOcclusion::cullRange(const CullSpheres& s, const uint32_t* ids, size_t begin, size_t end, uint32_t* out, SimdLevel level) const {
+  float width = (float)this->width(), height = (float)this->height();
+  size_t n = 0;
+  size_t i = begin;
+#ifdef VG_SIMD_X86
+  if (level == SimdLevel::AVX2) {
+    for (; i + 8 <= end; i += 8) {
+      alignas(32) float rects[5][8];
+      int nearMask = projectSpheresAVX2(s, ids, i, _viewProj, _corners, width, height, rects);
+      for (int l = 0; l < 8; ++l) {
+        bool visible = ((nearMask >> l) & 1) || rectVisible(rects[0][l], rects[1][l], rects[2][l], rects[3][l], rects[4][l]);
+        //n <= i - begin, so out may be ids.
+        out[n] = ids ? ids[i + l] : static_cast<uint32_t>(i + l);
+        n += visible ? 1 : 0;
+      }
+    }
+  }
+#endif
+  for (; i < end; ++i) {
+    uint32_t id = ids ? ids[i] : static_cast<uint32_t>(i);
+    float r = s._radius ? s._radius[id] : s._uniformRadius;
+    float center[4], clip[8][4];
+    transformPoint(_viewProj, s._x[id], s._y[id], s._z[id], center);
+    for (int k = 0; k < 8; ++k) {
+      for (int ir = 0; ir < 4; ++ir) {
+        clip[k][ir] = center[ir] + r * _corners[k][ir];
+      }
+    }
+    float rect[4], zMin;
+    bool visible = !projectRect(clip, 8, width, height, rect, zMin) || rectVisible(rect[0], rect[1], rect[2], rect[3], zMin);
+    out[n] = id;
+    n += visible ? 1 : 0;
+  }
+  return n;
+}
+size_t MaskedOcclusion::cullSpheres(const CullSpheres& spheres, const uint32_t* ids, size_t count, uint32_t* out_visible) const {
+  return cullSpheres(spheres, ids, count, out_visible, TransformKernels::simdLevel());
+}
+size_t MaskedOcclusion::cullSpheres(const CullSpheres& spheres, const uint32_t* ids, size_t count, uint32_t* out_visible, SimdLevel level) const {
+  AssertOrThrow2(spheres._x && spheres._y && spheres._z);
+  if (level > TransformKernels::simdLevel()) {
+    level = TransformKernels::simdLevel();
+  }
+  return cullRange(spheres, ids, 0, count, out_visible, level);
+}
+size_t MaskedOcclusion::cullSpheresParallel(JobSystem& jobs, size_t grain, const CullSpheres& spheres, const uint32_t* ids, size_t count, uint32_t* out_visible) const {
+  grain = std::max(grain, (size_t)64);
+  size_t ranges = (count + grain - 1) / grain;
+  if (ranges <= 1) {
+    return cullSpheres(spheres, ids, count, out_visible);
+  }
+  //As FrustumCuller::cullSpheresParallel, each range packs into its own part of the output.
+  std::vector<size_t> visible(ranges, 0);
+  jobs.parallelFor(ranges, 1, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      size_t first = r * grain;
+      visible[r] = cullRange(spheres, ids, first, std::min(first + grain, count), out_visible + first, TransformKernels::simdLevel());
+    }
+  });
+  size_t n = visible[0];
+  for (size_t r = 1; r < ranges; ++r) {
+    if (visible[r] > 0) {
+      memmove(out_visible + n, out_visible + r * grain, visible[r] * sizeof(uint32_t));
+    }
+    n += visible[r];
+  }
+  return n;
+}
+
+#pragma endregion
+
+}  // namespace VG
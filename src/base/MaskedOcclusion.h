@@ -0,0 +1,96 @@
+/**
+*  @file MaskedOcclusion.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief CPU software occlusion culling with a masked low resolution depth buffer.
+*/
+#pragma once
+#ifndef __MASKEDOCCLUSION_17923470162938475510264_H__
+#define __MASKEDOCCLUSION_17923470162938475510264_H__
+
+#include "./SandboxHeader.h"
+#include "./TransformKernels.h"
+#include "./FrustumCuller.h"
+
+namespace VG {
+
+class JobSystem;
+
+/**
+ * @class MaskedOcclusion
+ * @brief Low resolution depth buffer that occluder triangles are rasterized into on the CPU, then tested with
+ *        bounding boxes before draws are submitted. In the style of Masked Software Occlusion Culling
+ *        (Hasselgren, Andersson, Akenine-Moller 2016): 32x8 pixel tiles keep a coverage bit per pixel and
+ *        two depths instead of a depth per pixel.
+ * @details Depth is NDC z, larger is farther, like the depth buffer (cleared far, tested with Less).
+ *          A tile has a reference layer, the farthest depth anywhere in the tile, and a working layer, the pixels
+ *          in the mask and the farthest depth of the triangles that set them. A full mask makes the working layer
+ *          the reference. Both only bound the occluders from behind, so a box whose nearest depth is beyond them is
+ *          hidden. Triangles that cross the near plane or leave the guard band are skipped, an occluder can be
+ *          missing but never extra.
+ *          AVX2 computes the 8 row masks of a tile at once and projects 8 boxes at once. SSE2 has no per lane
+ *          shifts and runs the scalar code. Every level gives the same buffer and the same visible list.
+ *          rasterize() runs a tile row per job, each in the order the triangles were added, so the result doesn't
+ *          depend on the thread count. Add the nearest occluders first, the layers merge better front to back.
+ * */
+class MaskedOcclusion {
+public:
+  static constexpr uint32_t c_tileWidth = 32;  //One coverage bit per pixel of a tile row.
+  static constexpr uint32_t c_tileHeight = 8;  //One AVX2 lane per tile row.
+
+  MaskedOcclusion(uint32_t width = 256, uint32_t height = 128);
+
+  void resize(uint32_t width, uint32_t height);  //Rounded up to whole tiles. Clears.
+  uint32_t width() const { return _tilesX * c_tileWidth; }
+  uint32_t height() const { return _tilesY * c_tileHeight; }
+  size_t triangleCount() const { return _tris.size(); }  //Added since begin() and not skipped.
+
+  //Clears the buffer and the occluders. view and proj are column major, as for Frustum::fromViewProj.
+  void begin(const float* view16, const float* proj16);
+  //Object space positions, 3 floats at every strideBytes. model16 is column major, null for identity.
+  void addOccluder(const float* positions, size_t strideBytes, size_t vertexCount, const uint32_t* indices, size_t indexCount, const float* model16);
+  //Rasterizes the occluders added since begin(). With jobs the tile rows run in parallel.
+  void rasterize(JobSystem* jobs = nullptr);
+  void rasterize(JobSystem* jobs, SimdLevel level);
+
+  //World space box. False if the buffer hides it.
+  bool boxVisible(const float* min3, const float* max3) const;
+  //Tests the boxes around spheres ids[0, count) (or [0, count) without ids) and writes the ids of the visible
+  //ones packed in order. out_visible needs room for count ids and may be ids. Returns the number written.
+  size_t cullSpheres(const CullSpheres& spheres, const uint32_t* ids, size_t count, uint32_t* out_visible) const;
+  size_t cullSpheres(const CullSpheres& spheres, const uint32_t* ids, size_t count, uint32_t* out_visible, SimdLevel level) const;
+  size_t cullSpheresParallel(JobSystem& jobs, size_t grain, const CullSpheres& spheres, const uint32_t* ids, size_t count, uint32_t* out_visible) const;
+
+private:
+  class Tile {
+  public:
+    uint32_t _mask[c_tileHeight];  //Working layer coverage, bit x of row y.
+    float _zFar[2];                //Reference layer, working layer.
+  };
+  class Triangle {
+  public:
+    float _edge[3][3];  //A, B, C of A x + B y + C >= 0 inside, in pixels.
+    float _invA[3];
+    float _plane[3];    //z = a x + b y + c
+    float _zMax;        //Farthest vertex, bounds the plane.
+    int32_t _tx0, _ty0, _tx1, _ty1;  //Tiles touched, inclusive.
+  };
+
+  void clear();
+  void rasterizeRow(uint32_t ty, SimdLevel level);
+  void mergeTile(Tile& tile, const uint32_t* rows, float zTri);
+  bool rectVisible(float px0, float py0, float px1, float py1, float zMin) const;
+  size_t cullRange(const CullSpheres& spheres, const uint32_t* ids, size_t begin, size_t end, uint32_t* out, SimdLevel level) const;
+
+  uint32_t _tilesX = 0;
+  uint32_t _tilesY = 0;
+  std::vector<Tile> _tiles;
+  std::vector<Triangle> _tris;
+  std::vector<std::vector<uint32_t>> _bins;  //Triangles per tile row.
+  float _viewProj[16] = {};
+  float _corners[8][4] = {};  //viewProj * (+-1, +-1, +-1, 0), a box corner is the center plus half its size times these.
+};
+
+}  // namespace VG
+
+#endif
@@ -0,0 +1,87 @@
+#include "./MeshBatch.h"
+#include "./GWorld.h"
+
+namespace VG {
+
+#pragma region MeshBatch
+
+uint32_t MeshBatch::add(std::shared_ptr<Mesh> mesh) {
+  AssertOrThrow2(mesh != nullptr);
+  Source s;
+  s._verts = mesh->vertices();
+  s._inds = mesh->indices();
+  s._compatible = (mesh->indexType() == IndexType::IndexTypeUint32);
+  _sources.push_back(std::move(s));
+  return static_cast<uint32_t>(_sources.size() - 1);
+}
+uint32_t MeshBatch::add(std::vector<v_v3c4x2n3>&& verts, std::vector<uint32_t>&& inds) {
+  Source s;
+  s._verts = std::move(verts);
+  s._inds = std::move(inds);
+  _sources.push_back(std::move(s));
+  return static_cast<uint32_t>(_sources.size() - 1);
+}
+bool MeshBatch::build(Vulkan* v) {
+  std::vector<Mesh::VertType> verts;
+  std::vector<uint32_t> inds;
+  size_t vertCount = 0, indCount = 0;
+  for (auto& s : _sources) {
+    if (!s._compatible) {
+      BRLogError("MeshBatch: mesh index types differ, only 32 bit indexes are batched.");
+      return false;
+    }
+    vertCount += s._verts.size();
+    indCount += s._inds.size();
+  }
+  verts.reserve(vertCount);
+  inds.reserve(indCount);
+
+  _ranges.clear();
+  for (auto& s : _sources) {
+    Range r;
+    r._firstIndex = static_cast<uint32_t>(inds.size());
+    r._indexCount = static_cast<uint32_t>(s._inds.size());
+    r._vertexOffset = static_cast<int32_t>(verts.size());
+    _ranges.push_back(r);
+    verts.insert(verts.end(), s._verts.begin(), s._verts.end());
+    inds.insert(inds.end(), s._inds.begin(), s._inds.end());
+  }
+  _mesh = std::make_shared<Mesh>(v);
+  _mesh->setData(std::move(verts), std::move(inds));
+  return true;
+}
+
+#pragma endregion
+
+#pragma region IndirectDrawBuilder
+
+void IndirectDrawBuilder::add(const MeshBatch::Range& range, uint32_t instanceCount, uint32_t firstInstance) {
+  add(range._firstIndex, range._indexCount, range._vertexOffset, instanceCount, firstInstance);
+}
+void IndirectDrawBuilder::add(uint32_t firstIndex, uint32_t indexCount, int32_t vertexOffset, uint32_t instanceCount, uint32_t firstInstance) {
+  if (instanceCount == 0 || indexCount == 0) {
+    return;
+  }
+  _draws.push_back({
+    .indexCount = indexCount,
+    .instanceCount = instanceCount,
+    .firstIndex = firstIndex,
+    .vertexOffset = vertexOffset,
+    .firstInstance = firstInstance,
+  });
+}
+bool IndirectDrawBuilder::upload(VulkanBuffer* indirect) const {
+  AssertOrThrow2(indirect != nullptr);
+  if (indirect->buffer()->itemSize() != sizeof(VkDrawIndexedIndirectCommand) || indirect->buffer()->itemCount() < _draws.size()) {
+    BRLogErrorCycle("Indirect buffer can't hold " + std::to_string(_draws.size()) + " draws.");
+    return false;
+  }
+  if (_draws.size() > 0) {
+    indirect->writeData((void*)_draws.data(), _draws.size());
+  }
+  return true;
+}
+
+#pragma endregion
+
+}  // namespace VG
@@ -0,0 +1,68 @@
+/**
+*  @file MeshBatch.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Meshes packed into shared buffers and drawn with one multi-draw indirect call.
+*/
+#pragma once
+#ifndef __MESHBATCH_17923435118830426616081_H__
+#define __MESHBATCH_17923435118830426616081_H__
+
+#include "./VulkanHeader.h"
+
+namespace VG {
+
+/**
+ * @class MeshBatch
+ * @brief Packs compatible meshes (same vertex type and index type) into one vertex and one index buffer.
+ * @details Indexes are copied as is. Each mesh keeps its own range, drawn with vertexOffset = its first vertex:
+ *            batch.add(m) .. -> batch.build() -> bindMesh(batch.mesh()) -> one draw per range()
+ *          Meshes are added as CPU data, only the batch has GPU buffers. add(Mesh) copies the mesh's CPU copies.
+ * */
+class MeshBatch {
+public:
+  class Range {
+  public:
+    uint32_t _firstIndex = 0;
+    uint32_t _indexCount = 0;
+    int32_t _vertexOffset = 0;
+  };
+  uint32_t add(std::shared_ptr<Mesh> mesh);  //Returns the range index. False from build() if it isn't 32 bit indexed.
+  uint32_t add(std::vector<v_v3c4x2n3>&& verts, std::vector<uint32_t>&& inds);
+  bool build(Vulkan* v);                     //False if the meshes aren't compatible.
+  std::shared_ptr<Mesh> mesh() { return _mesh; }
+  const Range& range(size_t i) const { return _ranges[i]; }
+  size_t rangeCount() const { return _ranges.size(); }
+
+private:
+  class Source {
+  public:
+    std::vector<v_v3c4x2n3> _verts;
+    std::vector<uint32_t> _inds;
+    bool _compatible = true;
+  };
+  std::vector<Source> _sources;
+  std::vector<Range> _ranges;
+  std::shared_ptr<Mesh> _mesh = nullptr;
+};
+/**
+ * @class IndirectDrawBuilder
+ * @brief Builds the VkDrawIndexedIndirectCommands of a MeshBatch on the CPU. The list is also the fallback
+ *        when the device can't draw it indirectly, see CommandBuffer::drawIndexedBatch.
+ * */
+class IndirectDrawBuilder {
+public:
+  void clear() { _draws.clear(); }
+  void add(const MeshBatch::Range& range, uint32_t instanceCount, uint32_t firstInstance);  //Empty draws are skipped.
+  void add(uint32_t firstIndex, uint32_t indexCount, int32_t vertexOffset, uint32_t instanceCount, uint32_t firstInstance);
+  const std::vector<VkDrawIndexedIndirectCommand>& draws() const { return _draws; }
+  size_t size() const { return _draws.size(); }
+  bool upload(VulkanBuffer* indirect) const;  //False if the buffer is too small.
+
+private:
+  std::vector<VkDrawIndexedIndirectCommand> _draws;
+};
+
+}  // namespace VG
+
+#endif
@@ -0,0 +1,596 @@
+#include "./MeshSimplifier.h"
+#include "./GWorld.h"
+#include "./JobSystem.h"
+#include <unordered_map>
+
+namespace VG {
+
+#pragma region Quadric
+
+//Q(x) = x'Ax + 2b'x + c over N dimensions, A symmetric, stored as its upper triangle.
+template <uint32_t N>
+class Quadric {
+public:
+  static constexpr uint32_t c_size = N * (N + 1) / 2;
+  double _a[c_size] = {};
+  double _b[N] = {};
+  double _c = 0;
+  double _w = 0;  //Summed weights, the area the quadric was built from.
+
+  void add(const Quadric& q) {
+    for (uint32_t i = 0; i < c_size; ++i) {
+      _a[i] += q._a[i];
+    }
+    for (uint32_t i = 0; i < N; ++i) {
+      _b[i] += q._b[i];
+    }
+    _c += q._c;
+    _w += q._w;
+  }
+  double eval(const double* x) const {
+    double r = _c;
+    const double* a = _a;
+    for (uint32_t i = 0; i < N; ++i) {
+      double row = *a++ * x[i];
+      for (uint32_t j = i + 1; j < N; ++j) {
+        row += 2.0 * *a++ * x[j];
+      }
+      r += (row + 2.0 * _b[i]) * x[i];
+    }
+    return std::max(r, 0.0);
+  }
+  //Squared distance to the plane of triangle p0 p1 p2 in N dimensions (Garland & Heckbert 1998), times weight.
+  void addTriangle(const double* p0, const double* p1, const double* p2, double weight) {
+    double e1[N], e2[N];
+    double l1 = 0, d = 0;
+    for (uint32_t i = 0; i < N; ++i) {
+      e1[i] = p1[i] - p0[i];
+      l1 += e1[i] * e1[i];
+    }
+    if (l1 <= 0) {
+      return;
+    }
+    l1 = 1.0 / std::sqrt(l1);
+    for (uint32_t i = 0; i < N; ++i) {
+      e1[i] *= l1;
+      e2[i] = p2[i] - p0[i];
+      d += e1[i] * e2[i];
+    }
+    double l2 = 0;
+    for (uint32_t i = 0; i < N; ++i) {
+      e2[i] -= d * e1[i];
+      l2 += e2[i] * e2[i];
+    }
+    if (l2 <= 0) {
+      return;
+    }
+    l2 = 1.0 / std::sqrt(l2);
+    double pe1 = 0, pe2 = 0, pp = 0;
+    for (uint32_t i = 0; i < N; ++i) {
+      e2[i] *= l2;
+      pe1 += p0[i] * e1[i];
+      pe2 += p0[i] * e2[i];
+      pp += p0[i] * p0[i];
+    }
+    //A = I - e1e1' - e2e2', b = (p.e1)e1 + (p.e2)e2 - p, c = p.p - (p.e1)^2 - (p.e2)^2
+    double* a = _a;
+    for (uint32_t i = 0; i < N; ++i) {
+      for (uint32_t j = i; j < N; ++j) {
+        *a++ += weight * ((i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j]);
+      }
+      _b[i] += weight * (pe1 * e1[i] + pe2 * e2[i] - p0[i]);
+    }
+    _c += weight * (pp - pe1 * pe1 - pe2 * pe2);
+    _w += weight;
+  }
+  //Squared distance to the plane n.x + d = 0 over the first 3 dimensions (positions), times weight.
+  void addPlane(const double* n, double d, double weight) {
+    double* a = _a;
+    for (uint32_t i = 0; i < N; ++i) {
+      for (uint32_t j = i; j < N; ++j, ++a) {
+        if (i < 3 && j < 3) {
+          *a += weight * n[i] * n[j];
+        }
+      }
+      if (i < 3) {
+        _b[i] += weight * d * n[i];
+      }
+    }
+    _c += weight * d * d;
+  }
+};
+
+#pragma endregion
+#pragma region MeshSimplifier
+
+static const uint32_t c_attribs = 8;                //Position, normal, texcoord.
+static const uint32_t c_invalidVertex = 0xFFFFFFFF;
+static const float c_weldEpsilon = 1e-5f;           //Of the mesh extent.
+static const double c_borderWeight = 10.0;          //Of the edge length squared.
+static const size_t c_parallelCandidates = 8192;
+static const uint32_t c_maxPasses = 256;
+
+enum class VertexKind : uint8_t {
+  Interior,
+  Border,  //On exactly two open edges, collapses along them.
+  Locked   //Seams, non manifold and, with _lockBorders, border vertices.
+};
+
+class CollapseCandidate {
+public:
+  uint32_t _from = 0;  //Rep, the vertex index since it is collapsible.
+  uint32_t _to = 0;    //Rep.
+  double _cost = 0;
+};
+
+static inline void sub3(const double* a, const double* b, double* out) {
+  out[0] = a[0] - b[0];
+  out[1] = a[1] - b[1];
+  out[2] = a[2] - b[2];
+}
+static inline void cross3(const double* a, const double* b, double* out) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+static inline double dot3(const double* a, const double* b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+static bool sameAttributes(const v_v3c4x2n3& a, const v_v3c4x2n3& b) {
+  const float c_eps = 1e-5f;
+  return std::abs(a._tcoord.x - b._tcoord.x) <= c_eps && std::abs(a._tcoord.y - b._tcoord.y) <= c_eps &&
+         std::abs(a._normal.x - b._normal.x) <= c_eps && std::abs(a._normal.y - b._normal.y) <= c_eps &&
+         std::abs(a._normal.z - b._normal.z) <= c_eps && a._color.x == b._color.x && a._color.y == b._color.y &&
+         a._color.z == b._color.z && a._color.w == b._color.w;
+}
+//rep = first vertex within epsilon of the same position. Grid cells of epsilon, so matches are in the 27 around.
+static void weldPositions(const std::vector<v_v3c4x2n3>& verts, float epsilon, std::vector<uint32_t>& out_rep) {
+  std::unordered_map<uint64_t, uint32_t> cells;
+  std::vector<uint32_t> next(verts.size(), c_invalidVertex);
+  out_rep.resize(verts.size());
+  cells.reserve(verts.size());
+  float inv = 1.0f / epsilon;
+  float eps2 = epsilon * epsilon;
+  auto key = [](int64_t x, int64_t y, int64_t z) {
+    return (uint64_t)(x & 0x1FFFFF) | ((uint64_t)(y & 0x1FFFFF) << 21) | ((uint64_t)(z & 0x1FFFFF) << 42);
+  };
+  for (uint32_t i = 0; i < verts.size(); ++i) {
+    const BR2::vec3& p = verts[i]._pos;
+    int64_t cx = (int64_t)std::floor(p.x * inv), cy = (int64_t)std::floor(p.y * inv), cz = (int64_t)std::floor(p.z * inv);
+    uint32_t rep = i;
+    for (int64_t dz = -1; dz <= 1 && rep == i; ++dz) {
+      for (int64_t dy = -1; dy <= 1 && rep == i; ++dy) {
+        for (int64_t dx = -1; dx <= 1 && rep == i; ++dx) {
+          auto it = cells.find(key(cx + dx, cy + dy, cz + dz));
+          for (uint32_t j = (it == cells.end()) ? c_invalidVertex : it->second; j != c_invalidVertex; j = next[j]) {
+            const BR2::vec3& q = verts[j]._pos;
+            float ex = p.x - q.x, ey = p.y - q.y, ez = p.z - q.z;
+            if (out_rep[j] == j && ex * ex + ey * ey + ez * ez <= eps2) {
+              rep = j;
+              break;
+            }
+          }
+        }
+      }
+    }
+    out_rep[i] = rep;
+    auto& head = cells.emplace(key(cx, cy, cz), c_invalidVertex).first->second;
+    next[i] = head;
+    head = i;
+  }
+}
+std::vector<uint32_t> MeshSimplifier::simplify(const std::vector<v_v3c4x2n3>& verts, const std::vector<uint32_t>& inds, size_t targetIndexCount,
+                                               const SimplifyOptions& opt, SimplifyStats* out_stats, JobSystem* jobs) {
+  auto t0 = std::chrono::high_resolution_clock::now();
+  AssertOrThrow2(inds.size() % 3 == 0);
+  size_t vcount = verts.size();
+  SimplifyStats stats;
+  stats._sourceTriangles = inds.size() / 3;
+
+  //Work in a unit box so the attribute weights mean the same on any mesh.
+  BR2::vec3 bmin = vcount ? verts[0]._pos : BR2::vec3(0, 0, 0), bmax = bmin;
+  for (auto& v : verts) {
+    bmin = BR2::vec3(std::min(bmin.x, v._pos.x), std::min(bmin.y, v._pos.y), std::min(bmin.z, v._pos.z));
+    bmax = BR2::vec3(std::max(bmax.x, v._pos.x), std::max(bmax.y, v._pos.y), std::max(bmax.z, v._pos.z));
+  }
+  double extent = std::max(std::max(bmax.x - bmin.x, bmax.y - bmin.y), std::max(bmax.z - bmin.z, 1e-12f));
+  double invExtent = 1.0 / extent;
+  std::vector<double> attr(vcount * c_attribs);
+  for (size_t i = 0; i < vcount; ++i) {
+    const v_v3c4x2n3& v = verts[i];
+    double* x = &attr[i * c_attribs];
+    x[0] = (v._pos.x - bmin.x) * invExtent;
+    x[1] = (v._pos.y - bmin.y) * invExtent;
+    x[2] = (v._pos.z - bmin.z) * invExtent;
+    x[3] = v._normal.x * opt._normalWeight;
+    x[4] = v._normal.y * opt._normalWeight;
+    x[5] = v._normal.z * opt._normalWeight;
+    x[6] = v._tcoord.x * opt._uvWeight;
+    x[7] = v._tcoord.y * opt._uvWeight;
+  }
+
+  //Topology is over welded positions (reps). Copies of a rep's attributes alias to it, different ones lock it.
+  std::vector<uint32_t> rep;
+  weldPositions(verts, (float)(extent * c_weldEpsilon), rep);
+  std::vector<uint32_t> alias(vcount);
+  std::vector<VertexKind> kind(vcount, VertexKind::Interior);
+  for (uint32_t i = 0; i < vcount; ++i) {
+    alias[i] = i;
+    if (rep[i] != i) {
+      if (sameAttributes(verts[i], verts[rep[i]])) {
+        alias[i] = rep[i];
+      }
+      else {
+        kind[rep[i]] = VertexKind::Locked;
+      }
+    }
+  }
+  std::vector<uint32_t> tris;
+  tris.reserve(inds.size());
+  for (size_t t = 0; t < inds.size(); t += 3) {
+    uint32_t a = alias[inds[t]], b = alias[inds[t + 1]], c = alias[inds[t + 2]];
+    AssertOrThrow2(a < vcount && b < vcount && c < vcount);
+    if (rep[a] != rep[b] && rep[b] != rep[c] && rep[a] != rep[c]) {
+      tris.insert(tris.end(), { a, b, c });
+    }
+  }
+
+  //Open edges have one triangle, manifold ones two of opposite winding, anything else locks its ends.
+  std::vector<uint64_t> edges;
+  edges.reserve(tris.size());
+  for (size_t t = 0; t < tris.size(); t += 3) {
+    for (uint32_t k = 0; k < 3; ++k) {
+      uint64_t ra = rep[tris[t + k]], rb = rep[tris[t + (k + 1) % 3]];
+      //Undirected key in the high bits, direction in bit 0.
+      edges.push_back((std::min(ra, rb) << 33) | (std::max(ra, rb) << 1) | (ra < rb ? 1 : 0));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  std::vector<uint8_t> borderEdges(vcount, 0);
+  for (size_t e = 0; e < edges.size();) {
+    size_t n = 1;
+    while (e + n < edges.size() && (edges[e + n] >> 1) == (edges[e] >> 1)) {
+      n++;
+    }
+    uint32_t ra = (uint32_t)(edges[e] >> 33), rb = (uint32_t)((edges[e] >> 1) & 0xFFFFFFFF);
+    if (n == 1) {
+      borderEdges[ra] = (uint8_t)std::min(borderEdges[ra] + 1, 255);
+      borderEdges[rb] = (uint8_t)std::min(borderEdges[rb] + 1, 255);
+    }
+    else if (n != 2 || (edges[e] & 1) == (edges[e + 1] & 1)) {
+      kind[ra] = kind[rb] = VertexKind::Locked;
+    }
+    e += n;
+  }
+  for (uint32_t i = 0; i < vcount; ++i) {
+    if (borderEdges[i] && kind[i] != VertexKind::Locked) {
+      kind[i] = (opt._lockBorders || borderEdges[i] != 2) ? VertexKind::Locked : VertexKind::Border;
+    }
+  }
+
+  //Quadrics per vertex (wedge): attributes drive the collapse order, positions alone measure the error.
+  std::vector<Quadric<c_attribs>> quadrics(vcount);
+  std::vector<Quadric<3>> planes(vcount);
+  for (size_t t = 0; t < tris.size(); t += 3) {
+    const double* p[3] = { &attr[tris[t] * c_attribs], &attr[tris[t + 1] * c_attribs], &attr[tris[t + 2] * c_attribs] };
+    double e0[3], e1[3], n[3];
+    sub3(p[1], p[0], e0);
+    sub3(p[2], p[0], e1);
+    cross3(e0, e1, n);
+    double area = 0.5 * std::sqrt(dot3(n, n));
+    Quadric<c_attribs> q;
+    q.addTriangle(p[0], p[1], p[2], area);
+    Quadric<3> qp;
+    qp.addTriangle(p[0], p[1], p[2], area);
+    for (uint32_t k = 0; k < 3; ++k) {
+      quadrics[tris[t + k]].add(q);
+      planes[tris[t + k]].add(qp);
+    }
+    if (!opt._lockBorders) {
+      //Open edges also keep to the plane through them perpendicular to the triangle.
+      for (uint32_t k = 0; k < 3; ++k) {
+        uint32_t va = tris[t + k], vb = tris[t + (k + 1) % 3];
+        if (kind[rep[va]] != VertexKind::Border && kind[rep[vb]] != VertexKind::Border) {
+          continue;
+        }
+        uint64_t ra = rep[va], rb = rep[vb];
+        uint64_t undirected = (std::min(ra, rb) << 32) | std::max(ra, rb);
+        auto it = std::lower_bound(edges.begin(), edges.end(), undirected << 1);
+        bool open = (it + 1 == edges.end() || (*(it + 1) >> 1) != undirected);
+        if (!open) {
+          continue;
+        }
+        double ev[3], m[3];
+        sub3(&attr[vb * c_attribs], &attr[va * c_attribs], ev);
+        cross3(ev, n, m);
+        double len = std::sqrt(dot3(m, m));
+        if (len <= 0) {
+          continue;
+        }
+        m[0] /= len;
+        m[1] /= len;
+        m[2] /= len;
+        double d = -dot3(m, &attr[va * c_attribs]);
+        double w = c_borderWeight * dot3(ev, ev);
+        for (uint32_t v : { va, vb }) {
+          quadrics[v].addPlane(m, d, w);
+          planes[v].addPlane(m, d, w);
+        }
+      }
+    }
+  }
+
+  size_t liveTris = tris.size() / 3;
+  size_t targetTris = targetIndexCount / 3;
+  double maxError = (double)opt._maxError * invExtent;
+  double error = 0;
+  std::vector<uint32_t> adjOffsets(vcount + 1), adjacency;
+  std::vector<uint8_t> dead, passLocked(vcount);
+  std::vector<uint32_t> ringMark(vcount, 0);
+  uint32_t ringStamp = 0;
+  std::vector<CollapseCandidate> candidates;
+  std::vector<uint64_t> candidateKeys;
+
+  for (uint32_t pass = 0; pass < c_maxPasses && liveTris > targetTris; ++pass) {
+    //Triangles around each rep.
+    std::fill(adjOffsets.begin(), adjOffsets.end(), 0);
+    for (uint32_t v : tris) {
+      adjOffsets[rep[v] + 1]++;
+    }
+    for (size_t i = 0; i < vcount; ++i) {
+      adjOffsets[i + 1] += adjOffsets[i];
+    }
+    adjacency.resize(tris.size());
+    std::vector<uint32_t> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+    for (size_t i = 0; i < tris.size(); ++i) {
+      adjacency[fill[rep[tris[i]]]++] = static_cast<uint32_t>(i / 3);
+    }
+    dead.assign(liveTris, 0);
+    std::fill(passLocked.begin(), passLocked.end(), 0);
+
+    //Both directions of every edge that starts at a collapsible vertex.
+    candidateKeys.clear();
+    for (size_t t = 0; t < tris.size(); t += 3) {
+      for (uint32_t k = 0; k < 3; ++k) {
+        uint64_t ra = rep[tris[t + k]], rb = rep[tris[t + (k + 1) % 3]];
+        if (kind[ra] != VertexKind::Locked) {
+          candidateKeys.push_back((ra << 32) | rb);
+        }
+        if (kind[rb] != VertexKind::Locked) {
+          candidateKeys.push_back((rb << 32) | ra);
+        }
+      }
+    }
+    std::sort(candidateKeys.begin(), candidateKeys.end());
+    candidateKeys.erase(std::unique(candidateKeys.begin(), candidateKeys.end()), candidateKeys.end());
+    candidates.resize(candidateKeys.size());
+
+    //Cost of moving from onto the wedge of to on the shared triangles.
+    auto cost = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        CollapseCandidate& c = candidates[i];
+        c._from = (uint32_t)(candidateKeys[i] >> 32);
+        c._to = (uint32_t)(candidateKeys[i] & 0xFFFFFFFF);
+        uint32_t wedge = c_invalidVertex;
+        for (uint32_t j = adjOffsets[c._from]; j < adjOffsets[c._from + 1] && wedge == c_invalidVertex; ++j) {
+          const uint32_t* tri = &tris[adjacency[j] * 3];
+          for (uint32_t k = 0; k < 3; ++k) {
+            wedge = (rep[tri[k]] == c._to) ? tri[k] : wedge;
+          }
+        }
+        const double* x = &attr[wedge * c_attribs];
+        c._cost = quadrics[c._from].eval(x) + quadrics[wedge].eval(x);
+      }
+    };
+    if (jobs && candidates.size() >= c_parallelCandidates) {
+      jobs->parallelFor(candidates.size(), 0, cost);
+    }
+    else {
+      cost(0, candidates.size());
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const CollapseCandidate& a, const CollapseCandidate& b) { return a._cost < b._cost; });
+
+    size_t collapses = 0;
+    for (const CollapseCandidate& c : candidates) {
+      if (liveTris <= targetTris) {
+        break;
+      }
+      uint32_t a = c._from, b = c._to;
+      if (passLocked[a] || passLocked[b]) {
+        continue;
+      }
+      const uint32_t* adjA = &adjacency[adjOffsets[a]];
+      uint32_t adjACount = adjOffsets[a + 1] - adjOffsets[a];
+
+      //The edge's triangles must agree on b's wedge. Interior edges have two, open ones one.
+      uint32_t wedge = c_invalidVertex, edgeTris = 0;
+      bool split = false;
+      for (uint32_t j = 0; j < adjACount; ++j) {
+        if (dead[adjA[j]]) {
+          continue;
+        }
+        const uint32_t* tri = &tris[adjA[j] * 3];
+        for (uint32_t k = 0; k < 3; ++k) {
+          if (rep[tri[k]] == b) {
+            edgeTris++;
+            split |= (wedge != c_invalidVertex && wedge != tri[k]);
+            wedge = tri[k];
+          }
+        }
+      }
+      if (split || edgeTris != (kind[a] == VertexKind::Border ? 1u : 2u)) {
+        continue;
+      }
+
+      //Link condition: the rings of a and b share only the vertices opposite the edge.
+      if (++ringStamp == 0) {
+        std::fill(ringMark.begin(), ringMark.end(), 0);
+        ringStamp = 1;
+      }
+      for (uint32_t j = 0; j < adjACount; ++j) {
+        if (!dead[adjA[j]]) {
+          for (uint32_t k = 0; k < 3; ++k) {
+            ringMark[rep[tris[adjA[j] * 3 + k]]] = ringStamp;
+          }
+        }
+      }
+      uint32_t shared = 0;
+      for (uint32_t j = adjOffsets[b]; j < adjOffsets[b + 1]; ++j) {
+        if (dead[adjacency[j]]) {
+          continue;
+        }
+        for (uint32_t k = 0; k < 3; ++k) {
+          uint32_t r = rep[tris[adjacency[j] * 3 + k]];
+          if (r != a && r != b && ringMark[r] == ringStamp) {
+            ringMark[r] = 0;
+            shared++;
+          }
+        }
+      }
+      if (shared != edgeTris) {
+        continue;
+      }
+
+      //No triangle may turn more than ~75 degrees. Just rejecting flips lets a series of near 90 degree turns fold the surface.
+      const double* pb = &attr[wedge * c_attribs];
+      bool flip = false;
+      for (uint32_t j = 0; j < adjACount && !flip; ++j) {
+        if (dead[adjA[j]]) {
+          continue;
+        }
+        const uint32_t* tri = &tris[adjA[j] * 3];
+        if (rep[tri[0]] == b || rep[tri[1]] == b || rep[tri[2]] == b) {
+          continue;
+        }
+        uint32_t k = (tri[0] == a) ? 0 : (tri[1] == a) ? 1 : 2;
+        const double* p0 = &attr[tri[k] * c_attribs];
+        const double* p1 = &attr[tri[(k + 1) % 3] * c_attribs];
+        const double* p2 = &attr[tri[(k + 2) % 3] * c_attribs];
+        double e0[3], e1[3], n0[3], n1[3];
+        sub3(p1, p0, e0);
+        sub3(p2, p0, e1);
+        cross3(e0, e1, n0);
+        sub3(p1, pb, e0);
+        sub3(p2, pb, e1);
+        cross3(e0, e1, n1);
+        flip = dot3(n0, n1) <= 0.25 * std::sqrt(dot3(n0, n0) * dot3(n1, n1));
+      }
+      if (flip) {
+        continue;
+      }
+
+      double planeError = planes[a].eval(pb) + planes[wedge].eval(pb);
+      double weight = planes[a]._w + planes[wedge]._w;
+      double collapseError = weight > 0 ? std::sqrt(planeError / weight) : 0;
+      if (collapseError > maxError) {
+        continue;
+      }
+
+      for (uint32_t j = 0; j < adjACount; ++j) {
+        uint32_t t = adjA[j];
+        if (dead[t]) {
+          continue;
+        }
+        uint32_t* tri = &tris[t * 3];
+        if (rep[tri[0]] == b || rep[tri[1]] == b || rep[tri[2]] == b) {
+          dead[t] = 1;
+          liveTris--;
+        }
+        else {
+          for (uint32_t k = 0; k < 3; ++k) {
+            tri[k] = (tri[k] == a) ? wedge : tri[k];
+          }
+        }
+      }
+      quadrics[wedge].add(quadrics[a]);
+      planes[wedge].add(planes[a]);
+      passLocked[a] = passLocked[b] = 1;
+      error = std::max(error, collapseError);
+      collapses++;
+    }
+
+    size_t out = 0;
+    for (size_t t = 0; t < dead.size(); ++t) {
+      if (!dead[t]) {
+        tris[out * 3] = tris[t * 3];
+        tris[out * 3 + 1] = tris[t * 3 + 1];
+        tris[out * 3 + 2] = tris[t * 3 + 2];
+        out++;
+      }
+    }
+    tris.resize(out * 3);
+    if (collapses == 0) {
+      break;
+    }
+  }
+
+  stats._triangles = tris.size() / 3;
+  stats._error = (float)(error * extent);
+  stats._ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+  if (out_stats) {
+    *out_stats = stats;
+  }
+  return tris;
+}
+std::vector<std::vector<uint32_t>> MeshSimplifier::simplifyLevels(const std::vector<v_v3c4x2n3>& verts, const std::vector<uint32_t>& inds, uint32_t levels,
+                                                                  float ratio, const SimplifyOptions& opt, JobSystem* jobs, std::vector<SimplifyStats>& out_stats) {
+  AssertOrThrow2(ratio > 0 && ratio < 1);
+  std::vector<std::vector<uint32_t>> results(levels);
+  out_stats.assign(levels, SimplifyStats());
+  //Every level starts from LOD 0, so the levels are independent and errors don't compound.
+  auto level = [&](uint32_t l) {
+    size_t target = (size_t)((double)(inds.size() / 3) * std::pow((double)ratio, (double)(l + 1))) * 3;
+    results[l] = simplify(verts, inds, target, opt, &out_stats[l], jobs);
+  };
+  if (jobs && inds.size() / 3 >= c_parallelTriangles) {
+    JobCounter counter;
+    for (uint32_t l = 0; l < levels; ++l) {
+      jobs->run([&level, l]() { level(l); }, &counter);
+    }
+    jobs->wait(&counter);
+  }
+  else {
+    for (uint32_t l = 0; l < levels; ++l) {
+      level(l);
+    }
+  }
+  return results;
+}
+uint32_t MeshSimplifier::buildLodChain(Mesh& mesh, uint32_t levels, float ratio, const SimplifyOptions& opt, JobSystem* jobs,
+                                       std::vector<SimplifyStats>* out_stats) {
+  std::vector<SimplifyStats> stats;
+  std::vector<std::vector<uint32_t>> results = simplifyLevels(mesh.vertices(), mesh.indices(), levels, ratio, opt, jobs, stats);
+
+  std::vector<MeshLodData> chain;
+  size_t lastTriangles = mesh.indices().size() / 3;
+  float error = 0;
+  if (out_stats) {
+    out_stats->clear();
+  }
+  for (uint32_t l = 0; l < levels; ++l) {
+    if (stats[l]._triangles == 0 || stats[l]._triangles >= lastTriangles) {
+      continue;
+    }
+    lastTriangles = stats[l]._triangles;
+    //Each level is measured against LOD 0 on its own, keep the chain monotonic for the LOD selection.
+    error = std::max(error, stats[l]._error);
+    chain.emplace_back();
+    chain.back()._inds = std::move(results[l]);
+    chain.back()._error = error;
+    BRLogInfo("Mesh LOD " + std::to_string(chain.size()) + ": " + std::to_string(stats[l]._triangles) + "/" +
+              std::to_string(stats[l]._sourceTriangles) + " triangles (" + std::to_string(stats[l].ratio() * 100.0f) + "%), error " +
+              std::to_string(stats[l]._error) + ", " + std::to_string(stats[l]._ms) + "ms");
+    if (out_stats) {
+      out_stats->push_back(stats[l]);
+    }
+  }
+  uint32_t made = static_cast<uint32_t>(chain.size());
+  if (!mesh.setLodChain(std::move(chain))) {
+    return 0;
+  }
+  return made;
+}
+
+#pragma endregion
+
+}  // namespace VG
@@ -0,0 +1,73 @@
+/**
+*  @file MeshSimplifier.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Quadric error mesh simplification and LOD chain generation.
+*/
+#pragma once
+#ifndef __MESHSIMPLIFIER_17923452027493375566612_H__
+#define __MESHSIMPLIFIER_17923452027493375566612_H__
+
+#include "./SandboxHeader.h"
+
+namespace VG {
+
+class JobSystem;
+class Mesh;
+
+/**
+ * @class SimplifyOptions
+ * @brief Attribute weights are relative to positions scaled to a unit mesh extent.
+ * */
+class SimplifyOptions {
+public:
+  float _normalWeight = 0.25f;
+  float _uvWeight = 0.5f;
+  bool _lockBorders = true;  //Open edges and non manifold edges keep their vertices.
+  float _maxError = std::numeric_limits<float>::max();  //Object space. Stops before the target when reached.
+};
+/**
+ * @class SimplifyStats
+ * */
+class SimplifyStats {
+public:
+  size_t _sourceTriangles = 0;
+  size_t _triangles = 0;
+  float _error = 0;  //Object space distance to the source surface planes, from the position quadrics.
+  double _ms = 0;
+  float ratio() const { return _sourceTriangles ? (float)_triangles / (float)_sourceTriangles : 1.0f; }
+};
+/**
+ * @class MeshSimplifier
+ * @brief Greedy edge collapse ordered by quadric error (Garland & Heckbert), with generalized quadrics over
+ *        position, normal and texcoord so shading and UV layout are kept as well as the shape.
+ * @details Vertices collapse onto the other end of an edge, so the output indexes the input vertices and a LOD
+ *          shares LOD 0's vertex buffer. Topology is taken from welded positions. Vertices split by attributes
+ *          (UV seams, hard edges) are locked, like borders, so neither can open cracks.
+ *          Collapses run in passes: the candidates are costed (on the job system if one is given) and sorted,
+ *          then applied cheapest first, each locking its two endpoints for the rest of the pass. That is enough:
+ *          triangles are rewritten in place and only swap a for b's wedge, so every other vertex's adjacency still
+ *          lists its live triangles, and no wedge position or unlocked quadric moves, so the other candidates' costs
+ *          and checks stay valid. Collapses that would flip a triangle or join two rings beyond the edge are skipped.
+ * */
+class MeshSimplifier {
+public:
+  static constexpr size_t c_parallelTriangles = 20000;  //buildLodChain runs the levels as jobs from here.
+
+  //Indexes into verts, at most targetIndexCount unless _maxError or the locked vertices stop the collapses first.
+  static std::vector<uint32_t> simplify(const std::vector<v_v3c4x2n3>& verts, const std::vector<uint32_t>& inds, size_t targetIndexCount,
+                                        const SimplifyOptions& opt, SimplifyStats* out_stats = nullptr, JobSystem* jobs = nullptr);
+  //Replaces the mesh's LOD chain with up to levels simplifications of LOD 0, level l targeting ratio^l of its triangles.
+  //Levels that don't reduce further are dropped. Returns the levels made.
+  static uint32_t buildLodChain(Mesh& mesh, uint32_t levels, float ratio, const SimplifyOptions& opt, JobSystem* jobs = nullptr,
+                                std::vector<SimplifyStats>* out_stats = nullptr);
+
+private:
+  //Level l of the result targets ratio^(l + 1) of the triangles. Runs the levels as jobs on big meshes.
+  static std::vector<std::vector<uint32_t>> simplifyLevels(const std::vector<v_v3c4x2n3>& verts, const std::vector<uint32_t>& inds, uint32_t levels,
+                                                           float ratio, const SimplifyOptions& opt, JobSystem* jobs, std::vector<SimplifyStats>& out_stats);
+};
+
+}  // namespace VG
+
+#endif
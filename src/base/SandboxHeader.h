@@ -52,6 +52,7 @@
 #include <array>
 #include <random>
 #include <unordered_set>
+#include <atomic>
 #include <functional>
 
 #ifdef BR2_OS_WINDOWS
@@ -0,0 +1,298 @@
+#include "./SceneGraph.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VG_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace VG {
+
+#pragma region SceneGraph
+
+//out = a * b, column major. out may not alias a or b.
+static inline void mulMat4(const float* a, const float* b, float* out) {
+#ifdef VG_SIMD_X86
+  __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+  for (int c = 0; c < 4; ++c) {
+    const float* bc = b + c * 4;
+    __m128 col = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(bc[0])), _mm_mul_ps(a1, _mm_set1_ps(bc[1]))),
+                            _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(bc[2])), _mm_mul_ps(a3, _mm_set1_ps(bc[3]))));
+    _mm_storeu_ps(out + c * 4, col);
+  }
+#else
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+    }
+  }
+#endif
+}
+void SceneGraph::composeLocal(const BR2::vec3& pos, const BR2::vec3& axis, float angle, float* m) {
+  float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+  float x = axis.x, y = axis.y, z = axis.z;
+  m[0] = t * x * x + c;
+  m[1] = t * x * y + s * z;
+  m[2] = t * x * z - s * y;
+  m[3] = 0;
+  m[4] = t * x * y - s * z;
+  m[5] = t * y * y + c;
+  m[6] = t * y * z + s * x;
+  m[7] = 0;
+  m[8] = t * x * z + s * y;
+  m[9] = t * y * z - s * x;
+  m[10] = t * z * z + c;
+  m[11] = 0;
+  m[12] = pos.x;
+  m[13] = pos.y;
+  m[14] = pos.z;
+  m[15] = 1;
+}
+SceneNode SceneGraph::create(SceneNode parent, const float* local) {
+  uint32_t parentIndex = c_invalidIndex;
+  if (parent._slot != SceneNode::c_invalid) {
+    parentIndex = indexOf(parent);
+    AssertOrThrow2(parentIndex != c_invalidIndex);
+  }
+  uint32_t slot = 0;
+  if (_freeSlots.size() > 0) {
+    slot = _freeSlots.back();
+    _freeSlots.pop_back();
+  }
+  else {
+    slot = static_cast<uint32_t>(_slots.size());
+    _slots.push_back(Slot());
+  }
+  //Appended, so the parent still comes first. The children ranges wait for layout().
+  size_t index = count();
+  _slots[slot]._index = static_cast<uint32_t>(index);
+  _denseToSlot.push_back(slot);
+  _parent.push_back(parentIndex);
+  _firstChild.push_back(0);
+  _childCount.push_back(0);
+  _local.insert(_local.end(), local, local + 16);
+  _world.resize(_world.size() + 16, 0.0f);
+  _layoutDirty = true;
+  resizeBitsets();
+  markDirty(index);
+
+  SceneNode n;
+  n._slot = slot;
+  n._generation = _slots[slot]._generation;
+  return n;
+}
+SceneNode SceneGraph::create(SceneNode parent, const BR2::vec3& pos, const BR2::vec3& axis, float angle) {
+  float local[16];
+  composeLocal(pos, axis, angle, local);
+  return create(parent, local);
+}
+bool SceneGraph::destroy(SceneNode n) {
+  uint32_t index = indexOf(n);
+  if (index == c_invalidIndex) {
+    return false;
+  }
+  //Parents come first in any order we keep, so one forward pass finds the subtree.
+  size_t num = count();
+  std::vector<uint8_t> removed(num, 0);
+  removed[index] = 1;
+  for (size_t i = index + 1; i < num; ++i) {
+    removed[i] = (_parent[i] != c_invalidIndex) ? removed[_parent[i]] : 0;
+  }
+  std::vector<uint32_t> oldToNew(num, c_invalidIndex);
+  size_t kept = 0;
+  for (size_t i = 0; i < num; ++i) {
+    Slot& slot = _slots[_denseToSlot[i]];
+    if (removed[i]) {
+      slot._index = c_invalidIndex;
+      slot._generation++;
+      _freeSlots.push_back(_denseToSlot[i]);
+      continue;
+    }
+    oldToNew[i] = static_cast<uint32_t>(kept);
+    _denseToSlot[kept] = _denseToSlot[i];
+    _parent[kept] = (_parent[i] != c_invalidIndex) ? oldToNew[_parent[i]] : c_invalidIndex;
+    memmove(&_local[kept * 16], &_local[i * 16], 16 * sizeof(float));
+    slot._index = static_cast<uint32_t>(kept);
+    kept++;
+  }
+  _denseToSlot.resize(kept);
+  _parent.resize(kept);
+  _firstChild.resize(kept);
+  _childCount.resize(kept);
+  _local.resize(kept * 16);
+  _world.resize(kept * 16);
+  _layoutDirty = true;
+  resizeBitsets();
+  return true;
+}
+void SceneGraph::clear() {
+  for (auto& slot : _slots) {
+    if (slot._index != c_invalidIndex) {
+      slot._index = c_invalidIndex;
+      slot._generation++;
+      _freeSlots.push_back(static_cast<uint32_t>(&slot - _slots.data()));
+    }
+  }
+  _denseToSlot.clear();
+  _parent.clear();
+  _firstChild.clear();
+  _childCount.clear();
+  _local.clear();
+  _world.clear();
+  _changed.clear();
+  _layoutDirty = false;
+  _firstDirty = SIZE_MAX;
+  resizeBitsets();
+}
+uint32_t SceneGraph::indexOf(SceneNode n) const {
+  if (n._slot >= _slots.size() || _slots[n._slot]._generation != n._generation) {
+    return c_invalidIndex;
+  }
+  return _slots[n._slot]._index;
+}
+SceneNode SceneGraph::parentOf(SceneNode n) const {
+  SceneNode ret;
+  uint32_t index = indexOf(n);
+  if (index != c_invalidIndex && _parent[index] != c_invalidIndex) {
+    ret._slot = _denseToSlot[_parent[index]];
+    ret._generation = _slots[ret._slot]._generation;
+  }
+  return ret;
+}
+void SceneGraph::setLocal(SceneNode n, const float* local) {
+  uint32_t index = indexOf(n);
+  AssertOrThrow2(index != c_invalidIndex);
+  memcpy(&_local[(size_t)index * 16], local, 16 * sizeof(float));
+  markDirty(index);
+}
+void SceneGraph::setLocal(SceneNode n, const BR2::vec3& pos, const BR2::vec3& axis, float angle) {
+  float local[16];
+  composeLocal(pos, axis, angle, local);
+  setLocal(n, local);
+}
+const float* SceneGraph::local(SceneNode n) const {
+  uint32_t index = indexOf(n);
+  AssertOrThrow2(index != c_invalidIndex);
+  return &_local[(size_t)index * 16];
+}
+const float* SceneGraph::world(SceneNode n) const {
+  uint32_t index = indexOf(n);
+  AssertOrThrow2(index != c_invalidIndex);
+  return &_world[(size_t)index * 16];
+}
+void SceneGraph::update() {
+  _changed.clear();
+  _layoutChanged = false;
+  if (_layoutDirty) {
+    layout();
+  }
+  if (_firstDirty == SIZE_MAX) {
+    return;
+  }
+  //Children are after their parent, so marking them dirty here still reaches them in this pass.
+  size_t num = count();
+  for (size_t i = _dirty.findNext(_firstDirty); i < num; i = _dirty.findNext(i + 1)) {
+    float* w = &_world[i * 16];
+    if (_parent[i] == c_invalidIndex) {
+      memcpy(w, &_local[i * 16], 16 * sizeof(float));
+    }
+    else {
+      mulMat4(&_world[(size_t)_parent[i] * 16], &_local[i * 16], w);
+    }
+    _changed.push_back(static_cast<uint32_t>(i));
+    if (_childCount[i] > 0) {
+      _dirty.setRange(_firstChild[i], (size_t)_firstChild[i] + _childCount[i]);
+    }
+  }
+  for (auto& dirty : _uploadDirty) {
+    for (auto i : _changed) {
+      dirty.set(i);
+    }
+  }
+  _dirty.resetRange(_firstDirty, num);
+  _firstDirty = SIZE_MAX;
+}
+void SceneGraph::layout() {
+  //Children per node, in dense order.
+  size_t num = count();
+  std::vector<uint32_t> childStart(num + 1, 0);
+  std::vector<uint32_t> children(num);
+  for (size_t i = 0; i < num; ++i) {
+    if (_parent[i] != c_invalidIndex) {
+      childStart[_parent[i] + 1]++;
+    }
+  }
+  for (size_t i = 0; i < num; ++i) {
+    childStart[i + 1] += childStart[i];
+  }
+  std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+  for (size_t i = 0; i < num; ++i) {
+    if (_parent[i] != c_invalidIndex) {
+      children[fill[_parent[i]]++] = static_cast<uint32_t>(i);
+    }
+  }
+
+  //Breadth first from the roots. Appending each node's children together keeps them contiguous.
+  std::vector<uint32_t> order;
+  order.reserve(num);
+  for (size_t i = 0; i < num; ++i) {
+    if (_parent[i] == c_invalidIndex) {
+      order.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  for (size_t q = 0; q < order.size(); ++q) {
+    uint32_t i = order[q];
+    order.insert(order.end(), children.begin() + childStart[i], children.begin() + childStart[i + 1]);
+  }
+  AssertOrThrow2(order.size() == num);
+  std::vector<uint32_t> oldToNew(num);
+  for (size_t q = 0; q < num; ++q) {
+    oldToNew[order[q]] = static_cast<uint32_t>(q);
+  }
+
+  std::vector<uint32_t> denseToSlot(num), parent(num), firstChild(num), childCount(num);
+  std::vector<float> local(num * 16);
+  for (size_t q = 0; q < num; ++q) {
+    uint32_t i = order[q];
+    denseToSlot[q] = _denseToSlot[i];
+    parent[q] = (_parent[i] != c_invalidIndex) ? oldToNew[_parent[i]] : c_invalidIndex;
+    childCount[q] = childStart[i + 1] - childStart[i];
+    firstChild[q] = childCount[q] > 0 ? oldToNew[children[childStart[i]]] : 0;
+    memcpy(&local[q * 16], &_local[(size_t)i * 16], 16 * sizeof(float));
+    _slots[denseToSlot[q]]._index = static_cast<uint32_t>(q);
+  }
+  _denseToSlot.swap(denseToSlot);
+  _parent.swap(parent);
+  _firstChild.swap(firstChild);
+  _childCount.swap(childCount);
+  _local.swap(local);
+  _world.assign(num * 16, 0.0f);
+
+  //Every index may have moved, so everything is rebuilt and uploaded.
+  _layoutDirty = false;
+  _layoutChanged = true;
+  resizeBitsets();
+  _dirty.setAll();
+  _firstDirty = num > 0 ? 0 : SIZE_MAX;
+}
+void SceneGraph::markDirty(size_t index) {
+  _dirty.set(index);
+  _firstDirty = std::min(_firstDirty, index);
+}
+void SceneGraph::resizeBitsets() {
+  _dirty.resize(count());
+  for (auto& dirty : _uploadDirty) {
+    dirty.resize(count());
+  }
+}
+void SceneGraph::setUploadChannels(uint32_t channels) {
+  _uploadDirty.resize(channels);
+  for (auto& dirty : _uploadDirty) {
+    dirty.resize(count());
+    dirty.setAll();
+  }
+}
+
+#pragma endregion
+
+}  // namespace VG
@@ -0,0 +1,103 @@
+/**
+*  @file SceneGraph.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Transform hierarchy with incremental world matrix propagation.
+*/
+#pragma once
+#ifndef __SCENEGRAPH_17923441530982714463207_H__
+#define __SCENEGRAPH_17923441530982714463207_H__
+
+#include "./SandboxHeader.h"
+#include "./TransformStore.h"
+
+namespace VG {
+
+/**
+ * @class SceneNode
+ * @brief Stable reference to a SceneGraph node. Stale handles (destroyed nodes) fail validation.
+ * */
+class SceneNode {
+public:
+  static constexpr uint32_t c_invalid = 0xFFFFFFFF;
+  uint32_t _slot = c_invalid;
+  uint32_t _generation = 0;
+  bool operator==(const SceneNode& rhs) const { return _slot == rhs._slot && _generation == rhs._generation; }
+  bool operator!=(const SceneNode& rhs) const { return !(*this == rhs); }
+};
+/**
+ * @class SceneGraph
+ * @brief Local transforms in a hierarchy. update() recomputes world = parent world * local for dirty subtrees only.
+ * @details Nodes are dense and kept in breadth first order, so a parent always comes before its children and
+ *          the children of a node are contiguous. update() walks the dirty bits forward once: each dirty node is
+ *          rebuilt from its already final parent and marks its child range dirty.
+ *          Creating or destroying nodes only flags the layout, which is rebuilt (and every world matrix with it)
+ *          by the next update(). Dense indexes are stable between structural changes.
+ *          With no setLocal() since the last update(), update() returns immediately.
+ *          Matrices are column major mat4s (16 floats), like TransformStore::matrices().
+ * */
+class SceneGraph {
+public:
+  static constexpr uint32_t c_invalidIndex = 0xFFFFFFFF;
+
+  SceneNode create(SceneNode parent, const float* local);  //Invalid parent = root.
+  SceneNode create(SceneNode parent, const BR2::vec3& pos, const BR2::vec3& axis, float angle);
+  bool destroy(SceneNode n);  //And its subtree.
+  void clear();
+
+  bool valid(SceneNode n) const { return indexOf(n) != c_invalidIndex; }
+  uint32_t indexOf(SceneNode n) const;  //Dense index, or c_invalidIndex. Changes with the layout.
+  SceneNode parentOf(SceneNode n) const;
+  size_t count() const { return _denseToSlot.size(); }
+
+  void setLocal(SceneNode n, const float* local);
+  void setLocal(SceneNode n, const BR2::vec3& pos, const BR2::vec3& axis, float angle);
+  const float* local(SceneNode n) const;
+  const float* world(SceneNode n) const;  //As of the last update().
+
+  void update();
+  const std::vector<uint32_t>& changed() const { return _changed; }  //Dense indexes, in order, rebuilt by the last update().
+  const float* worldMatrices() const { return _world.data(); }        //16 floats per dense index.
+  bool layoutChanged() const { return _layoutChanged; }                //The last update() rebuilt the layout, dense indexes moved.
+
+  void setUploadChannels(uint32_t channels);  //Everything starts dirty in new channels.
+  uint32_t uploadChannels() const { return static_cast<uint32_t>(_uploadDirty.size()); }
+  const DirtyBitset& uploadDirty(uint32_t channel) const { return _uploadDirty[channel]; }
+  void clearUploadDirty(uint32_t channel) { _uploadDirty[channel].clear(); }
+
+  //Column major rotation about axis, then translation by pos.
+  static void composeLocal(const BR2::vec3& pos, const BR2::vec3& axis, float angle, float* out_mat4);
+
+private:
+  class Slot {
+  public:
+    uint32_t _index = c_invalidIndex;  //Dense index, c_invalidIndex if free.
+    uint32_t _generation = 0;
+  };
+
+  void layout();
+  void markDirty(size_t index);
+  void resizeBitsets();
+
+  std::vector<Slot> _slots;
+  std::vector<uint32_t> _freeSlots;
+
+  //Dense, breadth first.
+  std::vector<uint32_t> _denseToSlot;
+  std::vector<uint32_t> _parent;      //Dense index, c_invalidIndex for roots.
+  std::vector<uint32_t> _firstChild;  //Valid when the layout is.
+  std::vector<uint32_t> _childCount;
+  std::vector<float> _local;
+  std::vector<float> _world;
+
+  bool _layoutDirty = false;
+  bool _layoutChanged = false;
+  DirtyBitset _dirty;
+  size_t _firstDirty = SIZE_MAX;  //Lowest dirty index, SIZE_MAX if none.
+  std::vector<uint32_t> _changed;
+  std::vector<DirtyBitset> _uploadDirty;
+};
+
+}  // namespace VG
+
+#endif
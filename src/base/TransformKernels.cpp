@@ -0,0 +1,362 @@
+#include "./TransformKernels.h"
+#include "./VulkanHeader.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VG_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define VG_TARGET_AVX2
+#else
+#define VG_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace VG {
+
+#pragma region Kernels
+
+//Angles are wrapped to [-pi, pi] so the polynomial sin/cos stays accurate.
+static const float c_2Pi = 6.28318530717958647692f;
+static const float c_Inv2Pi = 0.15915494309189533577f;
+
+static void buildScalar(TransformStore& st, size_t begin, size_t end, const float o[3], float dt, float* out) {
+  for (size_t i = begin; i < end; ++i) {
+    float a = st.angle()[i] + st.angularVelocity()[i] * dt;
+    a -= c_2Pi * std::floor(a * c_Inv2Pi + 0.5f);
+    st.angle()[i] = a;
+
+    float c = std::cos(a), s = std::sin(a), t = 1.0f - c;
+    float x = st.axisX()[i], y = st.axisY()[i], z = st.axisZ()[i];
+    float* m = out + i * 16;
+    m[0] = t * x * x + c;
+    m[1] = t * x * y + s * z;
+    m[2] = t * x * z - s * y;
+    m[3] = 0;
+    m[4] = t * x * y - s * z;
+    m[5] = t * y * y + c;
+    m[6] = t * y * z + s * x;
+    m[7] = 0;
+    m[8] = t * x * z + s * y;
+    m[9] = t * y * z - s * x;
+    m[10] = t * z * z + c;
+    m[11] = 0;
+    m[12] = m[0] * o[0] + m[4] * o[1] + m[8] * o[2] + st.posX()[i];
+    m[13] = m[1] * o[0] + m[5] * o[1] + m[9] * o[2] + st.posY()[i];
+    m[14] = m[2] * o[0] + m[6] * o[1] + m[10] * o[2] + st.posZ()[i];
+    m[15] = 1;
+  }
+}
+
+#ifdef VG_SIMD_X86
+
+//Cephes sinf/cosf: reduce to [-pi/4, pi/4] by quadrant, then minimax polynomials.
+#define VG_SINCOS_CONSTANTS                                                                   \
+  const float c_2OverPi = 0.63661977236758134308f;                                           \
+  const float c_DP1 = 1.5703125f, c_DP2 = 4.837512969970703125e-4f, c_DP3 = 7.54978995489188216e-8f; \
+  const float c_S1 = -1.6666654611e-1f, c_S2 = 8.3321608736e-3f, c_S3 = -1.9515295891e-4f;   \
+  const float c_C1 = 4.166664568298827e-2f, c_C2 = -1.388731625493765e-3f, c_C3 = 2.443315711809948e-5f;
+
+static inline void sincos_SSE2(__m128 x, __m128& out_sin, __m128& out_cos) {
+  VG_SINCOS_CONSTANTS
+  __m128i qi = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(c_2OverPi)));  //Round to nearest
+  __m128 q = _mm_cvtepi32_ps(qi);
+  __m128 y = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(c_DP1)));
+  y = _mm_sub_ps(y, _mm_mul_ps(q, _mm_set1_ps(c_DP2)));
+  y = _mm_sub_ps(y, _mm_mul_ps(q, _mm_set1_ps(c_DP3)));
+  __m128 z = _mm_mul_ps(y, y);
+
+  __m128 sp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c_S3), z), _mm_set1_ps(c_S2));
+  sp = _mm_add_ps(_mm_mul_ps(sp, z), _mm_set1_ps(c_S1));
+  sp = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sp, z), y), y);
+
+  __m128 cp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c_C3), z), _mm_set1_ps(c_C2));
+  cp = _mm_add_ps(_mm_mul_ps(cp, z), _mm_set1_ps(c_C1));
+  cp = _mm_mul_ps(_mm_mul_ps(cp, z), z);
+  cp = _mm_add_ps(_mm_sub_ps(cp, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+  //Odd quadrants swap sin and cos. Quadrants 2,3 negate sin, quadrants 1,2 negate cos.
+  __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+  __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(qi, one), one));
+  __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(qi, two), 30));
+  __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(qi, one), two), 30));
+  __m128 s = _mm_or_ps(_mm_and_ps(swap, cp), _mm_andnot_ps(swap, sp));
+  __m128 c = _mm_or_ps(_mm_and_ps(swap, sp), _mm_andnot_ps(swap, cp));
+  out_sin = _mm_xor_ps(s, sinSign);
+  out_cos = _mm_xor_ps(c, cosSign);
+}
+static inline void storeColumns_SSE2(float* out, __m128 c0, __m128 c1, __m128 c2, __m128 c3, bool stream) {
+  if (stream) {
+    _mm_stream_ps(out + 0, c0);
+    _mm_stream_ps(out + 4, c1);
+    _mm_stream_ps(out + 8, c2);
+    _mm_stream_ps(out + 12, c3);
+  }
+  else {
+    _mm_storeu_ps(out + 0, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_ps(out + 12, c3);
+  }
+}
+static inline void storeMatrices4_SSE2(float* out, __m128 m0, __m128 m1, __m128 m2, __m128 m4, __m128 m5, __m128 m6,
+                                       __m128 m8, __m128 m9, __m128 m10, __m128 m12, __m128 m13, __m128 m14, bool stream) {
+  //Lanes hold 4 instances, transpose so each register holds one column of one instance.
+  __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  __m128 a0 = m0, a1 = m1, a2 = m2, a3 = zero;
+  __m128 b0 = m4, b1 = m5, b2 = m6, b3 = zero;
+  __m128 c0 = m8, c1 = m9, c2 = m10, c3 = zero;
+  __m128 d0 = m12, d1 = m13, d2 = m14, d3 = one;
+  _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+  _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+  storeColumns_SSE2(out + 0, a0, b0, c0, d0, stream);
+  storeColumns_SSE2(out + 16, a1, b1, c1, d1, stream);
+  storeColumns_SSE2(out + 32, a2, b2, c2, d2, stream);
+  storeColumns_SSE2(out + 48, a3, b3, c3, d3, stream);
+}
+static void buildSSE2(TransformStore& st, size_t begin, size_t end, const float o[3], float dt, float* out) {
+  //Mapped buffers are usually write combined, so write aligned output with non-temporal stores.
+  bool stream = (reinterpret_cast<uintptr_t>(out) & 15) == 0;
+  __m128 vdt = _mm_set1_ps(dt), v2Pi = _mm_set1_ps(c_2Pi), vInv2Pi = _mm_set1_ps(c_Inv2Pi), vOne = _mm_set1_ps(1.0f);
+  __m128 ox = _mm_set1_ps(o[0]), oy = _mm_set1_ps(o[1]), oz = _mm_set1_ps(o[2]);
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 a = _mm_add_ps(_mm_loadu_ps(&st.angle()[i]), _mm_mul_ps(_mm_loadu_ps(&st.angularVelocity()[i]), vdt));
+    a = _mm_sub_ps(a, _mm_mul_ps(v2Pi, _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(a, vInv2Pi)))));
+    _mm_storeu_ps(&st.angle()[i], a);
+
+    __m128 s, c;
+    sincos_SSE2(a, s, c);
+    __m128 t = _mm_sub_ps(vOne, c);
+    __m128 x = _mm_loadu_ps(&st.axisX()[i]), y = _mm_loadu_ps(&st.axisY()[i]), z = _mm_loadu_ps(&st.axisZ()[i]);
+    __m128 tx = _mm_mul_ps(t, x), ty = _mm_mul_ps(t, y), tz = _mm_mul_ps(t, z);
+    __m128 sx = _mm_mul_ps(s, x), sy = _mm_mul_ps(s, y), sz = _mm_mul_ps(s, z);
+    __m128 txy = _mm_mul_ps(tx, y), txz = _mm_mul_ps(tx, z), tyz = _mm_mul_ps(ty, z);
+
+    __m128 m0 = _mm_add_ps(_mm_mul_ps(tx, x), c);
+    __m128 m1 = _mm_add_ps(txy, sz);
+    __m128 m2 = _mm_sub_ps(txz, sy);
+    __m128 m4 = _mm_sub_ps(txy, sz);
+    __m128 m5 = _mm_add_ps(_mm_mul_ps(ty, y), c);
+    __m128 m6 = _mm_add_ps(tyz, sx);
+    __m128 m8 = _mm_add_ps(txz, sy);
+    __m128 m9 = _mm_sub_ps(tyz, sx);
+    __m128 m10 = _mm_add_ps(_mm_mul_ps(tz, z), c);
+    __m128 m12 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, ox), _mm_mul_ps(m4, oy)), _mm_add_ps(_mm_mul_ps(m8, oz), _mm_loadu_ps(&st.posX()[i])));
+    __m128 m13 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, ox), _mm_mul_ps(m5, oy)), _mm_add_ps(_mm_mul_ps(m9, oz), _mm_loadu_ps(&st.posY()[i])));
+    __m128 m14 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, ox), _mm_mul_ps(m6, oy)), _mm_add_ps(_mm_mul_ps(m10, oz), _mm_loadu_ps(&st.posZ()[i])));
+
+    storeMatrices4_SSE2(out + i * 16, m0, m1, m2, m4, m5, m6, m8, m9, m10, m12, m13, m14, stream);
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+  buildScalar(st, i, end, o, dt, out);
+}
+
+VG_TARGET_AVX2 static inline void sincos_AVX2(__m256 x, __m256& out_sin, __m256& out_cos) {
+  VG_SINCOS_CONSTANTS
+  __m256i qi = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(c_2OverPi)));
+  __m256 q = _mm256_cvtepi32_ps(qi);
+  __m256 y = _mm256_fnmadd_ps(q, _mm256_set1_ps(c_DP1), x);
+  y = _mm256_fnmadd_ps(q, _mm256_set1_ps(c_DP2), y);
+  y = _mm256_fnmadd_ps(q, _mm256_set1_ps(c_DP3), y);
+  __m256 z = _mm256_mul_ps(y, y);
+
+  __m256 sp = _mm256_fmadd_ps(_mm256_set1_ps(c_S3), z, _mm256_set1_ps(c_S2));
+  sp = _mm256_fmadd_ps(sp, z, _mm256_set1_ps(c_S1));
+  sp = _mm256_fmadd_ps(_mm256_mul_ps(sp, z), y, y);
+
+  __m256 cp = _mm256_fmadd_ps(_mm256_set1_ps(c_C3), z, _mm256_set1_ps(c_C2));
+  cp = _mm256_fmadd_ps(cp, z, _mm256_set1_ps(c_C1));
+  cp = _mm256_mul_ps(_mm256_mul_ps(cp, z), z);
+  cp = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), cp), _mm256_set1_ps(1.0f));
+
+  __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2);
+  __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(qi, one), one));
+  __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(qi, two), 30));
+  __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(qi, one), two), 30));
+  out_sin = _mm256_xor_ps(_mm256_blendv_ps(sp, cp, swap), sinSign);
+  out_cos = _mm256_xor_ps(_mm256_blendv_ps(cp, sp, swap), cosSign);
+}
+VG_TARGET_AVX2 static void buildAVX2(TransformStore& st, size_t begin, size_t end, const float o[3], float dt, float* out) {
+  bool stream = (reinterpret_cast<uintptr_t>(out) & 15) == 0;
+  __m256 vdt = _mm256_set1_ps(dt), v2Pi = _mm256_set1_ps(c_2Pi), vInv2Pi = _mm256_set1_ps(c_Inv2Pi), vOne = _mm256_set1_ps(1.0f);
+  __m256 ox = _mm256_set1_ps(o[0]), oy = _mm256_set1_ps(o[1]), oz = _mm256_set1_ps(o[2]);
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 a = _mm256_fmadd_ps(_mm256_loadu_ps(&st.angularVelocity()[i]), vdt, _mm256_loadu_ps(&st.angle()[i]));
+    a = _mm256_fnmadd_ps(v2Pi, _mm256_cvtepi32_ps(_mm256_cvtps_epi32(_mm256_mul_ps(a, vInv2Pi))), a);
+    _mm256_storeu_ps(&st.angle()[i], a);
+
+    __m256 s, c;
+    sincos_AVX2(a, s, c);
+    __m256 t = _mm256_sub_ps(vOne, c);
+    __m256 x = _mm256_loadu_ps(&st.axisX()[i]), y = _mm256_loadu_ps(&st.axisY()[i]), z = _mm256_loadu_ps(&st.axisZ()[i]);
+    __m256 tx = _mm256_mul_ps(t, x), ty = _mm256_mul_ps(t, y), tz = _mm256_mul_ps(t, z);
+    __m256 sx = _mm256_mul_ps(s, x), sy = _mm256_mul_ps(s, y), sz = _mm256_mul_ps(s, z);
+    __m256 txy = _mm256_mul_ps(tx, y), txz = _mm256_mul_ps(tx, z), tyz = _mm256_mul_ps(ty, z);
+
+    __m256 m0 = _mm256_fmadd_ps(tx, x, c);
+    __m256 m1 = _mm256_add_ps(txy, sz);
+    __m256 m2 = _mm256_sub_ps(txz, sy);
+    __m256 m4 = _mm256_sub_ps(txy, sz);
+    __m256 m5 = _mm256_fmadd_ps(ty, y, c);
+    __m256 m6 = _mm256_add_ps(tyz, sx);
+    __m256 m8 = _mm256_add_ps(txz, sy);
+    __m256 m9 = _mm256_sub_ps(tyz, sx);
+    __m256 m10 = _mm256_fmadd_ps(tz, z, c);
+    __m256 m12 = _mm256_fmadd_ps(m0, ox, _mm256_fmadd_ps(m4, oy, _mm256_fmadd_ps(m8, oz, _mm256_loadu_ps(&st.posX()[i]))));
+    __m256 m13 = _mm256_fmadd_ps(m1, ox, _mm256_fmadd_ps(m5, oy, _mm256_fmadd_ps(m9, oz, _mm256_loadu_ps(&st.posY()[i]))));
+    __m256 m14 = _mm256_fmadd_ps(m2, ox, _mm256_fmadd_ps(m6, oy, _mm256_fmadd_ps(m10, oz, _mm256_loadu_ps(&st.posZ()[i]))));
+
+    //Two groups of 4 instances per iteration.
+    storeMatrices4_SSE2(out + i * 16,
+                        _mm256_castps256_ps128(m0), _mm256_castps256_ps128(m1), _mm256_castps256_ps128(m2),
+                        _mm256_castps256_ps128(m4), _mm256_castps256_ps128(m5), _mm256_castps256_ps128(m6),
+                        _mm256_castps256_ps128(m8), _mm256_castps256_ps128(m9), _mm256_castps256_ps128(m10),
+                        _mm256_castps256_ps128(m12), _mm256_castps256_ps128(m13), _mm256_castps256_ps128(m14), stream);
+    storeMatrices4_SSE2(out + (i + 4) * 16,
+                        _mm256_extractf128_ps(m0, 1), _mm256_extractf128_ps(m1, 1), _mm256_extractf128_ps(m2, 1),
+                        _mm256_extractf128_ps(m4, 1), _mm256_extractf128_ps(m5, 1), _mm256_extractf128_ps(m6, 1),
+                        _mm256_extractf128_ps(m8, 1), _mm256_extractf128_ps(m9, 1), _mm256_extractf128_ps(m10, 1),
+                        _mm256_extractf128_ps(m12, 1), _mm256_extractf128_ps(m13, 1), _mm256_extractf128_ps(m14, 1), stream);
+  }
+  if (stream) {
+    _mm_sfence();
+  }
+  buildSSE2(st, i, end, o, dt, out);
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region TransformKernels
+
+SimdLevel TransformKernels::simdLevel() {
+  static SimdLevel level = []() {
+    SimdLevel ret = SimdLevel::Scalar;
+#ifdef VG_SIMD_X86
+    ret = SimdLevel::SSE2;  //Baseline on x64
+#if defined(_MSC_VER)
+    //CPUID leaf 7 EBX bit 5 = AVX2, leaf 1 ECX bit 12 = FMA, bit 27 = OSXSAVE. The OS must save the YMM registers.
+    int info[4];
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    if (avx2 && fma && osxsave && (_xgetbv(0) & 0x6) == 0x6) {
+      ret = SimdLevel::AVX2;
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      ret = SimdLevel::AVX2;
+    }
+#endif
+#endif
+    return ret;
+  }();
+  return level;
+}
+const char* TransformKernels::simdLevelName(SimdLevel level) {
+  if (level == SimdLevel::AVX2) {
+    return "AVX2";
+  }
+  else if (level == SimdLevel::SSE2) {
+    return "SSE2";
+  }
+  return "Scalar";
+}
+void TransformKernels::buildInstanceMatrices(TransformStore& store, size_t first, size_t count, const BR2::vec3& origin, float dt, float* out_mat4) {
+  buildInstanceMatrices(store, first, count, origin, dt, out_mat4, simdLevel());
+}
+void TransformKernels::buildInstanceMatrices(TransformStore& store, size_t first, size_t count, const BR2::vec3& origin, float dt, float* out_mat4, SimdLevel level) {
+  AssertOrThrow2(first + count <= store.count());
+  const float o[3] = { origin.x, origin.y, origin.z };
+  size_t end = first + count;
+  if (level > simdLevel()) {
+    level = simdLevel();
+  }
+#ifdef VG_SIMD_X86
+  if (level == SimdLevel::AVX2) {
+    buildAVX2(store, first, end, o, dt, out_mat4);
+    return;
+  }
+  else if (level == SimdLevel::SSE2) {
+    buildSSE2(store, first, end, o, dt, out_mat4);
+    return;
+  }
+#endif
+  buildScalar(store, first, end, o, dt, out_mat4);
+}
+void TransformKernels::benchmark() {
+  const int c_iterations = 20;
+  const float c_dt = 1.0f / 60.0f;
+  BR2::vec3 origin = { -0.5, -0.5, -0.5 };
+
+  BRLogInfo("TransformKernels benchmark, best level: " + std::string(simdLevelName(simdLevel())) + ", " + std::to_string(c_iterations) + " iterations.");
+  for (size_t count : { (size_t)1000, (size_t)10000, (size_t)100000 }) {
+    //Same instances in every store.
+    auto fill = [count](TransformStore& store) {
+      std::mt19937 engine(1234);
+      std::uniform_real_distribution<float> dist(-1, 1);
+      store.reserve(count);
+      for (size_t i = 0; i < count; ++i) {
+        BR2::vec3 pos(dist(engine) * 3, dist(engine) * 3, dist(engine) * 3);
+        BR2::vec3 axis(dist(engine), dist(engine), dist(engine));
+        axis.normalize();
+        float angle = dist(engine) * 6.28f;
+        store.create(pos, axis, angle, dist(engine) * 6.28f);
+      }
+    };
+
+    //Current path: three mat4 multiplies per instance.
+    TransformStore ref;
+    fill(ref);
+    std::vector<BR2::mat4> refMats(count);
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (int it = 0; it < c_iterations; ++it) {
+      for (size_t i = 0; i < count; ++i) {
+        ref.angle()[i] += ref.angularVelocity()[i] * c_dt;
+        refMats[i] = BR2::mat4::translation(origin) *
+                     BR2::mat4::rotation(ref.angle()[i], BR2::vec3(ref.axisX()[i], ref.axisY()[i], ref.axisZ()[i])) *
+                     BR2::mat4::translation(BR2::vec3(ref.posX()[i], ref.posY()[i], ref.posZ()[i]));
+      }
+    }
+    double refMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count() / c_iterations;
+    string_t line = "  " + std::to_string(count) + " instances: mat4 " + std::to_string(refMs) + "ms";
+
+    for (int il = 0; il <= (int)simdLevel(); ++il) {
+      SimdLevel level = (SimdLevel)il;
+      TransformStore st;
+      fill(st);
+      std::vector<InstanceUBOData> mats(count);
+      t0 = std::chrono::high_resolution_clock::now();
+      for (int it = 0; it < c_iterations; ++it) {
+        buildInstanceMatrices(st, 0, count, origin, c_dt, reinterpret_cast<float*>(mats.data()), level);
+      }
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count() / c_iterations;
+
+      //Same angles modulo 2pi, so the matrices should match.
+      float maxErr = 0;
+      for (size_t i = 0; i < count; ++i) {
+        const float* a = reinterpret_cast<const float*>(&mats[i].model);
+        const float* b = reinterpret_cast<const float*>(&refMats[i]);
+        for (int im = 0; im < 16; ++im) {
+          maxErr = std::max(maxErr, std::fabs(a[im] - b[im]));
+        }
+      }
+      line += ", " + std::string(simdLevelName(level)) + " " + std::to_string(ms) + "ms (" + std::to_string(refMs / std::max(ms, 0.000001)) + "x, err " + std::to_string(maxErr) + ")";
+    }
+    BRLogInfo(line);
+  }
+}
+
+#pragma endregion
+
+}  // namespace VG
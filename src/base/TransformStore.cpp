@@ -0,0 +1,318 @@
+#include "./TransformStore.h"
+#include <bitset>
+#include <cstring>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace VG {
+
+#pragma region DirtyBitset
+
+static inline uint32_t ctz64(uint64_t x) {
+#if defined(_MSC_VER)
+  unsigned long ret = 0;
+  _BitScanForward64(&ret, x);
+  return static_cast<uint32_t>(ret);
+#else
+  return static_cast<uint32_t>(__builtin_ctzll(x));
+#endif
+}
+void DirtyBitset::resize(size_t bits) {
+  _words.resize((bits + 63) / 64, 0);
+  _size = bits;
+  if (bits & 63) {
+    _words.back() &= ((uint64_t)1 << (bits & 63)) - 1;
+  }
+}
+void DirtyBitset::setRange(size_t begin, size_t end) {
+  AssertOrThrow2(end <= _size);
+  for (size_t i = begin; i < end;) {
+    size_t bit = i & 63;
+    size_t n = std::min((size_t)64 - bit, end - i);
+    uint64_t mask = (n == 64) ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1) << bit;
+    _words[i >> 6] |= mask;
+    i += n;
+  }
+}
+void DirtyBitset::resetRange(size_t begin, size_t end) {
+  AssertOrThrow2(end <= _size);
+  for (size_t i = begin; i < end;) {
+    size_t bit = i & 63;
+    size_t n = std::min((size_t)64 - bit, end - i);
+    uint64_t mask = (n == 64) ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1) << bit;
+    _words[i >> 6] &= ~mask;
+    i += n;
+  }
+}
+void DirtyBitset::clear() {
+  std::fill(_words.begin(), _words.end(), 0);
+}
+bool DirtyBitset::any() const {
+  for (auto w : _words) {
+    if (w != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+size_t DirtyBitset::count() const {
+  size_t ret = 0;
+  for (auto w : _words) {
+    ret += std::bitset<64>(w).count();
+  }
+  return ret;
+}
+size_t DirtyBitset::findNext(size_t i) const {
+  if (i >= _size) {
+    return _size;
+  }
+  size_t w = i >> 6;
+  uint64_t word = _words[w] & (~(uint64_t)0 << (i & 63));
+  while (word == 0) {
+    if (++w >= _words.size()) {
+      return _size;
+    }
+    word = _words[w];
+  }
+  return std::min(_size, w * 64 + ctz64(word));
+}
+void DirtyBitset::forEachRange(size_t begin, size_t end, const std::function<void(size_t begin, size_t end)>& func) const {
+  end = std::min(end, _size);
+  size_t i = begin;
+  while (i < end) {
+    //Next set bit. Clean words are skipped whole.
+    size_t w = i >> 6;
+    uint64_t word = _words[w] & (~(uint64_t)0 << (i & 63));
+    while (word == 0) {
+      if (++w * 64 >= end) {
+        return;
+      }
+      word = _words[w];
+    }
+    size_t start = w * 64 + ctz64(word);
+    if (start >= end) {
+      return;
+    }
+    //Next clear bit.
+    w = start >> 6;
+    word = ~_words[w] & (~(uint64_t)0 << (start & 63));
+    while (word == 0) {
+      if (++w * 64 >= end) {
+        break;
+      }
+      word = ~_words[w];
+    }
+    size_t stop = (word == 0) ? end : std::min(end, w * 64 + ctz64(word));
+    func(start, stop);
+    i = stop;
+  }
+}
+
+#pragma endregion
+
+#pragma region TransformStore
+
+TransformStore::TransformStore() {
+}
+TransformStore::~TransformStore() {
+  if (_block) {
+    ::operator delete(_block, std::align_val_t(c_alignment));
+    _block = nullptr;
+  }
+}
+void TransformStore::reserve(size_t capacity) {
+  if (capacity <= _capacity) {
+    return;
+  }
+  //Whole cache lines per column, so every column starts aligned and SIMD tails stay in the allocation.
+  const size_t c_floatsPerLine = c_alignment / sizeof(float);
+  capacity = (capacity + c_floatsPerLine - 1) / c_floatsPerLine * c_floatsPerLine;
+  size_t floats = capacity * (Column_Count + 16);
+  float* block = static_cast<float*>(::operator new(floats * sizeof(float), std::align_val_t(c_alignment)));
+  memset(block, 0, floats * sizeof(float));
+
+  for (int ic = 0; ic < Column_Count; ++ic) {
+    float* col = block + capacity * ic;
+    if (_count > 0) {
+      memcpy(col, _columns[ic], _count * sizeof(float));
+    }
+    _columns[ic] = col;
+  }
+  float* mats = block + capacity * Column_Count;
+  if (_count > 0) {
+    memcpy(mats, _matrices, _count * 16 * sizeof(float));
+  }
+  _matrices = mats;
+
+  if (_block) {
+    ::operator delete(_block, std::align_val_t(c_alignment));
+  }
+  _block = block;
+  _capacity = capacity;
+}
+void TransformStore::clear() {
+  for (auto& slot : _slots) {
+    if (slot._index != c_invalidIndex) {
+      slot._index = c_invalidIndex;
+      slot._generation++;
+      _freeSlots.push_back(static_cast<uint32_t>(&slot - _slots.data()));
+    }
+  }
+  _denseToSlot.clear();
+  _count = 0;
+  _animatedCount = 0;
+  _generation++;
+  resizeBitsets();
+}
+TransformHandle TransformStore::create(const BR2::vec3& pos, const BR2::vec3& axis, float angle, float angularVelocity) {
+  if (_count == _capacity) {
+    reserve(std::max(_capacity * 2, (size_t)64));
+  }
+  uint32_t slot = 0;
+  if (_freeSlots.size() > 0) {
+    slot = _freeSlots.back();
+    _freeSlots.pop_back();
+  }
+  else {
+    slot = static_cast<uint32_t>(_slots.size());
+    _slots.push_back(Slot());
+  }
+  size_t index = _count++;
+  _slots[slot]._index = static_cast<uint32_t>(index);
+  _denseToSlot.push_back(slot);
+
+  posX()[index] = pos.x;
+  posY()[index] = pos.y;
+  posZ()[index] = pos.z;
+  axisX()[index] = axis.x;
+  axisY()[index] = axis.y;
+  axisZ()[index] = axis.z;
+  this->angle()[index] = angle;
+  this->angularVelocity()[index] = 0;
+  resizeBitsets();
+  markChanged(index);
+
+  TransformHandle h;
+  h._slot = slot;
+  h._generation = _slots[slot]._generation;
+  setAngularVelocity(h, angularVelocity);
+  return h;
+}
+bool TransformStore::destroy(TransformHandle h) {
+  uint32_t index = indexOf(h);
+  if (index == c_invalidIndex) {
+    return false;
+  }
+  //Keep the animated range packed, then fill the hole with the last instance.
+  size_t i = index;
+  if (i < _animatedCount) {
+    swapInstances(i, _animatedCount - 1);
+    i = --_animatedCount;
+  }
+  swapInstances(i, _count - 1);
+
+  Slot& slot = _slots[h._slot];
+  slot._index = c_invalidIndex;
+  slot._generation++;
+  _freeSlots.push_back(h._slot);
+  _denseToSlot.pop_back();
+  _count--;
+  _generation++;
+  resizeBitsets();
+  return true;
+}
+uint32_t TransformStore::indexOf(TransformHandle h) const {
+  if (h._slot >= _slots.size() || _slots[h._slot]._generation != h._generation) {
+    return c_invalidIndex;
+  }
+  return _slots[h._slot]._index;
+}
+TransformHandle TransformStore::handleAt(size_t index) const {
+  TransformHandle h;
+  if (index < _count) {
+    h._slot = _denseToSlot[index];
+    h._generation = _slots[h._slot]._generation;
+  }
+  return h;
+}
+void TransformStore::setPosition(TransformHandle h, const BR2::vec3& pos) {
+  uint32_t index = indexOf(h);
+  AssertOrThrow2(index != c_invalidIndex);
+  posX()[index] = pos.x;
+  posY()[index] = pos.y;
+  posZ()[index] = pos.z;
+  markChanged(index);
+}
+void TransformStore::setRotation(TransformHandle h, const BR2::vec3& axis, float angle) {
+  uint32_t index = indexOf(h);
+  AssertOrThrow2(index != c_invalidIndex);
+  axisX()[index] = axis.x;
+  axisY()[index] = axis.y;
+  axisZ()[index] = axis.z;
+  this->angle()[index] = angle;
+  markChanged(index);
+}
+void TransformStore::setAngularVelocity(TransformHandle h, float angularVelocity) {
+  uint32_t index = indexOf(h);
+  AssertOrThrow2(index != c_invalidIndex);
+  this->angularVelocity()[index] = angularVelocity;
+  if (angularVelocity != 0 && index >= _animatedCount) {
+    swapInstances(index, _animatedCount++);
+  }
+  else if (angularVelocity == 0 && index < _animatedCount) {
+    swapInstances(index, --_animatedCount);
+  }
+}
+void TransformStore::swapInstances(size_t a, size_t b) {
+  if (a == b) {
+    return;
+  }
+  for (int ic = 0; ic < Column_Count; ++ic) {
+    std::swap(_columns[ic][a], _columns[ic][b]);
+  }
+  std::swap_ranges(_matrices + a * 16, _matrices + a * 16 + 16, _matrices + b * 16);
+  std::swap(_denseToSlot[a], _denseToSlot[b]);
+  _slots[_denseToSlot[a]]._index = static_cast<uint32_t>(a);
+  _slots[_denseToSlot[b]]._index = static_cast<uint32_t>(b);
+
+  //The cached matrices moved with their instance, but the GPU copies didn't.
+  bool staleA = _stale.test(a), staleB = _stale.test(b);
+  staleA ? _stale.set(b) : _stale.reset(b);
+  staleB ? _stale.set(a) : _stale.reset(a);
+  for (auto& dirty : _uploadDirty) {
+    dirty.set(a);
+    dirty.set(b);
+  }
+}
+void TransformStore::resizeBitsets() {
+  _stale.resize(_count);
+  for (auto& dirty : _uploadDirty) {
+    dirty.resize(_count);
+  }
+}
+void TransformStore::markChanged(size_t index) {
+  _stale.set(index);
+  _generation++;
+}
+void TransformStore::markAllChanged() {
+  _stale.setAll();
+  _generation++;
+}
+void TransformStore::matricesRebuilt(size_t begin, size_t end) {
+  _stale.resetRange(begin, end);
+  for (auto& dirty : _uploadDirty) {
+    dirty.setRange(begin, end);
+  }
+}
+void TransformStore::setUploadChannels(uint32_t channels) {
+  _uploadDirty.resize(channels);
+  for (auto& dirty : _uploadDirty) {
+    dirty.resize(_count);
+    dirty.setAll();
+  }
+}
+
+#pragma endregion
+
+}  // namespace VG
@@ -0,0 +1,150 @@
+/**
+*  @file TransformStore.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Data oriented instance transforms with stable handles and dirty tracking.
+*/
+#pragma once
+#ifndef __TRANSFORMSTORE_17923312605871529421633_H__
+#define __TRANSFORMSTORE_17923312605871529421633_H__
+
+#include "./SandboxHeader.h"
+
+namespace VG {
+
+/**
+ * @class DirtyBitset
+ * @brief One bit per item. Ranges of set bits are found a 64 bit word at a time.
+ * */
+class DirtyBitset {
+public:
+  void resize(size_t bits);  //Bits past the new size are cleared.
+  size_t size() const { return _size; }
+  void set(size_t i) { _words[i >> 6] |= (uint64_t)1 << (i & 63); }
+  void reset(size_t i) { _words[i >> 6] &= ~((uint64_t)1 << (i & 63)); }
+  bool test(size_t i) const { return (_words[i >> 6] >> (i & 63)) & 1; }
+  void setRange(size_t begin, size_t end);
+  void resetRange(size_t begin, size_t end);
+  void setAll() { setRange(0, _size); }
+  void clear();
+  bool any() const;
+  size_t count() const;
+  size_t findNext(size_t i) const;  //First set bit at or after i, or size().
+
+  //Calls func(begin, end) once per run of set bits in [begin, end).
+  void forEachRange(size_t begin, size_t end, const std::function<void(size_t begin, size_t end)>& func) const;
+  void forEachRange(const std::function<void(size_t begin, size_t end)>& func) const { forEachRange(0, _size, func); }
+
+private:
+  std::vector<uint64_t> _words;
+  size_t _size = 0;
+};
+/**
+ * @class TransformHandle
+ * @brief Stable reference to a TransformStore instance. Stale handles (destroyed instances) fail validation.
+ * */
+class TransformHandle {
+public:
+  static constexpr uint32_t c_invalid = 0xFFFFFFFF;
+  uint32_t _slot = c_invalid;
+  uint32_t _generation = 0;
+  bool operator==(const TransformHandle& rhs) const { return _slot == rhs._slot && _generation == rhs._generation; }
+  bool operator!=(const TransformHandle& rhs) const { return !(*this == rhs); }
+};
+/**
+ * @class TransformStore
+ * @brief Structure-of-arrays instance transforms with 64 byte aligned columns.
+ * @details Instances are dense: destroy() moves the last instance into the hole, so kernels stream [0, count()).
+ *          Animated instances (angular velocity != 0) are kept in front of static ones, so per frame animation
+ *          only touches [0, animatedCount()).
+ *          matrices() caches one column major mat4 per instance. Changed instances are marked stale (matrix needs a rebuild)
+ *          and, once rebuilt, dirty in every upload channel (e.g. one channel per swapchain frame).
+ * */
+class TransformStore {
+public:
+  static constexpr size_t c_alignment = 64;
+  static constexpr uint32_t c_invalidIndex = 0xFFFFFFFF;
+
+  TransformStore();
+  virtual ~TransformStore();
+  TransformStore(const TransformStore&) = delete;
+  TransformStore& operator=(const TransformStore&) = delete;
+
+  TransformHandle create(const BR2::vec3& pos, const BR2::vec3& axis, float angle, float angularVelocity);
+  bool destroy(TransformHandle h);
+  void clear();
+  void reserve(size_t capacity);
+
+  bool valid(TransformHandle h) const { return indexOf(h) != c_invalidIndex; }
+  uint32_t indexOf(TransformHandle h) const;  //Dense index, or c_invalidIndex.
+  TransformHandle handleAt(size_t index) const;
+  size_t count() const { return _count; }
+  size_t animatedCount() const { return _animatedCount; }
+  size_t capacity() const { return _capacity; }
+  uint64_t generation() const { return _generation; }  //Bumped by anything that can move an instance, for caches of e.g. bounds.
+
+  void setPosition(TransformHandle h, const BR2::vec3& pos);
+  void setRotation(TransformHandle h, const BR2::vec3& axis, float angle);
+  void setAngularVelocity(TransformHandle h, float angularVelocity);  //Moves the instance across the animated/static boundary.
+
+  //Columns. Writing through these doesn't mark anything, call markChanged().
+  float* posX() { return _columns[PosX]; }
+  float* posY() { return _columns[PosY]; }
+  float* posZ() { return _columns[PosZ]; }
+  float* axisX() { return _columns[AxisX]; }
+  float* axisY() { return _columns[AxisY]; }
+  float* axisZ() { return _columns[AxisZ]; }
+  float* angle() { return _columns[Angle]; }  //Radians
+  float* angularVelocity() { return _columns[AngularVelocity]; }  //Radians per second
+  float* matrices() { return _matrices; }  //16 floats per instance
+
+  void markChanged(size_t index);
+  void markAllChanged();
+  const DirtyBitset& staleMatrices() const { return _stale; }
+  void matricesRebuilt(size_t begin, size_t end);  //Clears stale and marks [begin, end) dirty in every upload channel.
+
+  void setUploadChannels(uint32_t channels);  //Everything starts dirty in new channels.
+  uint32_t uploadChannels() const { return static_cast<uint32_t>(_uploadDirty.size()); }
+  const DirtyBitset& uploadDirty(uint32_t channel) const { return _uploadDirty[channel]; }
+  void clearUploadDirty(uint32_t channel) { _uploadDirty[channel].clear(); }
+
+private:
+  enum Column {
+    PosX,
+    PosY,
+    PosZ,
+    AxisX,
+    AxisY,
+    AxisZ,
+    Angle,
+    AngularVelocity,
+    Column_Count
+  };
+  class Slot {
+  public:
+    uint32_t _index = c_invalidIndex;  //Dense index, c_invalidIndex if free.
+    uint32_t _generation = 0;
+  };
+
+  void swapInstances(size_t a, size_t b);
+  void resizeBitsets();
+
+  float* _block = nullptr;  //All columns and the matrices in one aligned allocation.
+  float* _columns[Column_Count] = {};
+  float* _matrices = nullptr;
+  size_t _count = 0;
+  size_t _animatedCount = 0;
+  size_t _capacity = 0;
+  uint64_t _generation = 0;
+
+  std::vector<Slot> _slots;
+  std::vector<uint32_t> _freeSlots;
+  std::vector<uint32_t> _denseToSlot;
+
+  DirtyBitset _stale;
+  std::vector<DirtyBitset> _uploadDirty;
+};
+
+}  // namespace VG
+
+#endif
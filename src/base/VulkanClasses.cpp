@@ -81,6 +81,16 @@ void VulkanDeviceBuffer::copy_to(void* dst_buf, size_t copy_count_items, size_t
   }
   vkUnmapMemory(vulkan()->device(), _bufferMemory);
 }
+void* VulkanDeviceBuffer::map() {
+  AssertOrThrow2(_isGpuBuffer == false);
+  void* gpu_data = nullptr;
+  CheckVKR(vkMapMemory, vulkan()->device(), _bufferMemory, 0, _byteSize, 0, &gpu_data);
+  return gpu_data;
+}
+void VulkanDeviceBuffer::unmap() {
+  AssertOrThrow2(_isGpuBuffer == false);
+  vkUnmapMemory(vulkan()->device(), _bufferMemory);
+}
 void VulkanDeviceBuffer::copy_device(VulkanDeviceBuffer* host_buf, size_t item_copyCount, size_t itemOffset_Host, size_t itemOffset_Gpu) {
   AssertOrThrow2(_isGpuBuffer == true);
   AssertOrThrow2(host_buf != nullptr);
@@ -136,6 +146,10 @@ VulkanBuffer::VulkanBuffer(Vulkan* dev, VulkanBufferType eType, bool bStaged, si
       BRLogWarn("Uniform buffer resides in GPU memory. This will cause a performance penalty if the buffer is updated often (per frame).");
     }
   }
+  else if (_eType == VulkanBufferType::StorageBuffer) {
+    //Also a uniform, vertex and indirect buffer, so compute output can feed existing uniform blocks, instance streams and indirect draws.
+    bufType = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+  }
   else {
     BRThrowException(Stz "Invalid buffer type '" + (int)_eType + "'.");
   }
@@ -180,6 +194,16 @@ void VulkanBuffer::writeData(void* items, size_t item_count, size_t item_offset)
     _hostBuffer->copy_from(items, item_count, 0, 0);
   }
 }
+void* VulkanBuffer::mapData() {
+  AssertOrThrow2(_bUseStagingBuffer == false);
+  AssertOrThrow2(_hostBuffer != nullptr);
+  return _hostBuffer->map();
+}
+void VulkanBuffer::unmapData() {
+  AssertOrThrow2(_bUseStagingBuffer == false);
+  AssertOrThrow2(_hostBuffer != nullptr);
+  _hostBuffer->unmap();
+}
 VulkanDeviceBuffer* VulkanBuffer::buffer() {
   if (_bUseStagingBuffer) {
     AssertOrThrow2(_gpuBuffer);
@@ -227,6 +251,7 @@ TextureImage::TextureImage(Vulkan* v, const string_t& name, TextureType type, MS
   createView();
   createSampler();
   generateMipmaps();
+  registerBindless();
 }
 TextureImage::TextureImage(Vulkan* v, const string_t& name, TextureType type, MSAA samples, const BR2::usize2& size,
                            VkFormat format, VkImage image, const FilterData& filter) : TextureImage(v, name, type, samples, filter) {
@@ -266,6 +291,7 @@ TextureImage::TextureImage(Vulkan* v, const string_t& name, TextureType type, MS
   createView();
   createSampler();
   generateMipmaps();
+  registerBindless();
 }
 TextureImage::~TextureImage() {
   cleanup();
@@ -299,6 +325,9 @@ bool TextureImage::computeTypeProperties() {
   else if (_type == TextureType::DepthAttachment) {
     _tiling = VK_IMAGE_TILING_OPTIMAL;
     _usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (_samples == MSAA::Disabled && isFeatureSupported(VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+      _usage |= VK_IMAGE_USAGE_SAMPLED_BIT;  //Read by compute after the pass, e.g. HiZPyramid.
+    }
     _properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     _aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
     _initialLayout = _currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -314,6 +343,13 @@ bool TextureImage::computeTypeProperties() {
 }
 void TextureImage::cleanup() {
   vulkan()->waitIdle();
+  if (_bindlessIndex != BindlessTextureTable::c_invalidIndex) {
+    //The device is idle, so the slot can be reused immediately.
+    if (vulkan()->bindlessTextures()) {
+      vulkan()->bindlessTextures()->unregisterTexture(_bindlessIndex);
+    }
+    _bindlessIndex = BindlessTextureTable::c_invalidIndex;
+  }
   if (_textureSampler != VK_NULL_HANDLE) {
     vkDestroySampler(vulkan()->device(), _textureSampler, nullptr);
   }
@@ -506,6 +542,16 @@ void TextureImage::createSampler() {
   };
   CheckVKR(vkCreateSampler, vulkan()->device(), &samplerInfo, nullptr, &_textureSampler);
 }
+void TextureImage::registerBindless() {
+  //Only single sampled textures with a sampler can be read in shaders.
+  if (vulkan()->bindlessTextures() == nullptr || _error) {
+    return;
+  }
+  if (_textureSampler == VK_NULL_HANDLE || _imageView == VK_NULL_HANDLE || _samples != MSAA::Disabled) {
+    return;
+  }
+  _bindlessIndex = vulkan()->bindlessTextures()->registerTexture(this);
+}
 bool TextureImage::isFeatureSupported(VkFormatFeatureFlagBits flag) {
   VkFormatProperties formatProperties;
   vkGetPhysicalDeviceFormatProperties(vulkan()->physicalDevice(), format(), &formatProperties);
@@ -990,6 +1036,10 @@ void CommandBuffer::begin() {
   };
   CheckVKR(vkBeginCommandBuffer, _commandBuffer, &beginInfo);
   _state = CommandBufferState::Begin;
+
+  //Nothing is bound in a new command buffer.
+  _boundGraphics = BoundDescriptorSets();
+  _boundCompute = BoundDescriptorSets();
 }
 void CommandBuffer::end() {
   validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::EndPass);
@@ -1123,6 +1173,80 @@ void CommandBuffer::imageTransferBarrier(VkImage image, VkAccessFlagBits srcAcce
                        0, nullptr,
                        1, &barrier);
 }
+void CommandBuffer::imageBarrier(VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                 VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess,
+                                 uint32_t baseMipLevel, uint32_t mipLevelCount) {
+  validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::EndPass);
+  VkImageMemoryBarrier barrier = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+    .pNext = nullptr,
+    .srcAccessMask = srcAccess,
+    .dstAccessMask = dstAccess,
+    .oldLayout = oldLayout,
+    .newLayout = newLayout,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .image = image,
+    .subresourceRange = {
+      .aspectMask = aspect,
+      .baseMipLevel = baseMipLevel,
+      .levelCount = mipLevelCount,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+    },
+  };
+  vkCmdPipelineBarrier(_commandBuffer,
+                       srcStage,
+                       dstStage,
+                       0,
+                       0, nullptr,
+                       0, nullptr,
+                       1, &barrier);
+}
+void CommandBuffer::bufferBarrier(VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+  //Barriers can't be recorded in a render pass without a subpass self dependency.
+  validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::EndPass);
+  VkBufferMemoryBarrier barrier = {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    .pNext = nullptr,
+    .srcAccessMask = srcAccess,
+    .dstAccessMask = dstAccess,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .buffer = buffer,
+    .offset = 0,
+    .size = VK_WHOLE_SIZE,
+  };
+  vkCmdPipelineBarrier(_commandBuffer,
+                       srcStage,
+                       dstStage,
+                       0,
+                       0, nullptr,
+                       1, &barrier,
+                       0, nullptr);
+}
+void CommandBuffer::dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) {
+  validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::EndPass);
+  vkCmdDispatch(_commandBuffer, groupsX, groupsY, groupsZ);
+}
+void CommandBuffer::resetQueryPool(VkQueryPool pool, uint32_t firstQuery, uint32_t queryCount) {
+  //Must be outside of a render pass.
+  validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::EndPass);
+  vkCmdResetQueryPool(_commandBuffer, pool, firstQuery, queryCount);
+}
+void CommandBuffer::writeTimestamp(VkPipelineStageFlagBits stage, VkQueryPool pool, uint32_t query) {
+  validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::BeginPass || _state == CommandBufferState::EndPass);
+  vkCmdWriteTimestamp(_commandBuffer, stage, pool, query);
+}
+void CommandBuffer::beginQuery(VkQueryPool pool, uint32_t query) {
+  //Begun outside of a render pass, so the query can span several passes.
+  validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::EndPass);
+  vkCmdBeginQuery(_commandBuffer, pool, query, 0);
+}
+void CommandBuffer::endQuery(VkQueryPool pool, uint32_t query) {
+  validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::EndPass);
+  vkCmdEndQuery(_commandBuffer, pool, query);
+}
 void CommandBuffer::copyBuffer(VkBuffer from, VkBuffer to, size_t count, size_t from_offset, size_t to_offset) {
   validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::BeginPass);
   VkBufferCopy copyRegion{
@@ -1170,7 +1294,7 @@ void CommandBuffer::copyImageToBuffer(std::shared_ptr<TextureImage> image, Vulka
 
   vkCmdCopyImageToBuffer(_commandBuffer, image->image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buf->getVkBuffer(), 1, &region);
 }
-void CommandBuffer::bindMesh(std::shared_ptr<Mesh> mesh) {
+void CommandBuffer::bindMesh(std::shared_ptr<Mesh> mesh, const std::vector<VulkanBuffer*>& instanceStreams) {
   validateState(_state == CommandBufferState::BeginPass);
   VulkanBuffer* verts = mesh->vertexBuffer();
   VulkanBuffer* indexes = mesh->indexBuffer();
@@ -1192,18 +1316,131 @@ void CommandBuffer::bindMesh(std::shared_ptr<Mesh> mesh) {
     BRThrowException("Invalid index type.");
   }
 
-  VkBuffer vertexBuffers[] = { verts->buffer()->getVkBuffer() };
-  VkDeviceSize offsets[] = { 0 };
-  vkCmdBindVertexBuffers(_commandBuffer, 0, 1, vertexBuffers, offsets);
+  AssertOrThrow2(instanceStreams.size() < c_maxVertexStreams);
+  VkBuffer vertexBuffers[c_maxVertexStreams] = { verts->buffer()->getVkBuffer() };
+  VkDeviceSize offsets[c_maxVertexStreams] = { 0 };
+  uint32_t streams = 1;
+  for (auto stream : instanceStreams) {
+    AssertOrThrow2(stream != nullptr);
+    AssertOrThrow2(stream->bufferType() == VulkanBufferType::VertexBuffer || stream->bufferType() == VulkanBufferType::StorageBuffer);
+    vertexBuffers[streams] = stream->buffer()->getVkBuffer();
+    offsets[streams] = 0;
+    streams++;
+  }
+  vkCmdBindVertexBuffers(_commandBuffer, 0, streams, vertexBuffers, offsets);
   vkCmdBindIndexBuffer(_commandBuffer, indexes->buffer()->getVkBuffer(), 0, vulkan_idxtype);
 
   _pBoundIndexes = indexes;  //Cleared at end of pass.
+  _boundIndexCount = mesh->indexCount();
+}
+void CommandBuffer::drawIndexed(uint32_t instanceCount, uint32_t firstInstance) {
+  validateState(_state == CommandBufferState::BeginPass);
+  AssertOrThrow2(_pBoundIndexes != nullptr && _pBoundIndexes->buffer() != nullptr);
+  vkCmdDrawIndexed(_commandBuffer, _boundIndexCount, instanceCount, 0, 0, firstInstance);
+}
+void CommandBuffer::drawIndexedIndirect(VulkanBuffer* indirect, VkDeviceSize offset, uint32_t drawCount, uint32_t stride) {
+  validateState(_state == CommandBufferState::BeginPass);
+  AssertOrThrow2(_pBoundIndexes != nullptr && _pBoundIndexes->buffer() != nullptr);
+  AssertOrThrow2(indirect != nullptr && indirect->bufferType() == VulkanBufferType::StorageBuffer);
+  AssertOrThrow2(offset % 4 == 0 && stride % 4 == 0 && stride >= sizeof(VkDrawIndexedIndirectCommand));
+  if (drawCount > 1 && !vulkan()->deviceFeatures().multiDrawIndirect) {
+    BRLogErrorCycle("Indirect draw count " + std::to_string(drawCount) + " requires the multiDrawIndirect feature.");
+    return;
+  }
+  if (drawCount > vulkan()->deviceLimits().maxDrawIndirectCount) {
+    BRLogErrorCycle("Indirect draw count " + std::to_string(drawCount) + " exceeded maxDrawIndirectCount.");
+    return;
+  }
+  if (drawCount > 0 && offset + (VkDeviceSize)(drawCount - 1) * stride + sizeof(VkDrawIndexedIndirectCommand) > indirect->buffer()->totalSizeBytes()) {
+    BRLogErrorCycle("Indirect draws overran the indirect buffer.");
+    return;
+  }
+  vkCmdDrawIndexedIndirect(_commandBuffer, indirect->buffer()->getVkBuffer(), offset, drawCount, stride);
+}
+uint32_t CommandBuffer::drawIndexedBatch(VulkanBuffer* indirect, const std::vector<VkDrawIndexedIndirectCommand>& draws) {
+  //One indirect draw. Without multiDrawIndirect, or drawIndirectFirstInstance when an instance range doesn't start at 0,
+  // the same commands are drawn one at a time.
+  validateState(_state == CommandBufferState::BeginPass);
+  AssertOrThrow2(_pBoundIndexes != nullptr && _pBoundIndexes->buffer() != nullptr);
+  if (draws.size() == 0) {
+    return 0;
+  }
+  auto& features = vulkan()->deviceFeatures();
+  bool firstInstances = std::any_of(draws.begin(), draws.end(), [](const VkDrawIndexedIndirectCommand& d) { return d.firstInstance != 0; });
+  if (indirect != nullptr &&
+      (draws.size() == 1 || features.multiDrawIndirect) &&
+      (!firstInstances || features.drawIndirectFirstInstance) &&
+      draws.size() <= vulkan()->deviceLimits().maxDrawIndirectCount) {
+    drawIndexedIndirect(indirect, 0, static_cast<uint32_t>(draws.size()));
+    return 1;
+  }
+  for (auto& d : draws) {
+    vkCmdDrawIndexed(_commandBuffer, d.indexCount, d.instanceCount, d.firstIndex, d.vertexOffset, d.firstInstance);
+  }
+  return static_cast<uint32_t>(draws.size());
 }
-void CommandBuffer::drawIndexed(uint32_t instanceCount) {
+void CommandBuffer::drawIndexedIndirectCount(VulkanBuffer* indirect, VkDeviceSize offset, VulkanBuffer* countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride) {
   validateState(_state == CommandBufferState::BeginPass);
   AssertOrThrow2(_pBoundIndexes != nullptr && _pBoundIndexes->buffer() != nullptr);
-  uint32_t ind_count = static_cast<uint32_t>(_pBoundIndexes->buffer()->itemCount());
-  vkCmdDrawIndexed(_commandBuffer, ind_count, instanceCount, 0, 0, 0);
+  AssertOrThrow2(indirect != nullptr && indirect->bufferType() == VulkanBufferType::StorageBuffer);
+  AssertOrThrow2(countBuffer != nullptr && countBuffer->bufferType() == VulkanBufferType::StorageBuffer);
+  AssertOrThrow2(offset % 4 == 0 && countOffset % 4 == 0 && stride % 4 == 0 && stride >= sizeof(VkDrawIndexedIndirectCommand));
+  if (!vulkan()->drawIndirectCountSupported()) {
+    BRLogErrorCycle("drawIndexedIndirectCount requires VK_KHR_draw_indirect_count.");
+    return;
+  }
+  if (maxDrawCount > 0 && offset + (VkDeviceSize)(maxDrawCount - 1) * stride + sizeof(VkDrawIndexedIndirectCommand) > indirect->buffer()->totalSizeBytes()) {
+    BRLogErrorCycle("Indirect draws overran the indirect buffer.");
+    return;
+  }
+  vulkan()->vkCmdDrawIndexedIndirectCountKHR(_commandBuffer, indirect->buffer()->getVkBuffer(), offset,
+                                             countBuffer->buffer()->getVkBuffer(), countOffset, maxDrawCount, stride);
+}
+void CommandBuffer::pushConstants(Pipeline* pipe, uint32_t offset, uint32_t size, const void* data) {
+  validateState(_state == CommandBufferState::Begin || _state == CommandBufferState::BeginPass || _state == CommandBufferState::EndPass);
+  AssertOrThrow2(pipe != nullptr && data != nullptr);
+  //The stage flags must include every stage whose range overlaps the update.
+  VkShaderStageFlags stages = pipe->pushConstantStages(offset, size);
+  if (stages == 0) {
+    BRLogErrorCycle("Push constant update [" + std::to_string(offset) + "," + std::to_string(offset + size) + ") is outside of the pipeline's push constant ranges.");
+    return;
+  }
+  vkCmdPushConstants(_commandBuffer, pipe->getVkPipelineLayout(), stages, offset, size, data);
+}
+bool CommandBuffer::bindDescriptorSet(Pipeline* pipe, uint32_t set, VkDescriptorSet descriptorSet) {
+  //Binds the set unless it's already bound with a compatible layout. Returns true if the set was bound.
+  //https://www.khronos.org/registry/vulkan/specs/1.2-extensions/html/vkspec.html#descriptorsets-compatibility
+  auto rangeEq = [](const VkPushConstantRange& a, const VkPushConstantRange& b) {
+    return a.stageFlags == b.stageFlags && a.offset == b.offset && a.size == b.size;
+  };
+  auto& layouts = pipe->setLayouts();
+  if (set >= layouts.size()) {
+    BRLogErrorCycle("Descriptor set " + std::to_string(set) + " is not in the pipeline layout.");
+    return false;
+  }
+
+  //Sets stay bound up to the first set layout that differs. Different push constant ranges disturb all of them.
+  BoundDescriptorSets& bound = (pipe->bindPoint() == VK_PIPELINE_BIND_POINT_COMPUTE) ? _boundCompute : _boundGraphics;
+  size_t compatible = 0;
+  if (std::equal(bound._pushConstantRanges.begin(), bound._pushConstantRanges.end(),
+                 pipe->pushConstantRanges().begin(), pipe->pushConstantRanges().end(), rangeEq)) {
+    while (compatible < bound._setLayouts.size() && compatible < layouts.size() && bound._setLayouts[compatible] == layouts[compatible]) {
+      compatible++;
+    }
+  }
+  bound._sets.resize(std::min(bound._sets.size(), compatible));
+  bound._sets.resize(layouts.size(), VK_NULL_HANDLE);
+  bound._setLayouts = layouts;
+  bound._pushConstantRanges = pipe->pushConstantRanges();
+
+  if (bound._sets[set] == descriptorSet) {
+    _descriptorSetBindsSkipped++;
+    return false;
+  }
+  vkCmdBindDescriptorSets(_commandBuffer, pipe->bindPoint(), pipe->getVkPipelineLayout(), set, 1, &descriptorSet, 0, nullptr);
+  bound._sets[set] = descriptorSet;
+  _descriptorSetBinds++;
+  return true;
 }
 
 #pragma endregion
@@ -1216,6 +1453,10 @@ public:
   VkShaderModule _vkShaderModule = nullptr;
   SpvReflectShaderModule* _spvReflectModule = nullptr;
   string_t _baseName = "*unset*";
+  std::vector<std::unique_ptr<SpecConstant>> _specConstants;
+  std::vector<VkSpecializationMapEntry> _specEntries;
+  std::vector<uint32_t> _specData;
+  VkSpecializationInfo _specInfo = {};
 
   ShaderModule_Internal(Vulkan* pv) : VulkanObject(pv) {
   }
@@ -1234,20 +1475,147 @@ public:
       BRLogWarn("Shader was initialized when creating new shader.");
       vkDestroyShaderModule(vulkan()->device(), _vkShaderModule, nullptr);
     }
-    VkShaderModuleCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-    BRLogInfo("Creating shader : " + code.size() + " bytes.");
-    CheckVKR(vkCreateShaderModule, vulkan()->device(), &createInfo, nullptr, &_vkShaderModule);
-
     //Get Metadata
     _spvReflectModule = (SpvReflectShaderModule*)malloc(sizeof(SpvReflectShaderModule));
     SpvReflectResult result = spvReflectCreateShaderModule(code.size(), code.data(), _spvReflectModule);
     if (result != SPV_REFLECT_RESULT_SUCCESS) {
       BRThrowException("Spv-Reflect failed to parse shader.");
     }
+    assignDescriptorSets();
+
+    //The code may have been patched by assignDescriptorSets
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = spvReflectGetCodeSize(_spvReflectModule);
+    createInfo.pCode = spvReflectGetCode(_spvReflectModule);
+
+    BRLogInfo("Creating shader : " + std::to_string(createInfo.codeSize) + " bytes.");
+    CheckVKR(vkCreateShaderModule, vulkan()->device(), &createInfo, nullptr, &_vkShaderModule);
+
+    reflectSpecConstants(code);
+    updateSpecializationInfo();
+  }
+  void assignDescriptorSets() {
+    //Descriptors left in set 0 are moved to a set by their update frequency (PipelineShader::classifyDescriptorSet).
+    //Descriptors with an explicit layout(set = N > 0) keep it.
+    std::vector<std::pair<string_t, uint32_t>> moves;
+    for (uint32_t idb = 0; idb < _spvReflectModule->descriptor_binding_count; idb++) {
+      auto& binding = _spvReflectModule->descriptor_bindings[idb];
+      if (binding.set != 0 || binding.name == nullptr) {
+        continue;
+      }
+      bool isSampler = (binding.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+      uint32_t set = static_cast<uint32_t>(PipelineShader::classifyDescriptorSet(string_t(binding.name), isSampler));
+      if (set != 0) {
+        moves.push_back(std::make_pair(string_t(binding.name), set));
+      }
+    }
+    //Changing a set invalidates the binding pointers, so look each one up again.
+    for (auto& move : moves) {
+      for (uint32_t idb = 0; idb < _spvReflectModule->descriptor_binding_count; idb++) {
+        auto& binding = _spvReflectModule->descriptor_bindings[idb];
+        if (binding.name && StringUtil::equals(string_t(binding.name), move.first)) {
+          SpvReflectResult result = spvReflectChangeDescriptorBindingNumbers(_spvReflectModule, &binding, SPV_REFLECT_BINDING_NUMBER_DONT_CHANGE, move.second);
+          if (result != SPV_REFLECT_RESULT_SUCCESS) {
+            BRLogError("Failed to move descriptor '" + move.first + "' to set " + std::to_string(move.second) + " in shader '" + _name + "'.");
+          }
+          break;
+        }
+      }
+    }
+  }
+  void reflectSpecConstants(const std::vector<char>& code) {
+    //SPIRV-Reflect doesn't reflect specialization constants, so we parse the few opcodes we need here.
+    //https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#_a_id_physical_a_physical_layout_of_a_spir_v_module_and_instruction
+    const uint32_t OpName = 5, OpTypeBool = 20, OpTypeInt = 21, OpTypeFloat = 22;
+    const uint32_t OpSpecConstantTrue = 48, OpSpecConstantFalse = 49, OpSpecConstant = 50;
+    const uint32_t OpDecorate = 71, DecorationSpecId = 1;
+
+    _specConstants.clear();
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(code.data());
+    size_t wordCount = code.size() / sizeof(uint32_t);
+    if (wordCount < 5) {
+      return;
+    }
+    std::unordered_map<uint32_t, string_t> names;
+    std::unordered_map<uint32_t, uint32_t> specIds;
+    std::unordered_map<uint32_t, SpecConstantType> types;
+    std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> constants;  //Type, Id, Value
+
+    for (size_t iw = 5; iw < wordCount;) {
+      uint32_t opcode = words[iw] & 0xFFFF;
+      uint32_t count = words[iw] >> 16;
+      if (count == 0 || iw + count > wordCount) {
+        BRLogError("Invalid SPIR-V instruction parsing specialization constants.");
+        return;
+      }
+      const uint32_t* op = words + iw;
+      if (opcode == OpName && count > 2) {
+        names[op[1]] = string_t(reinterpret_cast<const char*>(op + 2));
+      }
+      else if (opcode == OpDecorate && count > 3 && op[2] == DecorationSpecId) {
+        specIds[op[1]] = op[3];
+      }
+      else if (opcode == OpTypeBool) {
+        types[op[1]] = SpecConstantType::Bool;
+      }
+      else if (opcode == OpTypeInt && op[2] == 32) {
+        types[op[1]] = op[3] ? SpecConstantType::Int : SpecConstantType::UInt;
+      }
+      else if (opcode == OpTypeFloat && op[2] == 32) {
+        types[op[1]] = SpecConstantType::Float;
+      }
+      else if (opcode == OpSpecConstantTrue || opcode == OpSpecConstantFalse) {
+        constants.push_back({ op[1], op[2], (opcode == OpSpecConstantTrue) ? 1u : 0u });
+      }
+      else if (opcode == OpSpecConstant && count == 4) {
+        constants.push_back({ op[1], op[2], op[3] });
+      }
+      else if (opcode == OpSpecConstant) {
+        BRLogWarn("64 bit specialization constants are not supported.");
+      }
+      iw += count;
+    }
+
+    for (auto& c : constants) {
+      uint32_t typeId = std::get<0>(c);
+      uint32_t id = std::get<1>(c);
+      auto specId = specIds.find(id);
+      if (specId == specIds.end()) {
+        continue;  //OpSpecConstantOp intermediates, etc.
+      }
+      auto type = types.find(typeId);
+      if (type == types.end()) {
+        BRLogWarn("Unsupported type for specialization constant '" + names[id] + "'.");
+        continue;
+      }
+      auto sc = std::make_unique<SpecConstant>();
+      sc->_name = names[id];
+      sc->_constantId = specId->second;
+      sc->_type = type->second;
+      sc->_defaultValue = std::get<2>(c);
+      sc->_value = sc->_defaultValue;
+      _specConstants.push_back(std::move(sc));
+    }
+  }
+  void updateSpecializationInfo() {
+    //All constants are 32 bits (VkBool32 for bool)
+    _specEntries.clear();
+    _specData.clear();
+    for (auto& sc : _specConstants) {
+      _specEntries.push_back({
+        .constantID = sc->_constantId,
+        .offset = static_cast<uint32_t>(_specData.size() * sizeof(uint32_t)),
+        .size = sizeof(uint32_t),
+      });
+      _specData.push_back(sc->_value);
+    }
+    _specInfo = {
+      .mapEntryCount = static_cast<uint32_t>(_specEntries.size()),
+      .pMapEntries = _specEntries.data(),
+      .dataSize = _specData.size() * sizeof(uint32_t),
+      .pData = _specData.data(),
+    };
   }
   VkPipelineShaderStageCreateInfo getPipelineStageCreateInfo() {
     VkShaderStageFlagBits type;
@@ -1261,6 +1629,9 @@ public:
     else if (_spvReflectModule->shader_stage & SPV_REFLECT_SHADER_STAGE_GEOMETRY_BIT) {
       type = VK_SHADER_STAGE_GEOMETRY_BIT;
     }
+    else if (_spvReflectModule->shader_stage & SPV_REFLECT_SHADER_STAGE_COMPUTE_BIT) {
+      type = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
 
     VkPipelineShaderStageCreateInfo stage = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -1269,7 +1640,7 @@ public:
       .stage = type,
       .module = _vkShaderModule,
       .pName = _spvReflectModule->entry_point_name,
-      .pSpecializationInfo = nullptr,
+      .pSpecializationInfo = _specConstants.size() ? &_specInfo : nullptr,
     };
     return stage;
   }
@@ -1289,6 +1660,20 @@ VkPipelineShaderStageCreateInfo ShaderModule::getPipelineStageCreateInfo() {
 const string_t& ShaderModule::name() {
   return _pInt->_name;
 }
+const std::vector<std::unique_ptr<SpecConstant>>& ShaderModule::specConstants() {
+  return _pInt->_specConstants;
+}
+SpecConstant* ShaderModule::getSpecConstant(const string_t& name) {
+  for (auto& sc : _pInt->_specConstants) {
+    if (StringUtil::equals(sc->_name, name)) {
+      return sc.get();
+    }
+  }
+  return nullptr;
+}
+void ShaderModule::updateSpecializationInfo() {
+  _pInt->updateSpecializationInfo();
+}
 
 #pragma endregion
 
@@ -1507,6 +1892,34 @@ bool PassDescription::hasDepthBuffer() {
   }
   return false;
 }
+PipelineOutputState PassDescription::pipelineState() {
+  PipelineOutputState state;
+  state._blendMode = _blendMode;
+  state._globalBlend = _globalBlend;
+  for (auto& output : _outputs) {
+    state._outputs.push_back({ output->_type, output->_output, output->_blending, output->_compareOp });
+  }
+  return state;
+}
+size_t PipelineOutputState::hash() const {
+  size_t seed = 0;
+  HashUtils::combine(seed, (int)_blendMode);
+  HashUtils::combine(seed, (int)_globalBlend);
+  for (auto& output : _outputs) {
+    HashUtils::combine(seed, (int)output._type);
+    HashUtils::combine(seed, (int)output._output);
+    HashUtils::combine(seed, (int)output._blending);
+    HashUtils::combine(seed, (int)output._compareOp);
+  }
+  return seed;
+}
+bool PipelineOutputState::equals(const PipelineOutputState& rhs) const {
+  auto outEq = [](const Output& a, const Output& b) {
+    return a._type == b._type && a._output == b._output && a._blending == b._blending && a._compareOp == b._compareOp;
+  };
+  return _blendMode == rhs._blendMode && _globalBlend == rhs._globalBlend &&
+         std::equal(_outputs.begin(), _outputs.end(), rhs._outputs.begin(), rhs._outputs.end(), outEq);
+}
 
 #pragma endregion
 
@@ -1630,7 +2043,7 @@ Framebuffer::Framebuffer(Vulkan* v) : VulkanObject(v) {
 }
 Framebuffer::~Framebuffer() {
   _attachments.clear();
-  vkDestroyRenderPass(vulkan()->device(), _renderPass, nullptr);
+  //_renderPass is owned by the PipelineCache
   vkDestroyFramebuffer(vulkan()->device(), _framebuffer, nullptr);
 }
 bool Framebuffer::pipelineError(const string_t& msg) {
@@ -1732,10 +2145,11 @@ bool Framebuffer::createRenderPass(RenderFrame* frame, Framebuffer* fbo) {
   //using subpassLoad you can read previous subpass values. This is more efficient than the old approach.
   //https://www.saschawillems.de/blog/2018/07/19/vulkan-input-attachments-and-sub-passes/
   //https://github.com/KhronosGroup/GLSL/blob/master/extensions/khr/GL_KHR_vulkan_glsl.txt
-  std::vector<VkAttachmentDescription> attachments;
-  std::vector<VkAttachmentReference> colorAttachmentRefs;
-  std::vector<VkAttachmentReference> resolveAttachmentRefs;
-  std::vector<VkAttachmentReference> depthAttachmentRefs;
+  _renderPassKey = RenderPassKey();
+  std::vector<VkAttachmentDescription>& attachments = _renderPassKey._attachments;
+  std::vector<VkAttachmentReference>& colorAttachmentRefs = _renderPassKey._colorRefs;
+  std::vector<VkAttachmentReference>& resolveAttachmentRefs = _renderPassKey._resolveRefs;
+  std::vector<VkAttachmentReference>& depthAttachmentRefs = _renderPassKey._depthRefs;
 
   for (size_t iatt = 0; iatt < _attachments.size(); ++iatt) {
     auto att = _attachments[iatt].get();
@@ -1743,9 +2157,13 @@ bool Framebuffer::createRenderPass(RenderFrame* frame, Framebuffer* fbo) {
     AssertOrThrow2(att != nullptr);
     AssertOrThrow2(att->desc() != nullptr);
     //Load or Clear the image
+    //A loaded attachment is still in the final layout of the pass that wrote it.
     VkAttachmentLoadOp loadOp;
+    VkImageLayout colorInitialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkImageLayout depthInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     if (att->desc()->_clear == false) {
       loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+      colorInitialLayout = depthInitialLayout = att->finalLayout();
     }
     else {
       loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -1771,7 +2189,7 @@ bool Framebuffer::createRenderPass(RenderFrame* frame, Framebuffer* fbo) {
         .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,  // VK_IMAGE_LAYOUT_UNDEFINED,
+        .initialLayout = colorInitialLayout,
         .finalLayout = att->finalLayout(),
       });
       if (att->desc()->_resolve) {
@@ -1796,10 +2214,10 @@ bool Framebuffer::createRenderPass(RenderFrame* frame, Framebuffer* fbo) {
         .format = att->target()->format(),
         .samples = sample_flags,
         .loadOp = loadOp,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,  //Kept for later passes that load it, and for HiZPyramid.
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .initialLayout = depthInitialLayout,
         .finalLayout = att->finalLayout(),  //** This needs to be changed for Deferred MRTs
       });
       depthAttachmentRefs.push_back({
@@ -1819,31 +2237,12 @@ bool Framebuffer::createRenderPass(RenderFrame* frame, Framebuffer* fbo) {
     }
   }
 
-  //TODO: implement "pixel local load operations" for deferred FBOs.
-  VkSubpassDescription subpass = {
-    .flags = 0,
-    .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-    .inputAttachmentCount = 0,
-    .pInputAttachments = nullptr,
-    .colorAttachmentCount = static_cast<uint32_t>(colorAttachmentRefs.size()),
-    .pColorAttachments = colorAttachmentRefs.data(),
-    .pResolveAttachments = resolveAttachmentRefs.data(),
-    .pDepthStencilAttachment = depthAttachmentRefs.data(),
-    .preserveAttachmentCount = 0,
-    .pPreserveAttachments = nullptr,
-  };
-  VkRenderPassCreateInfo renderPassInfo = {
-    .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-    .pNext = nullptr,
-    .flags = 0,
-    .attachmentCount = static_cast<uint32_t>(attachments.size()),
-    .pAttachments = attachments.data(),
-    .subpassCount = 1,
-    .pSubpasses = &subpass,
-    .dependencyCount = 0,
-    .pDependencies = nullptr,
-  };
-  CheckVKR(vkCreateRenderPass, vulkan()->device(), &renderPassInfo, nullptr, &_renderPass);
+  //Every frame creates the same pass, share it.
+  _renderPassHash = _renderPassKey.compatibleHash();
+  _renderPass = vulkan()->pipelineCache()->getRenderPass(_renderPassKey);
+  if (_renderPass == VK_NULL_HANDLE) {
+    return pipelineError("Failed to get render pass from the pipeline cache.");
+  }
 
   return true;
 }
@@ -2001,14 +2400,25 @@ MSAA Framebuffer::sampleCount() {
 
 #pragma region Pipeline
 
-Pipeline::Pipeline(Vulkan* v, VkPrimitiveTopology topo, VkPolygonMode mode, VkCullModeFlags cullmode) : VulkanObject(v) {
-  _primitiveTopology = topo;
-  _polygonMode = mode;
-  _cullMode = cullmode;
+Pipeline::Pipeline(Vulkan* v, const PipelineKey& key) : VulkanObject(v) {
+  _key = key;
 }
 Pipeline::~Pipeline() {
+  //_pipelineLayout is owned by the PipelineCache
   vkDestroyPipeline(vulkan()->device(), _pipeline, nullptr);
-  vkDestroyPipelineLayout(vulkan()->device(), _pipelineLayout, nullptr);
+}
+VkShaderStageFlags Pipeline::pushConstantStages(uint32_t offset, uint32_t size) {
+  VkShaderStageFlags stages = 0;
+  for (auto& range : _pushConstantRanges) {
+    if (offset < range.offset + range.size && range.offset < offset + size) {
+      if (offset < range.offset || offset + size > range.offset + range.size) {
+        //Update must be entirely within each overlapping range.
+        return 0;
+      }
+      stages |= range.stageFlags;
+    }
+  }
+  return stages;
 }
 VkPipelineColorBlendAttachmentState Pipeline::getVkPipelineColorBlendAttachmentState(BlendFunc bf, Framebuffer* fb) {
   VkPipelineColorBlendAttachmentState cba{};
@@ -2032,8 +2442,6 @@ VkPipelineColorBlendAttachmentState Pipeline::getVkPipelineColorBlendAttachmentS
   return cba;
 }
 bool Pipeline::init(PipelineShader* shader, std::shared_ptr<BR2::VertexFormat> vtxFormat, Framebuffer* pfbo) {
-  _fbo = pfbo;
-
   if (pfbo->passDescription() == nullptr) {
     return pfbo->pipelineError("Pass description was null in Pipeline::init");
   }
@@ -2042,17 +2450,12 @@ bool Pipeline::init(PipelineShader* shader, std::shared_ptr<BR2::VertexFormat> v
   }
 
   //Pipeline Layout
-  auto descriptorLayout = shader->getVkDescriptorSetLayout();
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
-    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-    //These are the getVkBuffer descriptors
-    .setLayoutCount = 1,
-    .pSetLayouts = &descriptorLayout,
-    //Constants to pass to shaders.
-    .pushConstantRangeCount = 0,
-    .pPushConstantRanges = nullptr
-  };
-  CheckVKR(vkCreatePipelineLayout, vulkan()->device(), &pipelineLayoutInfo, nullptr, &_pipelineLayout);
+  _pushConstantRanges = shader->pushConstantRanges();
+  _setLayouts = shader->getVkDescriptorSetLayouts();
+  _pipelineLayout = vulkan()->pipelineCache()->getPipelineLayout(_setLayouts, _pushConstantRanges);
+  if (_pipelineLayout == VK_NULL_HANDLE) {
+    return pfbo->pipelineError("Failed to get pipeline layout in Pipeline::init");
+  }
 
   //Blending
   bool independentBlend = (vulkan()->deviceFeatures().independentBlend == VK_TRUE);
@@ -2100,7 +2503,7 @@ bool Pipeline::init(PipelineShader* shader, std::shared_ptr<BR2::VertexFormat> v
     .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
     .pNext = nullptr,
     .flags = 0,
-    .topology = _primitiveTopology,
+    .topology = _key._topology,
     .primitiveRestartEnable = VK_FALSE,
   };
 
@@ -2177,8 +2580,8 @@ bool Pipeline::init(PipelineShader* shader, std::shared_ptr<BR2::VertexFormat> v
     .flags = 0,
     .depthClampEnable = VK_FALSE,
     .rasterizerDiscardEnable = VK_FALSE,
-    .polygonMode = _polygonMode,
-    .cullMode = _cullMode,
+    .polygonMode = _key._polygonMode,
+    .cullMode = _key._cullMode,
     .frontFace = VK_FRONT_FACE_CLOCKWISE,
     .depthBiasEnable = VK_FALSE,
     .depthBiasConstantFactor = 0,
@@ -2245,83 +2648,836 @@ bool Pipeline::init(PipelineShader* shader, std::shared_ptr<BR2::VertexFormat> v
     .pColorBlendState = &colorBlending,
     .pDynamicState = &dynamicState,
     .layout = _pipelineLayout,
-    .renderPass = _fbo->getVkRenderPass(),
+    .renderPass = pfbo->getVkRenderPass(),  //Any compatible pass.
     .subpass = 0,
     .basePipelineHandle = VK_NULL_HANDLE,
     .basePipelineIndex = -1,
   };
 
-  CheckVKR(vkCreateGraphicsPipelines, vulkan()->device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_pipeline);
+  CheckVKR(vkCreateGraphicsPipelines, vulkan()->device(), vulkan()->pipelineCache()->getVkPipelineCache(), 1, &pipelineInfo, nullptr, &_pipeline);
 
   return true;
 }
+bool Pipeline::initCompute(PipelineShader* shader) {
+  _bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
 
-#pragma endregion
-
-#pragma region PipelineShader
+  _pushConstantRanges = shader->pushConstantRanges();
+  _setLayouts = shader->getVkDescriptorSetLayouts();
+  _pipelineLayout = vulkan()->pipelineCache()->getPipelineLayout(_setLayouts, _pushConstantRanges);
+  if (_pipelineLayout == VK_NULL_HANDLE) {
+    return shader->shaderError("Failed to get pipeline layout in Pipeline::initCompute");
+  }
 
-std::unique_ptr<PipelineShader> PipelineShader::create(Vulkan* v, const string_t& name, const std::vector<string_t>& files) {
-  auto s = std::make_unique<PipelineShader>(v, name, files);
-  s->init();
-  s->vulkan()->swapchain()->registerShader(s.get());
-  return s;
-}
-PipelineShader::PipelineShader(Vulkan* v, const string_t& name, const std::vector<string_t>& files) : VulkanObject(v) {
-  _name = name;
-  _files = files;
-}
-PipelineShader::~PipelineShader() {
-  //This could be an error since vulkan is no longer an SP.
-  //Perhaps make vulkan an SP
-  //There are really 2 ways of doing this. weak_ptr is less efficient but less error prone.
-  if (vulkan() && vulkan()->swapchain()) {
-    vulkan()->swapchain()->unregisterShader(this);
+  std::vector<VkPipelineShaderStageCreateInfo> shaderStages = shader->getShaderStageCreateInfos();
+  if (shaderStages.size() != 1) {
+    return shader->shaderError("Compute pipelines take exactly one shader stage, got " + std::to_string(shaderStages.size()) + ".");
   }
-  cleanupDescriptors();
-  _modules.clear();
+  VkComputePipelineCreateInfo pipelineInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .stage = shaderStages[0],
+    .layout = _pipelineLayout,
+    .basePipelineHandle = VK_NULL_HANDLE,
+    .basePipelineIndex = -1,
+  };
+  CheckVKR(vkCreateComputePipelines, vulkan()->device(), vulkan()->pipelineCache()->getVkPipelineCache(), 1, &pipelineInfo, nullptr, &_pipeline);
+
+  return true;
 }
-bool PipelineShader::init() {
-  for (auto& str : _files) {
-    auto mod = std::make_unique<ShaderModule>(vulkan(), _name, str);
-    _modules.push_back(std::move(mod));
-  }
-  if (!checkGood()) {
-    return false;
-  }
-  if (!createInputs()) {
-    return false;
+
+#pragma endregion
+
+#pragma region PipelineCache
+
+size_t RenderPassKey::compatibleHash() const {
+  //https://www.khronos.org/registry/vulkan/specs/1.2-extensions/html/vkspec.html#renderpass-compatibility
+  size_t seed = 0;
+  HashUtils::combine(seed, _attachments.size());
+  for (auto& a : _attachments) {
+    HashUtils::combine(seed, a.format);
+    HashUtils::combine(seed, a.samples);
   }
-  if (!createOutputs()) {
-    return false;
+  for (auto refs : { &_colorRefs, &_resolveRefs, &_depthRefs }) {
+    HashUtils::combine(seed, refs->size());
+    for (auto& r : *refs) {
+      HashUtils::combine(seed, r.attachment);
+    }
   }
-  if (!createDescriptors()) {
-    return false;
+  return seed;
+}
+size_t RenderPassKey::exactHash() const {
+  size_t seed = compatibleHash();
+  for (auto& a : _attachments) {
+    HashUtils::combine(seed, a.loadOp);
+    HashUtils::combine(seed, a.storeOp);
+    HashUtils::combine(seed, a.stencilLoadOp);
+    HashUtils::combine(seed, a.stencilStoreOp);
+    HashUtils::combine(seed, a.initialLayout);
+    HashUtils::combine(seed, a.finalLayout);
+  }
+  for (auto refs : { &_colorRefs, &_resolveRefs, &_depthRefs }) {
+    for (auto& r : *refs) {
+      HashUtils::combine(seed, r.layout);
+    }
   }
-  return true;
+  return seed;
 }
-ShaderModule* PipelineShader::getModule(ShaderStage stage, bool throwIfNotFound) {
-  ShaderModule* mod = nullptr;
-  for (auto& module : _modules) {
-    auto ss = VulkanUtils::spvReflectShaderStageFlagBits_To_ShaderStage(module->reflectionData()->shader_stage);
-    if (ss == stage) {
-      mod = module.get();
-      break;
+bool RenderPassKey::compatible(const RenderPassKey& rhs) const {
+  auto attEq = [](const VkAttachmentDescription& a, const VkAttachmentDescription& b) {
+    return a.format == b.format && a.samples == b.samples;
+  };
+  auto refEq = [](const VkAttachmentReference& a, const VkAttachmentReference& b) {
+    return a.attachment == b.attachment;
+  };
+  return std::equal(_attachments.begin(), _attachments.end(), rhs._attachments.begin(), rhs._attachments.end(), attEq) &&
+         std::equal(_colorRefs.begin(), _colorRefs.end(), rhs._colorRefs.begin(), rhs._colorRefs.end(), refEq) &&
+         std::equal(_resolveRefs.begin(), _resolveRefs.end(), rhs._resolveRefs.begin(), rhs._resolveRefs.end(), refEq) &&
+         std::equal(_depthRefs.begin(), _depthRefs.end(), rhs._depthRefs.begin(), rhs._depthRefs.end(), refEq);
+}
+bool RenderPassKey::equals(const RenderPassKey& rhs) const {
+  auto attEq = [](const VkAttachmentDescription& a, const VkAttachmentDescription& b) {
+    return a.flags == b.flags && a.format == b.format && a.samples == b.samples &&
+           a.loadOp == b.loadOp && a.storeOp == b.storeOp &&
+           a.stencilLoadOp == b.stencilLoadOp && a.stencilStoreOp == b.stencilStoreOp &&
+           a.initialLayout == b.initialLayout && a.finalLayout == b.finalLayout;
+  };
+  auto refEq = [](const VkAttachmentReference& a, const VkAttachmentReference& b) {
+    return a.attachment == b.attachment && a.layout == b.layout;
+  };
+  return std::equal(_attachments.begin(), _attachments.end(), rhs._attachments.begin(), rhs._attachments.end(), attEq) &&
+         std::equal(_colorRefs.begin(), _colorRefs.end(), rhs._colorRefs.begin(), rhs._colorRefs.end(), refEq) &&
+         std::equal(_resolveRefs.begin(), _resolveRefs.end(), rhs._resolveRefs.begin(), rhs._resolveRefs.end(), refEq) &&
+         std::equal(_depthRefs.begin(), _depthRefs.end(), rhs._depthRefs.begin(), rhs._depthRefs.end(), refEq);
+}
+size_t PipelineKey::hash() const {
+  size_t seed = 0;
+  HashUtils::combine(seed, _shader);
+  HashUtils::combine(seed, _renderPassHash);
+  HashUtils::combine(seed, _outputStateHash);
+  HashUtils::combine(seed, _specConstantHash);
+  HashUtils::combine(seed, _vertexFormat.get());
+  HashUtils::combine(seed, _topology);
+  HashUtils::combine(seed, _polygonMode);
+  HashUtils::combine(seed, _cullMode);
+  return seed;
+}
+bool PipelineKey::equals(const PipelineKey& rhs) const {
+  return _shader == rhs._shader &&
+         _renderPass.compatible(rhs._renderPass) &&
+         _outputState.equals(rhs._outputState) &&
+         _specConstants == rhs._specConstants &&
+         _vertexFormat == rhs._vertexFormat &&
+         _topology == rhs._topology &&
+         _polygonMode == rhs._polygonMode &&
+         _cullMode == rhs._cullMode;
+}
+PipelineCache::PipelineCache(Vulkan* v) : VulkanObject(v) {
+  VkPipelineCacheCreateInfo cacheInfo = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .initialDataSize = 0,
+    .pInitialData = nullptr,
+  };
+  CheckVKR(vkCreatePipelineCache, vulkan()->device(), &cacheInfo, nullptr, &_pipelineCache);
+}
+PipelineCache::~PipelineCache() {
+  _pipelines.clear();
+  for (auto& layout : _pipelineLayouts) {
+    vkDestroyPipelineLayout(vulkan()->device(), layout._pipelineLayout, nullptr);
+  }
+  _pipelineLayouts.clear();
+  _descriptorSetLayouts.clear();
+  for (auto& pass : _renderPasses) {
+    vkDestroyRenderPass(vulkan()->device(), pass.second._renderPass, nullptr);
+  }
+  _renderPasses.clear();
+  vkDestroyPipelineCache(vulkan()->device(), _pipelineCache, nullptr);
+}
+VkRenderPass PipelineCache::getRenderPass(const RenderPassKey& key) {
+  size_t hash = key.exactHash();
+  auto range = _renderPasses.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second._key.equals(key)) {
+      return it->second._renderPass;
     }
   }
-  if (mod == nullptr && throwIfNotFound) {
-    BRThrowException("Could not find vertex shader module for shader '" + name() + "'");
+  VkRenderPass pass = createRenderPass(key);
+  if (pass != VK_NULL_HANDLE) {
+    _renderPasses.insert(std::make_pair(hash, CachedRenderPass{ ._key = key, ._renderPass = pass }));
   }
-
-  return mod;
+  return pass;
 }
-bool PipelineShader::checkGood() {
-  ShaderModule* vert = getModule(ShaderStage::VertexStage);
-  auto maxinputs = vulkan()->deviceProperties().limits.maxVertexInputAttributes;
-  if (vert->reflectionData()->input_variable_count >= maxinputs) {
-    return shaderError("Error creating shader '" + name() + "' - too many input variables");
-  }
-
-  ShaderModule* frag = getModule(ShaderStage::FragmentStage);
+VkRenderPass PipelineCache::createRenderPass(const RenderPassKey& key) {
+  //TODO: implement "pixel local load operations" for deferred FBOs.
+  VkSubpassDescription subpass = {
+    .flags = 0,
+    .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+    .inputAttachmentCount = 0,
+    .pInputAttachments = nullptr,
+    .colorAttachmentCount = static_cast<uint32_t>(key._colorRefs.size()),
+    .pColorAttachments = key._colorRefs.data(),
+    .pResolveAttachments = key._resolveRefs.data(),
+    .pDepthStencilAttachment = key._depthRefs.data(),
+    .preserveAttachmentCount = 0,
+    .pPreserveAttachments = nullptr,
+  };
+  VkRenderPassCreateInfo renderPassInfo = {
+    .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .attachmentCount = static_cast<uint32_t>(key._attachments.size()),
+    .pAttachments = key._attachments.data(),
+    .subpassCount = 1,
+    .pSubpasses = &subpass,
+    .dependencyCount = 0,
+    .pDependencies = nullptr,
+  };
+  VkRenderPass pass = VK_NULL_HANDLE;
+  CheckVKR(vkCreateRenderPass, vulkan()->device(), &renderPassInfo, nullptr, &pass);
+  return pass;
+}
+DescriptorSetLayout* PipelineCache::getDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings) {
+  //Shaders declaring the same bindings share one layout, so their pipeline layouts are compatible.
+  std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+  size_t hash = DescriptorSetLayout::hash(bindings);
+  auto range = _descriptorSetLayouts.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->equals(bindings)) {
+      return it->second.get();
+    }
+  }
+  auto layout = std::make_unique<DescriptorSetLayout>(vulkan());
+  if (!layout->init(bindings)) {
+    return nullptr;
+  }
+  DescriptorSetLayout* ret = layout.get();
+  _descriptorSetLayouts.insert(std::make_pair(hash, std::move(layout)));
+  return ret;
+}
+VkPipelineLayout PipelineCache::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+  auto rangeEq = [](const VkPushConstantRange& a, const VkPushConstantRange& b) {
+    return a.stageFlags == b.stageFlags && a.offset == b.offset && a.size == b.size;
+  };
+  for (auto& layout : _pipelineLayouts) {
+    if (layout._setLayouts == setLayouts &&
+        std::equal(layout._pushConstantRanges.begin(), layout._pushConstantRanges.end(), pushConstantRanges.begin(), pushConstantRanges.end(), rangeEq)) {
+      return layout._pipelineLayout;
+    }
+  }
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    //These are the getVkBuffer descriptors
+    .setLayoutCount = static_cast<uint32_t>(setLayouts.size()),
+    .pSetLayouts = setLayouts.data(),
+    //Constants to pass to shaders.
+    .pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()),
+    .pPushConstantRanges = pushConstantRanges.data()
+  };
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  CheckVKR(vkCreatePipelineLayout, vulkan()->device(), &pipelineLayoutInfo, nullptr, &pipelineLayout);
+  _pipelineLayouts.push_back({ ._setLayouts = setLayouts, ._pushConstantRanges = pushConstantRanges, ._pipelineLayout = pipelineLayout });
+  return pipelineLayout;
+}
+Pipeline* PipelineCache::getPipeline(const PipelineKey& key, Framebuffer* fbo) {
+  size_t hash = key.hash();
+  auto range = _pipelines.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->key().equals(key)) {
+      return it->second.get();
+    }
+  }
+  //Failed pipelines are cached too, so we don't try to recreate them every frame.
+  auto pipe = std::make_unique<Pipeline>(vulkan(), key);
+  Pipeline* ret = pipe.get();
+  bool success = key._shader->isCompute() ? pipe->initCompute(key._shader) : pipe->init(key._shader, key._vertexFormat, fbo);
+  if (!success) {
+    BRLogError("Failed to create pipeline.");
+  }
+  _pipelines.insert(std::make_pair(hash, std::move(pipe)));
+  BRLogDebug("PipelineCache: " + std::to_string(_pipelines.size()) + " pipelines, " + std::to_string(_pipelineLayouts.size()) + " layouts, " + std::to_string(_renderPasses.size()) + " render passes.");
+  return ret;
+}
+void PipelineCache::releaseShader(PipelineShader* shader) {
+  for (auto it = _pipelines.begin(); it != _pipelines.end();) {
+    if (it->second->key()._shader == shader) {
+      it = _pipelines.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  //Pipeline layouts are built from shared set layouts, other shaders may still use them.
+}
+
+#pragma endregion
+
+#pragma region BindlessTextureTable
+
+BindlessTextureTable::BindlessTextureTable(Vulkan* v) : VulkanObject(v) {
+}
+BindlessTextureTable::~BindlessTextureTable() {
+  vkDestroyDescriptorPool(vulkan()->device(), _descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(vulkan()->device(), _descriptorSetLayout, nullptr);
+}
+bool BindlessTextureTable::init() {
+  //https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VK_EXT_descriptor_indexing.html
+  _capacity = std::min((uint32_t)4096, vulkan()->deviceLimits().maxPerStageDescriptorSamplers);
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProps = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+    .pNext = nullptr,
+  };
+  VkPhysicalDeviceProperties2 props2 = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+    .pNext = &indexingProps,
+  };
+  vkGetPhysicalDeviceProperties2(vulkan()->physicalDevice(), &props2);
+  _capacity = std::min(_capacity, indexingProps.maxDescriptorSetUpdateAfterBindSampledImages);
+  _capacity = std::min(_capacity, indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers);
+  if (_capacity == 0) {
+    BRLogError("Bindless texture table capacity was zero.");
+    return false;
+  }
+
+  //Layout
+  VkDescriptorSetLayoutBinding binding = {
+    .binding = 0,
+    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    .descriptorCount = _capacity,
+    .stageFlags = VK_SHADER_STAGE_ALL,
+    .pImmutableSamplers = nullptr,
+  };
+  VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                             VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+                                             VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                             VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+    .pNext = nullptr,
+    .bindingCount = 1,
+    .pBindingFlags = &bindingFlags,
+  };
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .pNext = &bindingFlagsInfo,
+    .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+    .bindingCount = 1,
+    .pBindings = &binding,
+  };
+  CheckVKR(vkCreateDescriptorSetLayout, vulkan()->device(), &layoutInfo, nullptr, &_descriptorSetLayout);
+
+  //Pool
+  VkDescriptorPoolSize poolSize = {
+    .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    .descriptorCount = _capacity,
+  };
+  VkDescriptorPoolCreateInfo poolInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+    .maxSets = 1,
+    .poolSizeCount = 1,
+    .pPoolSizes = &poolSize,
+  };
+  CheckVKR(vkCreateDescriptorPool, vulkan()->device(), &poolInfo, nullptr, &_descriptorPool);
+
+  //Set
+  VkDescriptorSetVariableDescriptorCountAllocateInfoEXT countInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT,
+    .pNext = nullptr,
+    .descriptorSetCount = 1,
+    .pDescriptorCounts = &_capacity,
+  };
+  VkDescriptorSetAllocateInfo allocInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    .pNext = &countInfo,
+    .descriptorPool = _descriptorPool,
+    .descriptorSetCount = 1,
+    .pSetLayouts = &_descriptorSetLayout,
+  };
+  CheckVKR(vkAllocateDescriptorSets, vulkan()->device(), &allocInfo, &_descriptorSet);
+
+  BRLogInfo("Bindless texture table created with " + std::to_string(_capacity) + " slots.");
+  return true;
+}
+uint32_t BindlessTextureTable::registerTexture(TextureImage* tex) {
+  AssertOrThrow2(tex != nullptr);
+  uint32_t index = c_invalidIndex;
+  if (_free.size()) {
+    index = _free.back();
+    _free.pop_back();
+  }
+  else if (_next < _capacity) {
+    index = _next++;
+  }
+  else {
+    BRLogWarnOnce("Bindless texture table is full (" + std::to_string(_capacity) + " textures).");
+    return c_invalidIndex;
+  }
+
+  //Slots not used by pending command buffers can be written any time (UPDATE_UNUSED_WHILE_PENDING)
+  VkDescriptorImageInfo imageInfo = {
+    .sampler = tex->sampler(),
+    .imageView = tex->imageView(),
+    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+  };
+  VkWriteDescriptorSet write = {
+    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+    .pNext = nullptr,
+    .dstSet = _descriptorSet,
+    .dstBinding = 0,
+    .dstArrayElement = index,
+    .descriptorCount = 1,
+    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    .pImageInfo = &imageInfo,
+    .pBufferInfo = nullptr,
+    .pTexelBufferView = nullptr,
+  };
+  vkUpdateDescriptorSets(vulkan()->device(), 1, &write, 0, nullptr);
+  _count++;
+  return index;
+}
+void BindlessTextureTable::unregisterTexture(uint32_t index) {
+  //Slot stays partially bound (unwritten) until it's reused.
+  if (index == c_invalidIndex || index >= _next) {
+    return;
+  }
+  _free.push_back(index);
+  _count--;
+}
+
+#pragma endregion
+
+#pragma region DescriptorSetCache
+
+DescriptorUpdateTemplate::DescriptorUpdateTemplate(Vulkan* v) : VulkanObject(v) {
+}
+DescriptorUpdateTemplate::~DescriptorUpdateTemplate() {
+  vkDestroyDescriptorUpdateTemplate(vulkan()->device(), _template, nullptr);
+}
+bool DescriptorUpdateTemplate::init(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+  //One entry per binding, elements are packed in binding order.
+  std::vector<VkDescriptorSetLayoutBinding> sorted = bindings;
+  std::sort(sorted.begin(), sorted.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+  std::vector<VkDescriptorUpdateTemplateEntry> entries;
+  _bindingRanges.clear();
+  _elementCount = 0;
+  for (auto& b : sorted) {
+    _bindingRanges[b.binding] = std::make_pair(static_cast<uint32_t>(_elementCount), b.descriptorCount);
+    entries.push_back({
+      .dstBinding = b.binding,
+      .dstArrayElement = 0,
+      .descriptorCount = b.descriptorCount,
+      .descriptorType = b.descriptorType,
+      .offset = _elementCount * sizeof(DescriptorInfo),
+      .stride = sizeof(DescriptorInfo),
+    });
+    _elementCount += b.descriptorCount;
+  }
+  if (entries.size() == 0) {
+    return false;
+  }
+
+  VkDescriptorUpdateTemplateCreateInfo createInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size()),
+    .pDescriptorUpdateEntries = entries.data(),
+    .templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+    .descriptorSetLayout = layout,
+    .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,  //Ignored for DESCRIPTOR_SET templates
+    .pipelineLayout = VK_NULL_HANDLE,
+    .set = 0,
+  };
+  CheckVKR(vkCreateDescriptorUpdateTemplate, vulkan()->device(), &createInfo, nullptr, &_template);
+  return _template != VK_NULL_HANDLE;
+}
+bool DescriptorUpdateTemplate::pack(const DescriptorSlots& slots, std::vector<DescriptorInfo>& out_data) {
+  //Returns false if any element isn't bound, the template writes every element.
+  if (slots.size() != _elementCount) {
+    return false;
+  }
+  out_data.resize(_elementCount);
+  for (auto& p : slots) {
+    auto& slot = p.second;
+    auto it = _bindingRanges.find(slot._binding);
+    if (it == _bindingRanges.end()) {
+      return false;
+    }
+    //An element past the binding's array would land in the next binding.
+    if (slot._arrayElement >= it->second.second) {
+      return false;
+    }
+    size_t idx = it->second.first + slot._arrayElement;
+    if (slot.isImage()) {
+      out_data[idx]._image = slot._imageInfo;
+    }
+    else {
+      out_data[idx]._buffer = slot._bufferInfo;
+    }
+  }
+  return true;
+}
+void DescriptorUpdateTemplate::update(VkDescriptorSet set, const void* data) {
+  vkUpdateDescriptorSetWithTemplate(vulkan()->device(), set, _template, data);
+}
+
+bool DescriptorSlot::equals(const DescriptorSlot& rhs) const {
+  return _binding == rhs._binding && _arrayElement == rhs._arrayElement && _type == rhs._type && _resourceId == rhs._resourceId &&
+         _bufferInfo.buffer == rhs._bufferInfo.buffer && _bufferInfo.offset == rhs._bufferInfo.offset && _bufferInfo.range == rhs._bufferInfo.range &&
+         _imageInfo.sampler == rhs._imageInfo.sampler && _imageInfo.imageView == rhs._imageInfo.imageView && _imageInfo.imageLayout == rhs._imageInfo.imageLayout;
+}
+size_t DescriptorSlot::hash() const {
+  size_t seed = 0;
+  HashUtils::combine(seed, key());
+  HashUtils::combine(seed, _type);
+  HashUtils::combine(seed, _resourceId);
+  HashUtils::combine(seed, _bufferInfo.buffer);
+  HashUtils::combine(seed, _bufferInfo.offset);
+  HashUtils::combine(seed, _bufferInfo.range);
+  HashUtils::combine(seed, _imageInfo.sampler);
+  HashUtils::combine(seed, _imageInfo.imageView);
+  HashUtils::combine(seed, _imageInfo.imageLayout);
+  return seed;
+}
+DescriptorSetLayout::DescriptorSetLayout(Vulkan* v) : VulkanObject(v) {
+}
+DescriptorSetLayout::~DescriptorSetLayout() {
+  _pUpdateTemplate = nullptr;
+  vkDestroyDescriptorSetLayout(vulkan()->device(), _layout, nullptr);
+}
+bool DescriptorSetLayout::init(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+  _bindings = bindings;
+
+  //Descriptor counts for one set. Pools are created by the DescriptorSetCache.
+  _poolSizes.clear();
+  for (auto& b : _bindings) {
+    auto ps = std::find_if(_poolSizes.begin(), _poolSizes.end(), [&](const VkDescriptorPoolSize& x) { return x.type == b.descriptorType; });
+    if (ps == _poolSizes.end()) {
+      _poolSizes.push_back({ .type = b.descriptorType, .descriptorCount = 0 });
+      ps = _poolSizes.end() - 1;
+    }
+    ps->descriptorCount += b.descriptorCount;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .bindingCount = static_cast<uint32_t>(_bindings.size()),
+    .pBindings = _bindings.data(),
+  };
+  CheckVKR(vkCreateDescriptorSetLayout, vulkan()->device(), &layoutInfo, nullptr, &_layout);
+  if (_layout == VK_NULL_HANDLE) {
+    return false;
+  }
+
+  //Update template for writing whole sets
+  if (_bindings.size() > 0) {
+    _pUpdateTemplate = std::make_unique<DescriptorUpdateTemplate>(vulkan());
+    if (!_pUpdateTemplate->init(_layout, _bindings)) {
+      _pUpdateTemplate = nullptr;
+    }
+  }
+  return true;
+}
+bool DescriptorSetLayout::equals(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+  auto bindingEq = [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+    return a.binding == b.binding && a.descriptorType == b.descriptorType && a.descriptorCount == b.descriptorCount &&
+           a.stageFlags == b.stageFlags && a.pImmutableSamplers == b.pImmutableSamplers;
+  };
+  return std::equal(_bindings.begin(), _bindings.end(), bindings.begin(), bindings.end(), bindingEq);
+}
+size_t DescriptorSetLayout::hash(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+  size_t seed = 0;
+  HashUtils::combine(seed, bindings.size());
+  for (auto& b : bindings) {
+    HashUtils::combine(seed, b.binding);
+    HashUtils::combine(seed, b.descriptorType);
+    HashUtils::combine(seed, b.descriptorCount);
+    HashUtils::combine(seed, b.stageFlags);
+  }
+  return seed;
+}
+DescriptorPoolAllocator::DescriptorPoolAllocator(Vulkan* v) : VulkanObject(v) {
+}
+DescriptorPoolAllocator::~DescriptorPoolAllocator() {
+  //Descriptor sets are automatically freed when the descriptor pool is destroyed.
+  for (auto list : { &_persistent._pools, &_transient._pools, &_freePools }) {
+    for (auto pool : *list) {
+      vkDestroyDescriptorPool(vulkan()->device(), pool, nullptr);
+    }
+    list->clear();
+  }
+}
+void DescriptorPoolAllocator::beginFrame() {
+  //The frame's fence was waited on, so no transient set is in flight. Reset the pools whole.
+  for (auto pool : _transient._pools) {
+    CheckVKR(vkResetDescriptorPool, vulkan()->device(), pool, 0);
+    _freePools.push_back(pool);
+    _poolResets++;
+  }
+  _transient._pools.clear();
+}
+VkDescriptorSet DescriptorPoolAllocator::allocate(VkDescriptorSetLayout layout, bool transient) {
+  PoolList& list = transient ? _transient : _persistent;
+  VkDescriptorSetAllocateInfo allocInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    .pNext = nullptr,
+    .descriptorPool = VK_NULL_HANDLE,
+    .descriptorSetCount = 1,
+    .pSetLayouts = &layout,
+  };
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  VkResult res = VK_ERROR_OUT_OF_POOL_MEMORY;
+  if (list._pools.size()) {
+    allocInfo.descriptorPool = list._pools.back();
+    res = vkAllocateDescriptorSets(vulkan()->device(), &allocInfo, &set);
+  }
+  if (res == VK_ERROR_OUT_OF_POOL_MEMORY || res == VK_ERROR_FRAGMENTED_POOL) {
+    //Current pool is full, move to the next one and try once more.
+    VkDescriptorPool pool = nextPool();
+    if (pool == VK_NULL_HANDLE) {
+      return VK_NULL_HANDLE;
+    }
+    list._pools.push_back(pool);
+    allocInfo.descriptorPool = pool;
+    res = vkAllocateDescriptorSets(vulkan()->device(), &allocInfo, &set);
+    if (res == VK_ERROR_OUT_OF_POOL_MEMORY || res == VK_ERROR_FRAGMENTED_POOL) {
+      BRLogError("Descriptor set layout does not fit in an empty descriptor pool.");
+      return VK_NULL_HANDLE;
+    }
+  }
+  vulkan()->validateVkResult(res, "vkAllocateDescriptorSets");
+  if (res != VK_SUCCESS) {
+    return VK_NULL_HANDLE;
+  }
+  _allocatedSets++;
+  return set;
+}
+VkDescriptorPool DescriptorPoolAllocator::nextPool() {
+  if (_freePools.size()) {
+    VkDescriptorPool pool = _freePools.back();
+    _freePools.pop_back();
+    return pool;
+  }
+  return createPool();
+}
+VkDescriptorPool DescriptorPoolAllocator::createPool() {
+  //Descriptors per set, for an average set. Any layout can be allocated until one of these runs out.
+  static const std::vector<std::pair<VkDescriptorType, float>> c_ratios = {
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4.0f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+  };
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (auto& r : c_ratios) {
+    poolSizes.push_back({ .type = r.first, .descriptorCount = static_cast<uint32_t>(r.second * c_setsPerPool) });
+  }
+  VkDescriptorPoolCreateInfo poolInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,  //VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT - this may cause fragmentation
+    .maxSets = c_setsPerPool,
+    .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+    .pPoolSizes = poolSizes.data(),
+  };
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  CheckVKR(vkCreateDescriptorPool, vulkan()->device(), &poolInfo, nullptr, &pool);
+  if (pool != VK_NULL_HANDLE) {
+    _poolsCreated++;
+    BRLogDebug("DescriptorPoolAllocator: created pool " + std::to_string(_poolsCreated) + " (" + std::to_string(_allocatedSets) + " sets allocated).");
+  }
+  return pool;
+}
+DescriptorSetCache::DescriptorSetCache(Vulkan* v, DescriptorSetLayout* layout, DescriptorPoolAllocator* allocator, bool transient) : VulkanObject(v) {
+  _layout = layout;
+  _pAllocator = allocator;
+  _bTransient = transient;
+}
+DescriptorSetCache::~DescriptorSetCache() {
+  //Sets are freed with the allocator's pools.
+}
+void DescriptorSetCache::beginFrame(uint64_t frameNumber) {
+  if (frameNumber == _frameNumber) {
+    return;
+  }
+  if (_bTransient) {
+    //The allocator reset the transient pools, every set is gone.
+    _sets.clear();
+    _free.clear();
+    _frameNumber = frameNumber;
+    return;
+  }
+  //Recycle sets that weren't used the last time this frame rendered.
+  //The frame's fence was waited on, so nothing from that submission is in flight.
+  for (auto it = _sets.begin(); it != _sets.end();) {
+    if (it->second._lastUsedFrame < _frameNumber) {
+      _free.push_back(it->second._set);
+      it = _sets.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+  _frameNumber = frameNumber;
+}
+VkDescriptorSet DescriptorSetCache::getSet(const DescriptorSlots& slots, bool& out_hit) {
+  size_t hash = 0;
+  for (auto& slot : slots) {
+    HashUtils::combine(hash, slot.second.hash());
+  }
+
+  auto range = _sets.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    auto& cached = it->second;
+    if (cached._slots.size() == slots.size() &&
+        std::equal(cached._slots.begin(), cached._slots.end(), slots.begin(), [](const auto& a, const auto& b) { return a.second.equals(b.second); })) {
+      cached._lastUsedFrame = _frameNumber;
+      out_hit = true;
+      return cached._set;
+    }
+  }
+
+  out_hit = false;
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  if (_free.size()) {
+    set = _free.back();
+    _free.pop_back();
+  }
+  else {
+    set = _pAllocator->allocate(_layout->getVkDescriptorSetLayout(), _bTransient);
+  }
+  if (set == VK_NULL_HANDLE) {
+    return VK_NULL_HANDLE;
+  }
+  writeSet(set, slots);
+  _sets.insert(std::make_pair(hash, CachedSet{ ._slots = slots, ._set = set, ._lastUsedFrame = _frameNumber }));
+  return set;
+}
+void DescriptorSetCache::writeSet(VkDescriptorSet set, const DescriptorSlots& slots) {
+  //Every element bound - write the whole set with one template call.
+  auto updateTemplate = _layout->updateTemplate();
+  if (updateTemplate && updateTemplate->pack(slots, _templateData)) {
+    updateTemplate->update(set, _templateData.data());
+    return;
+  }
+
+  //Partially bound - all writes for the set in one update.
+  std::vector<VkWriteDescriptorSet> vk_writes;
+  vk_writes.reserve(slots.size());
+  for (auto& p : slots) {
+    auto& slot = p.second;
+    bool isImage = slot.isImage();
+    vk_writes.push_back({
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .pNext = nullptr,
+      .dstSet = set,
+      .dstBinding = slot._binding,
+      .dstArrayElement = slot._arrayElement,
+      .descriptorCount = 1,
+      .descriptorType = slot._type,
+      .pImageInfo = isImage ? &slot._imageInfo : nullptr,
+      .pBufferInfo = isImage ? nullptr : &slot._bufferInfo,
+      .pTexelBufferView = nullptr,
+    });
+  }
+  vkUpdateDescriptorSets(vulkan()->device(), static_cast<uint32_t>(vk_writes.size()), vk_writes.data(), 0, nullptr);
+}
+
+#pragma endregion
+
+#pragma region PipelineShader
+
+std::unique_ptr<PipelineShader> PipelineShader::create(Vulkan* v, const string_t& name, const std::vector<string_t>& files) {
+  auto s = std::make_unique<PipelineShader>(v, name, files);
+  s->init();
+  s->vulkan()->swapchain()->registerShader(s.get());
+  return s;
+}
+PipelineShader::PipelineShader(Vulkan* v, const string_t& name, const std::vector<string_t>& files) : VulkanObject(v) {
+  _name = name;
+  _files = files;
+}
+PipelineShader::~PipelineShader() {
+  //This could be an error since vulkan is no longer an SP.
+  //Perhaps make vulkan an SP
+  //There are really 2 ways of doing this. weak_ptr is less efficient but less error prone.
+  if (vulkan() && vulkan()->swapchain()) {
+    vulkan()->swapchain()->unregisterShader(this);
+  }
+  if (vulkan() && vulkan()->pipelineCache()) {
+    vulkan()->pipelineCache()->releaseShader(this);
+  }
+  cleanupDescriptors();
+  _modules.clear();
+}
+bool PipelineShader::init() {
+  for (auto& str : _files) {
+    auto mod = std::make_unique<ShaderModule>(vulkan(), _name, str);
+    _modules.push_back(std::move(mod));
+  }
+  for (auto& mod : _modules) {
+    for (auto& sc : mod->specConstants()) {
+      BRLogDebug("Shader '" + name() + "' spec constant '" + sc->_name + "' id=" + std::to_string(sc->_constantId) + " default=" + std::to_string(sc->_defaultValue));
+    }
+  }
+  updateSpecConstantHash();
+  _bCompute = (getModule(ShaderStage::ComputeStage) != nullptr);
+  if (_bCompute) {
+    //Compute shaders have no vertex inputs or attachment outputs.
+    if (_modules.size() != 1) {
+      return shaderError("Compute shader '" + name() + "' must be a single module.");
+    }
+  }
+  else {
+    if (!checkGood()) {
+      return false;
+    }
+    if (!createInputs()) {
+      return false;
+    }
+    if (!createOutputs()) {
+      return false;
+    }
+  }
+  if (!createDescriptors()) {
+    return false;
+  }
+  if (!createPushConstants()) {
+    return false;
+  }
+  return true;
+}
+ShaderModule* PipelineShader::getModule(ShaderStage stage, bool throwIfNotFound) {
+  ShaderModule* mod = nullptr;
+  for (auto& module : _modules) {
+    auto ss = VulkanUtils::spvReflectShaderStageFlagBits_To_ShaderStage(module->reflectionData()->shader_stage);
+    if (ss == stage) {
+      mod = module.get();
+      break;
+    }
+  }
+  if (mod == nullptr && throwIfNotFound) {
+    BRThrowException("Could not find vertex shader module for shader '" + name() + "'");
+  }
+
+  return mod;
+}
+bool PipelineShader::checkGood() {
+  ShaderModule* vert = getModule(ShaderStage::VertexStage);
+  auto maxinputs = vulkan()->deviceProperties().limits.maxVertexInputAttributes;
+  if (vert->reflectionData()->input_variable_count >= maxinputs) {
+    return shaderError("Error creating shader '" + name() + "' - too many input variables");
+  }
+
+  ShaderModule* frag = getModule(ShaderStage::FragmentStage);
   auto maxAttachments = vulkan()->deviceProperties().limits.maxFragmentOutputAttachments;
   if (frag->reflectionData()->output_variable_count >= maxAttachments) {
     return shaderError("Error creating shader '" + name() + "' - too many output attachments in fragment shader.");
@@ -2355,9 +3511,17 @@ bool PipelineShader::createInputs() {
       attrib->_name = std::string(iv.name);
 
       //Attrib Size
-      attrib->_componentCount = iv.numeric.vector.component_count;
       attrib->_componentSizeBytes = iv.numeric.scalar.width / 8;
-      attrib->_matrixSize = iv.numeric.matrix.column_count * iv.numeric.matrix.row_count;
+      if (iv.numeric.matrix.column_count > 0) {
+        //Reflection also reports the column vector of a matrix.
+        attrib->_componentCount = 0;
+        attrib->_matrixColumns = iv.numeric.matrix.column_count;
+        attrib->_matrixSize = iv.numeric.matrix.column_count * iv.numeric.matrix.row_count;
+      }
+      else {
+        attrib->_componentCount = std::max(iv.numeric.vector.component_count, (uint32_t)1);  //Scalars have no vector components.
+        attrib->_matrixSize = 0;
+      }
       attrib->_totalSizeBytes = (attrib->_componentCount + attrib->_matrixSize) * attrib->_componentSizeBytes;
 
       if ((iv.numeric.matrix.column_count != iv.numeric.matrix.row_count)) {
@@ -2372,16 +3536,18 @@ bool PipelineShader::createInputs() {
       else if (iv.numeric.matrix.stride > 0) {
         return shaderError("Failure - nonzero stride for matrix vertex attribute '" + attrib->_name + "' in shader '" + name() + "'");
       }
-
-      if (attrib->_matrixSize > 0 && attrib->_componentCount > 0) {
-        return shaderError("Failure - matrix and vector dimensions present in attribute '" + attrib->_name + "' in shader '" + name() + "'");
+      else if (attrib->_matrixSize > 0 && attrib->_componentSizeBytes != 4) {
+        return shaderError("Failure - matrix vertex attribute '" + attrib->_name + "' in shader '" + name() + "' must be 32 bit float.");
       }
 
       //Attrib type.
       //Note type_description.typeFlags is the int,scal,mat type.
       attrib->_typeFlags = iv.type_description->type_flags;
-      attrib->_userType = parseUserType(attrib->_name);
-      attrib->_desc.binding = 0;
+      attrib->_perInstance = StringUtil::startsWith(attrib->_name, VertexAttribute::c_instancePrefix);
+      if (!attrib->_perInstance) {
+        attrib->_userType = parseUserType(attrib->_name);
+      }
+      attrib->_desc.binding = attrib->_perInstance ? c_instanceBinding : c_vertexBinding;
       attrib->_desc.location = iv.location;
       attrib->_desc.format = spvReflectFormatToVulkanFormat(iv.format);
       attrib->_desc.offset = 0;  //This is computed later
@@ -2401,33 +3567,52 @@ bool PipelineShader::createInputs() {
   });
 
   //Compute Byte offsets.
-  size_t iOffset = 0;
-  for (auto& iat : _attributes) {
-    iat->_desc.offset = iOffset;
-    iOffset += iat->_totalSizeBytes;
-  }
-
+  // Vertex attributes are interleaved in the mesh binding, per instance attributes (_inst..) in the instance binding.
   //I don't believe inputs are std430 aligned, however ..
   // We need to create a new pipeline per new vertex input via the specification.
-  uint32_t size = 0;
+  uint32_t strides[2] = { 0, 0 };
   _attribDescriptions.clear();
   for (auto& attr : _attributes) {
-    _attribDescriptions.push_back(attr->_desc);
-    size += static_cast<uint32_t>(attr->_totalSizeBytes);
+    uint32_t& stride = strides[attr->_desc.binding];
+    attr->_desc.offset = stride;
+    if (attr->_matrixSize > 0) {
+      //Matrices are one vector attribute per column.
+      uint32_t rows = attr->_matrixSize / attr->_matrixColumns;
+      VkFormat colFormat = (rows == 2) ? VK_FORMAT_R32G32_SFLOAT : ((rows == 3) ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT);
+      for (uint32_t col = 0; col < attr->_matrixColumns; ++col) {
+        VkVertexInputAttributeDescription desc = attr->_desc;
+        desc.location = attr->_desc.location + col;
+        desc.format = colFormat;
+        desc.offset = stride + col * rows * attr->_componentSizeBytes;
+        _attribDescriptions.push_back(desc);
+      }
+    }
+    else {
+      _attribDescriptions.push_back(attr->_desc);
+    }
+    stride += static_cast<uint32_t>(attr->_totalSizeBytes);
+  }
+  if (_attribDescriptions.size() > maxinputs) {
+    return shaderError("Error creating shader '" + name() + "' - too many vertex attribute locations (matrices take one per column).");
+  }
+
+  _bindingDescs.clear();
+  _bindingDescs.push_back({
+    .binding = c_vertexBinding,
+    .stride = strides[c_vertexBinding],
+    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  });
+  _instanceStride = strides[c_instanceBinding];
+  if (_instanceStride > 0) {
+    _bindingDescs.push_back({
+      .binding = c_instanceBinding,
+      .stride = _instanceStride,
+      .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+    });
   }
-
-  VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-  if (_bInstanced) {
-    //**This doesn't seem to make a difference on my Nvidia 1660 driver
-    //inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
-    //Test frame rate with this option..?
-    BRLogWarn("VK_VERTEX_INPUT_RATE_INSTANCE Not supported");
+  if (_bindingDescs.size() > maxbindings) {
+    return shaderError("Error creating shader '" + name() + "' - too many vertex bindings.");
   }
-  _bindingDesc = {
-    .binding = 0,
-    .stride = size,
-    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-  };
   return true;
 }
 VkFormat PipelineShader::spvReflectFormatToVulkanFormat(SpvReflectFormat in_fmt) {
@@ -2613,8 +3798,8 @@ VkPipelineVertexInputStateCreateInfo PipelineShader::getVertexInputInfo(std::sha
     .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
     .pNext = nullptr,
     .flags = 0,
-    .vertexBindingDescriptionCount = 1,
-    .pVertexBindingDescriptions = &_bindingDesc,
+    .vertexBindingDescriptionCount = static_cast<uint32_t>(_bindingDescs.size()),
+    .pVertexBindingDescriptions = _bindingDescs.data(),
     .vertexAttributeDescriptionCount = static_cast<uint32_t>(_attribDescriptions.size()),
     .pVertexAttributeDescriptions = _attribDescriptions.data(),
   };
@@ -2628,9 +3813,103 @@ std::vector<VkPipelineShaderStageCreateInfo> PipelineShader::getShaderStageCreat
   }
   return ret;
 }
+bool PipelineShader::setSpecConstant(const string_t& name, int32_t value) {
+  return setSpecConstantRaw(name, static_cast<uint32_t>(value), SpecConstantType::Int);
+}
+bool PipelineShader::setSpecConstant(const string_t& name, uint32_t value) {
+  return setSpecConstantRaw(name, value, SpecConstantType::UInt);
+}
+bool PipelineShader::setSpecConstant(const string_t& name, float value) {
+  uint32_t raw = 0;
+  memcpy(&raw, &value, sizeof(float));
+  return setSpecConstantRaw(name, raw, SpecConstantType::Float);
+}
+bool PipelineShader::setSpecConstant(const string_t& name, bool value) {
+  return setSpecConstantRaw(name, value ? VK_TRUE : VK_FALSE, SpecConstantType::Bool);
+}
+bool PipelineShader::setSpecConstantRaw(const string_t& name, uint32_t value, SpecConstantType type) {
+  //The same constant may be declared in multiple stages.
+  bool found = false;
+  for (auto& mod : _modules) {
+    auto sc = mod->getSpecConstant(name);
+    if (sc == nullptr) {
+      continue;
+    }
+    found = true;
+    bool isInt = (type == SpecConstantType::Int || type == SpecConstantType::UInt);
+    bool scInt = (sc->_type == SpecConstantType::Int || sc->_type == SpecConstantType::UInt);
+    if (sc->_type != type && !(isInt && scInt)) {
+      return shaderError("Specialization constant '" + name + "' type mismatch.");
+    }
+    if (sc->_value != value) {
+      sc->_value = value;
+      mod->updateSpecializationInfo();
+    }
+  }
+  if (!found) {
+    BRLogWarnOnce("Specialization constant '" + name + "' was not found in shader '" + this->name() + "'.");
+    return false;
+  }
+  updateSpecConstantHash();
+  return true;
+}
+void PipelineShader::updateSpecConstantHash() {
+  //Pipelines are created with the current values, a different set of values is a different pipeline variant.
+  size_t seed = 0;
+  _specConstants.clear();
+  for (auto& mod : _modules) {
+    for (auto& sc : mod->specConstants()) {
+      HashUtils::combine(seed, sc->_constantId);
+      HashUtils::combine(seed, sc->_value);
+      _specConstants.push_back(std::make_pair(sc->_constantId, sc->_value));
+    }
+  }
+  _specConstantHash = seed;
+}
+bool PipelineShader::createPushConstants() {
+  //GLSL: layout(push_constant) uniform Block { .. } _name;
+  //There is one push constant block per stage. Stages may share the same block (same offsets).
+  _pushConstantRanges.clear();
+  for (auto& module : _modules) {
+    auto refl = module->reflectionData();
+    if (refl->push_constant_block_count > 1) {
+      return shaderError("Multiple push constant blocks in module '" + module->name() + "'.");
+    }
+    for (uint32_t ipc = 0; ipc < refl->push_constant_block_count; ipc++) {
+      auto& block = refl->push_constant_blocks[ipc];
+      VkShaderStageFlags stage = VulkanUtils::spvReflectShaderStageFlagBitsToVk(refl->shader_stage);
+      uint32_t size = (block.size + 3) & ~3u;
+
+      if (block.offset + size > vulkan()->deviceLimits().maxPushConstantsSize) {
+        return shaderError("Push constant block '" + std::string(block.name ? block.name : "") + "' (" + std::to_string(block.offset + size) +
+                           "B) exceeds maxPushConstantsSize (" + std::to_string(vulkan()->deviceLimits().maxPushConstantsSize) + "B).");
+      }
+
+      //Merge identical ranges so the stages share one range.
+      bool merged = false;
+      for (auto& range : _pushConstantRanges) {
+        if (range.offset == block.offset && range.size == size) {
+          range.stageFlags |= stage;
+          merged = true;
+          break;
+        }
+      }
+      if (!merged) {
+        _pushConstantRanges.push_back({
+          .stageFlags = stage,
+          .offset = block.offset,
+          .size = size,
+        });
+      }
+      BRLogDebug("Shader '" + name() + "' push constant block '" + std::string(block.name ? block.name : "") + "' offset=" + std::to_string(block.offset) + " size=" + std::to_string(size));
+    }
+  }
+  return true;
+}
 void PipelineShader::cleanupDescriptors() {
-  vkDestroyDescriptorPool(vulkan()->device(), _descriptorPool, nullptr);
-  vkDestroyDescriptorSetLayout(vulkan()->device(), _descriptorSetLayout, nullptr);
+  //Set layouts are shared in the PipelineCache, descriptor pools are owned by the RenderFrame DescriptorSetCaches.
+  _setLayouts.clear();
+  _boundSlots.clear();
 }
 DescriptorFunction PipelineShader::classifyDescriptor(const string_t& name) {
   DescriptorFunction ret = DescriptorFunction::Custom;
@@ -2645,11 +3924,31 @@ DescriptorFunction PipelineShader::classifyDescriptor(const string_t& name) {
   }
   return ret;
 }
+DescriptorSetFrequency PipelineShader::classifyDescriptorSet(const string_t& name, bool isSampler) {
+  //Naming convention for descriptors that don't specify a set.
+  //  _frame* / camera, lights -> PerFrame
+  //  _pass*                   -> PerPass
+  //  _mat* / samplers         -> PerMaterial
+  //  _draw* / instance data   -> PerDraw
+  auto startsWith = [&name](const char* prefix) { return StringUtil::startsWith(name, prefix); };
+  DescriptorFunction func = classifyDescriptor(name);
+  if (func == DescriptorFunction::ViewProjMatrixUBO || func == DescriptorFunction::LightsUBO || startsWith("_frame")) {
+    return DescriptorSetFrequency::PerFrame;
+  }
+  else if (startsWith("_pass")) {
+    return DescriptorSetFrequency::PerPass;
+  }
+  else if (func == DescriptorFunction::InstnaceMatrixUBO || startsWith("_draw")) {
+    return DescriptorSetFrequency::PerDraw;
+  }
+  else if (isSampler || startsWith("_mat")) {
+    return DescriptorSetFrequency::PerMaterial;
+  }
+  return DescriptorSetFrequency::PerFrame;
+}
 bool PipelineShader::createDescriptors() {
   //Create uniform blocks
   //Create samplers 
-  uint32_t _nPool_Samplers = 0;
-  uint32_t _nPool_UBOs = 0;
 
   //Parse shader metadata
   std::vector<Descriptor*> bindingLocations;
@@ -2657,6 +3956,15 @@ bool PipelineShader::createDescriptors() {
     for (uint32_t idb = 0; idb < module->reflectionData()->descriptor_binding_count; idb++) {
       auto& descriptor = module->reflectionData()->descriptor_bindings[idb];
 
+      //The bindless table has its own global layout and set.
+      if (descriptor.set == BindlessTextureTable::c_descriptorSet && descriptor.name && StringUtil::equals(descriptor.name, BindlessTextureTable::c_descriptorName)) {
+        if (vulkan()->bindlessTextures() == nullptr) {
+          return shaderError("Shader uses '" + std::string(BindlessTextureTable::c_descriptorName) + "' but descriptor indexing is not supported on this GPU.");
+        }
+        _bUsesBindless = true;
+        continue;
+      }
+
       auto d = std::make_unique<Descriptor>();
 
       d->_name = std::string(descriptor.name);
@@ -2691,7 +3999,6 @@ bool PipelineShader::createDescriptors() {
 
       if (descriptor.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
         d->_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        _nPool_UBOs++;
 
         d->_blockSizeBytes = descriptor.block.size;
 
@@ -2709,9 +4016,33 @@ bool PipelineShader::createDescriptors() {
         }
         d->_bufferSizeBytes = d->_blockSizeBytes * d->_arraySize;
       }
+      else if (descriptor.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+        d->_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+        d->_blockSizeBytes = descriptor.block.size;
+        if (descriptor.array.dims_count > 0) {
+          return shaderError("SSBO '" + d->_name + "' was a Block array - Arrays of SSBO blocks not supported.");
+        }
+        d->_arraySize = 1;
+        //A trailing runtime array (T items[];) is sized by the bound buffer. Reflection leaves its size 0, so
+        // the block size is the fixed members in front of it.
+        if (descriptor.block.member_count > 0) {
+          auto& last = descriptor.block.members[descriptor.block.member_count - 1];
+          if (last.type_description != nullptr && last.type_description->op == SpvOpTypeRuntimeArray) {
+            d->_runtimeArrayStride = last.array.stride;
+            if (d->_runtimeArrayStride == 0) {
+              d->_runtimeArrayStride = last.type_description->traits.array.stride;
+            }
+            if (d->_runtimeArrayStride == 0) {
+              return shaderError("SSBO '" + d->_name + "' runtime array '" + (last.name ? last.name : "") + "' had no array stride.");
+            }
+            d->_blockSizeBytes = last.offset;
+          }
+        }
+        d->_bufferSizeBytes = d->_blockSizeBytes;
+      }
       else if (descriptor.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
         d->_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        _nPool_Samplers++;
 
         if (descriptor.array.dims_count > 0) {
           if (descriptor.array.dims_count > 1) {
@@ -2723,17 +4054,30 @@ bool PipelineShader::createDescriptors() {
           }
         }
       }
+      else if (descriptor.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_STORAGE_IMAGE) {
+        d->_type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        if (descriptor.array.dims_count > 0) {
+          return shaderError("Storage image '" + d->_name + "' was an array - arrays of storage images not supported.");
+        }
+      }
       else {
         return shaderError("Shader descriptor not supported - Spirv-Reflect Descriptor: " + descriptor.descriptor_type);
       }
 
+      d->_set = descriptor.set;
       d->_binding = descriptor.binding;
+      if (d->_set == BindlessTextureTable::c_descriptorSet) {
+        return shaderError("Descriptor '" + d->_name + "' uses set " + std::to_string(d->_set) + " which is reserved for the bindless texture table.");
+      }
+      if (d->_set >= vulkan()->deviceProperties().limits.maxBoundDescriptorSets) {
+        return shaderError("Descriptor '" + d->_name + "' set " + std::to_string(d->_set) + " exceeds maxBoundDescriptorSets.");
+      }
 
       //Reusing names is alright, but may cause problems with built-in variables. This is disabled by default.
 
       for (auto& other : bindingLocations) {
         //**Reusing descriptors will cause severe vulkan errors. It will hault the GPU.
-        if (d->_binding == other->_binding) {
+        if (d->_set == other->_set && d->_binding == other->_binding) {
           return shaderError("Duplicate binding specified for descriptor '" + d->_name + "' in stage '" + VulkanUtils::ShaderStage_toString(d->_stage) + "', and '" +
                              other->_name + "' in stage '" + VulkanUtils::ShaderStage_toString(other->_stage));
         }
@@ -2757,66 +4101,53 @@ bool PipelineShader::createDescriptors() {
     }
   }
 
-  //Allocate Descriptor Pools.
-  VkDescriptorPoolSize uboPoolSize = {
-    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .descriptorCount = static_cast<uint32_t>(vulkan()->swapchain()->swapchainImageCount()) * _nPool_UBOs,
-  };
-  VkDescriptorPoolSize samplerPoolSize = {
-    .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-    .descriptorCount = static_cast<uint32_t>(vulkan()->swapchain()->swapchainImageCount()) * _nPool_Samplers,
-  };
-  std::array<VkDescriptorPoolSize, 2> poolSizes{ uboPoolSize, samplerPoolSize };
-  VkDescriptorPoolCreateInfo poolInfo = {
-    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-    .pNext = nullptr,
-    .flags = 0,  //VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT - this may cause fragmentation
-    .maxSets = static_cast<uint32_t>(vulkan()->swapchain()->swapchainImageCount()),
-    .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
-    .pPoolSizes = poolSizes.data(),
-  };
-  CheckVKR(vkCreateDescriptorPool, vulkan()->device(), &poolInfo, nullptr, &_descriptorPool);
-
-  // Create Descriptor Layouts
-  std::vector<VkDescriptorSetLayoutBinding> bindings;
+  //One layout per set index, up to the highest set used. Unused sets get an empty layout.
+  uint32_t setCount = _bUsesBindless ? BindlessTextureTable::c_descriptorSet + 1 : 0;
+  for (auto& it : _descriptors) {
+    setCount = std::max(setCount, it.second->_set + 1);
+  }
+  std::vector<std::vector<VkDescriptorSetLayoutBinding>> setBindings(setCount);
   for (auto& it : _descriptors) {
     auto& desc = it.second;
-    bindings.push_back({
+    //Per frame and per pass sets are visible to every stage so their layouts match in every shader.
+    //Compute pipelines have their own bind point, so they never share bound sets with graphics.
+    VkShaderStageFlags stages = static_cast<VkShaderStageFlags>(VulkanUtils::ShaderStage_to_VkShaderStageFlagBits(desc->_stage));
+    if (!_bCompute && (desc->_set == static_cast<uint32_t>(DescriptorSetFrequency::PerFrame) || desc->_set == static_cast<uint32_t>(DescriptorSetFrequency::PerPass))) {
+      stages = VK_SHADER_STAGE_ALL_GRAPHICS;
+    }
+    setBindings[desc->_set].push_back({
       .binding = desc->_binding,
       .descriptorType = desc->_type,
       .descriptorCount = desc->_arraySize,
-      .stageFlags = static_cast<VkShaderStageFlags>(VulkanUtils::ShaderStage_to_VkShaderStageFlagBits(desc->_stage)),
+      .stageFlags = stages,
       .pImmutableSamplers = nullptr,
     });
   }
 
-  VkDescriptorSetLayoutCreateInfo layoutInfo = {
-    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-    .pNext = nullptr,
-    .flags = 0,
-    .bindingCount = static_cast<uint32_t>(bindings.size()),
-    .pBindings = bindings.data(),
-  };
-  CheckVKR(vkCreateDescriptorSetLayout, vulkan()->device(), &layoutInfo, nullptr, &_descriptorSetLayout);
-
-  std::vector<VkDescriptorSetLayout> _layouts;
-  _layouts.resize(vulkan()->swapchain()->swapchainImageCount(), _descriptorSetLayout);
-
-  //Allocate Descriptor Sets
-  VkDescriptorSetAllocateInfo allocInfo = {
-    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-    .pNext = nullptr,
-    .descriptorPool = _descriptorPool,
-    .descriptorSetCount = static_cast<uint32_t>(vulkan()->swapchain()->swapchainImageCount()),
-    .pSetLayouts = _layouts.data(),
-  };
-
-  //Descriptor sets are automatically freed when the descriptor pool is destroyed.
-  _descriptorSets.resize(vulkan()->swapchain()->swapchainImageCount());
-  CheckVKR(vkAllocateDescriptorSets, vulkan()->device(), &allocInfo, _descriptorSets.data());
+  _setLayouts.clear();
+  for (uint32_t iset = 0; iset < setCount; ++iset) {
+    if (_bUsesBindless && iset == BindlessTextureTable::c_descriptorSet) {
+      _setLayouts.push_back(nullptr);
+      continue;
+    }
+    auto layout = vulkan()->pipelineCache()->getDescriptorSetLayout(setBindings[iset]);
+    if (layout == nullptr) {
+      return shaderError("Failed to create descriptor set layout for set " + std::to_string(iset) + ".");
+    }
+    _setLayouts.push_back(layout);
+  }
+  _boundSlots = std::vector<DescriptorSlots>(setCount);
 
   return true;
 }
+std::vector<VkDescriptorSetLayout> PipelineShader::getVkDescriptorSetLayouts() {
+  //One per set index. The bindless set uses the BindlessTextureTable layout.
+  std::vector<VkDescriptorSetLayout> ret;
+  for (auto layout : _setLayouts) {
+    ret.push_back(layout ? layout->getVkDescriptorSetLayout() : vulkan()->bindlessTextures()->getVkDescriptorSetLayout());
+  }
+  return ret;
+}
 Descriptor* PipelineShader::getDescriptor(const string_t& name) {
   //Returns the descriptor of the given name, or nullptr if not found.
   Descriptor* ret = nullptr;
@@ -2830,6 +4161,13 @@ Descriptor* PipelineShader::getDescriptor(const string_t& name) {
 bool PipelineShader::createUBO(const string_t& name, const string_t& var_name, size_t itemSize, size_t itemCount) {
   //Create a UBO. Name must match uniform name in shader.
   // We allow the creation of dynamically sized UBO's (separate from the GPU spec) to allow to use smaller memory sizes.
+  return createBuffer(name, var_name, VulkanBufferType::UniformBuffer, false, itemSize, itemCount);
+}
+bool PipelineShader::createStorageBuffer(const string_t& name, const string_t& var_name, size_t itemSize, size_t itemCount, bool bDeviceLocal) {
+  //Storage buffers written by the GPU live in device memory. Ones the CPU rewrites each frame are host visible, like UBOs.
+  return createBuffer(name, var_name, VulkanBufferType::StorageBuffer, bDeviceLocal, itemSize, itemCount);
+}
+bool PipelineShader::createBuffer(const string_t& name, const string_t& var_name, VulkanBufferType type, bool bDeviceLocal, size_t itemSize, size_t itemCount) {
   if (_shaderData.size() == 0) {
     return shaderError("Shader data was uninitialized when creating UBO.");
   }
@@ -2844,15 +4182,26 @@ bool PipelineShader::createUBO(const string_t& name, const string_t& var_name, s
       return shaderError("UBO for shader variable '" + var_name + "' with client variable '" + name + "' was already created.");
     }
     else {
-      if (itemSize * itemCount > desc->_bufferSizeBytes) {
+      size_t bytes = itemSize * itemCount;
+      if (desc->_runtimeArrayStride > 0) {
+        if (bytes < desc->_bufferSizeBytes) {
+          return shaderError("Buffer for '" + var_name + "' was smaller than the fixed part of the block (" + std::to_string(desc->_bufferSizeBytes) + " bytes).");
+        }
+      }
+      else if (bytes > desc->_bufferSizeBytes) {
         return shaderError("Ubo size was greater than the supplied size.");
       }
+      auto& limits = vulkan()->deviceProperties().limits;
+      size_t maxRange = (desc->_type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) ? limits.maxStorageBufferRange : limits.maxUniformBufferRange;
+      if (bytes > maxRange) {
+        return shaderError("Buffer for '" + var_name + "' (" + std::to_string(bytes) + " bytes) exceeded the device range limit of " + std::to_string(maxRange) + " bytes.");
+      }
 
       auto datUBO = std::make_unique<ShaderDataUBO>();
       datUBO->_buffer = std::make_shared<VulkanBuffer>(
         vulkan(),
-        VulkanBufferType::UniformBuffer,
-        false,  //not on GPU
+        type,
+        bDeviceLocal,  //Staged into device memory, UBOs are not on GPU
         itemSize, itemCount, nullptr, 0);
       datUBO->_descriptor = desc;
       data->_uniformBuffers.insert(std::make_pair(name, std::move(datUBO)));
@@ -2863,6 +4212,12 @@ bool PipelineShader::createUBO(const string_t& name, const string_t& var_name, s
 }
 bool PipelineShader::bindUBO(const string_t& name, std::shared_ptr<VulkanBuffer> buffer, VkDeviceSize offset, VkDeviceSize range) {
   //Binds a shader Uniform to this shader for the given swapchain image.
+  return bindBuffer(name, buffer, offset, range, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+}
+bool PipelineShader::bindStorageBuffer(const string_t& name, std::shared_ptr<VulkanBuffer> buffer, VkDeviceSize offset, VkDeviceSize range) {
+  return bindBuffer(name, buffer, offset, range, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+}
+bool PipelineShader::bindBuffer(const string_t& name, std::shared_ptr<VulkanBuffer> buffer, VkDeviceSize offset, VkDeviceSize range, VkDescriptorType type) {
   if (!beginPassGood()) {
     return false;
   }
@@ -2871,25 +4226,31 @@ bool PipelineShader::bindUBO(const string_t& name, std::shared_ptr<VulkanBuffer>
   if (desc == nullptr) {
     return renderError("Descriptor '" + name + "'could not be found for shader '" + this->name() + "'.");
   }
+  if (desc->_type != type) {
+    return renderError("Descriptor '" + name + "' in shader '" + this->name() + "' is not a " + (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ? "storage buffer." : "uniform buffer."));
+  }
+  if (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && buffer->bufferType() != VulkanBufferType::StorageBuffer) {
+    return renderError("Buffer bound to '" + name + "' was not created as a storage buffer.");
+  }
+  if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+    //Storage buffers can be bound as UBOs, but only a window of them fits a uniform block.
+    VkDeviceSize bound = (range == VK_WHOLE_SIZE) ? buffer->buffer()->totalSizeBytes() - offset : range;
+    if (bound > vulkan()->deviceProperties().limits.maxUniformBufferRange) {
+      return renderError("Range bound to UBO '" + name + "' (" + std::to_string(bound) + " bytes) exceeded maxUniformBufferRange, bind a smaller range.");
+    }
+  }
 
-  VkDescriptorBufferInfo bufferInfo = {
+  DescriptorSlot slot;
+  slot._binding = desc->_binding;
+  slot._arrayElement = 0;
+  slot._type = desc->_type;
+  slot._resourceId = buffer->resourceId();
+  slot._bufferInfo = {
     .buffer = buffer->buffer()->getVkBuffer(),
     .offset = offset,
     .range = range,
   };
-  VkWriteDescriptorSet descWrite = {
-    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-    .pNext = nullptr,
-    .dstSet = _descriptorSets[_pBoundFrame->frameIndex()],
-    .dstBinding = desc->_binding,
-    .dstArrayElement = 0,
-    .descriptorCount = 1,
-    .descriptorType = desc->_type,
-    .pImageInfo = nullptr,
-    .pBufferInfo = &bufferInfo,
-    .pTexelBufferView = nullptr,
-  };
-  vkUpdateDescriptorSets(vulkan()->device(), 1, &descWrite, 0, nullptr);
+  bindSlot(desc->_set, slot);
 
 
 /*
@@ -2939,29 +4300,57 @@ bool PipelineShader::bindSampler(const string_t& name, std::shared_ptr<TextureIm
     return renderError("Descriptor '" + name + "'could not be found for shader.");
   }
 
-  VkDescriptorImageInfo imageInfo = {
+  DescriptorSlot slot;
+  slot._binding = desc->_binding;
+  slot._arrayElement = arrayIndex;  //** Samplers are opaque and thus can be arrayed in GLSL shaders.
+  slot._type = desc->_type;
+  slot._resourceId = texture->resourceId();
+  slot._imageInfo = {
     .sampler = texture->sampler(),
     .imageView = texture->imageView(),
     .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
   };
-  VkWriteDescriptorSet descriptorWrite = {
-    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-    .pNext = nullptr,
-    .dstSet = _descriptorSets[_pBoundFrame->frameIndex()],
-    .dstBinding = desc->_binding,
-    .dstArrayElement = arrayIndex,  //** Samplers are opaque and thus can be arrayed in GLSL shaders.
-    .descriptorCount = 1,
-    .descriptorType = desc->_type,
-    .pImageInfo = &imageInfo,
-    .pBufferInfo = nullptr,
-    .pTexelBufferView = nullptr,
+  bindSlot(desc->_set, slot);
+
+  desc->_isBound = true;
+
+  return true;
+}
+bool PipelineShader::bindImage(const string_t& name, uint64_t resourceId, VkImageView view, VkImageLayout layout, VkSampler sampler) {
+  if (!beginPassGood()) {
+    return false;
+  }
+  auto desc = getDescriptor(name);
+  if (desc == nullptr) {
+    return renderError("Descriptor '" + name + "'could not be found for shader.");
+  }
+  if (desc->_type != VK_DESCRIPTOR_TYPE_STORAGE_IMAGE && desc->_type != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+    return renderError("Descriptor '" + name + "' was not an image.");
+  }
+  if (view == VK_NULL_HANDLE || (desc->_type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && sampler == VK_NULL_HANDLE)) {
+    return renderError("Tried to bind a null image view or sampler to '" + name + "'.");
+  }
+
+  DescriptorSlot slot;
+  slot._binding = desc->_binding;
+  slot._arrayElement = 0;
+  slot._type = desc->_type;
+  slot._resourceId = resourceId;
+  slot._imageInfo = {
+    .sampler = (desc->_type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) ? sampler : VK_NULL_HANDLE,
+    .imageView = view,
+    .imageLayout = layout,
   };
+  bindSlot(desc->_set, slot);
 
   desc->_isBound = true;
 
-  vkUpdateDescriptorSets(vulkan()->device(), 1, &descriptorWrite, 0, nullptr);
   return true;
 }
+void PipelineShader::bindSlot(uint32_t set, const DescriptorSlot& slot) {
+  //The set is chosen in bindDescriptors from everything bound.
+  _boundSlots[set][slot.key()] = slot;
+}
 string_t PipelineShader::createUniqueFBOName(RenderFrame* frame, ShaderData* data, PassDescription* passdesc) {
   string_t ret = std::string("(") + name() + ").(fbo" + std::to_string((int)data->_framebuffers.size()) + ")";
 
@@ -3110,7 +4499,7 @@ bool PipelineShader::beginRenderPass(CommandBuffer* buf, std::unique_ptr<PassDes
 }
 bool PipelineShader::beginPassGood() {
   //Returns false if the pass has not begun, or the data state is invalid.
-  if (_pBoundFBO == nullptr) {
+  if (_pBoundFBO == nullptr && !_bCompute) {
     return renderError("FBO was not bound calling bindDescriptors");
   }
   if (_pBoundFrame == nullptr) {
@@ -3126,25 +4515,24 @@ Pipeline* PipelineShader::getPipeline(std::shared_ptr<BR2::VertexFormat> vertexF
     BRLogError("Pipeline: ShaderData was not set.");
     return nullptr;
   }
-  Pipeline* pipe = nullptr;
-  for (auto& the_pipe : _pBoundData->_pipelines) {
-    if (the_pipe->primitiveTopology() == topo &&
-        the_pipe->polygonMode() == polymode &&
-        the_pipe->vertexFormat() == vertexFormat &&
-        the_pipe->cullMode() == cullMode &&
-        _pBoundFBO == the_pipe->fbo()) {
-      pipe = the_pipe.get();
-      break;
-    }
-  }
-  if (pipe == nullptr) {
-    std::shared_ptr<BR2::VertexFormat> format = nullptr;  // ** TODO create multiple pipelines for Vertex Format, Polygonmode & Topo.
-    auto pipe_pt = std::make_unique<Pipeline>(vulkan(), topo, polymode, cullMode);
-    pipe = pipe_pt.get();
-    pipe->init(this, format, _pBoundFBO);
-    _pBoundData->_pipelines.push_back(std::move(pipe_pt));
+  if (_pBoundFBO == nullptr) {
+    BRLogError("Pipeline: Framebuffer was not bound.");
+    return nullptr;
   }
-  return pipe;
+  //Pipelines are shared across swapchain frames. Any FBO with a compatible render pass can use the same pipeline.
+  PipelineKey key;
+  key._shader = this;
+  key._renderPass = _pBoundFBO->renderPassKey();
+  key._outputState = _pBoundFBO->passDescription()->pipelineState();
+  key._specConstants = _specConstants;
+  key._renderPassHash = _pBoundFBO->renderPassHash();
+  key._outputStateHash = key._outputState.hash();
+  key._specConstantHash = _specConstantHash;
+  key._vertexFormat = vertexFormat;
+  key._topology = topo;
+  key._polygonMode = polymode;
+  key._cullMode = cullMode;
+  return vulkan()->pipelineCache()->getPipeline(key, _pBoundFBO);
 }
 bool PipelineShader::bindDescriptors(CommandBuffer* cmd) {
   if (!beginPassGood()) {
@@ -3156,8 +4544,34 @@ bool PipelineShader::bindDescriptors(CommandBuffer* cmd) {
     }
   }
 
-  vkCmdBindDescriptorSets(cmd->getVkCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, _pBoundPipeline->getVkPipelineLayout(),
-                          0,  1, &_descriptorSets[_pBoundFrame->frameIndex()], 0, nullptr);
+  for (uint32_t iset = 0; iset < _setLayouts.size(); ++iset) {
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    auto layout = _setLayouts[iset];
+    if (layout == nullptr) {
+      set = vulkan()->bindlessTextures()->getVkDescriptorSet();
+    }
+    else if (layout->empty()) {
+      continue;
+    }
+    else {
+      //Find or create a set holding exactly the bound resources. Sets are never rewritten while in use.
+      //Caches are per frame and shared between shaders, so an unchanged per frame set is the same VkDescriptorSet for every shader.
+      bool hit = false;
+      bool transient = iset >= static_cast<uint32_t>(DescriptorSetFrequency::PerDraw);
+      set = _pBoundFrame->getDescriptorSetCache(layout, transient)->getSet(_boundSlots[iset], hit);
+      if (set == VK_NULL_HANDLE) {
+        return renderError("Failed to get descriptor set " + std::to_string(iset) + " for shader '" + name() + "'.");
+      }
+      if (hit) {
+        _descriptorWritesSkipped += _boundSlots[iset].size();
+      }
+      else {
+        _descriptorWritesFlushed += _boundSlots[iset].size();
+      }
+    }
+    //Sets still bound with a compatible layout are skipped.
+    cmd->bindDescriptorSet(_pBoundPipeline, iset, set);
+  }
   return true;
 }
 bool PipelineShader::shaderError(const string_t& msg) {
@@ -3199,18 +4613,58 @@ bool PipelineShader::bindPipeline(CommandBuffer* cmd, std::shared_ptr<BR2::Verte
   return bindPipeline(cmd, pipe);
 }
 bool PipelineShader::bindPipeline(CommandBuffer* cmd, Pipeline* pipe) {
-  if (pipe->fbo() != _pBoundFBO) {
-    return renderError("Output FBO is not bound to correct pipeline.");
+  if (!pipe->key()._renderPass.compatible(_pBoundFBO->renderPassKey())) {
+    return renderError("Pipeline render pass is not compatible with the bound output FBO.");
   }
 
   vkCmdBindPipeline(cmd->getVkCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipe->getVkPipeline());
   _pBoundPipeline = pipe;
   return true;
 }
-void PipelineShader::drawIndexed(CommandBuffer* cmd, std::shared_ptr<Mesh> m, uint32_t numInstances) {
-  cmd->bindMesh(m);
+bool PipelineShader::validateInstanceStreams(const std::vector<VulkanBuffer*>& instanceStreams, uint32_t numInstances) {
+  if (hasInstanceStream()) {
+    if (instanceStreams.size() != 1) {
+      return renderError("Shader '" + name() + "' reads per instance attributes, exactly one instance stream must be given.");
+    }
+    if (instanceStreams[0]->buffer()->itemSize() != _instanceStride) {
+      return renderError("Instance stream item size " + std::to_string(instanceStreams[0]->buffer()->itemSize()) + " doesn't match the instance attributes of '" + name() + "' (" + std::to_string(_instanceStride) + " bytes).");
+    }
+    if (instanceStreams[0]->buffer()->itemCount() < numInstances) {
+      return renderError("Instance stream for '" + name() + "' is smaller than the instance count.");
+    }
+  }
+  return true;
+}
+void PipelineShader::drawIndexed(CommandBuffer* cmd, std::shared_ptr<Mesh> m, uint32_t numInstances, const std::vector<VulkanBuffer*>& instanceStreams) {
+  if (!validateInstanceStreams(instanceStreams, numInstances)) {
+    return;
+  }
+  cmd->bindMesh(m, instanceStreams);
   cmd->drawIndexed(numInstances);
 }
+void PipelineShader::drawIndexedIndirect(CommandBuffer* cmd, std::shared_ptr<Mesh> m, VulkanBuffer* indirect, VkDeviceSize offset, uint32_t drawCount) {
+  if (hasInstanceStream()) {
+    //The instance count is on the GPU, so a stream can't be validated against it.
+    renderError("Shader '" + name() + "' reads per instance attributes, indirect draws fetch instance data from storage buffers.");
+    return;
+  }
+  cmd->bindMesh(m);
+  cmd->drawIndexedIndirect(indirect, offset, drawCount);
+}
+void PipelineShader::drawIndexedIndirectCount(CommandBuffer* cmd, std::shared_ptr<Mesh> m, VulkanBuffer* indirect, VkDeviceSize offset,
+                                              VulkanBuffer* countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount) {
+  if (!vulkan()->drawIndirectCountSupported()) {
+    //Unwritten draws are left with zero instances.
+    drawIndexedIndirect(cmd, m, indirect, offset, maxDrawCount);
+    return;
+  }
+  if (hasInstanceStream()) {
+    renderError("Shader '" + name() + "' reads per instance attributes, indirect draws fetch instance data from storage buffers.");
+    return;
+  }
+  cmd->bindMesh(m);
+  cmd->drawIndexedIndirectCount(indirect, offset, countBuffer, countOffset, maxDrawCount);
+}
 void PipelineShader::bindViewport(CommandBuffer* cmd, const BR2::urect2& size) {
   cmd->cmdSetViewport(size);
 }
@@ -3251,7 +4705,12 @@ void PipelineShader::clearShaderDataCache(RenderFrame* frame) {
   }
   data = it->second.get();
   data->_framebuffers.clear();
-  data->_pipelines.clear();
+
+  //Render targets are recreated, so their handles may be reused. Forget the bound resources.
+  //The RenderFrame's descriptor set caches are recreated with it.
+  for (auto& slots : _boundSlots) {
+    slots.clear();
+  }
 }
 std::unique_ptr<PassDescription> PipelineShader::getPass(RenderFrame* frame, MSAA sampleCount, BlendFunc globalBlend, FramebufferBlendMode rbm) {
   //@param MSAA - You can't have mixed sample counts except for using the AMD extension to allow varied depth getVkBuffer sample counts.
@@ -3268,6 +4727,73 @@ bool PipelineShader::sampleShadingVariables() {
 
 #pragma endregion
 
+#pragma region ComputeShader
+
+std::unique_ptr<ComputeShader> ComputeShader::create(Vulkan* v, const string_t& name, const string_t& file) {
+  auto s = std::make_unique<ComputeShader>(v, name, file);
+  if (s->init()) {
+    if (!s->isCompute()) {
+      s->shaderError("'" + file + "' is not a compute shader.");
+    }
+    else {
+      auto& size = s->_modules[0]->reflectionData()->entry_points[0].local_size;
+      s->_localSizeX = std::max(size.x, (uint32_t)1);
+      s->_localSizeY = std::max(size.y, (uint32_t)1);
+      s->_localSizeZ = std::max(size.z, (uint32_t)1);
+    }
+  }
+  s->vulkan()->swapchain()->registerShader(s.get());
+  return s;
+}
+ComputeShader::ComputeShader(Vulkan* v, const string_t& name, const string_t& file) : PipelineShader(v, name, std::vector<string_t>{ file }) {
+}
+ComputeShader::~ComputeShader() {
+}
+bool ComputeShader::beginDispatch(CommandBuffer* cmd, RenderFrame* frame) {
+  if (!valid()) {
+    return false;
+  }
+  if (_pBoundPipeline != nullptr) {
+    return renderError("beginDispatch called twice without endDispatch.");
+  }
+  _pBoundFrame = frame;
+  _pBoundData = getShaderData(frame);
+
+  //No render pass or vertex state, the shader and its constants are the whole key.
+  PipelineKey key;
+  key._shader = this;
+  key._specConstants = _specConstants;
+  key._specConstantHash = _specConstantHash;
+  Pipeline* pipe = vulkan()->pipelineCache()->getPipeline(key, nullptr);
+  if (pipe == nullptr || pipe->getVkPipeline() == VK_NULL_HANDLE) {
+    endDispatch();
+    return renderError("Failed to get compute pipeline.");
+  }
+  vkCmdBindPipeline(cmd->getVkCommandBuffer(), VK_PIPELINE_BIND_POINT_COMPUTE, pipe->getVkPipeline());
+  _pBoundPipeline = pipe;
+  return true;
+}
+bool ComputeShader::dispatch(CommandBuffer* cmd, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) {
+  if (!bindDescriptors(cmd)) {
+    return false;
+  }
+  cmd->dispatch(groupsX, groupsY, groupsZ);
+  return true;
+}
+bool ComputeShader::dispatchItems(CommandBuffer* cmd, uint32_t itemCount) {
+  if (itemCount == 0) {
+    return true;
+  }
+  return dispatch(cmd, (itemCount + _localSizeX - 1) / _localSizeX);
+}
+void ComputeShader::endDispatch() {
+  _pBoundPipeline = nullptr;
+  _pBoundData = nullptr;
+  _pBoundFrame = nullptr;
+}
+
+#pragma endregion
+
 #pragma region ShaderData
 
 ShaderDataUBO* ShaderData::getUBOData(const string_t& name) {
@@ -3285,9 +4811,33 @@ ShaderDataUBO* ShaderData::getUBOData(const string_t& name) {
 RenderFrame::RenderFrame(Vulkan* v) : VulkanObject(v) {
 }
 RenderFrame::~RenderFrame() {
+  for (auto& caches : _descriptorSetCaches) {
+    caches.clear();
+  }
+  _pDescriptorAllocator = nullptr;
   vkDestroySemaphore(vulkan()->device(), _imageAvailableSemaphore, nullptr);
   vkDestroySemaphore(vulkan()->device(), _renderFinishedSemaphore, nullptr);
   vkDestroyFence(vulkan()->device(), _inFlightFence, nullptr);
+  if (_timestampPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(vulkan()->device(), _timestampPool, nullptr);
+  }
+  if (_pipelineStatsPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(vulkan()->device(), _pipelineStatsPool, nullptr);
+  }
+}
+DescriptorSetCache* RenderFrame::getDescriptorSetCache(DescriptorSetLayout* layout, bool transient) {
+  //Layouts are shared, so one can be a per draw set in one shader and a per pass set in another. Each gets its own cache.
+  if (_pDescriptorAllocator == nullptr) {
+    _pDescriptorAllocator = std::make_unique<DescriptorPoolAllocator>(vulkan());
+  }
+  auto& caches = _descriptorSetCaches[transient ? 1 : 0];
+  auto it = caches.find(layout);
+  if (it == caches.end()) {
+    auto cache = std::make_unique<DescriptorSetCache>(vulkan(), layout, _pDescriptorAllocator.get(), transient);
+    cache->beginFrame(_frameNumber);
+    it = caches.insert(std::make_pair(layout, std::move(cache))).first;
+  }
+  return it->second.get();
 }
 void RenderFrame::addRenderTarget(OutputMRT output, MSAA samples, std::shared_ptr<TextureImage> tex) {
 }
@@ -3375,6 +4925,8 @@ void RenderFrame::init(Swapchain* ps, uint32_t frameIndex, VkImage swapImg, VkSu
   _frameIndex = frameIndex;
 
   createSyncObjects();
+  createTimestampQueries();
+  createPipelineStatsQueries();
   string_t errors;
   if (getRenderTarget(OutputMRT::RT_DefaultColor, MSAA::Disabled, fmt.format, errors, swapImg, true) == nullptr) {
     BRThrowException("Failed to create swapchain render target: " + errors)
@@ -3399,6 +4951,95 @@ void RenderFrame::createSyncObjects() {
 
   CheckVKR(vkCreateFence, vulkan()->device(), &fenceInfo, nullptr, &_inFlightFence);
 }
+void RenderFrame::createTimestampQueries() {
+  if (!vulkan()->deviceProperties().limits.timestampComputeAndGraphics) {
+    BRLogWarnOnce("Device doesn't support timestamps on the graphics queue, GPU frame times are unavailable.");
+    return;
+  }
+  VkQueryPoolCreateInfo poolInfo = {
+    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .queryType = VK_QUERY_TYPE_TIMESTAMP,
+    .queryCount = 2,
+    .pipelineStatistics = 0,
+  };
+  CheckVKR(vkCreateQueryPool, vulkan()->device(), &poolInfo, nullptr, &_timestampPool);
+}
+void RenderFrame::createPipelineStatsQueries() {
+  if (!vulkan()->deviceFeatures().pipelineStatisticsQuery) {
+    BRLogWarnOnce("Device doesn't support pipeline statistics queries, fragment invocation counts are unavailable.");
+    return;
+  }
+  //Results are written in bit order, see PipelineStats.
+  VkQueryPoolCreateInfo poolInfo = {
+    .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+    .pNext = nullptr,
+    .flags = 0,
+    .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+    .queryCount = 1,
+    .pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                          VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                          VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+  };
+  CheckVKR(vkCreateQueryPool, vulkan()->device(), &poolInfo, nullptr, &_pipelineStatsPool);
+}
+void RenderFrame::beginGpuTimer() {
+  if (_timestampPool == VK_NULL_HANDLE) {
+    return;
+  }
+  _pCommandBuffer->resetQueryPool(_timestampPool, 0, 2);
+  _pCommandBuffer->writeTimestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestampPool, 0);
+}
+void RenderFrame::endGpuTimer() {
+  if (_timestampPool == VK_NULL_HANDLE) {
+    return;
+  }
+  _pCommandBuffer->writeTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestampPool, 1);
+  _bGpuTimerWritten = true;
+}
+void RenderFrame::beginPipelineStats() {
+  if (_pipelineStatsPool == VK_NULL_HANDLE) {
+    return;
+  }
+  _pCommandBuffer->resetQueryPool(_pipelineStatsPool, 0, 1);
+  _pCommandBuffer->beginQuery(_pipelineStatsPool, 0);
+}
+void RenderFrame::endPipelineStats() {
+  if (_pipelineStatsPool == VK_NULL_HANDLE) {
+    return;
+  }
+  _pCommandBuffer->endQuery(_pipelineStatsPool, 0);
+  _bPipelineStatsWritten = true;
+}
+void RenderFrame::readPipelineStats() {
+  _pipelineStats._valid = false;
+  if (!_bPipelineStatsWritten) {
+    return;
+  }
+  _bPipelineStatsWritten = false;
+  uint64_t counts[3] = { 0, 0, 0 };
+  VkResult res = vkGetQueryPoolResults(vulkan()->device(), _pipelineStatsPool, 0, 1, sizeof(counts), counts, sizeof(counts), VK_QUERY_RESULT_64_BIT);
+  if (res == VK_SUCCESS) {
+    _pipelineStats._vertexInvocations = counts[0];
+    _pipelineStats._clippingPrimitives = counts[1];
+    _pipelineStats._fragmentInvocations = counts[2];
+    _pipelineStats._valid = true;
+  }
+}
+void RenderFrame::readGpuTimer() {
+  //The in flight fence was waited, so the queries of the last submit are available.
+  _gpuTimeMs = -1;
+  if (!_bGpuTimerWritten) {
+    return;
+  }
+  _bGpuTimerWritten = false;
+  uint64_t stamps[2] = { 0, 0 };
+  VkResult res = vkGetQueryPoolResults(vulkan()->device(), _timestampPool, 0, 2, sizeof(stamps), stamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (res == VK_SUCCESS) {
+    _gpuTimeMs = (double)(stamps[1] - stamps[0]) * (double)vulkan()->deviceProperties().limits.timestampPeriod / 1000000.0;
+  }
+}
 bool RenderFrame::beginFrame() {
   //I feel like the async aspect of RenderFrame might need to be a separate DispatchedFrame structure or..
   VkResult res = VK_SUCCESS;
@@ -3422,6 +5063,8 @@ bool RenderFrame::beginFrame() {
       BRLogWarnOnce("Unhandled return code from vkWaitForFences '" + std::to_string((int)res) + "'");
     }
   }
+  readGpuTimer();
+  readPipelineStats();
 
   //The semaphore passed into vkAcquireNextImageKHR makes sure the iamge is not still being read to via the VkQueueSubmit. You must use the same semaphore for both images.
   res = vkAcquireNextImageKHR(vulkan()->device(), _pSwapchain->getVkSwapchain(), wait_fences, _imageAvailableSemaphore, VK_NULL_HANDLE, &_currentRenderingImageIndex);
@@ -3451,6 +5094,15 @@ bool RenderFrame::beginFrame() {
 
   _pSwapchain->waitImage(_currentRenderingImageIndex, _inFlightFence);
 
+  _frameNumber++;
+  if (_pDescriptorAllocator) {
+    _pDescriptorAllocator->beginFrame();
+  }
+  for (auto& caches : _descriptorSetCaches) {
+    for (auto& it : caches) {
+      it.second->beginFrame(_frameNumber);
+    }
+  }
   _frameState = FrameState::FrameBegin;
   return true;
 }
@@ -3992,6 +5644,8 @@ Vulkan::~Vulkan() {
   CheckVKRV(vkDeviceWaitIdle, _device);
 
   _pSwapchain = nullptr;
+  _pBindlessTextures = nullptr;
+  _pPipelineCache = nullptr;
   _pQueueFamilies = nullptr;
 
   vkDestroyCommandPool(_device, _commandPool, nullptr);
@@ -4021,6 +5675,13 @@ void Vulkan::initVulkan(const string_t& title, SDL_Window* win, bool enableDebug
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  _pPipelineCache = std::make_unique<PipelineCache>(this);
+  if (_bDescriptorIndexing) {
+    _pBindlessTextures = std::make_unique<BindlessTextureTable>(this);
+    if (!_pBindlessTextures->init()) {
+      _pBindlessTextures = nullptr;
+    }
+  }
 }
 void Vulkan::createInstance(const string_t& title, SDL_Window* win, bool enableDebug) {
   _pDebug = std::make_unique<VulkanDebug>(this, enableDebug);
@@ -4031,7 +5692,7 @@ void Vulkan::createInstance(const string_t& title, SDL_Window* win, bool enableD
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = VK_API_VERSION_1_1;  //1.1 for vkGetPhysicalDeviceFeatures2 (descriptor indexing)
 
   VkInstanceCreateInfo createinfo{};
   createinfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -4246,7 +5907,9 @@ std::vector<const char*> Vulkan::getEnabledDeviceExtensions() {
   };
   //Optional
   const std::vector<const char*> optinalExtensions = {
-    VK_AMD_MIXED_ATTACHMENT_SAMPLES_EXTENSION_NAME
+    VK_AMD_MIXED_ATTACHMENT_SAMPLES_EXTENSION_NAME,
+    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,  //Bindless textures
+    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME   //GPU culled draw counts
   };
 
   string_t extMsg = "";
@@ -4293,6 +5956,11 @@ void Vulkan::createLogicalDevice() {
   VkPhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.geometryShader = VK_TRUE;
   deviceFeatures.fillModeNonSolid = VK_TRUE;
+  //Optional, indirect draws with drawCount > 1 and firstInstance != 0.
+  deviceFeatures.multiDrawIndirect = _deviceFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance = _deviceFeatures.drawIndirectFirstInstance;
+  //Optional, RenderFrame::beginPipelineStats.
+  deviceFeatures.pipelineStatisticsQuery = _deviceFeatures.pipelineStatisticsQuery;
   //widelines, largepoints, individualBlendState
 
   // Queues
@@ -4315,9 +5983,14 @@ void Vulkan::createLogicalDevice() {
   //Check Device Extensions
   std::vector<const char*> extensions = getEnabledDeviceExtensions();
 
+  //Descriptor indexing (bindless)
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  _bDescriptorIndexing = extensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) && checkDescriptorIndexingFeatures(indexingFeatures);
+
   // Logical Device
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = _bDescriptorIndexing ? &indexingFeatures : nullptr;
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.pEnabledFeatures = &deviceFeatures;
@@ -4333,6 +6006,43 @@ void Vulkan::createLogicalDevice() {
   //**0 is the queue index - this should be checke to make sure that it's less than the queue family size.
   vkGetDeviceQueue(_device, _pQueueFamilies->_graphicsFamily.value(), 0, &_graphicsQueue);
   vkGetDeviceQueue(_device, _pQueueFamilies->_presentFamily.value(), 0, &_presentQueue);
+
+  if (extensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+    vkCmdDrawIndexedIndirectCountKHR = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR");
+  }
+}
+bool Vulkan::checkDescriptorIndexingFeatures(VkPhysicalDeviceDescriptorIndexingFeaturesEXT& out_features) {
+  //Returns the features to enable for the bindless texture table, false if they aren't all supported.
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+    .pNext = nullptr,
+  };
+  VkPhysicalDeviceFeatures2 features2 = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    .pNext = &supported,
+  };
+  vkGetPhysicalDeviceFeatures2(_physicalDevice, &features2);
+
+  if (!supported.shaderSampledImageArrayNonUniformIndexing ||
+      !supported.descriptorBindingSampledImageUpdateAfterBind ||
+      !supported.descriptorBindingUpdateUnusedWhilePending ||
+      !supported.descriptorBindingPartiallyBound ||
+      !supported.descriptorBindingVariableDescriptorCount ||
+      !supported.runtimeDescriptorArray) {
+    BRLogWarn("VK_EXT_descriptor_indexing is missing features needed for bindless textures.");
+    return false;
+  }
+  out_features = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+    .pNext = nullptr,
+    .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+    .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+    .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+    .descriptorBindingPartiallyBound = VK_TRUE,
+    .descriptorBindingVariableDescriptorCount = VK_TRUE,
+    .runtimeDescriptorArray = VK_TRUE,
+  };
+  return true;
 }
 Vulkan::QueueFamilies* Vulkan::findQueueFamilies() {
   if (_pQueueFamilies != nullptr) {
@@ -4500,6 +6210,12 @@ void Vulkan::endOneTimeGraphicsCommands(VkCommandBuffer commandBuffer) {
 Swapchain* Vulkan::swapchain() {
   return _pSwapchain.get();
 }
+PipelineCache* Vulkan::pipelineCache() {
+  return _pPipelineCache.get();
+}
+BindlessTextureTable* Vulkan::bindlessTextures() {
+  return _pBindlessTextures.get();
+}
 void Vulkan::waitIdle() {
   //A fence that waits for the GPU to finish operations.
   CheckVKRV(vkDeviceWaitIdle, device());
@@ -22,6 +22,11 @@ public:
   VulkanObject(Vulkan* dev) { _vulkan = dev; }
   virtual ~VulkanObject() {}
   Vulkan* vulkan() { return _vulkan; }
+  //Unique for the process lifetime. Vk handles are reused once destroyed, so anything keyed on resources uses these.
+  static uint64_t newResourceId() {
+    static std::atomic<uint64_t> s_next{ 1 };
+    return s_next++;
+  }
 };
 class VulkanObjectShared : public VulkanObject, public SharedObject<VulkanObject> {
 public:
@@ -46,6 +51,8 @@ public:
   void copy_from(void* src_buf, size_t copy_count_items, size_t data_offset_items, size_t device_offset_item);
   void copy_to(void* dst_buf, size_t copy_count_items, size_t data_offset_items, size_t buffer_offset_items);
   void copy_device(VulkanDeviceBuffer* host_buf, size_t item_copyCount, size_t itemOffset_Host, size_t itemOffset_Gpu);
+  void* map();  //Maps the whole getVkBuffer so it can be written in place. Host buffers only.
+  void unmap();
   static uint32_t findMemoryType(VkPhysicalDevice d, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 private:
@@ -70,8 +77,12 @@ public:
   virtual ~VulkanBuffer() override;
 
   VulkanDeviceBuffer* buffer();
+  VulkanBufferType bufferType() { return _eType; }
+  uint64_t resourceId() { return _resourceId; }
 
   void writeData(void* items, size_t item_count, size_t item_offset = 0);
+  void* mapData();  //Write in place, without the copy. Not for staged buffers.
+  void unmapData();
 
 private:
   std::unique_ptr<VulkanDeviceBuffer> _hostBuffer = nullptr;
@@ -79,6 +90,7 @@ private:
 
   VulkanBufferType _eType = VulkanBufferType::VertexBuffer;
   bool _bUseStagingBuffer = false;
+  uint64_t _resourceId = newResourceId();
 };
 /**
 * @class FilterData
@@ -126,6 +138,8 @@ public:
   uint32_t mipLevels() { return _filter._mipLevels; }  //See ifthese are actually used.
   bool error() { return _error; }
   const FilterData& filter() { return _filter; }
+  uint64_t resourceId() { return _resourceId; }
+  uint32_t bindlessIndex() { return _bindlessIndex; }  //Index into the BindlessTextureTable, or BindlessTextureTable::c_invalidIndex
 
   static VkSampleCountFlagBits multisampleToVkSampleCountFlagBits(MSAA s);
   static VkSamplerMipmapMode convertMipmapMode(MipmapMode mode, TexFilter filter);
@@ -156,8 +170,11 @@ protected:
   VkImageUsageFlags _transferSrc = (VkImageUsageFlags)0;
   bool _error = false;
   bool _ownsImage = true;
+  uint64_t _resourceId = newResourceId();
+  uint32_t _bindlessIndex = 0xFFFFFFFF;
 
   void cleanup();
+  void registerBindless();
   void createGPUImage();  // = VK_IMAGE_LAYOUT_UNDEFINED
   void createView();      // = 1
   void createSampler();
@@ -194,17 +211,55 @@ public:
                  VkImageAspectFlagBits aspectFlags, VkFilter filter);
   void imageTransferBarrier(VkImage image, VkAccessFlagBits srcAccessFlags, VkAccessFlagBits dstAccessFlags,
                             VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, VkImageAspectFlagBits subresourceMask);
+  //Any stages, and a mip range. Outside of render passes.
+  void imageBarrier(VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+                    VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess,
+                    uint32_t baseMipLevel = 0, uint32_t mipLevelCount = VK_REMAINING_MIP_LEVELS);
   void validateState(bool b);
   void copyBuffer(VkBuffer from, VkBuffer to, size_t count, size_t from_offset, size_t to_offset);
-  void bindMesh(std::shared_ptr<Mesh> mesh);
-  void drawIndexed(uint32_t instanceCount);
+  void bufferBarrier(VkBuffer buffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+  void bindMesh(std::shared_ptr<Mesh> mesh, const std::vector<VulkanBuffer*>& instanceStreams = {});  //Instance streams bind after the mesh.
+  void drawIndexed(uint32_t instanceCount, uint32_t firstInstance = 0);
+  void drawIndexedIndirect(VulkanBuffer* indirect, VkDeviceSize offset, uint32_t drawCount, uint32_t stride = sizeof(VkDrawIndexedIndirectCommand));
+  void drawIndexedIndirectCount(VulkanBuffer* indirect, VkDeviceSize offset, VulkanBuffer* countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount,
+                                uint32_t stride = sizeof(VkDrawIndexedIndirectCommand));  //Requires Vulkan::drawIndirectCountSupported()
+  //draws uploaded to indirect (e.g. by IndirectDrawBuilder). Returns the vkCmdDraw* calls recorded.
+  uint32_t drawIndexedBatch(VulkanBuffer* indirect, const std::vector<VkDrawIndexedIndirectCommand>& draws);
+  void dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ);
+  void resetQueryPool(VkQueryPool pool, uint32_t firstQuery, uint32_t queryCount);
+  void writeTimestamp(VkPipelineStageFlagBits stage, VkQueryPool pool, uint32_t query);
+  void beginQuery(VkQueryPool pool, uint32_t query);
+  void endQuery(VkQueryPool pool, uint32_t query);
+  void pushConstants(Pipeline* pipe, uint32_t offset, uint32_t size, const void* data);
+  bool bindDescriptorSet(Pipeline* pipe, uint32_t set, VkDescriptorSet descriptorSet);
+  uint64_t descriptorSetBinds() { return _descriptorSetBinds; }
+  uint64_t descriptorSetBindsSkipped() { return _descriptorSetBindsSkipped; }
+  template <typename T>
+  void pushConstants(Pipeline* pipe, const T& data, uint32_t offset = 0) {
+    static_assert(std::is_trivially_copyable<T>::value, "Push constant data must be POD.");
+    static_assert(sizeof(T) % 4 == 0, "Push constant size must be a multiple of 4.");
+    pushConstants(pipe, offset, static_cast<uint32_t>(sizeof(T)), &data);
+  }
 
 private:
   CommandBufferState _state = CommandBufferState::Unset;
   RenderFrame* _pRenderFrame = nullptr;
   VkCommandPool _sharedPool = VK_NULL_HANDLE;       //Do not free
   VkCommandBuffer _commandBuffer = VK_NULL_HANDLE;  //_commandBuffers;
+  class BoundDescriptorSets {
+  public:
+    std::vector<VkDescriptorSetLayout> _setLayouts;  //Layouts the bound sets are compatible with.
+    std::vector<VkPushConstantRange> _pushConstantRanges;
+    std::vector<VkDescriptorSet> _sets;
+  };
+
   VulkanBuffer* _pBoundIndexes = nullptr;
+  uint32_t _boundIndexCount = 0;  //LOD 0 of the bound mesh, the buffer also holds the coarser levels.
+  BoundDescriptorSets _boundGraphics;  //Graphics and compute bind points have separate descriptor sets.
+  BoundDescriptorSets _boundCompute;
+  uint64_t _descriptorSetBinds = 0;
+  uint64_t _descriptorSetBindsSkipped = 0;
+  static constexpr uint32_t c_maxVertexStreams = 8;
 };
 /**
  * @class UBOClassData
@@ -236,11 +291,27 @@ public:
   VkPipelineShaderStageCreateInfo getPipelineStageCreateInfo();
   SpvReflectShaderModule* reflectionData();
   const string_t& name();
+  const std::vector<std::unique_ptr<SpecConstant>>& specConstants();
+  SpecConstant* getSpecConstant(const string_t& name);
+  void updateSpecializationInfo();
 
 private:
   class ShaderModule_Internal;
   std::unique_ptr<ShaderModule_Internal> _pInt;
 };
+/**
+ * @class SpecConstant
+ * @brief Specialization constant reflected from SPIR-V. GLSL: layout(constant_id = ..) const ..
+ * @details Values are baked into the pipeline, so changing one creates a new pipeline variant.
+ * */
+class SpecConstant {
+public:
+  string_t _name = "";
+  uint32_t _constantId = 0;
+  SpecConstantType _type = SpecConstantType::Int;
+  uint32_t _defaultValue = 0;  //Raw 32 bit value from the shader.
+  uint32_t _value = 0;
+};
 /**
  * @class Descriptor
  * @brief Shader input descriptor.
@@ -249,24 +320,183 @@ class Descriptor {
 public:
   string_t _name = "";
   VkDescriptorType _type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+  uint32_t _set = 0;      //Descriptor set index. GLSL: layout(set = ..)
   uint32_t _binding = 0;  //The acutal binding index. GLSL: layout(location = ..)
   uint32_t _arraySize = 0;
   uint32_t _blockSizeBytes = 0;
   uint32_t _bufferSizeBytes = 0;
+  uint32_t _runtimeArrayStride = 0;  //SSBO blocks ending in a runtime array (T items[];). _bufferSizeBytes is then the fixed part only.
   ShaderStage _stage;
   bool _isBound = false;
   DescriptorFunction _function = DescriptorFunction::Unset; //Used by the engine to auto update common descriptors (lights/MVP matrix), Custom if not auto.
 };
+/**
+ * @class DescriptorSlot
+ * @brief One resource bound to a descriptor (binding + array element).
+ * */
+class DescriptorSlot {
+public:
+  uint32_t _binding = 0;
+  uint32_t _arrayElement = 0;
+  VkDescriptorType _type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+  uint64_t _resourceId = 0;  //VulkanObject::newResourceId() of the bound resource, the handles alone can be reused.
+  VkDescriptorBufferInfo _bufferInfo = {};
+  VkDescriptorImageInfo _imageInfo = {};
+  bool equals(const DescriptorSlot& rhs) const;
+  size_t hash() const;
+  bool isImage() const { return _type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || _type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE; }
+  uint64_t key() const { return ((uint64_t)_binding << 32) | (uint64_t)_arrayElement; }
+};
+typedef std::map<uint64_t, DescriptorSlot> DescriptorSlots;  //Ordered so the hash is stable.
+/**
+ * @union DescriptorInfo
+ * @brief One element of the packed data passed to a DescriptorUpdateTemplate.
+ * */
+union DescriptorInfo {
+  VkDescriptorBufferInfo _buffer;
+  VkDescriptorImageInfo _image;
+};
+/**
+ * @class DescriptorUpdateTemplate
+ * @brief VkDescriptorUpdateTemplate for a descriptor set layout, built from reflection.
+ * @details The data is a packed array of DescriptorInfo, one per descriptor array element, ordered by binding.
+ *          A POD struct with one VkDescriptorBufferInfo/VkDescriptorImageInfo per element in binding order has the same layout.
+ * */
+class DescriptorUpdateTemplate : public VulkanObject {
+public:
+  DescriptorUpdateTemplate(Vulkan* v);
+  virtual ~DescriptorUpdateTemplate() override;
+
+  bool init(VkDescriptorSetLayout layout, const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+  size_t elementCount() { return _elementCount; }
+  size_t dataSize() { return _elementCount * sizeof(DescriptorInfo); }
+  bool pack(const DescriptorSlots& slots, std::vector<DescriptorInfo>& out_data);
+  void update(VkDescriptorSet set, const void* data);
+  template <typename T>
+  void update(VkDescriptorSet set, const T& data) {
+    static_assert(std::is_trivially_copyable<T>::value, "Descriptor data must be POD.");
+    AssertOrThrow2(sizeof(T) == dataSize());
+    update(set, (const void*)&data);
+  }
+
+private:
+  VkDescriptorUpdateTemplate _template = VK_NULL_HANDLE;
+  std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> _bindingRanges;  //Binding -> (first element, descriptorCount)
+  size_t _elementCount = 0;
+};
+/**
+ * @class DescriptorSetLayout
+ * @brief A descriptor set layout with its pool sizes and update template.
+ * @details Shared by every shader declaring the same bindings (see PipelineCache::getDescriptorSetLayout),
+ *          so pipeline layouts built from them are compatible and their sets can stay bound between shaders.
+ * */
+class DescriptorSetLayout : public VulkanObject {
+public:
+  DescriptorSetLayout(Vulkan* v);
+  virtual ~DescriptorSetLayout() override;
+
+  bool init(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+  VkDescriptorSetLayout getVkDescriptorSetLayout() { return _layout; }
+  const std::vector<VkDescriptorSetLayoutBinding>& bindings() { return _bindings; }
+  const std::vector<VkDescriptorPoolSize>& poolSizes() { return _poolSizes; }  //Descriptor counts for one set.
+  DescriptorUpdateTemplate* updateTemplate() { return _pUpdateTemplate.get(); }
+  bool empty() { return _bindings.size() == 0; }
+  bool equals(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+  static size_t hash(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+private:
+  VkDescriptorSetLayout _layout = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSetLayoutBinding> _bindings;  //Sorted by binding
+  std::vector<VkDescriptorPoolSize> _poolSizes;
+  std::unique_ptr<DescriptorUpdateTemplate> _pUpdateTemplate = nullptr;
+};
+/**
+ * @class DescriptorPoolAllocator
+ * @brief Pool of descriptor pools for one swapchain frame, shared by every shader and set layout.
+ * @details Pools are sized by a fixed ratio of descriptor types, so no per-shader tuning is needed.
+ *          When a pool runs out (VK_ERROR_OUT_OF_POOL_MEMORY) the next one is taken from the free list or created.
+ *          Transient pools are reset whole at the start of the frame, persistent pools live as long as the frame.
+ * */
+class DescriptorPoolAllocator : public VulkanObject {
+public:
+  static constexpr uint32_t c_setsPerPool = 256;
+
+  DescriptorPoolAllocator(Vulkan* v);
+  virtual ~DescriptorPoolAllocator() override;
+
+  void beginFrame();
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout, bool transient);
+  size_t poolCount() { return _persistent._pools.size() + _transient._pools.size() + _freePools.size(); }
+  size_t freePoolCount() { return _freePools.size(); }
+  uint64_t allocatedSets() { return _allocatedSets; }
+  uint64_t poolsCreated() { return _poolsCreated; }
+  uint64_t poolResets() { return _poolResets; }
+
+private:
+  class PoolList {
+  public:
+    std::vector<VkDescriptorPool> _pools;  //Last is the current pool
+  };
+  VkDescriptorPool nextPool();
+  VkDescriptorPool createPool();
+
+  PoolList _persistent;
+  PoolList _transient;
+  std::vector<VkDescriptorPool> _freePools;
+  uint64_t _allocatedSets = 0;
+  uint64_t _poolsCreated = 0;
+  uint64_t _poolResets = 0;
+};
+/**
+ * @class DescriptorSetCache
+ * @brief Descriptor sets for one set layout on one swapchain frame, cached by the resources bound to them.
+ * @details A set is written once when it's created and never changed after, so any draw binding
+ *          the same resources gets the same set. Sets that weren't used the last time this frame was rendered
+ *          are recycled (the frame's fence has been waited so they aren't in flight).
+ *          Transient caches (per draw sets) only dedupe within a frame, their pools are reset every frame.
+ * */
+class DescriptorSetCache : public VulkanObject {
+public:
+  DescriptorSetCache(Vulkan* v, DescriptorSetLayout* layout, DescriptorPoolAllocator* allocator, bool transient);
+  virtual ~DescriptorSetCache() override;
+
+  void beginFrame(uint64_t frameNumber);
+  VkDescriptorSet getSet(const DescriptorSlots& slots, bool& out_hit);
+  size_t setCount() { return _sets.size(); }
+  size_t freeSetCount() { return _free.size(); }
+  bool transient() { return _bTransient; }
+
+private:
+  class CachedSet {
+  public:
+    DescriptorSlots _slots;
+    VkDescriptorSet _set = VK_NULL_HANDLE;
+    uint64_t _lastUsedFrame = 0;
+  };
+  void writeSet(VkDescriptorSet set, const DescriptorSlots& slots);
+
+  DescriptorSetLayout* _layout = nullptr;  //Owned by the PipelineCache
+  DescriptorPoolAllocator* _pAllocator = nullptr;  //Owned by the RenderFrame
+  bool _bTransient = false;
+  std::vector<DescriptorInfo> _templateData;
+  std::unordered_multimap<size_t, CachedSet> _sets;
+  std::vector<VkDescriptorSet> _free;
+  uint64_t _frameNumber = 0;
+};
 /**
  * Vertex attribute
  * TODO: use BR2 attribs.
  * */
 class VertexAttribute {
 public:
+  static constexpr const char* c_instancePrefix = "_inst";  //e.g. layout(location = 4) in mat4 _instModel; Read per instance from the instance stream.
+
   string_t _name = "";
   uint32_t _componentSizeBytes = 0;  //Size of EACH component
   uint32_t _componentCount = 0;
   uint32_t _matrixSize = 0;  //Number of entries 4, 9, 16 ..
+  uint32_t _matrixColumns = 0;  //Each column takes a location.
+  bool _perInstance = false;
   //VkFormat _format; //TODO ,  FYI Attribute formats use colors.
   VkVertexInputAttributeDescription _desc;
   SpvReflectTypeFlags _typeFlags;
@@ -380,6 +610,25 @@ private:
   std::shared_ptr<TextureImage> _texture = nullptr;
   Swapchain* _swapchain = nullptr;
 };
+/**
+ * @class PipelineOutputState
+ * @brief Output state baked into a pipeline that isn't part of the render pass - blending, depth compare.
+ * */
+class PipelineOutputState {
+public:
+  struct Output {
+    FBOType _type = FBOType::Undefined;
+    OutputMRT _output = OutputMRT::RT_DefaultColor;
+    BlendFunc _blending = BlendFunc::Disabled;
+    CompareOp _compareOp = CompareOp::Less;
+  };
+  FramebufferBlendMode _blendMode = FramebufferBlendMode::Global;
+  BlendFunc _globalBlend = BlendFunc::Disabled;
+  std::vector<Output> _outputs;
+
+  size_t hash() const;
+  bool equals(const PipelineOutputState& rhs) const;
+};
 /**
  * @class PassDescription
  * @brief Describes a rendering pass FBO
@@ -401,6 +650,7 @@ public:
   uint32_t colorOutputCount();
   BlendFunc globalBlend() { return _globalBlend; }
   FramebufferBlendMode blendMode() { return _blendMode; }
+  PipelineOutputState pipelineState();
 
 private:
   bool passError(const string_t& msg);
@@ -414,6 +664,26 @@ private:
   FramebufferBlendMode _blendMode = FramebufferBlendMode::Global;
   BlendFunc _globalBlend = BlendFunc::Disabled;
 };
+/**
+ * @class RenderPassKey
+ * @brief Everything needed to create a VkRenderPass.
+ * @details Framebuffers fill this out and get their render pass from the PipelineCache, so identical passes
+ *          (e.g. the same pass on every swapchain frame) share one VkRenderPass.
+ *          Compatible = same attachment formats, sample counts and references. Pipelines only need a compatible pass.
+ *          Exact = compatible + load/store ops and layouts. vkCmdBeginRenderPass needs the exact pass.
+ * */
+class RenderPassKey {
+public:
+  std::vector<VkAttachmentDescription> _attachments;
+  std::vector<VkAttachmentReference> _colorRefs;
+  std::vector<VkAttachmentReference> _resolveRefs;
+  std::vector<VkAttachmentReference> _depthRefs;
+
+  size_t compatibleHash() const;
+  size_t exactHash() const;
+  bool compatible(const RenderPassKey& rhs) const;
+  bool equals(const RenderPassKey& rhs) const;
+};
 /**
  * @class FramebufferAttachment
  * */
@@ -463,6 +733,9 @@ public:
   std::vector<std::unique_ptr<FramebufferAttachment>>& attachments() { return _attachments; }
   PassDescription* passDescription() { return _passDescription.get(); }
 
+  const RenderPassKey& renderPassKey() { return _renderPassKey; }
+  size_t renderPassHash() { return _renderPassHash; }
+
   bool create(const string_t& name, RenderFrame* frame, std::unique_ptr<PassDescription> desc);
   bool pipelineError(const string_t& msg);
   uint32_t nextLocation();
@@ -479,42 +752,112 @@ private:
   std::vector<std::unique_ptr<FramebufferAttachment>> _attachments;
   RenderFrame* _frame = nullptr;
   std::unique_ptr<PassDescription> _passDescription = nullptr;
-  VkRenderPass _renderPass = VK_NULL_HANDLE;
+  VkRenderPass _renderPass = VK_NULL_HANDLE;  //Shared, owned by the PipelineCache
+  RenderPassKey _renderPassKey;
+  size_t _renderPassHash = 0;  //Compatible hash
   bool _bValid = true;
   uint32_t _currentLocation = 0;
 };
+/**
+ * @class PipelineKey
+ * @brief Identifies a Pipeline in the PipelineCache.
+ * @details The render pass is matched by compatibility so one pipeline serves every swapchain frame.
+ *          The hashes only pick the bucket, equals() compares the state itself.
+ * */
+class PipelineKey {
+public:
+  PipelineShader* _shader = nullptr;
+  RenderPassKey _renderPass;  //Compared with RenderPassKey::compatible()
+  PipelineOutputState _outputState;
+  std::vector<std::pair<uint32_t, uint32_t>> _specConstants;  //PipelineShader::specConstants()
+  size_t _renderPassHash = 0;    //RenderPassKey::compatibleHash()
+  size_t _outputStateHash = 0;   //PipelineOutputState::hash()
+  size_t _specConstantHash = 0;  //PipelineShader::specConstantHash()
+  std::shared_ptr<BR2::VertexFormat> _vertexFormat = nullptr;
+  VkPrimitiveTopology _topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkPolygonMode _polygonMode = VK_POLYGON_MODE_FILL;
+  VkCullModeFlags _cullMode = VK_CULL_MODE_NONE;
+
+  size_t hash() const;
+  bool equals(const PipelineKey& rhs) const;
+};
 /**
  * @class Pipeline
  * @brief Essentially, a GL ShaderProgram with VAO state.
  * */
 class Pipeline : public VulkanObject {
 public:
-  Pipeline(Vulkan* v,
-           VkPrimitiveTopology topo,
-           VkPolygonMode mode, VkCullModeFlags cm);
+  Pipeline(Vulkan* v, const PipelineKey& key);
   virtual ~Pipeline() override;
   bool init(PipelineShader* shader,
             std::shared_ptr<BR2::VertexFormat> vtxFormat,
             Framebuffer* fbo);
+  bool initCompute(PipelineShader* shader);
 
   VkPipeline getVkPipeline() { return _pipeline; }
   VkPipelineLayout getVkPipelineLayout() { return _pipelineLayout; }
-  VkPrimitiveTopology primitiveTopology() { return _primitiveTopology; }
-  VkPolygonMode polygonMode() { return _polygonMode; }
-  VkCullModeFlags cullMode() { return _cullMode; }
-  std::shared_ptr<BR2::VertexFormat> vertexFormat() { return _vertexFormat; }
-  Framebuffer* fbo() { return _fbo; }
+  VkPipelineBindPoint bindPoint() { return _bindPoint; }
+  VkPrimitiveTopology primitiveTopology() { return _key._topology; }
+  VkPolygonMode polygonMode() { return _key._polygonMode; }
+  VkCullModeFlags cullMode() { return _key._cullMode; }
+  std::shared_ptr<BR2::VertexFormat> vertexFormat() { return _key._vertexFormat; }
+  const PipelineKey& key() { return _key; }
+  const std::vector<VkPushConstantRange>& pushConstantRanges() { return _pushConstantRanges; }
+  const std::vector<VkDescriptorSetLayout>& setLayouts() { return _setLayouts; }
+  VkShaderStageFlags pushConstantStages(uint32_t offset, uint32_t size);
 
 private:
   VkPipelineColorBlendAttachmentState getVkPipelineColorBlendAttachmentState(BlendFunc bf, Framebuffer* fb);
 
-  std::shared_ptr<BR2::VertexFormat> _vertexFormat = nullptr;
-  VkPrimitiveTopology _primitiveTopology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  VkPolygonMode _polygonMode = VK_POLYGON_MODE_FILL;
-  VkCullModeFlags _cullMode = VK_CULL_MODE_NONE;
-  VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+  PipelineKey _key;
+  std::vector<VkPushConstantRange> _pushConstantRanges;
+  std::vector<VkDescriptorSetLayout> _setLayouts;
+  VkPipelineBindPoint _bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;  //Shared, owned by the PipelineCache
   VkPipeline _pipeline = VK_NULL_HANDLE;
-  Framebuffer* _fbo = nullptr;
+};
+/**
+ * @class PipelineCache
+ * @brief Device level cache of render passes, pipeline layouts and pipelines.
+ * @details These are identical for every swapchain frame, so we create them once here.
+ *          Only the VkFramebuffer (which references the frame's images) stays per frame.
+ * */
+class PipelineCache : public VulkanObject {
+public:
+  PipelineCache(Vulkan* v);
+  virtual ~PipelineCache() override;
+
+  VkPipelineCache getVkPipelineCache() { return _pipelineCache; }
+  VkRenderPass getRenderPass(const RenderPassKey& key);
+  DescriptorSetLayout* getDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+  VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+  Pipeline* getPipeline(const PipelineKey& key, Framebuffer* fbo);
+  void releaseShader(PipelineShader* shader);
+  size_t renderPassCount() { return _renderPasses.size(); }
+  size_t descriptorSetLayoutCount() { return _descriptorSetLayouts.size(); }
+  size_t pipelineLayoutCount() { return _pipelineLayouts.size(); }
+  size_t pipelineCount() { return _pipelines.size(); }
+
+private:
+  class CachedRenderPass {
+  public:
+    RenderPassKey _key;
+    VkRenderPass _renderPass = VK_NULL_HANDLE;
+  };
+  class CachedPipelineLayout {
+  public:
+    std::vector<VkDescriptorSetLayout> _setLayouts;
+    std::vector<VkPushConstantRange> _pushConstantRanges;
+    VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+  };
+
+  VkRenderPass createRenderPass(const RenderPassKey& key);
+
+  VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+  std::unordered_multimap<size_t, CachedRenderPass> _renderPasses;  //Exact hash -> pass
+  std::unordered_multimap<size_t, std::unique_ptr<DescriptorSetLayout>> _descriptorSetLayouts;  //Bindings hash -> layout
+  std::vector<CachedPipelineLayout> _pipelineLayouts;
+  std::unordered_multimap<size_t, std::unique_ptr<Pipeline>> _pipelines;  //PipelineKey hash -> pipeline
 };
 /**
  * @class PipelineShader
@@ -528,17 +871,33 @@ public:
 
   const string_t& name() { return _name; }
   bool valid() { return _bValid; }
+  bool isCompute() { return _bCompute; }
   bool shaderError(const string_t& msg);
   bool renderError(const string_t& msg);
   const std::vector<std::unique_ptr<ShaderOutputBinding>>& outputBindings() const { return _outputBindings; }
   const std::vector<uint32_t> locations() { return _locations; }
-  VkDescriptorSetLayout getVkDescriptorSetLayout() { return _descriptorSetLayout; }
+  static DescriptorSetFrequency classifyDescriptorSet(const string_t& name, bool isSampler);
+  std::vector<VkDescriptorSetLayout> getVkDescriptorSetLayouts();
+  DescriptorSetLayout* descriptorSetLayout(uint32_t set) { return set < _setLayouts.size() ? _setLayouts[set] : nullptr; }
+  uint32_t descriptorSetCount() { return static_cast<uint32_t>(_setLayouts.size()); }
+  bool usesBindlessTextures() { return _bUsesBindless; }
+  const std::vector<VkPushConstantRange>& pushConstantRanges() { return _pushConstantRanges; }
   std::vector<VkPipelineShaderStageCreateInfo> getShaderStageCreateInfos();
+  bool setSpecConstant(const string_t& name, int32_t value);
+  bool setSpecConstant(const string_t& name, uint32_t value);
+  bool setSpecConstant(const string_t& name, float value);
+  bool setSpecConstant(const string_t& name, bool value);
+  size_t specConstantHash() { return _specConstantHash; }
+  const std::vector<std::pair<uint32_t, uint32_t>>& specConstants() { return _specConstants; }  //(constant id, value)
+  uint64_t descriptorWritesFlushed() { return _descriptorWritesFlushed; }
+  uint64_t descriptorWritesSkipped() { return _descriptorWritesSkipped; }
   VkPipelineVertexInputStateCreateInfo getVertexInputInfo(std::shared_ptr<BR2::VertexFormat> fmt);
   bool sampleShadingVariables();
   Pipeline* getPipeline(std::shared_ptr<BR2::VertexFormat> vertexFormat, VkPrimitiveTopology topo, VkPolygonMode mode, VkCullModeFlags cullMode);
   std::shared_ptr<VulkanBuffer> getUBO(const string_t& name, RenderFrame* frame);
+  std::shared_ptr<VulkanBuffer> getStorageBuffer(const string_t& name, RenderFrame* frame) { return getUBO(name, frame); }
   bool createUBO(const string_t& name, const string_t& var_name, size_t itemSize, size_t itemCount);
+  bool createStorageBuffer(const string_t& name, const string_t& var_name, size_t itemSize, size_t itemCount, bool bDeviceLocal = true);  //Per frame. Host visible if the CPU writes it each frame.
   Pipeline* boundPipeline() { return _pBoundPipeline; }
   void clearShaderDataCache(RenderFrame* frame);
 
@@ -546,40 +905,61 @@ public:
   bool beginRenderPass(CommandBuffer* buf, std::unique_ptr<PassDescription> desc, BR2::urect2* extent = nullptr);
   void endRenderPass(CommandBuffer* buf);
   bool bindUBO(const string_t& name, std::shared_ptr<VulkanBuffer> buf, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);  //buf =  Optionally, update.
+  bool bindStorageBuffer(const string_t& name, std::shared_ptr<VulkanBuffer> buf, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
   bool bindSampler(const string_t& name, std::shared_ptr<TextureImage> texture, uint32_t arrayIndex = 0);
+  //A view that isn't a sampled TextureImage, e.g. one mip as a storage image, or a depth attachment. Samplers need a sampler.
+  bool bindImage(const string_t& name, uint64_t resourceId, VkImageView view, VkImageLayout layout, VkSampler sampler = VK_NULL_HANDLE);
   bool bindPipeline(CommandBuffer* cmd, std::shared_ptr<BR2::VertexFormat> v_fmt, VkPolygonMode mode = VK_POLYGON_MODE_FILL,
                     VkPrimitiveTopology topo = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VkCullModeFlags cull = VK_CULL_MODE_BACK_BIT);
   bool bindPipeline(CommandBuffer* cmd, Pipeline* pipe);
   void bindViewport(CommandBuffer* cmd, const BR2::urect2& size);
   bool bindDescriptors(CommandBuffer* cmd);
-  void drawIndexed(CommandBuffer* cmd, std::shared_ptr<Mesh> m, uint32_t numInstances);
+  void drawIndexed(CommandBuffer* cmd, std::shared_ptr<Mesh> m, uint32_t numInstances, const std::vector<VulkanBuffer*>& instanceStreams = {});
+  //Draw parameters come from VkDrawIndexedIndirectCommands in indirect, e.g. written by a compute pass.
+  void drawIndexedIndirect(CommandBuffer* cmd, std::shared_ptr<Mesh> m, VulkanBuffer* indirect, VkDeviceSize offset, uint32_t drawCount);
+  //Reads the draw count from countBuffer, falls back to drawIndexedIndirect with maxDrawCount without VK_KHR_draw_indirect_count.
+  void drawIndexedIndirectCount(CommandBuffer* cmd, std::shared_ptr<Mesh> m, VulkanBuffer* indirect, VkDeviceSize offset,
+                                VulkanBuffer* countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount);
+  bool validateInstanceStreams(const std::vector<VulkanBuffer*>& instanceStreams, uint32_t numInstances);  //Logs and returns false if the streams can't feed numInstances.
+  bool hasInstanceStream() { return _instanceStride > 0; }
+  uint32_t instanceStride() { return _instanceStride; }  //Bytes per instance of the _inst attributes.
+
+  static constexpr uint32_t c_vertexBinding = 0;
+  static constexpr uint32_t c_instanceBinding = 1;
 
-private:
+protected:
   bool init();
   bool checkGood();
   bool createInputs();
   bool createOutputs();
   bool createDescriptors();
+  bool createPushConstants();
   void cleanupDescriptors();
+  bool createBuffer(const string_t& name, const string_t& var_name, VulkanBufferType type, bool bDeviceLocal, size_t itemSize, size_t itemCount);
+  bool bindBuffer(const string_t& name, std::shared_ptr<VulkanBuffer> buf, VkDeviceSize offset, VkDeviceSize range, VkDescriptorType type);
   Framebuffer* getOrCreateFramebuffer(RenderFrame* frame, ShaderData* data, std::unique_ptr<PassDescription> desc);
   Framebuffer* findFramebuffer(ShaderData* data, PassDescription* desc);
   ShaderData* getShaderData(RenderFrame* frame);
   OutputMRT parseShaderOutputTag(const string_t& tag);
-  DescriptorFunction classifyDescriptor(const string_t& name);
+  static DescriptorFunction classifyDescriptor(const string_t& name);
   BR2::VertexUserType parseUserType(const string_t& err);
   ShaderModule* getModule(ShaderStage stage, bool throwIfNotFound = false);
   Descriptor* getDescriptor(const string_t& name);
   VkFormat spvReflectFormatToVulkanFormat(SpvReflectFormat fmt);
   bool beginPassGood();
+  bool setSpecConstantRaw(const string_t& name, uint32_t value, SpecConstantType type);
+  void bindSlot(uint32_t set, const DescriptorSlot& slot);
+  void updateSpecConstantHash();
   string_t createUniqueFBOName(RenderFrame* frame, ShaderData* data, PassDescription* desc);
 
   string_t _name = "*undefined*";
   std::vector<string_t> _files;
-  VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
-  VkDescriptorSetLayout _descriptorSetLayout = VK_NULL_HANDLE;
-  std::vector<VkDescriptorSet> _descriptorSets;  //One per frame, TODO: put these on ShaderData (one per frame)
+  std::vector<DescriptorSetLayout*> _setLayouts;   //Indexed by set. Shared, owned by the PipelineCache. Null for the bindless set.
+  std::vector<DescriptorSlots> _boundSlots;        //Resources for the next bindDescriptors, per set
+  std::vector<VkPushConstantRange> _pushConstantRanges;  //One per stage block
   std::vector<VkVertexInputAttributeDescription> _attribDescriptions;
-  VkVertexInputBindingDescription _bindingDesc;
+  std::vector<VkVertexInputBindingDescription> _bindingDescs;  //Mesh vertexes, then the instance stream if any.
+  uint32_t _instanceStride = 0;
   std::vector<std::unique_ptr<ShaderModule>> _modules;
   std::unordered_map<string_t, std::unique_ptr<Descriptor>> _descriptors; //Maps descriptor name e.g. "_viewMatrix" to the descriptor (specific shader input)
   std::vector<std::unique_ptr<VertexAttribute>> _attributes;
@@ -589,9 +969,75 @@ private:
   ShaderData* _pBoundData = nullptr;
   RenderFrame* _pBoundFrame = nullptr;
   bool _bInstanced = false;  //True if we find gl_InstanceIndex (gl_instanceID) in the shader - and we will bind vertexes per instance.
+  bool _bUsesBindless = false;  //True if the shader declares the BindlessTextureTable array.
+  bool _bCompute = false;       //True if this is a single compute module, see ComputeShader.
   bool _bValid = true;       // TODO: flags
   std::map<uint32_t, std::unique_ptr<ShaderData>> _shaderData;
   std::vector<uint32_t> _locations;
+  std::vector<std::pair<uint32_t, uint32_t>> _specConstants;
+  size_t _specConstantHash = 0;
+  uint64_t _descriptorWritesFlushed = 0;
+  uint64_t _descriptorWritesSkipped = 0;
+};
+/**
+ * @class ComputeShader
+ * @brief Compute pipeline built from a single compute module, with the same reflection and descriptors as PipelineShader.
+ * @details Dispatches are recorded outside of render passes:
+ *            beginDispatch(cmd, frame) -> bindStorageBuffer/bindUBO .. -> pushConstants -> dispatch .. -> endDispatch()
+ *          Results read by later passes need a CommandBuffer::bufferBarrier.
+ * */
+class ComputeShader : public PipelineShader {
+public:
+  static std::unique_ptr<ComputeShader> create(Vulkan* v, const string_t& name, const string_t& file);
+  ComputeShader(Vulkan* v, const string_t& name, const string_t& file);
+  virtual ~ComputeShader() override;
+
+  uint32_t localSizeX() { return _localSizeX; }  //GLSL: layout(local_size_x = ..) in;
+  uint32_t localSizeY() { return _localSizeY; }
+  uint32_t localSizeZ() { return _localSizeZ; }
+
+  bool beginDispatch(CommandBuffer* cmd, RenderFrame* frame);
+  bool dispatch(CommandBuffer* cmd, uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1);
+  bool dispatchItems(CommandBuffer* cmd, uint32_t itemCount);  //1D, enough groups to cover itemCount invocations.
+  void endDispatch();
+
+private:
+  uint32_t _localSizeX = 1;
+  uint32_t _localSizeY = 1;
+  uint32_t _localSizeZ = 1;
+};
+/**
+ * @class BindlessTextureTable
+ * @brief Global table of sampled textures, indexed in shaders. Requires VK_EXT_descriptor_indexing.
+ * @details GLSL: layout(set = 1, binding = 0) uniform sampler2D _ufBindlessTextures[];
+ *          Every TextureImage with a sampler registers itself and keeps its index for its lifetime,
+ *          so one descriptor bind covers every texture drawn in the frame.
+ * */
+class BindlessTextureTable : public VulkanObject {
+public:
+  static constexpr uint32_t c_invalidIndex = 0xFFFFFFFF;
+  static constexpr uint32_t c_descriptorSet = static_cast<uint32_t>(DescriptorSetFrequency::Bindless);
+  static constexpr const char* c_descriptorName = "_ufBindlessTextures";
+
+  BindlessTextureTable(Vulkan* v);
+  virtual ~BindlessTextureTable() override;
+
+  bool init();
+  uint32_t registerTexture(TextureImage* tex);
+  void unregisterTexture(uint32_t index);
+  VkDescriptorSetLayout getVkDescriptorSetLayout() { return _descriptorSetLayout; }
+  VkDescriptorSet getVkDescriptorSet() { return _descriptorSet; }
+  uint32_t capacity() { return _capacity; }
+  uint32_t count() { return _count; }
+
+private:
+  VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+  VkDescriptorSetLayout _descriptorSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet _descriptorSet = VK_NULL_HANDLE;
+  uint32_t _capacity = 0;
+  uint32_t _count = 0;
+  uint32_t _next = 0;
+  std::vector<uint32_t> _free;
 };
 /**
  * @class ShaderData
@@ -603,8 +1049,18 @@ class ShaderData {
 public:
   std::unordered_map<std::string, std::unique_ptr<ShaderDataUBO>> _uniformBuffers;
   ShaderDataUBO* getUBOData(const string_t& name);
-  std::vector<std::unique_ptr<Framebuffer>> _framebuffers;  //In the future we can optimize this search.
-  std::vector<std::unique_ptr<Pipeline>> _pipelines;        // All pipelines bound to this data.
+  std::vector<std::unique_ptr<Framebuffer>> _framebuffers;  //In the future we can optimize this search. Pipelines are shared in the PipelineCache.
+};
+/**
+ * @class PipelineStats
+ * @brief Pipeline statistics query results, see RenderFrame::beginPipelineStats.
+ * */
+class PipelineStats {
+public:
+  uint64_t _vertexInvocations = 0;
+  uint64_t _clippingPrimitives = 0;  //Primitives that reached the rasterizer.
+  uint64_t _fragmentInvocations = 0;
+  bool _valid = false;
 };
 /**
  * @class RenderFrame
@@ -621,15 +1077,28 @@ public:
   CommandBuffer* commandBuffer() { return _pCommandBuffer.get(); }               //Possible to have multiple buffers as vkQUeueSubmit allows for multiple. Need?
   uint32_t currentRenderingImageIndex() { return _currentRenderingImageIndex; }  //TODO: remove later
   uint32_t frameIndex() { return _frameIndex; }                                  //Image index in the swapchain array
+  uint64_t frameNumber() { return _frameNumber; }                                //Number of times this frame has begun.
+  DescriptorSetCache* getDescriptorSetCache(DescriptorSetLayout* layout, bool transient);
+  DescriptorPoolAllocator* descriptorAllocator() { return _pDescriptorAllocator.get(); }
 
   void init(Swapchain* ps, uint32_t frameIndex, VkImage swapImg, VkSurfaceFormatKHR fmt);
   bool beginFrame();
   void endFrame();
+  void beginGpuTimer();  //Timestamps the command buffer, call after CommandBuffer::begin.
+  void endGpuTimer();    //Call before CommandBuffer::end.
+  double gpuTimeMs() { return _gpuTimeMs; }  //GPU time between the timestamps the last time this frame completed, -1 if it wasn't timed.
+  void beginPipelineStats();  //Counts the draws recorded until endPipelineStats. Outside of render passes.
+  void endPipelineStats();
+  const PipelineStats& pipelineStats() { return _pipelineStats; }  //The last time this frame completed, _valid is false if it wasn't counted.
 
   std::shared_ptr<TextureImage> getRenderTarget(OutputMRT target, MSAA samples, VkFormat format, string_t& out_errors, VkImage swapImg, bool createNew);
 
 private:
   void createSyncObjects();
+  void createTimestampQueries();
+  void createPipelineStatsQueries();
+  void readGpuTimer();
+  void readPipelineStats();
   void addRenderTarget(OutputMRT output, MSAA samples, std::shared_ptr<TextureImage> tex);
   std::shared_ptr<TextureImage> createNewRenderTarget(OutputMRT target, MSAA samples, VkFormat format, string_t& out_error, VkImage swapImage);
 
@@ -639,6 +1108,9 @@ private:
   std::unique_ptr<CommandBuffer> _pCommandBuffer = nullptr;
 
   uint32_t _frameIndex = 0;
+  uint64_t _frameNumber = 0;
+  std::unique_ptr<DescriptorPoolAllocator> _pDescriptorAllocator = nullptr;
+  std::unordered_map<DescriptorSetLayout*, std::unique_ptr<DescriptorSetCache>> _descriptorSetCaches[2];  //[transient], shared by all shaders using the layout
 
   std::map<OutputMRT, std::map<MSAA, std::shared_ptr<TextureImage>>> _renderTargets;  //Stores output images by their ShaderOutput, and by their MSAA level. MAX 2 MSAA images.
 
@@ -647,6 +1119,13 @@ private:
   VkSemaphore _imageAvailableSemaphore = VK_NULL_HANDLE;
   VkSemaphore _renderFinishedSemaphore = VK_NULL_HANDLE;
   uint32_t _currentRenderingImageIndex = 0;
+
+  VkQueryPool _timestampPool = VK_NULL_HANDLE;  //Null if the graphics queue can't write timestamps.
+  bool _bGpuTimerWritten = false;
+  double _gpuTimeMs = -1;
+  VkQueryPool _pipelineStatsPool = VK_NULL_HANDLE;  //Null without the pipelineStatisticsQuery feature.
+  bool _bPipelineStatsWritten = false;
+  PipelineStats _pipelineStats;
 };
 /**
  * @class Swapchain
@@ -778,6 +1257,11 @@ public:
   VkCommandBuffer beginOneTimeGraphicsCommands();
   void endOneTimeGraphicsCommands(VkCommandBuffer commandBuffer);
   Swapchain* swapchain();
+  PipelineCache* pipelineCache();
+  BindlessTextureTable* bindlessTextures();  //nullptr if descriptor indexing isn't supported.
+  bool drawIndirectCountSupported() { return vkCmdDrawIndexedIndirectCountKHR != nullptr; }
+
+  VkExtFn(vkCmdDrawIndexedIndirectCountKHR);  //VK_KHR_draw_indirect_count, nullptr if unsupported.
 
 private:
   void init(const string_t& title, SDL_Window* win, bool vsync_enabled, bool wait_fences, bool enableDebug);
@@ -791,6 +1275,7 @@ private:
   bool isExtensionSupported(const string_t& extName);
   std::vector<const char*> getEnabledDeviceExtensions();
   void createLogicalDevice();
+  bool checkDescriptorIndexingFeatures(VkPhysicalDeviceDescriptorIndexingFeaturesEXT& out_features);
   Vulkan::QueueFamilies* findQueueFamilies();
   void createCommandPool();
   VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
@@ -798,6 +1283,8 @@ private:
   std::unique_ptr<VulkanDebug> _pDebug;
   std::unique_ptr<QueueFamilies> _pQueueFamilies;
   std::unique_ptr<Swapchain> _pSwapchain = nullptr;
+  std::unique_ptr<PipelineCache> _pPipelineCache = nullptr;
+  std::unique_ptr<BindlessTextureTable> _pBindlessTextures = nullptr;
   VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
   VkDevice _device = VK_NULL_HANDLE;
   VkInstance _instance = VK_NULL_HANDLE;
@@ -810,6 +1297,7 @@ private:
   bool _bPhysicalDeviceAcquired = false;
   bool _vsync_enabled = false;
   bool _wait_fences = false;
+  bool _bDescriptorIndexing = false;
   std::unordered_set<std::string> _enabledExtensions;
   VkPhysicalDeviceProperties _deviceProperties;
   VkPhysicalDeviceLimits _physicalDeviceLimits;
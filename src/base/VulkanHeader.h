@@ -60,6 +60,7 @@ enum class VulkanBufferType {
   VertexBuffer,
   IndexBuffer,
   UniformBuffer,
+  StorageBuffer,
   ImageBuffer
 };
 enum class RenderMode {
@@ -173,6 +174,22 @@ enum class SamplerType {
   None,
   Sampled
 };
+enum class SpecConstantType {
+  Bool,
+  Int,
+  UInt,
+  Float
+};
+//Descriptor set index, from least to most frequently rebound.
+//Pipeline layouts are compatible up to the first set that differs, so the low sets stay bound across shaders.
+enum class DescriptorSetFrequency {
+  PerFrame,     //Camera, lights
+  Bindless,     //BindlessTextureTable
+  PerPass,
+  PerMaterial,  //Textures
+  PerDraw,      //Instance data
+  Frequency_Count
+};
 /////////////////////////////////////////////////////////////////////////////////
 //FWD
 
@@ -186,7 +203,10 @@ class Sampler;
 class Texture2D;
 class VulkanCommands;
 class ShaderModule;
+class SpecConstant;
 class Descriptor;
+class DescriptorSetLayout;
+class DescriptorPoolAllocator;
 class ShaderOutputBinding;
 class OutputDescription;
 class ShaderOutputArray;
@@ -194,6 +214,7 @@ class ShaderOutputCache;
 class FramebufferAttachment;
 class Framebuffer;
 class PipelineShader;
+class ComputeShader;
 class Pipeline;
 class CommandBuffer;
 class InstanceUBOClassData;
@@ -205,6 +226,11 @@ class Swapchain;
 class RenderTexture;
 class RenderTarget;
 class PassDescription;
+class RenderPassKey;
+class PipelineKey;
+class PipelineCache;
+class BindlessTextureTable;
+class HiZPyramid;
 class Extensions;
 
 //Dummies
@@ -230,6 +256,47 @@ struct ViewProjUBOData {
 struct InstanceUBOData { 
   alignas(16) BR2::mat4 model;
 };
+//Input to the instance update compute shader (instance_update.cs). std430 layout.
+struct GPUInstanceParams {
+  BR2::vec3 offset;
+  float phase;  //Rotation at time 0
+  BR2::vec3 axis;
+  float angularVelocity;
+};
+//Push constants of instance_update.cs.
+struct GPUInstanceUpdatePush {
+  BR2::vec3 origin;
+  float time;
+  uint32_t count;
+};
+//Push constants of instance_cull.cs.
+struct GPUInstanceCullPush {
+  float planes[6][4];  //Frustum planes, see Frustum.
+  BR2::vec3 center;    //Model space bounding sphere of the mesh.
+  float radius;
+  uint32_t count;
+  uint32_t phase;  //See HiZPyramid, 0 frustum only.
+};
+//Occlusion test of instance_cull.cs. std140 layout.
+struct GPUOcclusionUBO {
+  BR2::mat4 view[2];  //[0] the frame the pyramid was built in, for the early phase. [1] this frame, for the late phase.
+  BR2::mat4 proj[2];
+  BR2::vec2 depthSize;    //Of the depth the pyramid was built from.
+  uint32_t mipLevels;
+  uint32_t pyramidValid;  //0 skips the early test, everything visible last frame is unknown.
+};
+//Push constants of hiz_reduce.cs.
+struct GPUHiZReducePush {
+  int32_t srcSize[2];
+  int32_t dstSize[2];
+  int32_t srcLod;
+};
+//Indirect draws written by instance_cull.cs. std430 layout, the draws start at byte 16.
+struct GPUIndirectDraws {
+  uint32_t drawCount;  //Count buffer of drawIndexedIndirectCount.
+  uint32_t pad[3];
+  VkDrawIndexedIndirectCommand draws[1];
+};
 struct GPULight {
   BR2::vec3 pos;
   float radius;
@@ -262,6 +329,14 @@ public:
   }
 
 };
+class HashUtils {
+public:
+  //boost::hash_combine
+  template <typename T>
+  static void combine(size_t& seed, const T& value) {
+    seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  }
+};
 
 }  // namespace VG
 
@@ -0,0 +1,40 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//One level of the Hi-Z pyramid, see HiZPyramid. Each texel is the farthest depth of the source texels under it.
+//An odd sized source folds its last row and column into the edge texels so nothing is dropped.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+//The depth attachment for mip 0, otherwise the pyramid, read at srcLod.
+layout(binding = 0) uniform sampler2D _passHiZSource;
+layout(r32f, binding = 1) uniform writeonly image2D _passHiZDest;
+
+layout(push_constant) uniform HiZReducePush {
+  ivec2 srcSize;
+  ivec2 dstSize;
+  int srcLod;
+} _pcHiZReduce;
+
+void main() {
+  ivec2 dst = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(dst, _pcHiZReduce.dstSize))) {
+    return;
+  }
+  ivec2 last = _pcHiZReduce.srcSize - 1;
+  ivec2 first = min(dst * 2, last);
+  ivec2 end = min(dst * 2 + 1, last);
+  if (dst.x == _pcHiZReduce.dstSize.x - 1) {
+    end.x = last.x;
+  }
+  if (dst.y == _pcHiZReduce.dstSize.y - 1) {
+    end.y = last.y;
+  }
+  float d = 0;
+  for (int y = first.y; y <= end.y; ++y) {
+    for (int x = first.x; x <= end.x; ++x) {
+      d = max(d, texelFetch(_passHiZSource, ivec2(x, y), _pcHiZReduce.srcLod).r);
+    }
+  }
+  imageStore(_passHiZDest, dst, vec4(d));
+}
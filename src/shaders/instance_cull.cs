@@ -0,0 +1,138 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//Frustum culls instance bounding spheres and compacts the visible instance IDs for test_cull.vs.
+//Same test as FrustumCuller on the CPU.
+//The early and late phases also test the sphere's box against the Hi-Z pyramid, see HiZPyramid.
+
+layout(local_size_x = 64) in;
+
+struct InstanceData {
+  mat4 model;
+};
+//Output of instance_update.cs.
+layout(std430, binding = 0) readonly buffer InstanceMatricesBlock {
+  InstanceData instances[];
+} _drawInstanceMatrices;
+
+layout(std430, binding = 1) writeonly buffer VisibleInstancesBlock {
+  uint ids[];
+} _drawVisibleInstances;
+
+//VkDrawIndexedIndirectCommand
+struct DrawIndexedIndirect {
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+//The CPU resets drawCount and instanceCount to zero each frame. See GPUIndirectDraws.
+layout(std430, binding = 2) buffer IndirectDrawsBlock {
+  uint drawCount;
+  uint pad0;
+  uint pad1;
+  uint pad2;
+  DrawIndexedIndirect draws[];
+} _drawIndirect;
+
+//1 where the early phase hid a frustum visible instance, the late phase retests only those.
+layout(std430, binding = 3) buffer OcclusionStateBlock {
+  uint occluded[];
+} _drawOcclusionState;
+
+//See GPUOcclusionUBO.
+layout(std140, binding = 4) uniform OcclusionBlock {
+  mat4 view[2];
+  mat4 proj[2];
+  vec2 depthSize;
+  uint mipLevels;
+  uint pyramidValid;
+} _uboOcclusion;
+
+layout(binding = 5) uniform sampler2D _passHiZ;
+
+const uint c_phaseFrustum = 0;
+const uint c_phaseEarly = 1;
+const uint c_phaseLate = 2;
+
+layout(push_constant) uniform InstanceCullPush {
+  vec4 planes[6];
+  vec3 center;  //Model space
+  float radius;
+  uint count;
+  uint phase;
+} _pcInstanceCull;
+
+bool occluded(vec3 c, float r, uint iview) {
+  //Nearest depth and screen rectangle of the box around the sphere.
+  mat4 viewProj = _uboOcclusion.proj[iview] * _uboOcclusion.view[iview];
+  vec2 uvMin = vec2(1);
+  vec2 uvMax = vec2(0);
+  float zMin = 1;
+  for (int corner = 0; corner < 8; ++corner) {
+    vec3 offset = vec3((corner & 1) != 0 ? r : -r, (corner & 2) != 0 ? r : -r, (corner & 4) != 0 ? r : -r);
+    vec4 clip = viewProj * vec4(c + offset, 1);
+    if (clip.w <= 0) {
+      return false;  //Crosses the camera plane.
+    }
+    vec3 ndc = clip.xyz / clip.w;
+    vec2 uv = ndc.xy * 0.5 + 0.5;
+    uvMin = min(uvMin, uv);
+    uvMax = max(uvMax, uv);
+    zMin = min(zMin, ndc.z);
+  }
+  //The frustum test passed, so only the part on screen matters.
+  vec2 pMin = clamp(uvMin, 0.0, 1.0) * _uboOcclusion.depthSize;
+  vec2 pMax = clamp(uvMax, 0.0, 1.0) * _uboOcclusion.depthSize;
+
+  //The mip where the rectangle spans at most 2x2 texels. Mip L texels are 2^(L + 1) depth pixels.
+  vec2 extent = pMax - pMin;
+  float pixels = max(max(extent.x, extent.y), 1.0);
+  int lod = clamp(int(ceil(log2(pixels))) - 1, 0, int(_uboOcclusion.mipLevels) - 1);
+  ivec2 lastTexel = textureSize(_passHiZ, lod) - 1;
+  ivec2 t0 = min(ivec2(pMin) >> (lod + 1), lastTexel);
+  ivec2 t1 = min(ivec2(pMax) >> (lod + 1), lastTexel);
+  float zFar = max(max(texelFetch(_passHiZ, t0, lod).r, texelFetch(_passHiZ, ivec2(t1.x, t0.y), lod).r),
+                   max(texelFetch(_passHiZ, ivec2(t0.x, t1.y), lod).r, texelFetch(_passHiZ, t1, lod).r));
+  return zMin > zFar;
+}
+
+void main() {
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= _pcInstanceCull.count) {
+    return;
+  }
+  uint phase = _pcInstanceCull.phase;
+  if (phase == c_phaseLate && _drawOcclusionState.occluded[i] == 0) {
+    return;  //Drawn in the early pass, or outside the frustum.
+  }
+  //Instance matrices are rigid, the radius doesn't scale.
+  vec3 c = (_drawInstanceMatrices.instances[i].model * vec4(_pcInstanceCull.center, 1)).xyz;
+  for (int ip = 0; ip < 6; ++ip) {
+    vec4 p = _pcInstanceCull.planes[ip];
+    if (dot(p.xyz, c) + p.w < -_pcInstanceCull.radius) {
+      if (phase == c_phaseEarly) {
+        _drawOcclusionState.occluded[i] = 0;
+      }
+      return;
+    }
+  }
+  if (phase == c_phaseEarly) {
+    //The last frame's pyramid, seen from where it was built.
+    bool hidden = _uboOcclusion.pyramidValid != 0 && occluded(c, _pcInstanceCull.radius, 0);
+    _drawOcclusionState.occluded[i] = hidden ? 1 : 0;
+    if (hidden) {
+      return;
+    }
+  }
+  else if (phase == c_phaseLate && occluded(c, _pcInstanceCull.radius, 1)) {
+    return;
+  }
+  uint slot = atomicAdd(_drawIndirect.draws[0].instanceCount, 1);
+  _drawVisibleInstances.ids[slot] = i;
+  if (slot == 0) {
+    //Empty draws are dropped by drawIndexedIndirectCount.
+    _drawIndirect.drawCount = 1;
+  }
+}
@@ -0,0 +1,54 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+//Builds the instance model matrices of test.vs on the GPU.
+//Same matrix as TransformKernels: model = T(offset) * R(angle, axis) * T(origin) with column vectors,
+//so the translation column is R * origin + offset. (TransformKernels.h writes it in BR2's row vector order.)
+
+layout(local_size_x = 64) in;
+
+struct InstanceParams {
+  vec3 offset;
+  float phase;  //Angle at time zero
+  vec3 axis;    //Unit rotation axis
+  float angularVelocity;
+};
+layout(std430, binding = 0) readonly buffer InstanceParamsBlock {
+  InstanceParams params[];
+} _drawInstanceParams;
+
+struct InstanceData {
+  mat4 model;
+};
+//Bound as test.vs _uboInstanceData or test_ssbo.vs _drawInstanceData, std430 mat4 arrays have the same stride as std140.
+layout(std430, binding = 1) writeonly buffer InstanceMatricesBlock {
+  InstanceData instances[];
+} _drawInstanceMatrices;
+
+layout(push_constant) uniform InstanceUpdatePush {
+  vec3 origin;
+  float time;
+  uint count;
+} _pcInstanceUpdate;
+
+void main() {
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= _pcInstanceUpdate.count) {
+    return;
+  }
+  InstanceParams p = _drawInstanceParams.params[i];
+
+  float a = p.phase + p.angularVelocity * _pcInstanceUpdate.time;
+  float c = cos(a), s = sin(a), t = 1.0 - c;
+  vec3 ax = p.axis;
+  mat3 r = mat3(
+    t * ax.x * ax.x + c, t * ax.x * ax.y + s * ax.z, t * ax.x * ax.z - s * ax.y,
+    t * ax.x * ax.y - s * ax.z, t * ax.y * ax.y + c, t * ax.y * ax.z + s * ax.x,
+    t * ax.x * ax.z + s * ax.y, t * ax.y * ax.z - s * ax.x, t * ax.z * ax.z + c);
+
+  _drawInstanceMatrices.instances[i].model = mat4(
+    vec4(r[0], 0),
+    vec4(r[1], 0),
+    vec4(r[2], 0),
+    vec4(r * _pcInstanceUpdate.origin + p.offset, 1));
+}
@@ -11,6 +11,9 @@ layout(location = 0) out vec4 _outFBO_DefaultColor;
 
 layout(binding = 2) uniform sampler2D _ufTexture0;
 
+//Number of active lights. Set with PipelineShader::setSpecConstant, must be <= the lights[] array size.
+layout(constant_id = 0) const int c_numLights = 10;
+
 struct GPULight {
     vec3 pos;
     float radius;
@@ -34,10 +37,8 @@ void main() {
    vec3 lightDiffuseRGB = vec3(0,0,0);
    vec3 lightSpecRGB = vec3(0,0,0);
 
-   for(int iLight=0; iLight<10; ++iLight) {
-        if(_uboLights.lights[iLight].radius < 0.001) {
-            continue;
-        }
+   //The loop count is a constant so the driver can unroll it.
+   for(int iLight=0; iLight<c_numLights; ++iLight) {
         vec3 lightdir = normalize(_uboLights.lights[iLight].pos - _vPositionVS);
         float lamb = clamp(dot(normalize(_vNormalVS), lightdir), 0, 1);
         if(lamb <= 0.0f) {
@@ -0,0 +1,102 @@
+#include "./SandboxTests.h"
+#include "../base/TransformStore.h"
+
+namespace VG {
+
+//Runs of set bits, as forEachRange reports them.
+static std::vector<std::pair<size_t, size_t>> ranges(const DirtyBitset& bits, size_t begin, size_t end) {
+  std::vector<std::pair<size_t, size_t>> ret;
+  bits.forEachRange(begin, end, [&](size_t b, size_t e) { ret.push_back({ b, e }); });
+  return ret;
+}
+
+VG_TEST(DirtyBitset_SetAndTest) {
+  DirtyBitset bits;
+  bits.resize(200);
+  VG_CHECK(bits.size() == 200 && !bits.any() && bits.count() == 0);
+  bits.set(0);
+  bits.set(63);
+  bits.set(64);
+  bits.set(199);
+  VG_CHECK(bits.test(0) && bits.test(63) && bits.test(64) && bits.test(199) && !bits.test(1) && !bits.test(65));
+  VG_CHECK(bits.count() == 4 && bits.any());
+  bits.reset(63);
+  VG_CHECK(!bits.test(63) && bits.count() == 3);
+  bits.clear();
+  VG_CHECK(!bits.any() && bits.size() == 200);
+}
+VG_TEST(DirtyBitset_Ranges) {
+  //Ranges that start, end and span word boundaries.
+  DirtyBitset bits;
+  bits.resize(300);
+  bits.setRange(60, 130);
+  VG_CHECK(bits.count() == 70 && !bits.test(59) && bits.test(60) && bits.test(129) && !bits.test(130));
+  bits.resetRange(64, 128);
+  VG_CHECK(bits.count() == 6);
+  VG_CHECK((ranges(bits, 0, bits.size()) == std::vector<std::pair<size_t, size_t>>{ { 60, 64 }, { 128, 130 } }));
+  bits.setAll();
+  VG_CHECK(bits.count() == 300);
+  VG_CHECK((ranges(bits, 0, bits.size()) == std::vector<std::pair<size_t, size_t>>{ { 0, 300 } }));
+  //Clipped to [begin, end).
+  VG_CHECK((ranges(bits, 70, 140) == std::vector<std::pair<size_t, size_t>>{ { 70, 140 } }));
+}
+VG_TEST(DirtyBitset_FindNext) {
+  DirtyBitset bits;
+  bits.resize(130);
+  VG_CHECK(bits.findNext(0) == 130);
+  bits.set(5);
+  bits.set(128);
+  VG_CHECK(bits.findNext(0) == 5);
+  VG_CHECK(bits.findNext(5) == 5);
+  VG_CHECK(bits.findNext(6) == 128);
+  VG_CHECK(bits.findNext(129) == 130);
+  VG_CHECK(bits.findNext(500) == 130);
+}
+VG_TEST(DirtyBitset_ResizeClearsTail) {
+  //Shrinking drops the bits past the new size, growing back doesn't bring them back.
+  DirtyBitset bits;
+  bits.resize(128);
+  bits.setAll();
+  bits.resize(70);
+  VG_CHECK(bits.count() == 70);
+  bits.resize(128);
+  VG_CHECK(bits.count() == 70 && !bits.test(70) && bits.findNext(70) == 128);
+}
+VG_TEST(DirtyBitset_MatchesReference) {
+  //Random edits against a std::vector<bool>.
+  const size_t c_bits = 1000;
+  std::mt19937 engine(1234);
+  DirtyBitset bits;
+  bits.resize(c_bits);
+  std::vector<bool> ref(c_bits, false);
+  for (int it = 0; it < 500; ++it) {
+    size_t a = engine() % c_bits, b = engine() % c_bits;
+    size_t begin = std::min(a, b), end = std::max(a, b);
+    bool set = (engine() & 1) != 0;
+    if (set) {
+      bits.setRange(begin, end);
+    }
+    else {
+      bits.resetRange(begin, end);
+    }
+    for (size_t i = begin; i < end; ++i) {
+      ref[i] = set;
+    }
+  }
+  std::vector<std::pair<size_t, size_t>> expected;
+  for (size_t i = 0; i < c_bits;) {
+    if (!ref[i]) {
+      i++;
+      continue;
+    }
+    size_t start = i;
+    while (i < c_bits && ref[i]) {
+      i++;
+    }
+    expected.push_back({ start, i });
+  }
+  VG_CHECK(ranges(bits, 0, c_bits) == expected);
+  VG_CHECK(bits.count() == (size_t)std::count(ref.begin(), ref.end(), true));
+}
+
+}  // namespace VG
@@ -0,0 +1,78 @@
+#include "./SandboxTests.h"
+#include "../base/DrawQueue.h"
+
+namespace VG {
+
+static bool sameItems(const std::vector<DrawQueue::SortItem>& a, const std::vector<DrawQueue::SortItem>& b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const DrawQueue::SortItem& x, const DrawQueue::SortItem& y) {
+    return x._key == y._key && x._index == y._index;
+  });
+}
+static std::vector<DrawQueue::SortItem> stableSorted(std::vector<DrawQueue::SortItem> items) {
+  std::stable_sort(items.begin(), items.end(), [](const DrawQueue::SortItem& a, const DrawQueue::SortItem& b) { return a._key < b._key; });
+  return items;
+}
+
+VG_TEST(DrawQueue_RadixSortMatchesStableSort) {
+  //Few distinct fields so most keys repeat, which checks the sort is stable.
+  const uint64_t c_layers = 3, c_pipelines = 8, c_materials = 64, c_meshes = 256;
+  std::mt19937 engine(1234);
+  std::vector<DrawQueue::SortItem> items(50000);
+  for (size_t i = 0; i < items.size(); ++i) {
+    uint64_t key = ((uint64_t)(engine() % c_layers) << DrawQueue::c_layerShift) |
+                   ((uint64_t)(engine() % c_pipelines) << DrawQueue::c_pipelineShift) |
+                   ((uint64_t)(engine() % c_materials) << DrawQueue::c_materialShift) |
+                   ((uint64_t)(engine() % c_meshes) << DrawQueue::c_meshShift);
+    items[i] = { key, static_cast<uint32_t>(i) };
+  }
+  std::vector<DrawQueue::SortItem> expected = stableSorted(items);
+  std::vector<DrawQueue::SortItem> scratch;
+  DrawQueue::radixSort(items, scratch);
+  VG_CHECK(sameItems(items, expected));
+}
+VG_TEST(DrawQueue_RadixSortSkippedPasses) {
+  //Only the layer byte differs, so 7 of the 8 passes are skipped. An odd number of passes leaves the result in scratch.
+  std::vector<DrawQueue::SortItem> items = {
+    { 2ull << DrawQueue::c_layerShift, 0 }, { 0, 1 }, { 1ull << DrawQueue::c_layerShift, 2 }, { 0, 3 }, { 2ull << DrawQueue::c_layerShift, 4 }
+  };
+  std::vector<DrawQueue::SortItem> expected = stableSorted(items);
+  std::vector<DrawQueue::SortItem> scratch;
+  DrawQueue::radixSort(items, scratch);
+  VG_CHECK(sameItems(items, expected));
+
+  //Equal keys keep submission order.
+  std::vector<DrawQueue::SortItem> same = { { 7, 0 }, { 7, 1 }, { 7, 2 } };
+  std::vector<DrawQueue::SortItem> sameExpected = same;
+  DrawQueue::radixSort(same, scratch);
+  VG_CHECK(sameItems(same, sameExpected));
+
+  std::vector<DrawQueue::SortItem> empty;
+  DrawQueue::radixSort(empty, scratch);
+  VG_CHECK(empty.empty());
+}
+VG_TEST(DrawQueue_SortedBindCounts) {
+  //Sorted, each pipeline is bound once and each material once per pipeline it's used with.
+  const uint64_t c_pipelines = 4, c_materials = 16;
+  std::mt19937 engine(99);
+  std::vector<DrawQueue::SortItem> items(4096);
+  std::set<std::pair<uint64_t, uint64_t>> pipelineMaterials;
+  std::set<std::tuple<uint64_t, uint64_t, uint64_t>> pipelineMaterialMeshes;
+  for (size_t i = 0; i < items.size(); ++i) {
+    uint64_t pipeline = engine() % c_pipelines, material = engine() % c_materials, mesh = engine() % 32;
+    pipelineMaterials.insert({ pipeline, material });
+    pipelineMaterialMeshes.insert({ pipeline, material, mesh });
+    items[i] = { (pipeline << DrawQueue::c_pipelineShift) | (material << DrawQueue::c_materialShift) | (mesh << DrawQueue::c_meshShift), static_cast<uint32_t>(i) };
+  }
+  uint64_t p0 = 0, d0 = 0, m0 = 0;
+  DrawQueue::countBinds(items, p0, d0, m0);
+  std::vector<DrawQueue::SortItem> scratch;
+  DrawQueue::radixSort(items, scratch);
+  uint64_t p1 = 0, d1 = 0, m1 = 0;
+  DrawQueue::countBinds(items, p1, d1, m1);
+  VG_CHECK(p1 == c_pipelines);
+  VG_CHECK(d1 == pipelineMaterials.size());
+  VG_CHECK(m1 == pipelineMaterialMeshes.size());
+  VG_CHECK(p1 < p0 && d1 < d0 && m1 < m0);
+}
+
+}  // namespace VG
@@ -0,0 +1,136 @@
+#include "./SandboxTests.h"
+#include "../base/EntityStore.h"
+
+namespace VG {
+
+//Test components.
+class TestPosition {
+public:
+  float _x, _y, _z;
+};
+class TestVelocity {
+public:
+  float _x, _y, _z;
+};
+class TestTag {
+public:
+  uint32_t _value;
+};
+
+VG_TEST(EntityStore_ArchetypeMoves) {
+  EntityStore store;
+  std::vector<Entity> entities;
+  for (uint32_t i = 0; i < 10; ++i) {
+    entities.push_back(store.create(TestPosition{ (float)i, 0, 0 }, TestVelocity{ 1, 2, 3 }));
+  }
+  VG_CHECK(store.count() == 10 && store.archetypeCount() == 1);
+
+  //Adding moves the entity to a new archetype with its old components, the last entity fills its row.
+  VG_CHECK(store.add(entities[2], TestTag{ 7 }));
+  VG_CHECK(store.archetypeCount() == 2 && store.count() == 10);
+  VG_CHECK(store.has<TestTag>(entities[2]) && store.get<TestTag>(entities[2])->_value == 7);
+  VG_CHECK(store.get<TestPosition>(entities[2])->_x == 2 && store.get<TestVelocity>(entities[2])->_z == 3);
+  for (uint32_t i = 0; i < 10; ++i) {
+    VG_CHECK(store.valid(entities[i]) && store.get<TestPosition>(entities[i])->_x == (float)i);
+    VG_CHECK(store.has<TestTag>(entities[i]) == (i == 2));
+  }
+
+  //Adding a component it has only sets it.
+  VG_CHECK(store.add(entities[2], TestTag{ 9 }));
+  VG_CHECK(store.archetypeCount() == 2 && store.get<TestTag>(entities[2])->_value == 9);
+
+  //Removing moves it back, the emptied archetype stays for reuse.
+  VG_CHECK(store.remove<TestTag>(entities[2]));
+  VG_CHECK(!store.remove<TestTag>(entities[2]));
+  VG_CHECK(!store.has<TestTag>(entities[2]) && store.get<TestTag>(entities[2]) == nullptr);
+  VG_CHECK(store.get<TestPosition>(entities[2])->_x == 2);
+  VG_CHECK(store.remove<TestVelocity>(entities[5]));
+  VG_CHECK(store.archetypeCount() == 3);
+  VG_CHECK(store.get<TestVelocity>(entities[5]) == nullptr && store.get<TestPosition>(entities[5])->_x == 5);
+  for (uint32_t i = 0; i < 10; ++i) {
+    VG_CHECK(store.get<TestPosition>(entities[i])->_x == (float)i);
+  }
+}
+VG_TEST(EntityStore_DestroyAndReuse) {
+  EntityStore store;
+  std::vector<Entity> entities;
+  for (uint32_t i = 0; i < 5; ++i) {
+    entities.push_back(store.create(TestTag{ i }));
+  }
+  VG_CHECK(store.destroy(entities[1]));
+  VG_CHECK(!store.destroy(entities[1]));
+  VG_CHECK(!store.valid(entities[1]) && store.get<TestTag>(entities[1]) == nullptr);
+  VG_CHECK(store.count() == 4);
+  for (uint32_t i = 0; i < 5; ++i) {
+    VG_CHECK(i == 1 || store.get<TestTag>(entities[i])->_value == i);
+  }
+  //A reused slot gets a new generation.
+  Entity e = store.create(TestTag{ 100 });
+  VG_CHECK(e._slot == entities[1]._slot && e != entities[1]);
+  VG_CHECK(store.valid(e) && !store.valid(entities[1]));
+  store.clear();
+  VG_CHECK(store.count() == 0 && !store.valid(e) && !store.valid(entities[0]));
+}
+VG_TEST(EntityStore_Queries) {
+  //Enough entities for several chunks, half tagged so the query spans two archetypes.
+  const size_t c_entities = 5000;
+  const float dt = 0.5f;
+  EntityStore store;
+  std::vector<Entity> entities;
+  for (size_t i = 0; i < c_entities; ++i) {
+    if (i & 1) {
+      entities.push_back(store.create(TestPosition{ (float)i, 0, 0 }, TestVelocity{ 1, 2, 3 }, TestTag{ (uint32_t)i }));
+    }
+    else {
+      entities.push_back(store.create(TestPosition{ (float)i, 0, 0 }, TestVelocity{ 1, 2, 3 }));
+    }
+  }
+  VG_CHECK(store.chunkCount() > 2);
+  auto integrate = [dt](size_t count, const Entity*, TestPosition* p, const TestVelocity* v) {
+    for (size_t i = 0; i < count; ++i) {
+      p[i]._x += v[i]._x * dt;
+      p[i]._y += v[i]._y * dt;
+      p[i]._z += v[i]._z * dt;
+    }
+  };
+  store.forEachChunk<TestPosition, const TestVelocity>(integrate);
+  JobSystem jobs(3);
+  store.parallelForEachChunk<TestPosition, const TestVelocity>(jobs, integrate);
+
+  size_t visited = 0;
+  bool ok = true;
+  store.forEach<const TestPosition>([&](Entity e, const TestPosition& p) {
+    visited++;
+    size_t i = (size_t)(p._x - 2.0f * dt);
+    ok = ok && i < c_entities && entities[i] == e && p._y == 2.0f * 2.0f * dt && p._z == 3.0f * 2.0f * dt;
+  });
+  VG_CHECK(ok && visited == c_entities);
+  size_t tagged = 0;
+  store.forEach<const TestTag>([&](Entity, const TestTag& t) { tagged += (t._value & 1) ? 1 : 0; });
+  VG_CHECK(tagged == c_entities / 2);
+}
+VG_TEST(EntityStore_ScheduleWaves) {
+  //Readers of the same component share a wave, a writer starts a new one.
+  auto system = [](ComponentMask reads, ComponentMask writes) {
+    EntitySystem s;
+    s._reads = reads;
+    s._writes = writes;
+    s._update = [](EntityStore&, JobSystem&, float) {};
+    return s;
+  };
+  ComponentMask pos = componentBit<TestPosition>(), vel = componentBit<TestVelocity>(), tag = componentBit<TestTag>();
+  SystemSchedule schedule;
+  schedule.add(system(vel, pos));
+  schedule.add(system(0, tag));
+  VG_CHECK(schedule.waveCount() == 1);
+  schedule.add(system(pos, 0));
+  VG_CHECK(schedule.waveCount() == 2);
+  schedule.add(system(pos | tag, 0));
+  VG_CHECK(schedule.waveCount() == 2);
+  schedule.add(system(0, vel));
+  VG_CHECK(schedule.waveCount() == 2);
+  schedule.add(system(vel, 0));
+  VG_CHECK(schedule.waveCount() == 3);
+}
+
+}  // namespace VG
@@ -0,0 +1,71 @@
+#include "./SandboxTests.h"
+#include "../base/FrustumCuller.h"
+#include "../base/JobSystem.h"
+
+namespace VG {
+
+//Camera at the origin looking down -z, 90 degree fov.
+static Frustum testFrustum() {
+  const float c_near = 0.1f, c_far = 100.0f;
+  float view[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+  float proj[16] = { 1, 0, 0, 0,
+                     0, 1, 0, 0,
+                     0, 0, -(c_far + c_near) / (c_far - c_near), -1,
+                     0, 0, -2 * c_far * c_near / (c_far - c_near), 0 };
+  Frustum frustum;
+  frustum.fromViewProj(view, proj);
+  return frustum;
+}
+
+VG_TEST(FrustumCuller_KnownSpheres) {
+  //In front, behind, past the far plane, outside the left plane, crossing the left plane, crossing the far plane.
+  std::vector<float> x = { 0, 0, 0, -20, -10.5f, 0 };
+  std::vector<float> y = { 0, 0, 0, 0, 0, 0 };
+  std::vector<float> z = { -10, 10, -150, -10, -10, -100.5f };
+  std::vector<uint32_t> expected = { 0, 4, 5 };
+  CullSpheres spheres;
+  spheres._x = x.data();
+  spheres._y = y.data();
+  spheres._z = z.data();
+  spheres._uniformRadius = 1.0f;
+  Frustum frustum = testFrustum();
+  for (int il = 0; il <= (int)TransformKernels::simdLevel(); ++il) {
+    std::vector<uint32_t> visible(x.size());
+    visible.resize(FrustumCuller::cullSpheres(frustum, spheres, 0, x.size(), visible.data(), (SimdLevel)il));
+    VG_CHECK(visible == expected);
+  }
+}
+VG_TEST(FrustumCuller_LevelsAgree) {
+  //Every level and the parallel path give the scalar list, in ascending order. The count isn't a multiple of 8.
+  const size_t c_count = 100003;
+  std::mt19937 engine(1234);
+  std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+  std::vector<float> x(c_count), y(c_count), z(c_count);
+  for (size_t i = 0; i < c_count; ++i) {
+    x[i] = dist(engine);
+    y[i] = dist(engine);
+    z[i] = dist(engine);
+  }
+  CullSpheres spheres;
+  spheres._x = x.data();
+  spheres._y = y.data();
+  spheres._z = z.data();
+  spheres._uniformRadius = 0.866f;
+  Frustum frustum = testFrustum();
+
+  std::vector<uint32_t> expected(c_count);
+  expected.resize(FrustumCuller::cullSpheres(frustum, spheres, 0, c_count, expected.data(), SimdLevel::Scalar));
+  VG_CHECK(expected.size() > 0 && expected.size() < c_count);
+  VG_CHECK(std::is_sorted(expected.begin(), expected.end()));
+
+  std::vector<uint32_t> visible(c_count);
+  for (int il = 0; il <= (int)TransformKernels::simdLevel(); ++il) {
+    size_t n = FrustumCuller::cullSpheres(frustum, spheres, 0, c_count, visible.data(), (SimdLevel)il);
+    VG_CHECK(n == expected.size() && std::equal(expected.begin(), expected.end(), visible.begin()));
+  }
+  JobSystem jobs(3);
+  size_t n = FrustumCuller::cullSpheresParallel(jobs, 4096, frustum, spheres, c_count, visible.data());
+  VG_CHECK(n == expected.size() && std::equal(expected.begin(), expected.end(), visible.begin()));
+}
+
+}  // namespace VG
@@ -0,0 +1,51 @@
+#include "./SandboxTests.h"
+#include "../base/LodSelector.h"
+
+namespace VG {
+
+static bool closeTo(float a, float b) { return std::fabs(a - b) <= 1e-3f * std::max(1.0f, std::fabs(b)); }
+
+VG_TEST(LodSelector_Thresholds) {
+  //90 degrees over 1080 pixels is 540 pixels per unit at distance 1.
+  float scale = LodSelector::projScale(1080, 3.14159265f * 0.5f);
+  VG_CHECK(closeTo(scale, 540.0f));
+
+  //LOD l is fine from where its error projects to pixelError: d = error * scale / pixelError + radius.
+  const float c_errors[] = { 0, 0.01f, 0.04f, 0.16f };
+  std::vector<float> minDist2;
+  LodSelector::distanceThresholds(c_errors, 4, 0.5f, scale, 2.0f, minDist2);
+  VG_CHECK(minDist2.size() == 4);
+  VG_CHECK(minDist2[0] == 0);
+  for (uint32_t l = 1; l < 4; ++l) {
+    float d = c_errors[l] * scale / 2.0f + 0.5f;
+    VG_CHECK(closeTo(minDist2[l], d * d));
+    VG_CHECK(closeTo(c_errors[l] * scale / (std::sqrt(minDist2[l]) - 0.5f), 2.0f));
+  }
+
+  //A finer LOD after a coarser one can't need a smaller distance, the table stays sorted.
+  const float c_unsorted[] = { 0, 0.04f, 0.01f };
+  LodSelector::distanceThresholds(c_unsorted, 3, 0.5f, scale, 1.0f, minDist2);
+  VG_CHECK(minDist2[2] == minDist2[1]);
+}
+VG_TEST(LodSelector_SelectBuckets) {
+  //Thresholds at 10, 20 and 40 units, instances on the x axis either side of them.
+  std::vector<float> minDist2 = { 0, 100, 400, 1600 };
+  std::vector<float> x = { 50, 5, 9.9f, 10, 25, 19.9f, 40, 0, 1000 };
+  std::vector<float> y(x.size(), 0), z(x.size(), 0);
+  std::vector<uint8_t> expectedLod = { 3, 0, 0, 1, 2, 1, 3, 0, 3 };
+  LodBuckets buckets;
+  LodSelector::select(minDist2, x.data(), y.data(), z.data(), nullptr, x.size(), BR2::vec3(0, 0, 0), buckets);
+  VG_CHECK(buckets._first.size() == 4 && buckets._count.size() == 4);
+  VG_CHECK(buckets._lod == expectedLod);
+  VG_CHECK((buckets._count == std::vector<uint32_t>{ 3, 2, 1, 3 }));
+  VG_CHECK((buckets._first == std::vector<uint32_t>{ 0, 3, 5, 6 }));
+  VG_CHECK((buckets._instances == std::vector<uint32_t>{ 1, 2, 7, 3, 5, 4, 0, 6, 8 }));
+
+  //Only the listed ids, relative to the eye.
+  std::vector<uint32_t> ids = { 8, 4, 1 };
+  LodSelector::select(minDist2, x.data(), y.data(), z.data(), ids.data(), ids.size(), BR2::vec3(995, 0, 0), buckets);
+  VG_CHECK((buckets._count == std::vector<uint32_t>{ 1, 0, 0, 2 }));
+  VG_CHECK((buckets._instances == std::vector<uint32_t>{ 8, 4, 1 }));
+}
+
+}  // namespace VG
@@ -0,0 +1,139 @@
+#include "./SandboxTests.h"
+#include "../base/MaskedOcclusion.h"
+#include "../base/JobSystem.h"
+
+namespace VG {
+
+//Camera at the origin looking down -z, 90 degree fov. At z the screen is x, y in [-|z|, |z|].
+//The 256x128 buffer is 8x16 tiles, so NDC x = 0 is pixel 128, the left edge of tile column 4, and NDC y = 0 is
+//pixel row 64, the top of tile row 8.
+static const float c_near = 0.1f, c_far = 100.0f;
+static const float c_view[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+static const float c_proj[16] = { 1, 0, 0, 0,
+                                  0, 1, 0, 0,
+                                  0, 0, -(c_far + c_near) / (c_far - c_near), -1,
+                                  0, 0, -2 * c_far * c_near / (c_far - c_near), 0 };
+static const float c_occluderZ = -5.0f;
+static const float c_boxZ = -10.0f;
+
+//Quad facing the camera at c_occluderZ.
+static void addQuad(MaskedOcclusion& moc, float x0, float y0, float x1, float y1) {
+  float pos[12] = { x0, y0, c_occluderZ, x1, y0, c_occluderZ, x1, y1, c_occluderZ, x0, y1, c_occluderZ };
+  uint32_t inds[6] = { 0, 1, 2, 0, 2, 3 };
+  moc.addOccluder(pos, sizeof(float) * 3, 4, inds, 6, nullptr);
+}
+//Box of half depth 0.25 around c_boxZ.
+static bool boxVisible(const MaskedOcclusion& moc, float x0, float y0, float x1, float y1, float z = c_boxZ) {
+  float bmin[3] = { x0, y0, z - 0.25f }, bmax[3] = { x1, y1, z + 0.25f };
+  return moc.boxVisible(bmin, bmax);
+}
+static std::vector<SimdLevel> levels() {
+  std::vector<SimdLevel> ret = { SimdLevel::Scalar };
+  if (TransformKernels::simdLevel() == SimdLevel::AVX2) {
+    ret.push_back(SimdLevel::AVX2);
+  }
+  return ret;
+}
+
+VG_TEST(MaskedOcclusion_BehindAndBeside) {
+  for (SimdLevel level : levels()) {
+    MaskedOcclusion moc;
+    moc.begin(c_view, c_proj);
+    addQuad(moc, -1, -1, 1, 1);  //[-2, 2] at c_boxZ
+    moc.rasterize(nullptr, level);
+    VG_CHECK(moc.triangleCount() == 2);
+    VG_CHECK(!boxVisible(moc, -0.5f, -0.5f, 0.5f, 0.5f));           //Behind
+    VG_CHECK(boxVisible(moc, 4.0f, -0.5f, 5.0f, 0.5f));             //Beside
+    VG_CHECK(boxVisible(moc, -0.5f, -0.5f, 0.5f, 0.5f, -3.0f));     //In front
+    VG_CHECK(boxVisible(moc, 1.5f, -0.5f, 2.5f, 0.5f));             //Half behind
+  }
+}
+VG_TEST(MaskedOcclusion_TileEdgeX) {
+  for (SimdLevel level : levels()) {
+    //Covers pixel columns [0, 128), the first 4 tile columns exactly.
+    MaskedOcclusion moc;
+    moc.begin(c_view, c_proj);
+    addQuad(moc, -5, -5, 0, 5);
+    moc.rasterize(nullptr, level);
+    VG_CHECK(!boxVisible(moc, -8.0f, -2.0f, -1.0f, 2.0f));  //Columns 23-115
+    VG_CHECK(!boxVisible(moc, -1.0f, -2.0f, -0.2f, 2.0f));  //115-125, the last tile up to its edge
+    VG_CHECK(boxVisible(moc, -1.0f, -2.0f, 0.3f, 2.0f));    //115-131, 4 pixels into tile column 4
+    VG_CHECK(boxVisible(moc, 0.2f, -2.0f, 1.0f, 2.0f));     //130-141, only tile column 4
+  }
+}
+VG_TEST(MaskedOcclusion_TileEdgeY) {
+  for (SimdLevel level : levels()) {
+    //Covers one half of the pixel rows, 8 tile rows exactly whichever way y points.
+    MaskedOcclusion moc;
+    moc.begin(c_view, c_proj);
+    addQuad(moc, -5, -5, 5, 0);
+    moc.rasterize(nullptr, level);
+    VG_CHECK(!boxVisible(moc, -2.0f, -4.0f, 2.0f, -1.0f));  //Rows 6-26 from the edge
+    VG_CHECK(!boxVisible(moc, -2.0f, -1.0f, 2.0f, -0.3f));  //2-6 rows from the edge, in the last tile row
+    VG_CHECK(boxVisible(moc, -2.0f, -1.0f, 2.0f, 0.5f));    //3 rows past the edge
+  }
+}
+VG_TEST(MaskedOcclusion_EdgeInsideTile) {
+  for (SimdLevel level : levels()) {
+    //Right edge at pixel column 144, the middle of tile column 4. The per pixel mask decides.
+    MaskedOcclusion moc;
+    moc.begin(c_view, c_proj);
+    addQuad(moc, -5, -5, 0.625f, 5);
+    moc.rasterize(nullptr, level);
+    VG_CHECK(!boxVisible(moc, -1.0f, -2.0f, 1.0f, 2.0f));  //115-141
+    VG_CHECK(boxVisible(moc, 1.0f, -2.0f, 1.6f, 2.0f));    //141-149
+  }
+}
+VG_TEST(MaskedOcclusion_LevelsAgree) {
+  //Every SIMD level and the parallel raster give the scalar visible list, and nothing in front of the wall is culled.
+  MaskedOcclusion moc;
+  moc.begin(c_view, c_proj);
+  for (int py = 0; py < 4; ++py) {
+    for (int px = 0; px < 8; ++px) {
+      addQuad(moc, -4.0f + px, -2.0f + py, -3.0f + px, -1.0f + py);  //Abutting, a wall of x [-4, 4] y [-2, 2]
+    }
+  }
+  std::mt19937 engine(1234);
+  std::uniform_real_distribution<float> distXY(-10.0f, 10.0f), distZ(-20.0f, -1.0f);
+  const size_t c_spheres = 4096;
+  std::vector<float> x(c_spheres), y(c_spheres), z(c_spheres);
+  for (size_t i = 0; i < c_spheres; ++i) {
+    x[i] = distXY(engine);
+    y[i] = distXY(engine);
+    z[i] = distZ(engine);
+  }
+  CullSpheres spheres;
+  spheres._x = x.data();
+  spheres._y = y.data();
+  spheres._z = z.data();
+  spheres._uniformRadius = 0.5f;
+
+  Frustum frustum;
+  frustum.fromViewProj(c_view, c_proj);
+  std::vector<uint32_t> inFrustum(c_spheres);
+  inFrustum.resize(FrustumCuller::cullSpheres(frustum, spheres, 0, c_spheres, inFrustum.data()));
+
+  moc.rasterize(nullptr, SimdLevel::Scalar);
+  std::vector<uint32_t> expected(inFrustum.size());
+  expected.resize(moc.cullSpheres(spheres, inFrustum.data(), inFrustum.size(), expected.data(), SimdLevel::Scalar));
+  VG_CHECK(expected.size() < inFrustum.size());  //The wall hides something.
+  for (size_t i = 0, ie = 0; i < inFrustum.size(); ++i) {
+    uint32_t id = inFrustum[i];
+    bool kept = ie < expected.size() && expected[ie] == id;
+    ie += kept ? 1 : 0;
+    VG_CHECK(kept || z[id] + spheres._uniformRadius < c_occluderZ);
+  }
+
+  JobSystem jobs(3);
+  std::vector<uint32_t> visible(inFrustum.size());
+  for (SimdLevel level : levels()) {
+    moc.rasterize(nullptr, level);
+    size_t n = moc.cullSpheres(spheres, inFrustum.data(), inFrustum.size(), visible.data(), level);
+    VG_CHECK(n == expected.size() && std::equal(expected.begin(), expected.end(), visible.begin()));
+  }
+  moc.rasterize(&jobs);
+  size_t n = moc.cullSpheresParallel(jobs, 256, spheres, inFrustum.data(), inFrustum.size(), visible.data());
+  VG_CHECK(n == expected.size() && std::equal(expected.begin(), expected.end(), visible.begin()));
+}
+
+}  // namespace VG
@@ -0,0 +1,23 @@
+#include "./SandboxTests.h"
+#include "../base/MeshBatch.h"
+
+namespace VG {
+
+VG_TEST(MeshBatch_IndirectDraws) {
+  //One command per range drawn, in order. Empty ranges and ranges with no instances are skipped.
+  std::vector<MeshBatch::Range> ranges = { { 0, 36, 0 }, { 36, 0, 24 }, { 36, 720, 24 }, { 756, 6, 500 } };
+  IndirectDrawBuilder builder;
+  builder.add(ranges[0], 10, 0);
+  builder.add(ranges[1], 5, 10);
+  builder.add(ranges[2], 0, 15);
+  builder.add(ranges[3], 3, 15);
+  VG_CHECK(builder.size() == 2);
+  const VkDrawIndexedIndirectCommand& a = builder.draws()[0];
+  const VkDrawIndexedIndirectCommand& b = builder.draws()[1];
+  VG_CHECK(a.firstIndex == 0 && a.indexCount == 36 && a.vertexOffset == 0 && a.instanceCount == 10 && a.firstInstance == 0);
+  VG_CHECK(b.firstIndex == 756 && b.indexCount == 6 && b.vertexOffset == 500 && b.instanceCount == 3 && b.firstInstance == 15);
+  builder.clear();
+  VG_CHECK(builder.size() == 0);
+}
+
+}  // namespace VG
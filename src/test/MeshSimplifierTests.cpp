@@ -0,0 +1,102 @@
+#include "./SandboxTests.h"
+#include "../base/MeshSimplifier.h"
+#include "../base/GWorld.h"
+#include "../base/JobSystem.h"
+
+namespace VG {
+
+//Whole triangles with every index in range.
+static bool validIndexes(const std::vector<uint32_t>& inds, size_t vertexCount) {
+  if (inds.size() % 3 != 0) {
+    return false;
+  }
+  for (auto i : inds) {
+    if (i >= vertexCount) {
+      return false;
+    }
+  }
+  return true;
+}
+
+VG_TEST(MeshSimplifier_TriangleBudget) {
+  std::vector<v_v3c4x2n3> verts;
+  std::vector<uint32_t> inds;
+  Mesh::makeSphereData(64, 32, verts, inds);
+  SimplifyOptions opt;
+  size_t lastTriangles = inds.size() / 3;
+  for (uint32_t div : { 2u, 4u, 8u }) {
+    size_t target = inds.size() / div / 3 * 3;
+    SimplifyStats st;
+    std::vector<uint32_t> lod = MeshSimplifier::simplify(verts, inds, target, opt, &st);
+    //Within budget, not far under it, and every level coarser than the last.
+    VG_CHECK(lod.size() <= target);
+    VG_CHECK(lod.size() >= target * 3 / 4);
+    VG_CHECK(validIndexes(lod, verts.size()));
+    VG_CHECK(st._sourceTriangles == inds.size() / 3 && st._triangles == lod.size() / 3);
+    VG_CHECK(st._triangles < lastTriangles);
+    //Still a sphere of diameter 1.
+    VG_CHECK(st._error > 0 && st._error < 0.05f);
+    lastTriangles = st._triangles;
+  }
+}
+VG_TEST(MeshSimplifier_MaxErrorStops) {
+  std::vector<v_v3c4x2n3> verts;
+  std::vector<uint32_t> inds;
+  Mesh::makeSphereData(64, 32, verts, inds);
+  SimplifyOptions opt;
+  SimplifyStats unlimited;
+  MeshSimplifier::simplify(verts, inds, 0, opt, &unlimited);
+  opt._maxError = unlimited._error * 0.25f;
+  SimplifyStats capped;
+  MeshSimplifier::simplify(verts, inds, 0, opt, &capped);
+  VG_CHECK(capped._error <= opt._maxError);
+  VG_CHECK(capped._triangles > unlimited._triangles);
+}
+VG_TEST(MeshSimplifier_LockedBorders) {
+  //An open grid: with locked borders every border vertex is still used, and the grid still spans its outline.
+  const uint32_t c_n = 16;
+  std::vector<v_v3c4x2n3> verts;
+  std::vector<uint32_t> inds;
+  for (uint32_t iy = 0; iy <= c_n; ++iy) {
+    for (uint32_t ix = 0; ix <= c_n; ++ix) {
+      verts.push_back({ BR2::vec3((float)ix, 0, (float)iy), { 1, 1, 1, 1 }, { (float)ix / c_n, (float)iy / c_n }, BR2::vec3(0, 1, 0) });
+    }
+  }
+  for (uint32_t iy = 0; iy < c_n; ++iy) {
+    for (uint32_t ix = 0; ix < c_n; ++ix) {
+      uint32_t a = iy * (c_n + 1) + ix, b = a + c_n + 1;
+      inds.insert(inds.end(), { a, b, a + 1, a + 1, b, b + 1 });
+    }
+  }
+  SimplifyOptions opt;
+  SimplifyStats st;
+  std::vector<uint32_t> lod = MeshSimplifier::simplify(verts, inds, 0, opt, &st);
+  VG_CHECK(validIndexes(lod, verts.size()));
+  VG_CHECK(st._triangles < inds.size() / 3);
+  //Flat, so nothing moves off the plane.
+  VG_CHECK(st._error < 1e-4f);
+  std::vector<uint8_t> used(verts.size(), 0);
+  for (auto i : lod) {
+    used[i] = 1;
+  }
+  for (uint32_t iy = 0; iy <= c_n; ++iy) {
+    for (uint32_t ix = 0; ix <= c_n; ++ix) {
+      if (ix == 0 || iy == 0 || ix == c_n || iy == c_n) {
+        VG_CHECK(used[iy * (c_n + 1) + ix]);
+      }
+    }
+  }
+}
+VG_TEST(MeshSimplifier_JobsMatchSerial) {
+  //Costing on the job system doesn't change which collapses are made.
+  std::vector<v_v3c4x2n3> verts;
+  std::vector<uint32_t> inds;
+  Mesh::makeSphereData(128, 64, verts, inds);
+  SimplifyOptions opt;
+  JobSystem jobs(3);
+  std::vector<uint32_t> serial = MeshSimplifier::simplify(verts, inds, inds.size() / 4 / 3 * 3, opt);
+  std::vector<uint32_t> parallel = MeshSimplifier::simplify(verts, inds, inds.size() / 4 / 3 * 3, opt, nullptr, &jobs);
+  VG_CHECK(serial == parallel);
+}
+
+}  // namespace VG
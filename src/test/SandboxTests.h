@@ -0,0 +1,51 @@
+/**
+*  @file SandboxTests.h
+*  @date 10/18/2026
+*  @author Derek Page
+*  @brief Headless unit tests of the engine side code, run by ctest. No window or Vulkan device.
+*/
+#pragma once
+#ifndef __SANDBOXTESTS_17923501846230917745213_H__
+#define __SANDBOXTESTS_17923501846230917745213_H__
+
+#include "../base/SandboxHeader.h"
+#include <stdexcept>
+
+namespace VG {
+
+/**
+ * @class TestFailure
+ * @brief Thrown by VG_CHECK, the test stops at the first failed check.
+ * */
+class TestFailure : public std::runtime_error {
+public:
+  TestFailure(const string_t& msg) : std::runtime_error(msg) {}
+};
+/**
+ * @class Tests
+ * @brief Registry of the VG_TEST functions.
+ * @details SandboxTests [group] runs the tests whose name starts with group, ctest runs one group per add_test.
+ * */
+class Tests {
+public:
+  typedef void (*TestFunc)();
+  static bool add(const char* name, TestFunc func);
+  static int run(const string_t& group);  //Returns the number of failed tests.
+};
+
+}  // namespace VG
+
+//VG_TEST(Group_Name) { VG_CHECK(..); }
+#define VG_TEST(name)                                                   \
+  static void name();                                                   \
+  static const bool name##_registered = VG::Tests::add(#name, &name); \
+  static void name()
+
+#define VG_CHECK(x)                                                                                          \
+  do {                                                                                                       \
+    if (!(x)) {                                                                                              \
+      throw VG::TestFailure(std::string(__FILE__) + "(" + std::to_string(__LINE__) + "): check failed: " #x); \
+    }                                                                                                        \
+  } while (0)
+
+#endif
@@ -0,0 +1,141 @@
+#include "./SandboxTests.h"
+#include "../base/SceneGraph.h"
+
+namespace VG {
+
+//World matrix from the node's ancestors, column major.
+static void referenceWorld(const SceneGraph& graph, SceneNode n, float* out) {
+  SceneNode parent = graph.parentOf(n);
+  if (!graph.valid(parent)) {
+    memcpy(out, graph.local(n), 16 * sizeof(float));
+    return;
+  }
+  float pw[16];
+  referenceWorld(graph, parent, pw);
+  const float* l = graph.local(n);
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      out[c * 4 + r] = pw[r] * l[c * 4] + pw[4 + r] * l[c * 4 + 1] + pw[8 + r] * l[c * 4 + 2] + pw[12 + r] * l[c * 4 + 3];
+    }
+  }
+}
+static bool worldMatchesReference(const SceneGraph& graph, const std::vector<SceneNode>& nodes) {
+  for (auto n : nodes) {
+    if (!graph.valid(n)) {
+      continue;
+    }
+    float expected[16];
+    referenceWorld(graph, n, expected);
+    const float* w = graph.world(n);
+    for (int i = 0; i < 16; ++i) {
+      if (std::fabs(expected[i] - w[i]) > 1e-3f) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+class TestHierarchy {
+public:
+  static constexpr size_t c_roots = 20, c_children = 4, c_grandchildren = 5;
+  SceneGraph _graph;
+  std::vector<SceneNode> _roots;
+  std::vector<SceneNode> _nodes;
+  std::mt19937 _engine{ 1234 };
+
+  void randomLocal(float* out) {
+    std::uniform_real_distribution<float> dist(-1, 1);
+    BR2::vec3 axis(dist(_engine), dist(_engine), dist(_engine) + 2.0f);
+    axis.normalize();
+    SceneGraph::composeLocal(BR2::vec3(dist(_engine) * 3, dist(_engine) * 3, dist(_engine) * 3), axis, dist(_engine) * 3.14f, out);
+  }
+  //Created depth first, the first update() lays it out breadth first.
+  TestHierarchy() {
+    float m[16];
+    for (size_t ir = 0; ir < c_roots; ++ir) {
+      randomLocal(m);
+      SceneNode root = _graph.create(SceneNode(), m);
+      _roots.push_back(root);
+      _nodes.push_back(root);
+      for (size_t ic = 0; ic < c_children; ++ic) {
+        randomLocal(m);
+        SceneNode child = _graph.create(root, m);
+        _nodes.push_back(child);
+        for (size_t ig = 0; ig < c_grandchildren; ++ig) {
+          randomLocal(m);
+          _nodes.push_back(_graph.create(child, m));
+        }
+      }
+    }
+  }
+};
+
+VG_TEST(SceneGraph_LayoutIsBreadthFirst) {
+  TestHierarchy h;
+  h._graph.update();
+  VG_CHECK(h._graph.layoutChanged());
+  VG_CHECK(h._graph.changed().size() == h._nodes.size());
+  //Parents before children.
+  for (auto n : h._nodes) {
+    SceneNode parent = h._graph.parentOf(n);
+    VG_CHECK(!h._graph.valid(parent) || h._graph.indexOf(parent) < h._graph.indexOf(n));
+  }
+  VG_CHECK(worldMatchesReference(h._graph, h._nodes));
+}
+VG_TEST(SceneGraph_IncrementalUpdate) {
+  TestHierarchy h;
+  h._graph.setUploadChannels(2);
+  h._graph.update();
+  h._graph.clearUploadDirty(0);
+
+  //Nothing dirty, nothing rebuilt.
+  h._graph.update();
+  VG_CHECK(h._graph.changed().empty() && !h._graph.layoutChanged());
+
+  //One root rebuilds exactly its subtree, and only those are dirty for upload.
+  const size_t c_subtree = 1 + TestHierarchy::c_children * (1 + TestHierarchy::c_grandchildren);
+  float m[16];
+  h.randomLocal(m);
+  h._graph.setLocal(h._roots[3], m);
+  h._graph.update();
+  VG_CHECK(h._graph.changed().size() == c_subtree);
+  VG_CHECK(std::is_sorted(h._graph.changed().begin(), h._graph.changed().end()));
+  VG_CHECK(h._graph.uploadDirty(0).count() == c_subtree);
+  VG_CHECK(h._graph.uploadDirty(1).count() == h._nodes.size());
+  VG_CHECK(worldMatchesReference(h._graph, h._nodes));
+
+  //A leaf rebuilds only itself.
+  SceneNode leaf = h._nodes.back();
+  h.randomLocal(m);
+  h._graph.setLocal(leaf, m);
+  h._graph.update();
+  VG_CHECK(h._graph.changed().size() == 1 && h._graph.changed()[0] == h._graph.indexOf(leaf));
+  VG_CHECK(worldMatchesReference(h._graph, h._nodes));
+}
+VG_TEST(SceneGraph_DestroySubtree) {
+  TestHierarchy h;
+  h._graph.update();
+  //The second child of the first root and its grandchildren.
+  size_t first = 1 + (1 + TestHierarchy::c_grandchildren);
+  SceneNode child = h._nodes[first];
+  VG_CHECK(h._graph.parentOf(child) == h._roots[0]);
+  VG_CHECK(h._graph.destroy(child));
+  VG_CHECK(!h._graph.destroy(child));
+  for (size_t i = first; i < first + 1 + TestHierarchy::c_grandchildren; ++i) {
+    VG_CHECK(!h._graph.valid(h._nodes[i]));
+  }
+  VG_CHECK(h._graph.count() == h._nodes.size() - (1 + TestHierarchy::c_grandchildren));
+  VG_CHECK(h._graph.valid(h._roots[0]) && h._graph.valid(h._nodes[1]));
+
+  //Freed slots are reused with a new generation, the stale handles stay invalid.
+  float m[16];
+  h.randomLocal(m);
+  SceneNode reused = h._graph.create(h._roots[0], m);
+  h._nodes.push_back(reused);
+  VG_CHECK(h._graph.valid(reused) && !h._graph.valid(child));
+  h._graph.update();
+  VG_CHECK(h._graph.layoutChanged());
+  VG_CHECK(worldMatchesReference(h._graph, h._nodes));
+}
+
+}  // namespace VG
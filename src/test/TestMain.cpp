@@ -0,0 +1,41 @@
+#include "./SandboxTests.h"
+
+namespace VG {
+
+static std::vector<std::pair<const char*, Tests::TestFunc>>& registry() {
+  static std::vector<std::pair<const char*, Tests::TestFunc>> tests;
+  return tests;
+}
+bool Tests::add(const char* name, TestFunc func) {
+  registry().push_back(std::make_pair(name, func));
+  return true;
+}
+int Tests::run(const string_t& group) {
+  int ran = 0, failed = 0;
+  for (auto& test : registry()) {
+    if (!StringUtil::startsWith(test.first, group)) {
+      continue;
+    }
+    ran++;
+    try {
+      test.second();
+      BRLogInfo("[ OK ] " + std::string(test.first));
+    }
+    catch (std::exception& ex) {
+      BRLogError("[FAIL] " + std::string(test.first) + ": " + ex.what());
+      failed++;
+    }
+  }
+  if (ran == 0) {
+    BRLogError("No tests matched '" + group + "'.");
+    return 1;
+  }
+  BRLogInfo(std::to_string(ran - failed) + "/" + std::to_string(ran) + " tests passed.");
+  return failed;
+}
+
+}  // namespace VG
+
+int main(int argc, char** argv) {
+  return VG::Tests::run(argc > 1 ? argv[1] : "") == 0 ? 0 : 1;
+}